@@ -0,0 +1,259 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "defns.h"
+
+#include "activity.h"
+
+/* Pending activity is flushed at most this often */
+#define ACTIVITY_FRAME_MS 16
+
+struct ActivityMonitor {
+    ROXTermData *roxterm;
+    gboolean queued;            /* In activity_global.pending */
+    gboolean output_pending;
+    guint bells_pending;
+    gint64 last_output;
+    gboolean watching;          /* In activity_global.watching */
+    int silence_secs;
+    guint bell_limit;
+    gint64 bell_window_start;
+    guint bells_in_window;
+    guint dropped_bells;
+};
+
+typedef struct {
+    ActivityHandler activity_handler;
+    ActivitySilenceHandler silence_handler;
+    GList *pending;             /* Monitors with unflushed output or bells */
+    GList *watching;            /* Monitors waiting for silence */
+    guint tag;
+    guint interval;
+} ActivityGlobal;
+
+static ActivityGlobal activity_global;
+
+void activity_init(ActivityHandler activity_handler,
+        ActivitySilenceHandler silence_handler)
+{
+    activity_global.activity_handler = activity_handler;
+    activity_global.silence_handler = silence_handler;
+}
+
+/* Returns 0 if the timer isn't needed */
+static guint activity_next_interval(gint64 now)
+{
+    GList *link;
+    gint64 deadline = G_MAXINT64;
+
+    if (activity_global.pending)
+        return ACTIVITY_FRAME_MS;
+    for (link = activity_global.watching; link; link = g_list_next(link))
+    {
+        ActivityMonitor *am = link->data;
+        gint64 d = am->last_output +
+                (gint64) am->silence_secs * G_USEC_PER_SEC;
+
+        if (d < deadline)
+            deadline = d;
+    }
+    if (deadline == G_MAXINT64)
+        return 0;
+    deadline = (deadline - now) / 1000 + 1;
+    return deadline < ACTIVITY_FRAME_MS ? ACTIVITY_FRAME_MS : (guint) deadline;
+}
+
+static gboolean activity_tick(gpointer data);
+
+static void activity_schedule(guint interval)
+{
+    if (activity_global.tag)
+    {
+        if (interval == activity_global.interval)
+            return;
+        g_source_remove(activity_global.tag);
+        activity_global.tag = 0;
+    }
+    activity_global.interval = interval;
+    if (interval)
+        activity_global.tag = g_timeout_add(interval, activity_tick, NULL);
+}
+
+static void activity_flush(ActivityMonitor *am, gint64 now)
+{
+    guint bells = am->bells_pending;
+    gboolean output = am->output_pending;
+
+    am->queued = FALSE;
+    am->output_pending = FALSE;
+    am->bells_pending = 0;
+    if (!output && !bells)
+        return;
+    if (output)
+    {
+        am->last_output = now;
+        if (am->silence_secs && !am->watching)
+        {
+            am->watching = TRUE;
+            activity_global.watching =
+                    g_list_prepend(activity_global.watching, am);
+        }
+    }
+    if (activity_global.activity_handler)
+        activity_global.activity_handler(am->roxterm, bells);
+}
+
+static gboolean activity_tick(gpointer data)
+{
+    gint64 now = g_get_monotonic_time();
+    GList *pending = activity_global.pending;
+    GList *silent = NULL;
+    GList *link;
+    guint interval;
+    (void) data;
+
+    activity_global.pending = NULL;
+    for (link = pending; link; link = g_list_next(link))
+        activity_flush(link->data, now);
+    g_list_free(pending);
+
+    for (link = activity_global.watching; link; )
+    {
+        ActivityMonitor *am = link->data;
+        GList *next = g_list_next(link);
+
+        if (now - am->last_output >=
+                (gint64) am->silence_secs * G_USEC_PER_SEC)
+        {
+            am->watching = FALSE;
+            activity_global.watching =
+                    g_list_delete_link(activity_global.watching, link);
+            silent = g_list_prepend(silent, am);
+        }
+        link = next;
+    }
+    for (link = silent; link; link = g_list_next(link))
+    {
+        ActivityMonitor *am = link->data;
+
+        if (activity_global.silence_handler)
+            activity_global.silence_handler(am->roxterm);
+    }
+    g_list_free(silent);
+
+    interval = activity_next_interval(now);
+    if (interval == activity_global.interval)
+        return G_SOURCE_CONTINUE;
+    activity_global.tag = 0;
+    activity_schedule(interval);
+    return G_SOURCE_REMOVE;
+}
+
+static void activity_queue(ActivityMonitor *am)
+{
+    if (am->queued)
+        return;
+    am->queued = TRUE;
+    activity_global.pending = g_list_prepend(activity_global.pending, am);
+    activity_schedule(ACTIVITY_FRAME_MS);
+}
+
+ActivityMonitor *activity_monitor_new(ROXTermData *roxterm)
+{
+    ActivityMonitor *am = g_new0(ActivityMonitor, 1);
+
+    am->roxterm = roxterm;
+    return am;
+}
+
+static void activity_monitor_unwatch(ActivityMonitor *am)
+{
+    if (am->watching)
+    {
+        activity_global.watching =
+                g_list_remove(activity_global.watching, am);
+        am->watching = FALSE;
+    }
+}
+
+void activity_monitor_delete(ActivityMonitor *am)
+{
+    if (am->queued)
+        activity_global.pending = g_list_remove(activity_global.pending, am);
+    activity_monitor_unwatch(am);
+    g_free(am);
+    if (!activity_global.pending && !activity_global.watching)
+        activity_schedule(0);
+}
+
+void activity_monitor_configure(ActivityMonitor *am,
+        int silence_secs, int bell_limit)
+{
+    am->silence_secs = silence_secs > 0 ? silence_secs : 0;
+    am->bell_limit = bell_limit > 0 ? bell_limit : 0;
+    if (!am->silence_secs)
+        activity_monitor_unwatch(am);
+}
+
+void activity_monitor_note_output(ActivityMonitor *am)
+{
+    am->output_pending = TRUE;
+    activity_queue(am);
+}
+
+void activity_monitor_note_bell(ActivityMonitor *am)
+{
+    if (am->bell_limit)
+    {
+        gint64 now = g_get_monotonic_time();
+
+        if (now - am->bell_window_start >= G_USEC_PER_SEC)
+        {
+            am->bell_window_start = now;
+            am->bells_in_window = 0;
+        }
+        if (am->bells_in_window >= am->bell_limit)
+        {
+            ++am->dropped_bells;
+            return;
+        }
+        ++am->bells_in_window;
+    }
+    ++am->bells_pending;
+    activity_queue(am);
+}
+
+void activity_monitor_reset(ActivityMonitor *am)
+{
+    am->output_pending = FALSE;
+    am->bells_pending = 0;
+    activity_monitor_unwatch(am);
+}
+
+guint activity_monitor_get_dropped_bells(ActivityMonitor *am)
+{
+    return am->dropped_bells;
+}
+
+gint64 activity_monitor_get_last_output(ActivityMonitor *am)
+{
+    return am->last_output;
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
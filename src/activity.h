@@ -0,0 +1,73 @@
+#ifndef ACTIVITY_H
+#define ACTIVITY_H
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* Tracks output, bells and silence for each terminal. Signals from VTE only
+ * set flags here; the consequences (status icons, attention, urgency hints)
+ * are applied at most once per frame by a single timer shared by all
+ * terminals, which only runs while there's something to do.
+ */
+
+#include "roxterm.h"
+
+typedef struct ActivityMonitor ActivityMonitor;
+
+/* Called from the shared timer with the number of bells which got through
+ * the rate limit since the last call; bells is 0 if there was only output
+ * (but there may be output as well as bells).
+ */
+typedef void (*ActivityHandler)(ROXTermData *roxterm, guint bells);
+
+/* Called once when a terminal has been silent for its configured period after
+ * producing output.
+ */
+typedef void (*ActivitySilenceHandler)(ROXTermData *roxterm);
+
+void activity_init(ActivityHandler activity_handler,
+        ActivitySilenceHandler silence_handler);
+
+ActivityMonitor *activity_monitor_new(ROXTermData *roxterm);
+
+void activity_monitor_delete(ActivityMonitor *am);
+
+/* silence_secs of 0 disables silence alerts, bell_limit is the maximum
+ * number of bells per second which are reported, 0 for no limit.
+ */
+void activity_monitor_configure(ActivityMonitor *am,
+        int silence_secs, int bell_limit);
+
+void activity_monitor_note_output(ActivityMonitor *am);
+
+void activity_monitor_note_bell(ActivityMonitor *am);
+
+/* Forget about pending activity eg when the tab is selected */
+void activity_monitor_reset(ActivityMonitor *am);
+
+/* Number of bells ignored due to the rate limit */
+guint activity_monitor_get_dropped_bells(ActivityMonitor *am);
+
+/* Timestamp (g_get_monotonic_time) of most recent output, at frame
+ * resolution, or 0 if none yet.
+ */
+gint64 activity_monitor_get_last_output(ActivityMonitor *am);
+
+#endif /* ACTIVITY_H */
+
+/* vi:set sw=4 ts=4 et cindent cino= */
@@ -0,0 +1,82 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "defns.h"
+
+#include "bench.h"
+
+/* Counts calls to malloc etc by overriding them, in the same way as
+ * osc52filter.c overrides read(). This relies on glibc exporting its real
+ * allocator under other names; elsewhere allocations aren't counted.
+ */
+
+#ifdef __GLIBC__
+
+#include <stddef.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static gsize bench_alloc_count;
+static gsize bench_alloc_bytes;
+
+inline static void bench_alloc_note(size_t size)
+{
+    g_atomic_pointer_add(&bench_alloc_count, 1);
+    g_atomic_pointer_add(&bench_alloc_bytes, (gssize) size);
+}
+
+void *malloc(size_t size)
+{
+    bench_alloc_note(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    bench_alloc_note(nmemb * size);
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    bench_alloc_note(size);
+    return __libc_realloc(ptr, size);
+}
+
+gboolean bench_alloc_get_counts(guint64 *count, guint64 *bytes)
+{
+    *count = (gsize) g_atomic_pointer_get(&bench_alloc_count);
+    *bytes = (gsize) g_atomic_pointer_get(&bench_alloc_bytes);
+    return TRUE;
+}
+
+#else
+
+gboolean bench_alloc_get_counts(guint64 *count, guint64 *bytes)
+{
+    *count = 0;
+    *bytes = 0;
+    return FALSE;
+}
+
+#endif
+
+/* vi:set sw=4 ts=4 et cindent cino= */
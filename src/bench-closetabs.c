@@ -0,0 +1,138 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "defns.h"
+
+#include "bench.h"
+#include "multitab.h"
+
+/* Opens windows with a lot of tabs, each with some scrollback, and times
+ * closing all but one of the tabs, then closing a whole window. Each case
+ * reports how long the close itself took, which is how long the UI is
+ * blocked, and how long it took until all the terminals had been destroyed
+ * in the background. This needs a display; use xvfb-run where there isn't
+ * one.
+ */
+
+#define BENCH_CLOSE_TABS_LINES 2000
+
+static const guint bench_close_tabs_counts[] = { 30, 300 };
+
+static void bench_close_tabs_fill(MultiWin *win)
+{
+    GString *text = g_string_new(NULL);
+    GList *link;
+    int line;
+
+    for (line = 0; line < BENCH_CLOSE_TABS_LINES; ++line)
+    {
+        g_string_append_printf(text,
+                "%06d CC src/module%d.o -O2 -Wall -I../include "
+                "-c ../src/module%d.c\r\n", line, line % 89, line % 89);
+    }
+    for (link = multi_win_get_tabs(win); link; link = g_list_next(link))
+    {
+        vte_terminal_feed(roxterm_get_vte_terminal(
+                    multi_tab_get_user_data(link->data)),
+                text->str, text->len);
+    }
+    g_string_free(text, TRUE);
+    bench_drain_main_loop();
+}
+
+/* Opens a new window with ntabs tabs */
+static MultiWin *bench_close_tabs_open_window(guint ntabs)
+{
+    GList *old_wins = g_list_copy(multi_win_all);
+    MultiWin *win = NULL;
+    GList *link;
+
+    bench_open_terminal(FALSE);
+    for (link = multi_win_all; link && !win; link = g_list_next(link))
+    {
+        if (!g_list_find(old_wins, link->data))
+            win = link->data;
+    }
+    g_list_free(old_wins);
+    if (!win)
+        return NULL;
+    while (multi_win_get_ntabs(win) < ntabs)
+        multi_tab_new(win, multi_win_get_user_data_for_current_tab(win));
+    bench_drain_main_loop();
+    bench_close_tabs_fill(win);
+    return win;
+}
+
+static void bench_close_tabs_report(BenchReport *report, const char *name,
+        gint64 start, gint64 closed)
+{
+    char *key = g_strdup_printf("%s_usec", name);
+
+    bench_report_int(report, key, closed - start);
+    g_free(key);
+    bench_drain_main_loop();
+    key = g_strdup_printf("%s_destroyed_usec", name);
+    bench_report_int(report, key, g_get_monotonic_time() - start);
+    g_free(key);
+}
+
+void bench_close_tabs(BenchReport *report)
+{
+    guint n;
+
+    /* Make sure there's another window, so closing the benchmark's windows
+     * doesn't quit */
+    if (!bench_open_terminal(FALSE))
+    {
+        bench_report_string(report, "skipped", "unable to open a terminal");
+        return;
+    }
+    for (n = 0; n < G_N_ELEMENTS(bench_close_tabs_counts); ++n)
+    {
+        guint ntabs = bench_close_tabs_counts[n];
+        char *name = g_strdup_printf("tabs_%u", ntabs);
+        MultiWin *win = bench_close_tabs_open_window(ntabs);
+        gint64 start;
+
+        bench_report_begin_case(report, name);
+        g_free(name);
+        if (!win)
+        {
+            bench_report_string(report, "skipped", "unable to open a window");
+            continue;
+        }
+        bench_report_int(report, "tabs", multi_win_get_ntabs(win));
+        start = g_get_monotonic_time();
+        multi_win_close_other_tabs(win, multi_win_get_current_tab(win));
+        bench_close_tabs_report(report, "close_others", start,
+                g_get_monotonic_time());
+        multi_win_delete(win);
+
+        win = bench_close_tabs_open_window(ntabs);
+        if (!win)
+            continue;
+        start = g_get_monotonic_time();
+        multi_win_delete(win);
+        bench_close_tabs_report(report, "close_window", start,
+                g_get_monotonic_time());
+    }
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
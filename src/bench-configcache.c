@@ -0,0 +1,167 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+
+#include "defns.h"
+
+#include <glib/gstdio.h>
+
+#include "bench.h"
+#include "configcache.h"
+#include "dynopts.h"
+#include "optsfile.h"
+
+/* Times reading every config file roxterm can find, and parsing the colours
+ * and shortcuts in them, without the config cache (cold) and with a cache
+ * which has just been written and mapped again (warm). Each includes opening
+ * the cache, so it's the cost at startup. The cache is written to a
+ * temporary directory so the user's own cache isn't touched.
+ */
+
+#define BENCH_CONFIG_CACHE_ROUNDS 20
+
+typedef struct {
+    const char *family;
+    const char *group_name;
+} BenchConfigFamily;
+
+static const BenchConfigFamily bench_config_families[] = {
+    { "Profiles", "roxterm profile" },
+    { "Colours", "roxterm colour scheme" },
+    { "Shortcuts", "roxterm shortcuts scheme" }
+};
+
+/* Parses every value in kf as a colour or shortcut, which is close to what
+ * colourscheme.c and shortcuts.c do with them.
+ */
+static void bench_config_cache_parse(GKeyFile *kf, const char *group_name,
+        gboolean accels)
+{
+    char **keys = g_key_file_get_keys(kf, group_name, NULL, NULL);
+    char **pkey;
+
+    for (pkey = keys; pkey && *pkey; ++pkey)
+    {
+        char *value = g_key_file_get_string(kf, group_name, *pkey, NULL);
+
+        if (!value)
+            continue;
+        if (accels)
+        {
+            guint key;
+            GdkModifierType modifiers;
+
+            config_cache_parse_accel(value, &key, &modifiers);
+        }
+        else
+        {
+            GdkRGBA colour;
+
+            config_cache_parse_colour(value, &colour);
+        }
+        g_free(value);
+    }
+    g_strfreev(keys);
+}
+
+/* Returns the number of files */
+static int bench_config_cache_load_all(void)
+{
+    int nfiles = 1;
+    guint f;
+
+    options_file_delete(options_file_open("Global", "roxterm options"));
+    for (f = 0; f < G_N_ELEMENTS(bench_config_families); ++f)
+    {
+        const BenchConfigFamily *family = &bench_config_families[f];
+        char **names = dynamic_options_list(
+                dynamic_options_get(family->family));
+        char **pname;
+
+        for (pname = names; *pname; ++pname, ++nfiles)
+        {
+            char *leafname = g_build_filename(family->family, *pname, NULL);
+            GKeyFile *kf = options_file_open(leafname, family->group_name);
+
+            if (f > 0)
+                bench_config_cache_parse(kf, family->group_name, f == 2);
+            options_file_delete(kf);
+            g_free(leafname);
+        }
+        g_strfreev(names);
+    }
+    return nfiles;
+}
+
+static gint64 bench_config_cache_time(const char *cache_file, int *nfiles)
+{
+    gint64 start = g_get_monotonic_time();
+    int n;
+
+    for (n = 0; n < BENCH_CONFIG_CACHE_ROUNDS; ++n)
+    {
+        /* Forgets the mapping and everything parsed so far */
+        config_cache_set_filename(cache_file);
+        *nfiles = bench_config_cache_load_all();
+    }
+    return (g_get_monotonic_time() - start) / BENCH_CONFIG_CACHE_ROUNDS;
+}
+
+void bench_config_cache(BenchReport *report)
+{
+    char *dir = bench_make_tmp_dir();
+    char *cache_file = g_build_filename(dir, "config-cache", NULL);
+    gint64 start;
+    gint64 usec;
+    int nfiles = 0;
+    GStatBuf st;
+
+    config_cache_set_enabled(FALSE);
+    usec = bench_config_cache_time(NULL, &nfiles);
+    config_cache_set_enabled(TRUE);
+    bench_report_int(report, "files", nfiles);
+    bench_report_int(report, "rounds", BENCH_CONFIG_CACHE_ROUNDS);
+    bench_report_begin_case(report, "cold");
+    bench_report_int(report, "usec", usec);
+
+    config_cache_set_filename(cache_file);
+    bench_config_cache_load_all();
+    start = g_get_monotonic_time();
+    if (!config_cache_write_now())
+    {
+        bench_report_string(report, "skipped", "unable to write the cache");
+    }
+    else
+    {
+        bench_report_begin_case(report, "write");
+        bench_report_int(report, "usec", g_get_monotonic_time() - start);
+        if (!g_stat(cache_file, &st))
+            bench_report_int(report, "bytes", st.st_size);
+        usec = bench_config_cache_time(cache_file, &nfiles);
+        bench_report_begin_case(report, "warm");
+        bench_report_int(report, "usec", usec);
+    }
+
+    config_cache_set_filename(NULL);
+    g_free(cache_file);
+    bench_remove_tmp_dir(dir);
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
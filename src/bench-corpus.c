@@ -0,0 +1,236 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "defns.h"
+
+#include "bench.h"
+
+/* A corpus of pty output for replaying. The built-in streams are generated
+ * from a fixed seed so every run and every machine sees exactly the same
+ * bytes. Captures of real sessions (eg plain output logs) can be added with
+ * --corpus=FILE.
+ */
+
+#define BENCH_CORPUS_SIZE (4 * 1024 * 1024)
+#define BENCH_CORPUS_SEED 52
+
+static GSList *bench_corpus_files;
+
+static const char *bench_corpus_words[] = {
+    "roxterm", "multitab", "options", "profile", "colour", "scheme", "vte",
+    "terminal", "search", "session", "shortcut", "dialog", "window", "tab",
+    "label", "regex", "uri", "filter", "clipboard", "activity", "bell",
+};
+
+inline static const char *bench_corpus_word(GRand *rand)
+{
+    return bench_corpus_words[g_rand_int_range(rand, 0,
+            G_N_ELEMENTS(bench_corpus_words))];
+}
+
+static void bench_corpus_compiler_log(GString *s, GRand *rand)
+{
+    int percent = 0;
+
+    while (s->len < BENCH_CORPUS_SIZE)
+    {
+        const char *word = bench_corpus_word(rand);
+
+        g_string_append_printf(s, "[%3d%%] Building C object "
+                "src/CMakeFiles/roxterm.dir/%s.c.o\r\n", percent, word);
+        percent = (percent + 1) % 101;
+        if (g_rand_int_range(rand, 0, 4) == 0)
+        {
+            int line = g_rand_int_range(rand, 1, 5000);
+            int col = g_rand_int_range(rand, 1, 60);
+
+            g_string_append_printf(s, "\033[01m\033[Ksrc/%s.c:%d:%d:\033[m"
+                    "\033[K \033[01;35m\033[Kwarning: \033[m\033[Kunused "
+                    "variable \xe2\x80\x98\033[01m\033[K%s\033[m\033[K"
+                    "\xe2\x80\x99 [\033[01;35m\033[K-Wunused-variable"
+                    "\033[m\033[K]\r\n", word, line, col,
+                    bench_corpus_word(rand));
+            g_string_append_printf(s, " %4d |     int %s;\r\n"
+                    "      |         \033[01;35m\033[K^~~~\033[m\033[K\r\n",
+                    line, bench_corpus_word(rand));
+        }
+    }
+}
+
+static void bench_corpus_ls_lR(GString *s, GRand *rand)
+{
+    int dir = 0;
+
+    while (s->len < BENCH_CORPUS_SIZE)
+    {
+        int n = g_rand_int_range(rand, 2, 40);
+
+        g_string_append_printf(s, "\r\n./%s/%s%d:\r\ntotal %d\r\n",
+                bench_corpus_word(rand), bench_corpus_word(rand), dir++,
+                n * 4);
+        while (n--)
+        {
+            gboolean is_dir = g_rand_int_range(rand, 0, 5) == 0;
+
+            g_string_append_printf(s, "%s 1 user group %8d Jan %2d "
+                    "%02d:%02d %s%s_%d%s\r\n",
+                    is_dir ? "drwxr-xr-x" : "-rw-r--r--",
+                    g_rand_int_range(rand, 0, 10000000),
+                    g_rand_int_range(rand, 1, 32),
+                    g_rand_int_range(rand, 0, 24),
+                    g_rand_int_range(rand, 0, 60),
+                    is_dir ? "\033[01;34m" : "",
+                    bench_corpus_word(rand), n,
+                    is_dir ? "\033[0m" : ".c");
+        }
+    }
+}
+
+/* Full-screen redraws like top or an editor, on the alternate screen */
+static void bench_corpus_ncurses(GString *s, GRand *rand)
+{
+    g_string_append(s, "\033[?1049h\033[22;0;0t\033[1;24r\033[?25l");
+    while (s->len < BENCH_CORPUS_SIZE)
+    {
+        int n;
+
+        g_string_append(s, "\033[H\033[2J");
+        for (n = 0; n < 60; ++n)
+        {
+            g_string_append_printf(s, "\033[%d;%dH\033[38;5;%dm\033[48;5;%dm"
+                    "%-12s%6d\033[m\033[K",
+                    g_rand_int_range(rand, 1, 25),
+                    g_rand_int_range(rand, 1, 70),
+                    g_rand_int_range(rand, 0, 256),
+                    g_rand_int_range(rand, 0, 256),
+                    bench_corpus_word(rand),
+                    g_rand_int_range(rand, 0, 100000));
+        }
+        g_string_append(s, "\033[5;20r\033[20;1H\n\n\033[1;24r");
+    }
+    g_string_append(s, "\033[?25h\033[?1049l");
+}
+
+static void bench_corpus_osc52(GString *s, GRand *rand)
+{
+    gsize len = 64 * 1024;
+    guint8 *payload = g_malloc(len);
+    gboolean st = FALSE;
+
+    while (s->len < BENCH_CORPUS_SIZE)
+    {
+        gsize n;
+        char *b64;
+
+        for (n = 0; n < len; ++n)
+            payload[n] = (guint8) g_rand_int(rand);
+        b64 = g_base64_encode(payload, len);
+        g_string_append_printf(s, "copying %s\r\n\033]52;c;%s%s",
+                bench_corpus_word(rand), b64, st ? "\033\\" : "\a");
+        g_free(b64);
+        st = !st;
+    }
+    g_free(payload);
+}
+
+/* A shell which sets the title at every prompt, running a tight loop */
+static void bench_corpus_title_flood(GString *s, GRand *rand)
+{
+    int n = 0;
+
+    while (s->len < BENCH_CORPUS_SIZE)
+    {
+        const char *word = bench_corpus_word(rand);
+
+        g_string_append_printf(s, "\033]0;user@host: ~/%s/%d\a"
+                "\033]2;%s %d\a$ %s\r\n", word, n, word, n, word);
+        ++n;
+    }
+}
+
+static const struct {
+    const char *name;
+    void (*generate)(GString *s, GRand *rand);
+} bench_corpus_generators[] = {
+    { "compiler_log", bench_corpus_compiler_log },
+    { "ls_lR", bench_corpus_ls_lR },
+    { "ncurses", bench_corpus_ncurses },
+    { "osc52", bench_corpus_osc52 },
+    { "title_flood", bench_corpus_title_flood },
+};
+
+void bench_corpus_add_file(const char *filename)
+{
+    bench_corpus_files = g_slist_append(bench_corpus_files,
+            g_strdup(filename));
+}
+
+static void bench_stream_free(gpointer data)
+{
+    BenchStream *stream = data;
+
+    g_free(stream->name);
+    g_bytes_unref(stream->data);
+    g_free(stream);
+}
+
+GPtrArray *bench_corpus_load(void)
+{
+    GPtrArray *corpus = g_ptr_array_new_with_free_func(bench_stream_free);
+    GSList *link;
+    guint n;
+
+    for (n = 0; n < G_N_ELEMENTS(bench_corpus_generators); ++n)
+    {
+        GRand *rand = g_rand_new_with_seed(BENCH_CORPUS_SEED);
+        GString *s = g_string_sized_new(BENCH_CORPUS_SIZE + 4096);
+        BenchStream *stream = g_new(BenchStream, 1);
+        gsize len;
+
+        bench_corpus_generators[n].generate(s, rand);
+        g_rand_free(rand);
+        stream->name = g_strdup(bench_corpus_generators[n].name);
+        len = s->len;
+        stream->data = g_bytes_new_take(g_string_free(s, FALSE), len);
+        g_ptr_array_add(corpus, stream);
+    }
+    for (link = bench_corpus_files; link; link = g_slist_next(link))
+    {
+        const char *filename = link->data;
+        char *contents;
+        gsize len;
+        GError *error = NULL;
+        BenchStream *stream;
+
+        if (!g_file_get_contents(filename, &contents, &len, &error))
+        {
+            g_warning("Unable to load corpus '%s': %s",
+                    filename, error->message);
+            g_error_free(error);
+            continue;
+        }
+        stream = g_new(BenchStream, 1);
+        stream->name = g_path_get_basename(filename);
+        stream->data = g_bytes_new_take(contents, len);
+        g_ptr_array_add(corpus, stream);
+    }
+    return corpus;
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
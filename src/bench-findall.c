@@ -0,0 +1,169 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "defns.h"
+
+#include "bench.h"
+#include "findall.h"
+#include "multitab.h"
+#include "scrollback.h"
+
+/* Find in all tabs with many tabs and a lot of scrollback, first with a
+ * single worker thread, then with one per processor. As well as the overall
+ * time, reports how long the main thread spent copying text from the
+ * terminals, in total and in the worst slice, because that determines how
+ * long the UI might be held up. This needs a display; use xvfb-run where
+ * there isn't one, and plenty of memory.
+ */
+
+#define BENCH_FIND_ALL_TABS 100
+#define BENCH_FIND_ALL_LINES 100000
+#define BENCH_FIND_ALL_LINES_PER_FEED 1000
+
+/* One line in this many contains the pattern */
+#define BENCH_FIND_ALL_HIT_INTERVAL 997
+
+#define BENCH_FIND_ALL_PATTERN "error: [a-z]+ failed"
+
+static GList *bench_find_all_get_terminals(void)
+{
+    GList *terms = NULL;
+    GList *wlink;
+
+    for (wlink = multi_win_all; wlink; wlink = g_list_next(wlink))
+    {
+        GList *tlink;
+
+        for (tlink = multi_win_get_tabs(wlink->data); tlink;
+                tlink = g_list_next(tlink))
+        {
+            terms = g_list_prepend(terms,
+                    roxterm_get_vte_terminal(
+                        multi_tab_get_user_data(tlink->data)));
+        }
+    }
+    return terms;
+}
+
+static void bench_find_all_fill(GList *terms)
+{
+    GString *batch = g_string_new(NULL);
+    GList *link;
+    int line = 0;
+
+    for (link = terms; link; link = g_list_next(link))
+    {
+        vte_terminal_reset(link->data, TRUE, TRUE);
+        vte_terminal_set_scrollback_lines(link->data, BENCH_FIND_ALL_LINES);
+    }
+    while (line < BENCH_FIND_ALL_LINES)
+    {
+        int n;
+
+        g_string_truncate(batch, 0);
+        for (n = 0; n < BENCH_FIND_ALL_LINES_PER_FEED; ++n, ++line)
+        {
+            if (line % BENCH_FIND_ALL_HIT_INTERVAL)
+            {
+                g_string_append_printf(batch, "%06d %s\r\n", line,
+                        "CC src/module.o -O2 -Wall -Wextra "
+                        "-I../include -c ../src/module.c");
+            }
+            else
+            {
+                g_string_append_printf(batch, "%06d %s\r\n", line,
+                        "module.c:42: error: linker failed");
+            }
+        }
+        for (link = terms; link; link = g_list_next(link))
+            vte_terminal_feed(link->data, batch->str, batch->len);
+        bench_drain_main_loop();
+    }
+    g_string_free(batch, TRUE);
+}
+
+static void bench_find_all_done(FindAll *fa, gpointer loop)
+{
+    (void) fa;
+    g_main_loop_quit(loop);
+}
+
+static void bench_find_all_case(BenchReport *report, const char *name,
+        int threads)
+{
+    GError *error = NULL;
+    FindAll *fa = find_all_new(BENCH_FIND_ALL_PATTERN,
+            ROXTERM_SEARCH_AS_REGEX, &error);
+    GMainLoop *loop;
+    gint64 start;
+    gint64 usec, main_usec, longest_usec;
+
+    bench_report_begin_case(report, name);
+    if (!fa)
+    {
+        bench_report_string(report, "skipped", error->message);
+        g_error_free(error);
+        return;
+    }
+    find_all_set_max_threads(threads);
+    loop = g_main_loop_new(NULL, FALSE);
+    start = g_get_monotonic_time();
+    find_all_start(fa, bench_find_all_done, loop);
+    g_main_loop_run(loop);
+    usec = g_get_monotonic_time() - start;
+    find_all_get_main_thread_usec(fa, &main_usec, &longest_usec);
+    bench_report_int(report, "threads",
+            threads ? threads : (int) g_get_num_processors());
+    bench_report_int(report, "usec", usec);
+    bench_report_int(report, "main_thread_usec", main_usec);
+    bench_report_int(report, "longest_slice_usec", longest_usec);
+    bench_report_int(report, "results", find_all_get_n_results(fa));
+    bench_report_string(report, "truncated",
+            find_all_get_truncated(fa) ? "yes" : "no");
+    find_all_free(fa);
+    g_main_loop_unref(loop);
+}
+
+void bench_find_all(BenchReport *report)
+{
+    glong old_budget = scrollback_get_budget();
+    GList *terms;
+    int n;
+
+    if (!bench_open_terminal(FALSE))
+    {
+        bench_report_string(report, "skipped", "unable to open a terminal");
+        return;
+    }
+    for (n = 1; n < BENCH_FIND_ALL_TABS; ++n)
+        bench_open_terminal(TRUE);
+    /* Otherwise the governor would trim the scrollback */
+    scrollback_set_budget(0);
+    terms = bench_find_all_get_terminals();
+    bench_find_all_fill(terms);
+    bench_report_int(report, "tabs", g_list_length(terms));
+    bench_report_int(report, "lines_per_tab", BENCH_FIND_ALL_LINES);
+    bench_find_all_case(report, "one_thread", 1);
+    bench_find_all_case(report, "all_processors", 0);
+    scrollback_set_budget(old_budget);
+    g_list_free(terms);
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
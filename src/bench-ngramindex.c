@@ -0,0 +1,228 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "defns.h"
+
+#include <string.h>
+
+#include "bench.h"
+#include "dynopts.h"
+#include "scrollback.h"
+
+/* Compares the time to find a match near the top of a very long scrollback
+ * with VTE's own search, which scans every row, and with the search index.
+ * The output is fed to VTE and the index directly instead of through a pty.
+ * This needs a display; use xvfb-run where there isn't one.
+ *
+ * It also checks that the index can't rule out text which does match,
+ * reporting any patterns or output which it gets wrong as failures.
+ */
+
+#define BENCH_SEARCH_INDEX_LINES 2000000
+#define BENCH_SEARCH_INDEX_LINES_PER_FEED 10000
+#define BENCH_SEARCH_INDEX_NEEDLE_LINE 1000
+#define BENCH_SEARCH_INDEX_NEEDLE "segfault in worker 7f3a9c"
+
+static void bench_search_index_fill(VteTerminal *vte, NgramIndex *ni)
+{
+    GString *batch = g_string_new(NULL);
+    int line = 0;
+
+    while (line < BENCH_SEARCH_INDEX_LINES)
+    {
+        int n;
+
+        g_string_truncate(batch, 0);
+        for (n = 0; n < BENCH_SEARCH_INDEX_LINES_PER_FEED; ++n, ++line)
+        {
+            if (line == BENCH_SEARCH_INDEX_NEEDLE_LINE)
+            {
+                g_string_append_printf(batch, "%07d \033[31m%s\033[0m\r\n",
+                        line, BENCH_SEARCH_INDEX_NEEDLE);
+            }
+            else
+            {
+                g_string_append_printf(batch, "%07d %s %d\r\n", line,
+                        "CC src/module.o -O2 -Wall -Wextra -c module.c",
+                        line % 9973);
+            }
+        }
+        vte_terminal_feed(vte, batch->str, batch->len);
+        ngram_index_feed(ni, (const guint8 *) batch->str, batch->len);
+        bench_drain_main_loop();
+    }
+    g_string_free(batch, TRUE);
+}
+
+/* Whether ngram_query_new should find literals in each pattern. Escapes
+ * longer than two characters and extended mode could be mistaken for
+ * literal text, so they mustn't be used.
+ */
+static const struct {
+    const char *pattern;
+    gboolean usable;
+} bench_search_index_queries[] = {
+    { "segfault", TRUE },
+    { "seg\\dfault", TRUE },
+    { "seg\\.fault", TRUE },
+    { "\\x41segfault", FALSE },
+    { "\\x{263a}segfault", FALSE },
+    { "\\101segfault", FALSE },
+    { "\\1segfault", FALSE },
+    { "\\cAsegfault", FALSE },
+    { "\\p{L}segfault", FALSE },
+    { "\\P{L}segfault", FALSE },
+    { "\\N{U+41}segfault", FALSE },
+    { "\\g{1}segfault", FALSE },
+    { "\\k<a>segfault", FALSE },
+    { "\\o{101}segfault", FALSE },
+    { "(?x)seg fault # comment", FALSE },
+    { "(?ix)seg fault", FALSE },
+};
+
+static void bench_search_index_check_queries(BenchReport *report)
+{
+    GString *failures = g_string_new(NULL);
+    guint n;
+
+    for (n = 0; n < G_N_ELEMENTS(bench_search_index_queries); ++n)
+    {
+        const char *pattern = bench_search_index_queries[n].pattern;
+        NgramQuery *query = ngram_query_new(pattern,
+                ROXTERM_SEARCH_AS_REGEX | ROXTERM_SEARCH_MATCH_CASE);
+
+        if (!query != !bench_search_index_queries[n].usable)
+        {
+            g_string_append_printf(failures, "%s%s",
+                    failures->len ? " " : "", pattern);
+        }
+        if (query)
+            ngram_query_free(query);
+    }
+    bench_report_string(report, "query_failures", failures->str);
+    g_string_free(failures, TRUE);
+}
+
+/* Output which is overwritten on screen, each followed by what ends up on
+ * screen, which the index mustn't rule out.
+ */
+static const char *bench_search_index_overwrites[][2] = {
+    { "building 10%\rfinished 100%\r\n", "finished 100%" },
+    { "segfault\rx\r\n", "xegfault" },
+    { "segfaulx\bt\r\n", "segfault" },
+    { "segfault\033[8Dxyz\r\n", "xyzfault" },
+    { "\033[Ksegfault\r\n\033[Aabc\r\n", "abcfault" },
+};
+
+static void bench_search_index_check_overwrites(BenchReport *report)
+{
+    GString *failures = g_string_new(NULL);
+    guint n;
+
+    for (n = 0; n < G_N_ELEMENTS(bench_search_index_overwrites); ++n)
+    {
+        NgramIndex *ni = ngram_index_new();
+        const char *text = bench_search_index_overwrites[n][0];
+        NgramQuery *query = ngram_query_new(bench_search_index_overwrites[n][1],
+                ROXTERM_SEARCH_MATCH_CASE);
+        glong first, end;
+        int line;
+
+        ngram_index_feed(ni, (const guint8 *) text, strlen(text));
+        /* Fill the rest of the block, so it isn't a candidate just because
+         * it's still being filled.
+         */
+        for (line = 0; line < 200; ++line)
+            ngram_index_feed(ni, (const guint8 *) "padding\r\n", 9);
+        if (!ngram_index_find(ni, query, 0, FALSE, &first, &end) || first)
+        {
+            g_string_append_printf(failures, "%s%u",
+                    failures->len ? " " : "", n);
+        }
+        ngram_query_free(query);
+        ngram_index_free(ni);
+    }
+    bench_report_string(report, "overwrite_failures", failures->str);
+    g_string_free(failures, TRUE);
+}
+
+static void bench_search_index_case(BenchReport *report, const char *name,
+        ROXTermData *roxterm, gboolean use_index)
+{
+    VteTerminal *vte = roxterm_get_vte_terminal(roxterm);
+    gint64 start;
+    gboolean found;
+
+    /* Resets the position of the previous search */
+    roxterm_set_search(roxterm, BENCH_SEARCH_INDEX_NEEDLE,
+            ROXTERM_SEARCH_BACKWARDS, NULL);
+    vte_terminal_unselect_all(vte);
+    start = g_get_monotonic_time();
+    if (use_index)
+        found = roxterm_search_find(roxterm, TRUE);
+    else
+        found = vte_terminal_search_find_previous(vte);
+    bench_report_begin_case(report, name);
+    bench_report_int(report, "usec", g_get_monotonic_time() - start);
+    bench_report_string(report, "found", found ? "yes" : "no");
+}
+
+void bench_search_index(BenchReport *report)
+{
+    ROXTermData *roxterm = bench_open_terminal(FALSE);
+    glong old_budget = scrollback_get_budget();
+    Options *profile;
+    NgramIndex *ni;
+    VteTerminal *vte;
+    gint64 start;
+
+    bench_search_index_check_queries(report);
+    bench_search_index_check_overwrites(report);
+    if (!roxterm)
+    {
+        bench_report_string(report, "skipped", "unable to open a terminal");
+        return;
+    }
+    /* The index is created when the command starts, so it needs a new tab */
+    profile = dynamic_options_lookup(dynamic_options_get("Profiles"),
+            roxterm_get_profile_name(roxterm));
+    options_set_int(profile, "search_index", 1);
+    roxterm = bench_open_terminal(TRUE);
+    options_set_int(profile, "search_index", 0);
+    ni = roxterm ? roxterm_get_search_index(roxterm) : NULL;
+    if (!ni)
+    {
+        bench_report_string(report, "skipped", "no search index");
+        return;
+    }
+    vte = roxterm_get_vte_terminal(roxterm);
+    scrollback_set_budget(0);
+    vte_terminal_set_scrollback_lines(vte, -1);
+    start = g_get_monotonic_time();
+    bench_search_index_fill(vte, ni);
+    bench_report_int(report, "lines", BENCH_SEARCH_INDEX_LINES);
+    bench_report_int(report, "fill_usec", g_get_monotonic_time() - start);
+    bench_report_int(report, "index_bytes", ngram_index_get_size(ni));
+    bench_search_index_case(report, "vte", roxterm, FALSE);
+    bench_search_index_case(report, "index", roxterm, TRUE);
+    scrollback_set_budget(old_budget);
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
@@ -0,0 +1,132 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "defns.h"
+
+#include <string.h>
+
+#include "bench.h"
+#include "outputlog.h"
+
+/* Measures how fast output can be handed to a log without blocking, how much
+ * is dropped when it arrives faster than the writer can save it, and the
+ * writer's sustained throughput.
+ */
+
+#define BENCH_LOG_CHUNK 4096
+#define BENCH_LOG_TOTAL (256 * 1024 * 1024)
+#define BENCH_LOG_RING (4 * 1024 * 1024)
+
+/* Something like a compiler log with colours and a few non-ASCII characters
+ * so asciicast has some escaping to do.
+ */
+static guint8 *bench_log_make_chunk(void)
+{
+    static const char line[] = "\033[1msrc/roxterm.c:1234:5:\033[0m "
+            "\033[35mwarning:\033[0m unused variable \xe2\x80\x98x\xe2\x80\x99 "
+            "[-Wunused-variable]\r\n";
+    guint8 *chunk = g_malloc(BENCH_LOG_CHUNK);
+    gsize n;
+
+    for (n = 0; n < BENCH_LOG_CHUNK; ++n)
+        chunk[n] = line[n % (sizeof(line) - 1)];
+    return chunk;
+}
+
+/* If sustained is TRUE each dropped chunk is retried after a short pause, so
+ * nothing is lost and the time is limited by the writer; otherwise output is
+ * fed in as fast as possible and anything which doesn't fit is dropped.
+ */
+static void bench_log_case(BenchReport *report, const char *name,
+        OutputLogFormat format, gboolean compress, gboolean sustained,
+        const guint8 *chunk)
+{
+    char *dir = bench_make_tmp_dir();
+    char *filename = g_build_filename(dir, "bench.log", NULL);
+    GError *error = NULL;
+    OutputLog *olog = output_log_open(filename, format, compress,
+            BENCH_LOG_RING, 0, 80, 24, &error);
+    guint64 fed = 0;
+    guint64 dropped = 0;
+    gint64 worst = 0;
+    gint64 start, fed_time, drained_time;
+
+    if (!olog)
+        g_error("Unable to open '%s': %s", filename, error->message);
+    start = g_get_monotonic_time();
+    while (fed < BENCH_LOG_TOTAL)
+    {
+        gint64 t = g_get_monotonic_time();
+
+        output_log_write(olog, chunk, BENCH_LOG_CHUNK);
+        t = g_get_monotonic_time() - t;
+        if (t > worst)
+            worst = t;
+        if (output_log_get_dropped_bytes(olog) != dropped)
+        {
+            dropped = output_log_get_dropped_bytes(olog);
+            if (sustained)
+            {
+                g_usleep(50);
+                continue;
+            }
+        }
+        fed += BENCH_LOG_CHUNK;
+    }
+    fed_time = g_get_monotonic_time() - start;
+    output_log_close(olog);
+    output_log_shutdown();
+    drained_time = g_get_monotonic_time() - start;
+
+    bench_report_begin_case(report, name);
+    bench_report_int(report, "bytes", fed);
+    bench_report_double(report, "feed_mb_per_sec",
+            bench_mb_per_sec(fed, fed_time));
+    bench_report_int(report, "worst_write_usec", worst);
+    if (sustained)
+    {
+        bench_report_double(report, "writer_mb_per_sec",
+                bench_mb_per_sec(fed, drained_time));
+    }
+    else
+    {
+        bench_report_int(report, "dropped_bytes", dropped);
+    }
+    g_free(filename);
+    bench_remove_tmp_dir(dir);
+}
+
+void bench_output_log(BenchReport *report)
+{
+    guint8 *chunk = bench_log_make_chunk();
+
+    bench_log_case(report, "raw_burst", OUTPUT_LOG_RAW,
+            FALSE, FALSE, chunk);
+    bench_log_case(report, "raw_sustained", OUTPUT_LOG_RAW,
+            FALSE, TRUE, chunk);
+    bench_log_case(report, "raw_gzip_sustained", OUTPUT_LOG_RAW,
+            TRUE, TRUE, chunk);
+    bench_log_case(report, "asciicast_sustained", OUTPUT_LOG_ASCIICAST,
+            FALSE, TRUE, chunk);
+    bench_log_case(report, "asciicast_gzip_sustained", OUTPUT_LOG_ASCIICAST,
+            TRUE, TRUE, chunk);
+    g_free(chunk);
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
@@ -0,0 +1,180 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "defns.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <glib-unix.h>
+
+#include "bench.h"
+#include "paste.h"
+
+/* Pastes 100 MB of log-like text through PasteStream into a pty running
+ * "cat > /dev/null". max_main_loop_gap_usec is the longest time the main loop
+ * went without running a 10ms timer, which shows whether a paste this big
+ * would have held up drawing and input.
+ */
+
+#define BENCH_PASTE_SIZE (100 * 1024 * 1024)
+#define BENCH_PASTE_TICK_MS 10
+
+typedef struct {
+    GMainLoop *loop;
+    GPid pid;
+    gboolean ready;
+    gint64 last_tick;
+    gint64 max_gap;
+    guint64 echoed;
+} BenchPaste;
+
+static void bench_paste_spawned(VtePty *pty, GPid pid, GError *error,
+        gpointer data)
+{
+    BenchPaste *bp = data;
+    (void) pty;
+
+    if (pid == -1)
+        g_error("Unable to run cat: %s", error->message);
+    bp->pid = pid;
+}
+
+/* Waits for the shell to say it's set up the pty, then discards anything
+ * else, in case the pty echoes some of the input after all.
+ */
+static gboolean bench_paste_read(int fd, GIOCondition condition,
+        gpointer data)
+{
+    BenchPaste *bp = data;
+    char buf[4096];
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    (void) condition;
+
+    if (n <= 0)
+        return (n < 0 && errno == EINTR) ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+    if (!bp->ready)
+    {
+        buf[n] = 0;
+        if (strstr(buf, "ready"))
+        {
+            bp->ready = TRUE;
+            g_main_loop_quit(bp->loop);
+        }
+    }
+    else
+    {
+        bp->echoed += n;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean bench_paste_tick(gpointer data)
+{
+    BenchPaste *bp = data;
+    gint64 now = g_get_monotonic_time();
+
+    bp->max_gap = MAX(bp->max_gap, now - bp->last_tick);
+    bp->last_tick = now;
+    return G_SOURCE_CONTINUE;
+}
+
+static void bench_paste_progress(PasteStream *ps,
+        gsize done, gsize total, gboolean finished, gpointer data)
+{
+    BenchPaste *bp = data;
+    (void) ps;
+    (void) done;
+    (void) total;
+
+    if (finished)
+        g_main_loop_quit(bp->loop);
+}
+
+static GString *bench_paste_make_text(void)
+{
+    GString *text = g_string_sized_new(BENCH_PASTE_SIZE + 128);
+    int line = 0;
+
+    while (text->len < BENCH_PASTE_SIZE)
+    {
+        g_string_append_printf(text,
+                "2024-05-01T12:%02d:%02d.%06d INFO request %d served in %dms\n",
+                (line / 60) % 60, line % 60, line % 1000000, line,
+                line % 997);
+        ++line;
+    }
+    return text;
+}
+
+void bench_paste(BenchReport *report)
+{
+    const char *argv[] = { "/bin/sh", "-c",
+        "stty raw -echo && echo ready && exec cat > /dev/null", NULL };
+    BenchPaste bp = { 0 };
+    GError *error = NULL;
+    VtePty *pty = vte_pty_new_sync(VTE_PTY_DEFAULT, NULL, &error);
+    GString *text;
+    PasteStream *ps;
+    guint read_tag, tick_tag;
+    gint64 start, elapsed;
+    int fd;
+
+    if (!pty)
+        g_error("Unable to create pty: %s", error->message);
+    fd = vte_pty_get_fd(pty);
+    bp.loop = g_main_loop_new(NULL, FALSE);
+    bp.pid = -1;
+    vte_pty_spawn_async(pty, NULL, (char **) argv, NULL, G_SPAWN_DEFAULT,
+            NULL, NULL, NULL, -1, NULL, bench_paste_spawned, &bp);
+    read_tag = g_unix_fd_add(fd, G_IO_IN, bench_paste_read, &bp);
+    g_main_loop_run(bp.loop);
+
+    text = bench_paste_make_text();
+    tick_tag = g_timeout_add(BENCH_PASTE_TICK_MS, bench_paste_tick, &bp);
+    start = bp.last_tick = g_get_monotonic_time();
+    ps = paste_stream_new(fd, text->str, text->len, FALSE,
+            bench_paste_progress, &bp);
+    g_main_loop_run(bp.loop);
+    elapsed = g_get_monotonic_time() - start;
+    paste_stream_free(ps);
+    g_source_remove(tick_tag);
+    g_source_remove(read_tag);
+
+    bench_report_begin_case(report, "cat");
+    bench_report_int(report, "bytes", text->len);
+    bench_report_double(report, "mb_per_sec",
+            bench_mb_per_sec(text->len, elapsed));
+    bench_report_int(report, "max_main_loop_gap_usec", bp.max_gap);
+    bench_report_int(report, "echoed_bytes", bp.echoed);
+
+    g_object_unref(pty);
+    if (bp.pid != -1)
+    {
+        waitpid(bp.pid, NULL, 0);
+        g_spawn_close_pid(bp.pid);
+    }
+    g_string_free(text, TRUE);
+    g_main_loop_unref(bp.loop);
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
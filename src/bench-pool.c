@@ -0,0 +1,290 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "defns.h"
+
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "workerpool.h"
+
+/* Measures how responsive a quiet window is while another window is flooded
+ * with output, first with both windows in one roxterm process, then with
+ * --workers=2 so they're in different workers. The latency of a D-Bus Ping to
+ * the process with the quiet window stands in for input latency, because
+ * libdbus answers it from the same main loop which handles keyboard events.
+ * The roxterm binary next to roxterm-bench is used. It needs a display, and
+ * no other roxterm on the session bus; use dbus-run-session.
+ */
+
+#define BENCH_POOL_PING_INTERVAL_MS 10
+#define BENCH_POOL_DURATION_MS 3000
+#define BENCH_POOL_SETTLE_MS 500
+#define BENCH_POOL_START_TIMEOUT_MS 10000
+
+static const char *bench_pool_flood[] = {
+    "--execute", "sh", "-c", "yes 0123456789abcdef0123456789abcdef", NULL
+};
+
+static const char *bench_pool_quiet[] = { "--execute", "cat", NULL };
+
+typedef struct {
+    DBusConnection *connection;
+    char *exe;
+    GArray *children;
+} BenchPool;
+
+static gboolean bench_pool_spawn(BenchPool *bp, const char *opts,
+        const char **cmd)
+{
+    GPtrArray *argv = g_ptr_array_new_with_free_func(g_free);
+    GError *error = NULL;
+    GPid pid;
+    gboolean result;
+
+    g_ptr_array_add(argv, g_strdup(bp->exe));
+    if (opts)
+    {
+        char **split = g_strsplit(opts, " ", -1);
+        char **s;
+
+        for (s = split; *s; ++s)
+            g_ptr_array_add(argv, g_strdup(*s));
+        g_strfreev(split);
+    }
+    for (; *cmd; ++cmd)
+        g_ptr_array_add(argv, g_strdup(*cmd));
+    g_ptr_array_add(argv, NULL);
+    result = g_spawn_async(NULL, (char **) argv->pdata, NULL,
+            G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &pid, &error);
+    if (result)
+    {
+        g_array_append_val(bp->children, pid);
+    }
+    else
+    {
+        g_warning("Unable to run %s: %s", bp->exe, error->message);
+        g_error_free(error);
+    }
+    g_ptr_array_unref(argv);
+    return result;
+}
+
+static gboolean bench_pool_wait_for_name(BenchPool *bp, const char *name,
+        gboolean owned)
+{
+    gint64 deadline = g_get_monotonic_time() +
+            BENCH_POOL_START_TIMEOUT_MS * 1000;
+
+    while (g_get_monotonic_time() < deadline)
+    {
+        if (dbus_bus_name_has_owner(bp->connection, name, NULL) == owned)
+            return TRUE;
+        g_usleep(50000);
+    }
+    return FALSE;
+}
+
+static void bench_pool_kill_name(BenchPool *bp, const char *name)
+{
+    DBusMessage *message = dbus_message_new_method_call(DBUS_SERVICE_DBUS,
+            DBUS_PATH_DBUS, DBUS_INTERFACE_DBUS,
+            "GetConnectionUnixProcessID");
+    DBusMessage *reply;
+    dbus_uint32_t pid = 0;
+
+    dbus_message_append_args(message,
+            DBUS_TYPE_STRING, &name,
+            DBUS_TYPE_INVALID);
+    reply = dbus_connection_send_with_reply_and_block(bp->connection,
+            message, -1, NULL);
+    dbus_message_unref(message);
+    if (!reply)
+        return;
+    if (dbus_message_get_args(reply, NULL,
+                DBUS_TYPE_UINT32, &pid,
+                DBUS_TYPE_INVALID) && pid)
+    {
+        kill(pid, SIGTERM);
+    }
+    dbus_message_unref(reply);
+}
+
+static void bench_pool_cleanup(BenchPool *bp, gboolean pool)
+{
+    guint n;
+
+    if (pool)
+    {
+        char *name;
+
+        for (n = 0; n < 2; ++n)
+        {
+            name = worker_pool_get_worker_name(n);
+            bench_pool_kill_name(bp, name);
+            bench_pool_wait_for_name(bp, name, FALSE);
+            g_free(name);
+        }
+    }
+    bench_pool_kill_name(bp, ROXTERM_DBUS_NAME);
+    bench_pool_wait_for_name(bp, ROXTERM_DBUS_NAME, FALSE);
+    for (n = 0; n < bp->children->len; ++n)
+    {
+        GPid pid = g_array_index(bp->children, GPid, n);
+
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+        g_spawn_close_pid(pid);
+    }
+    g_array_set_size(bp->children, 0);
+}
+
+static int bench_pool_compare_rtt(gconstpointer a, gconstpointer b)
+{
+    gint64 ra = *(const gint64 *) a;
+    gint64 rb = *(const gint64 *) b;
+
+    return ra < rb ? -1 : ra > rb;
+}
+
+static void bench_pool_ping(BenchReport *report, BenchPool *bp,
+        const char *name)
+{
+    GArray *rtts = g_array_new(FALSE, FALSE, sizeof(gint64));
+    gint64 end = g_get_monotonic_time() + BENCH_POOL_DURATION_MS * 1000;
+    gint64 total = 0;
+    guint failures = 0;
+    guint n;
+
+    while (g_get_monotonic_time() < end)
+    {
+        DBusMessage *message = dbus_message_new_method_call(name, "/",
+                DBUS_INTERFACE_PEER, "Ping");
+        DBusMessage *reply;
+        gint64 start = g_get_monotonic_time();
+        gint64 rtt;
+
+        reply = dbus_connection_send_with_reply_and_block(bp->connection,
+                message, BENCH_POOL_START_TIMEOUT_MS, NULL);
+        rtt = g_get_monotonic_time() - start;
+        dbus_message_unref(message);
+        if (reply)
+        {
+            dbus_message_unref(reply);
+            g_array_append_val(rtts, rtt);
+            total += rtt;
+        }
+        else
+        {
+            ++failures;
+        }
+        g_usleep(BENCH_POOL_PING_INTERVAL_MS * 1000);
+    }
+    g_array_sort(rtts, bench_pool_compare_rtt);
+    n = rtts->len;
+    bench_report_int(report, "pings", n);
+    bench_report_int(report, "failures", failures);
+    if (n)
+    {
+        bench_report_double(report, "mean_rtt_usec", (double) total / n);
+        bench_report_int(report, "p99_rtt_usec",
+                g_array_index(rtts, gint64, (n - 1) * 99 / 100));
+        bench_report_int(report, "max_rtt_usec",
+                g_array_index(rtts, gint64, n - 1));
+    }
+    g_array_unref(rtts);
+}
+
+static void bench_pool_case(BenchReport *report, BenchPool *bp,
+        gboolean pool)
+{
+    char *quiet_name = pool ? worker_pool_get_worker_name(1) :
+            g_strdup(ROXTERM_DBUS_NAME);
+
+    bench_report_begin_case(report, pool ? "workers_2" : "single_process");
+    if (bench_pool_spawn(bp, pool ?
+                "--workers=2 --worker-placement=round-robin" : NULL,
+                bench_pool_flood) &&
+            bench_pool_wait_for_name(bp, pool ?
+                    ROXTERM_DBUS_NAME ".w0" : ROXTERM_DBUS_NAME, TRUE) &&
+            bench_pool_spawn(bp, NULL, bench_pool_quiet))
+    {
+        /* In single process mode the name is already owned, so give the
+         * second window a chance to open as well.
+         */
+        g_usleep(BENCH_POOL_SETTLE_MS * 1000);
+        if (bench_pool_wait_for_name(bp, quiet_name, TRUE))
+            bench_pool_ping(report, bp, quiet_name);
+        else
+            bench_report_string(report, "skipped", "terminal didn't start");
+    }
+    else
+    {
+        bench_report_string(report, "skipped", "terminal didn't start");
+    }
+    bench_pool_cleanup(bp, pool);
+    g_free(quiet_name);
+}
+
+void bench_pool_latency(BenchReport *report)
+{
+    BenchPool bp = { 0 };
+    char *self = g_file_read_link("/proc/self/exe", NULL);
+    char *dir;
+
+    if (!self || !g_getenv("DISPLAY"))
+    {
+        g_free(self);
+        bench_report_string(report, "skipped", "no display");
+        return;
+    }
+    dir = g_path_get_dirname(self);
+    bp.exe = g_build_filename(dir, "roxterm", NULL);
+    g_free(dir);
+    g_free(self);
+    bp.connection = dbus_bus_get(DBUS_BUS_SESSION, NULL);
+    if (!bp.connection)
+    {
+        bench_report_string(report, "skipped", "no session bus");
+    }
+    else if (!g_file_test(bp.exe, G_FILE_TEST_IS_EXECUTABLE))
+    {
+        bench_report_string(report, "skipped", "roxterm not built");
+    }
+    else if (dbus_bus_name_has_owner(bp.connection, ROXTERM_DBUS_NAME, NULL))
+    {
+        bench_report_string(report, "skipped",
+                "roxterm is already running; use dbus-run-session");
+    }
+    else
+    {
+        bp.children = g_array_new(FALSE, FALSE, sizeof(GPid));
+        bench_pool_case(report, &bp, FALSE);
+        bench_pool_case(report, &bp, TRUE);
+        g_array_unref(bp.children);
+    }
+    if (bp.connection)
+        dbus_connection_unref(bp.connection);
+    g_free(bp.exe);
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
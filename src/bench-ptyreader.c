@@ -0,0 +1,236 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "defns.h"
+
+#include <errno.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <glib-unix.h>
+
+#include "bench.h"
+#include "osc52filter.h"
+#include "outputlog.h"
+#include "ptyreader.h"
+
+/* Compares the two ways roxterm can filter a terminal's output: the read()
+ * wrapper, which runs OSC 52 capture and logging in the main thread when VTE
+ * reads the pty, and PtyReader, which runs them in a thread of its own. A
+ * producer thread writes each corpus stream into a pipe as fast as it can,
+ * standing in for the child, and the main loop consumes it without passing
+ * it to VTE, so the figures show the cost of the filtering and hand-off
+ * alone. main_thread_cpu_usec is the CPU time used by the main thread, which
+ * is what competes with drawing and input; total_cpu_usec includes the
+ * reader and log writer threads.
+ */
+
+#define BENCH_PTY_CHUNK 16384
+#define BENCH_PTY_QUEUE (1024 * 1024)
+#define BENCH_PTY_OSC52_BUFFER (1024 * 1024)
+#define BENCH_PTY_LOG_RING (4 * 1024 * 1024)
+
+typedef struct {
+    int pipe_r, pipe_w;
+    GBytes *data;
+    GMainLoop *loop;
+    guint64 received;
+    guint8 buf[BENCH_PTY_CHUNK];
+} BenchPty;
+
+static gpointer bench_pty_produce(gpointer data)
+{
+    BenchPty *bp = data;
+    gsize len;
+    const guint8 *buf = g_bytes_get_data(bp->data, &len);
+
+    while (len)
+    {
+        ssize_t n = write(bp->pipe_w, buf, MIN(len, BENCH_PTY_CHUNK));
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            g_error("Unable to write to pipe: %s", g_strerror(errno));
+        }
+        buf += n;
+        len -= n;
+    }
+    close(bp->pipe_w);
+    return NULL;
+}
+
+static gboolean bench_pty_interposer_read(int fd, GIOCondition condition,
+        gpointer data)
+{
+    BenchPty *bp = data;
+    ssize_t n = read(fd, bp->buf, BENCH_PTY_CHUNK);
+    (void) condition;
+
+    if (n > 0)
+    {
+        bp->received += n;
+        return G_SOURCE_CONTINUE;
+    }
+    if (n < 0 && errno == EINTR)
+        return G_SOURCE_CONTINUE;
+    g_main_loop_quit(bp->loop);
+    return G_SOURCE_REMOVE;
+}
+
+static void bench_pty_sink(const guint8 *buf, gsize len, gpointer data)
+{
+    BenchPty *bp = data;
+    (void) buf;
+
+    bp->received += len;
+}
+
+static void bench_pty_eof(gpointer data)
+{
+    BenchPty *bp = data;
+
+    g_main_loop_quit(bp->loop);
+}
+
+static void bench_pty_osc52_filter(GByteArray *chunk, gpointer oflt)
+{
+    osc52filter_scan(oflt, chunk->data, chunk->len);
+}
+
+static void bench_pty_log_filter(GByteArray *chunk, gpointer olog)
+{
+    output_log_write(olog, chunk->data, chunk->len);
+}
+
+static gint64 bench_pty_cpu_usec(int who)
+{
+    struct rusage usage;
+
+    getrusage(who, &usage);
+    return (gint64) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) *
+            G_USEC_PER_SEC + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+#ifdef RUSAGE_THREAD
+#define BENCH_PTY_RUSAGE_MAIN RUSAGE_THREAD
+#else
+#define BENCH_PTY_RUSAGE_MAIN RUSAGE_SELF
+#endif
+
+static void bench_pty_case(BenchReport *report, BenchStream *stream,
+        gboolean threaded)
+{
+    char *dir = bench_make_tmp_dir();
+    char *filename = g_build_filename(dir, "bench.log", NULL);
+    char *name = g_strdup_printf("%s_%s", stream->name,
+            threaded ? "thread" : "interposer");
+    BenchPty bp = { 0 };
+    int fds[2];
+    GError *error = NULL;
+    OutputLog *olog;
+    Osc52Filter *oflt;
+    PtyReader *reader = NULL;
+    GThread *producer;
+    gint64 start, elapsed;
+    gint64 main_cpu, total_cpu;
+
+    if (!g_unix_open_pipe(fds, FD_CLOEXEC, &error))
+        g_error("Unable to create pipe: %s", error->message);
+    bp.pipe_r = fds[0];
+    bp.pipe_w = fds[1];
+    bp.data = stream->data;
+    bp.loop = g_main_loop_new(NULL, FALSE);
+    olog = output_log_open(filename, OUTPUT_LOG_RAW, FALSE,
+            BENCH_PTY_LOG_RING, 0, 80, 24, &error);
+    if (!olog)
+        g_error("Unable to open '%s': %s", filename, error->message);
+    if (threaded)
+    {
+        reader = pty_reader_new(bp.pipe_r, BENCH_PTY_QUEUE,
+                bench_pty_sink, bench_pty_eof, &bp);
+        oflt = osc52filter_new(NULL, BENCH_PTY_OSC52_BUFFER);
+        pty_reader_add_filter(reader, -1, bench_pty_osc52_filter, oflt, NULL);
+        pty_reader_add_filter(reader, -1, bench_pty_log_filter, olog, NULL);
+    }
+    else
+    {
+        oflt = osc52filter_create_for_fd(NULL, bp.pipe_r,
+                BENCH_PTY_OSC52_BUFFER);
+        osc52filter_set_output_log(bp.pipe_r, olog);
+        g_unix_fd_add(bp.pipe_r, G_IO_IN | G_IO_HUP,
+                bench_pty_interposer_read, &bp);
+    }
+
+    start = g_get_monotonic_time();
+    main_cpu = bench_pty_cpu_usec(BENCH_PTY_RUSAGE_MAIN);
+    total_cpu = bench_pty_cpu_usec(RUSAGE_SELF);
+    producer = g_thread_new("bench-producer", bench_pty_produce, &bp);
+    g_main_loop_run(bp.loop);
+    elapsed = g_get_monotonic_time() - start;
+    main_cpu = bench_pty_cpu_usec(BENCH_PTY_RUSAGE_MAIN) - main_cpu;
+    total_cpu = bench_pty_cpu_usec(RUSAGE_SELF) - total_cpu;
+    g_thread_join(producer);
+
+    bench_report_begin_case(report, name);
+    bench_report_int(report, "bytes", bp.received);
+    bench_report_double(report, "mb_per_sec",
+            bench_mb_per_sec(bp.received, elapsed));
+    bench_report_int(report, "main_thread_cpu_usec", main_cpu);
+    bench_report_int(report, "total_cpu_usec", total_cpu);
+    if (threaded)
+    {
+        bench_report_int(report, "reader_stalls",
+                pty_reader_get_stalls(reader));
+        pty_reader_free(reader);
+    }
+    else
+    {
+        osc52filter_set_output_log(bp.pipe_r, NULL);
+    }
+    bench_report_int(report, "log_dropped_bytes",
+            output_log_get_dropped_bytes(olog));
+    osc52filter_remove(oflt);
+    output_log_close(olog);
+    output_log_shutdown();
+
+    close(bp.pipe_r);
+    g_main_loop_unref(bp.loop);
+    g_free(name);
+    g_free(filename);
+    bench_remove_tmp_dir(dir);
+}
+
+void bench_pty_reader(BenchReport *report)
+{
+    GPtrArray *corpus = bench_corpus_load();
+    guint n;
+
+    for (n = 0; n < corpus->len; ++n)
+    {
+        BenchStream *stream = g_ptr_array_index(corpus, n);
+
+        bench_pty_case(report, stream, FALSE);
+        bench_pty_case(report, stream, TRUE);
+    }
+    g_ptr_array_unref(corpus);
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
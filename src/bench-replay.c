@@ -0,0 +1,225 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "defns.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "globalopts.h"
+#include "multitab.h"
+#include "osc52filter.h"
+#include "roxterm.h"
+
+/* Replays the corpus into a real roxterm tab. Each chunk is written to a pipe
+ * and read back through the read() wrapper, so it passes through the OSC 52
+ * filter, then fed to the tab's VteTerminal, whose title, bell and output
+ * signals are handled by roxterm as usual. This needs a display; use
+ * xvfb-run where there isn't one.
+ *
+ * A timer measures how late the main loop is to service it while this is
+ * going on.
+ */
+
+#define BENCH_REPLAY_CHUNK 4096
+#define BENCH_REPLAY_PROBE_MS 5
+#define BENCH_REPLAY_OSC52_BUFFER (1024 * 1024)
+
+typedef struct {
+    VteTerminal *vte;
+    int pipe_r, pipe_w;
+    const guint8 *data;
+    gsize len;
+    gsize pos;
+    GMainLoop *loop;
+    GArray *lateness;
+    gint64 probe_due;
+    guint8 buf[BENCH_REPLAY_CHUNK];
+} BenchReplay;
+
+static gboolean bench_replay_feed(gpointer data)
+{
+    BenchReplay *br = data;
+    gsize n = MIN(BENCH_REPLAY_CHUNK, br->len - br->pos);
+    ssize_t got;
+
+    if (write(br->pipe_w, br->data + br->pos, n) != (ssize_t) n)
+        g_error("Unable to write to replay pipe: %s", g_strerror(errno));
+    got = read(br->pipe_r, br->buf, n);
+    if (got <= 0)
+        g_error("Unable to read from replay pipe: %s", g_strerror(errno));
+    vte_terminal_feed(br->vte, (const char *) br->buf, got);
+    br->pos += got;
+    if (br->pos < br->len)
+        return G_SOURCE_CONTINUE;
+    g_main_loop_quit(br->loop);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean bench_replay_probe(gpointer data)
+{
+    BenchReplay *br = data;
+    gint64 now = g_get_monotonic_time();
+    gint64 late = MAX(now - br->probe_due, 0);
+
+    g_array_append_val(br->lateness, late);
+    br->probe_due = now + BENCH_REPLAY_PROBE_MS * 1000;
+    return G_SOURCE_CONTINUE;
+}
+
+static int bench_replay_compare_lateness(gconstpointer a, gconstpointer b)
+{
+    gint64 la = *(const gint64 *) a;
+    gint64 lb = *(const gint64 *) b;
+
+    return la < lb ? -1 : (la > lb ? 1 : 0);
+}
+
+static void bench_replay_report_lateness(BenchReport *report, GArray *lateness)
+{
+    gint64 total = 0;
+    guint n;
+
+    bench_report_int(report, "loop_probes", lateness->len);
+    if (!lateness->len)
+        return;
+    g_array_sort(lateness, bench_replay_compare_lateness);
+    for (n = 0; n < lateness->len; ++n)
+        total += g_array_index(lateness, gint64, n);
+    bench_report_double(report, "loop_latency_mean_usec",
+            (double) total / lateness->len);
+    bench_report_int(report, "loop_latency_p99_usec",
+            g_array_index(lateness, gint64, lateness->len * 99 / 100));
+    bench_report_int(report, "loop_latency_max_usec",
+            g_array_index(lateness, gint64, lateness->len - 1));
+}
+
+void bench_drain_main_loop(void)
+{
+    while (g_main_context_pending(NULL))
+        g_main_context_iteration(NULL, FALSE);
+}
+
+static void bench_replay_stream(BenchReport *report, ROXTermData *roxterm,
+        BenchStream *stream)
+{
+    BenchReplay br;
+    int fds[2];
+    Osc52Filter *oflt;
+    guint probe_tag;
+    guint64 allocs0, bytes0, allocs1, bytes1;
+    gboolean counted;
+    gint64 start, elapsed;
+
+    if (pipe(fds))
+        g_error("Unable to open replay pipe: %s", g_strerror(errno));
+    br.vte = roxterm_get_vte_terminal(roxterm);
+    br.pipe_r = fds[0];
+    br.pipe_w = fds[1];
+    br.data = g_bytes_get_data(stream->data, &br.len);
+    br.pos = 0;
+    br.loop = g_main_loop_new(NULL, FALSE);
+    br.lateness = g_array_new(FALSE, FALSE, sizeof(gint64));
+    oflt = osc52filter_create_for_fd(roxterm, br.pipe_r,
+            BENCH_REPLAY_OSC52_BUFFER);
+    vte_terminal_reset(br.vte, TRUE, TRUE);
+    bench_drain_main_loop();
+
+    counted = bench_alloc_get_counts(&allocs0, &bytes0);
+    start = g_get_monotonic_time();
+    br.probe_due = start + BENCH_REPLAY_PROBE_MS * 1000;
+    probe_tag = g_timeout_add_full(G_PRIORITY_HIGH, BENCH_REPLAY_PROBE_MS,
+            bench_replay_probe, &br, NULL);
+    g_idle_add_full(G_PRIORITY_DEFAULT, bench_replay_feed, &br, NULL);
+    g_main_loop_run(br.loop);
+    /* Include deferred work such as OSC 52 handling and title updates */
+    bench_drain_main_loop();
+    elapsed = g_get_monotonic_time() - start;
+    g_source_remove(probe_tag);
+    bench_alloc_get_counts(&allocs1, &bytes1);
+
+    bench_report_begin_case(report, stream->name);
+    bench_report_int(report, "bytes", br.len);
+    bench_report_int(report, "usec", elapsed);
+    bench_report_double(report, "mb_per_sec",
+            bench_mb_per_sec(br.len, elapsed));
+    if (counted)
+    {
+        bench_report_int(report, "allocations", allocs1 - allocs0);
+        bench_report_int(report, "allocated_bytes", bytes1 - bytes0);
+    }
+    bench_replay_report_lateness(report, br.lateness);
+
+    osc52filter_remove(oflt);
+    close(br.pipe_r);
+    close(br.pipe_w);
+    g_array_free(br.lateness, TRUE);
+    g_main_loop_unref(br.loop);
+}
+
+ROXTermData *bench_open_terminal(gboolean new_tab)
+{
+    static const char *args[] = {
+        "roxterm-bench", "--separate", "--profile=roxterm-bench",
+        "--execute", "cat", NULL
+    };
+    static gboolean initialised = FALSE;
+    MultiWin *win;
+    MultiTab *tab;
+
+    if (!initialised)
+    {
+        char **argv = g_strdupv((char **) args);
+        int argc = g_strv_length(argv);
+
+        if (!gtk_init_check(NULL, NULL))
+            return NULL;
+        global_options_preparse_argv_for_execute(&argc, argv, FALSE);
+        global_options_init(&argc, &argv, FALSE);
+        roxterm_init();
+        initialised = TRUE;
+    }
+    global_options_tab = new_tab && multi_win_all;
+    roxterm_launch(environ);
+    bench_drain_main_loop();
+    win = multi_win_all ? multi_win_all->data : NULL;
+    tab = win ? multi_win_get_current_tab(win) : NULL;
+    return tab ? multi_tab_get_user_data(tab) : NULL;
+}
+
+void bench_replay(BenchReport *report)
+{
+    ROXTermData *roxterm = bench_open_terminal(FALSE);
+    GPtrArray *corpus;
+    guint n;
+
+    if (!roxterm)
+    {
+        bench_report_string(report, "skipped", "unable to open a terminal");
+        return;
+    }
+    corpus = bench_corpus_load();
+    for (n = 0; n < corpus->len; ++n)
+        bench_replay_stream(report, roxterm, g_ptr_array_index(corpus, n));
+    g_ptr_array_unref(corpus);
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
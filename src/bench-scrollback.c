@@ -0,0 +1,180 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "defns.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "multitab.h"
+#include "scrollback.h"
+
+/* Stress test for the scrollback governor. Opens many tabs and floods each
+ * with more output than its share of the budget, then checks that the total
+ * of the governor's allocations stays within the budget and compares the
+ * growth in resident memory with the same load and no budget. The tabs use a
+ * profile with unlimited scrollback unless roxterm-bench's profile says
+ * otherwise. This needs a display; use xvfb-run where there isn't one.
+ */
+
+#define BENCH_SCROLLBACK_TABS 40
+#define BENCH_SCROLLBACK_LINES 20000
+#define BENCH_SCROLLBACK_BUDGET 40000
+#define BENCH_SCROLLBACK_LINES_PER_FEED 500
+
+/* Longer than the governor's rebalancing interval */
+#define BENCH_SCROLLBACK_SETTLE_MS 2500
+
+static gint64 bench_scrollback_rss_kb(void)
+{
+    char *statm = NULL;
+    long pages = 0;
+
+    if (g_file_get_contents("/proc/self/statm", &statm, NULL, NULL))
+    {
+        if (sscanf(statm, "%*s %ld", &pages) != 1)
+            pages = 0;
+    }
+    g_free(statm);
+    return (gint64) pages * sysconf(_SC_PAGESIZE) / 1024;
+}
+
+static gboolean bench_scrollback_quit(gpointer loop)
+{
+    g_main_loop_quit(loop);
+    return G_SOURCE_REMOVE;
+}
+
+static void bench_scrollback_wait(guint ms)
+{
+    GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+
+    g_timeout_add(ms, bench_scrollback_quit, loop);
+    g_main_loop_run(loop);
+    g_main_loop_unref(loop);
+}
+
+static GList *bench_scrollback_get_terminals(void)
+{
+    GList *terms = NULL;
+    GList *wlink;
+
+    for (wlink = multi_win_all; wlink; wlink = g_list_next(wlink))
+    {
+        GList *tlink;
+
+        for (tlink = multi_win_get_tabs(wlink->data); tlink;
+                tlink = g_list_next(tlink))
+        {
+            terms = g_list_prepend(terms,
+                    roxterm_get_vte_terminal(
+                        multi_tab_get_user_data(tlink->data)));
+        }
+    }
+    return terms;
+}
+
+/* Feeds every terminal a batch at a time, letting the main loop run in
+ * between so the governor can rebalance as it would with real output.
+ */
+static void bench_scrollback_flood(GList *terms)
+{
+    GString *batch = g_string_new(NULL);
+    int line = 0;
+
+    while (line < BENCH_SCROLLBACK_LINES)
+    {
+        GList *link;
+        int n;
+
+        g_string_truncate(batch, 0);
+        for (n = 0; n < BENCH_SCROLLBACK_LINES_PER_FEED; ++n, ++line)
+        {
+            g_string_append_printf(batch, "%06d %s\r\n", line,
+                    "the quick brown fox jumps over the lazy dog "
+                    "0123456789abcdefghijklmnopqrstuvwxyz");
+        }
+        for (link = terms; link; link = g_list_next(link))
+            vte_terminal_feed(link->data, batch->str, batch->len);
+        bench_drain_main_loop();
+    }
+    g_string_free(batch, TRUE);
+}
+
+static void bench_scrollback_case(BenchReport *report, GList *terms,
+        glong budget)
+{
+    GList *link;
+    gint64 rss0, rss1;
+    gint64 start;
+    glong total;
+
+    for (link = terms; link; link = g_list_next(link))
+        vte_terminal_reset(link->data, TRUE, TRUE);
+    scrollback_set_budget(budget);
+    bench_drain_main_loop();
+    rss0 = bench_scrollback_rss_kb();
+    start = g_get_monotonic_time();
+    bench_scrollback_flood(terms);
+    /* Give the governor's timer a chance to catch up */
+    bench_scrollback_wait(BENCH_SCROLLBACK_SETTLE_MS);
+    rss1 = bench_scrollback_rss_kb();
+    total = scrollback_get_allocated_total();
+
+    bench_report_begin_case(report, budget ? "budget" : "no_budget");
+    bench_report_int(report, "tabs", g_list_length(terms));
+    bench_report_int(report, "lines_per_tab", BENCH_SCROLLBACK_LINES);
+    bench_report_int(report, "budget_lines", budget);
+    bench_report_int(report, "allocated_lines", total);
+    if (budget)
+    {
+        bench_report_string(report, "within_budget",
+                total >= 0 && total <= budget ? "yes" : "no");
+    }
+    bench_report_int(report, "usec", g_get_monotonic_time() - start);
+    bench_report_int(report, "rss_kb", rss1);
+    bench_report_int(report, "rss_growth_kb", rss1 - rss0);
+}
+
+void bench_scrollback_budget(BenchReport *report)
+{
+    glong old_budget = scrollback_get_budget();
+    GList *terms;
+    int n;
+
+    if (!bench_open_terminal(FALSE))
+    {
+        bench_report_string(report, "skipped", "unable to open a terminal");
+        return;
+    }
+    for (n = 1; n < BENCH_SCROLLBACK_TABS; ++n)
+        bench_open_terminal(TRUE);
+    terms = bench_scrollback_get_terminals();
+    /* RSS doesn't shrink much when memory is freed, so the budgeted case
+     * goes first.
+     */
+    bench_scrollback_case(report, terms, BENCH_SCROLLBACK_BUDGET);
+    bench_scrollback_case(report, terms, 0);
+    scrollback_set_budget(old_budget);
+    g_list_free(terms);
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
@@ -0,0 +1,181 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "defns.h"
+
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
+
+#include "bench.h"
+#include "dynopts.h"
+#include "multitab.h"
+#include "scrollback.h"
+#include "session-file.h"
+
+/* Saves a session with a lot of tabs whose profile has session_scrollback
+ * set, then loads it again. Reports the size of the files and how long it
+ * took to save them, how long it took to load the session, which only
+ * restores the scrollback of the tab showing in each window, and how long it
+ * then took to show another tab, which restores its scrollback on demand.
+ * This needs a display; use xvfb-run where there isn't one.
+ */
+
+#define BENCH_SESSION_SCROLLBACK_TABS 300
+#define BENCH_SESSION_SCROLLBACK_LINES 10000
+#define BENCH_SESSION_SCROLLBACK_LINES_PER_FEED 1000
+
+static void bench_session_scrollback_fill(GList *tabs)
+{
+    GString *batch = g_string_new(NULL);
+    GList *link;
+    int line = 0;
+
+    for (link = tabs; link; link = g_list_next(link))
+    {
+        VteTerminal *vte = roxterm_get_vte_terminal(
+                multi_tab_get_user_data(link->data));
+
+        vte_terminal_reset(vte, TRUE, TRUE);
+        vte_terminal_set_scrollback_lines(vte,
+                BENCH_SESSION_SCROLLBACK_LINES);
+    }
+    while (line < BENCH_SESSION_SCROLLBACK_LINES)
+    {
+        int n;
+
+        g_string_truncate(batch, 0);
+        for (n = 0; n < BENCH_SESSION_SCROLLBACK_LINES_PER_FEED; ++n, ++line)
+        {
+            g_string_append_printf(batch,
+                    "%06d CC src/module%d.o -O2 -Wall -I../include "
+                    "-c ../src/module%d.c\r\n", line, line % 89, line % 89);
+        }
+        for (link = tabs; link; link = g_list_next(link))
+        {
+            vte_terminal_feed(roxterm_get_vte_terminal(
+                        multi_tab_get_user_data(link->data)),
+                    batch->str, batch->len);
+        }
+        bench_drain_main_loop();
+    }
+    g_string_free(batch, TRUE);
+}
+
+static gint64 bench_session_scrollback_dir_size(const char *dir)
+{
+    GDir *gdir = g_dir_open(dir, 0, NULL);
+    const char *leaf;
+    gint64 size = 0;
+
+    while (gdir && (leaf = g_dir_read_name(gdir)) != NULL)
+    {
+        char *filename = g_build_filename(dir, leaf, NULL);
+        GStatBuf info;
+
+        if (!g_stat(filename, &info))
+            size += info.st_size;
+        g_free(filename);
+    }
+    if (gdir)
+        g_dir_close(gdir);
+    return size;
+}
+
+void bench_session_scrollback(BenchReport *report)
+{
+    ROXTermData *roxterm = bench_open_terminal(FALSE);
+    glong old_budget = scrollback_get_budget();
+    MultiWin *win;
+    GList *old_wins;
+    GList *wlink;
+    Options *profile;
+    char *dir;
+    char *filename;
+    char *scrollback_dir;
+    GStatBuf info;
+    gint64 start;
+    MultiTab *tab;
+    int n;
+
+    if (!roxterm)
+    {
+        bench_report_string(report, "skipped", "unable to open a terminal");
+        return;
+    }
+    win = roxterm_get_multi_win(roxterm);
+    for (n = 1; n < BENCH_SESSION_SCROLLBACK_TABS; ++n)
+        bench_open_terminal(TRUE);
+    scrollback_set_budget(0);
+    bench_session_scrollback_fill(multi_win_get_tabs(win));
+    profile = dynamic_options_lookup(dynamic_options_get("Profiles"),
+            roxterm_get_profile_name(roxterm));
+    options_set_int(profile, "session_scrollback", 1);
+
+    dir = bench_make_tmp_dir();
+    filename = g_build_filename(dir, "session", NULL);
+    scrollback_dir = g_strdup_printf("%s.scrollback", filename);
+    start = g_get_monotonic_time();
+    if (!save_session_to_file(filename, "roxterm-bench"))
+    {
+        bench_report_string(report, "skipped", "unable to save session");
+        goto out;
+    }
+    bench_report_int(report, "tabs", multi_win_get_ntabs(win));
+    bench_report_int(report, "lines_per_tab",
+            BENCH_SESSION_SCROLLBACK_LINES);
+    bench_report_int(report, "save_usec", g_get_monotonic_time() - start);
+    if (!g_stat(filename, &info))
+        bench_report_int(report, "session_bytes", info.st_size);
+    bench_report_int(report, "scrollback_bytes",
+            bench_session_scrollback_dir_size(scrollback_dir));
+
+    old_wins = g_list_copy(multi_win_all);
+    start = g_get_monotonic_time();
+    load_session_from_file(filename, NULL);
+    bench_drain_main_loop();
+    bench_report_int(report, "load_usec", g_get_monotonic_time() - start);
+    win = NULL;
+    for (wlink = multi_win_all; wlink && !win; wlink = g_list_next(wlink))
+    {
+        if (!g_list_find(old_wins, wlink->data))
+            win = wlink->data;
+    }
+    g_list_free(old_wins);
+    tab = win ? multi_win_get_tabs(win)->data : NULL;
+    if (tab && tab == multi_win_get_current_tab(win))
+        tab = g_list_last(multi_win_get_tabs(win))->data;
+    if (tab)
+    {
+        start = g_get_monotonic_time();
+        multi_win_select_tab(win, tab);
+        bench_drain_main_loop();
+        bench_report_int(report, "first_show_usec",
+                g_get_monotonic_time() - start);
+    }
+
+out:
+    options_set_int(profile, "session_scrollback", 0);
+    scrollback_set_budget(old_budget);
+    bench_remove_tmp_dir(scrollback_dir);
+    g_free(filename);
+    bench_remove_tmp_dir(dir);
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
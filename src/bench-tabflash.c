@@ -0,0 +1,118 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+
+#include "defns.h"
+
+#include "bench.h"
+#include "multitab.h"
+#include "multitab-label.h"
+
+/* Draws attention to every tab in a window with a lot of tabs and measures
+ * how often the shared flashing timer wakes the process up. This should stay
+ * at the flash rate however many tabs are flashing, and drop to 0 once they
+ * have all stopped. This needs a display; use xvfb-run where there isn't
+ * one.
+ */
+
+/* Long enough for the timer to measure its rate over at least one second */
+#define BENCH_TAB_FLASH_MS 2500
+
+static const guint bench_tab_flash_counts[] = { 1, 30, 300 };
+
+static gboolean bench_tab_flash_quit(gpointer loop)
+{
+    g_main_loop_quit(loop);
+    return G_SOURCE_REMOVE;
+}
+
+static void bench_tab_flash_wait(guint ms)
+{
+    GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+
+    g_timeout_add(ms, bench_tab_flash_quit, loop);
+    g_main_loop_run(loop);
+    g_main_loop_unref(loop);
+}
+
+/* Opens a new window with ntabs tabs */
+static MultiWin *bench_tab_flash_open_window(guint ntabs)
+{
+    GList *old_wins = g_list_copy(multi_win_all);
+    MultiWin *win = NULL;
+    GList *link;
+
+    bench_open_terminal(FALSE);
+    for (link = multi_win_all; link && !win; link = g_list_next(link))
+    {
+        if (!g_list_find(old_wins, link->data))
+            win = link->data;
+    }
+    g_list_free(old_wins);
+    if (!win)
+        return NULL;
+    while (multi_win_get_ntabs(win) < ntabs)
+        multi_tab_new(win, multi_win_get_user_data_for_current_tab(win));
+    bench_drain_main_loop();
+    return win;
+}
+
+void bench_tab_flash(BenchReport *report)
+{
+    guint n;
+
+    /* Make sure there's another window, so closing the benchmark's windows
+     * doesn't quit */
+    if (!bench_open_terminal(FALSE))
+    {
+        bench_report_string(report, "skipped", "unable to open a terminal");
+        return;
+    }
+    for (n = 0; n < G_N_ELEMENTS(bench_tab_flash_counts); ++n)
+    {
+        guint ntabs = bench_tab_flash_counts[n];
+        char *name = g_strdup_printf("tabs_%u", ntabs);
+        MultiWin *win = bench_tab_flash_open_window(ntabs);
+        GList *link;
+
+        bench_report_begin_case(report, name);
+        g_free(name);
+        if (!win)
+        {
+            bench_report_string(report, "skipped", "unable to open a window");
+            continue;
+        }
+        bench_report_int(report, "tabs", multi_win_get_ntabs(win));
+        for (link = multi_win_get_tabs(win); link; link = g_list_next(link))
+            multi_tab_draw_attention(link->data);
+        bench_tab_flash_wait(BENCH_TAB_FLASH_MS);
+        bench_report_int(report, "flashing_wakeups_per_sec",
+                multitab_label_get_animation_wakeup_rate());
+        for (link = multi_win_get_tabs(win); link; link = g_list_next(link))
+            multi_tab_cancel_attention(link->data);
+        bench_drain_main_loop();
+        bench_report_int(report, "stopped_wakeups_per_sec",
+                multitab_label_get_animation_wakeup_rate());
+        multi_win_delete(win);
+        bench_drain_main_loop();
+    }
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
@@ -0,0 +1,104 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+
+#include "defns.h"
+
+#include <string.h>
+
+#include "bench.h"
+#include "tabswitch.h"
+
+/* Times filtering the tab switcher's index one keystroke at a time, with a
+ * realistic mixture of titles, directories and profiles. Typing extends the
+ * query, so each keystroke only rescans the previous matches; deleting
+ * characters has to rescan every tab. This doesn't need a display.
+ */
+
+#define BENCH_TAB_SWITCH_TABS 5000
+#define BENCH_TAB_SWITCH_QUERY "rxtrmsrc"
+
+static const char *bench_tab_switch_words[] = {
+    "build", "vim", "htop", "ssh", "logs", "make", "git", "python",
+    "cargo", "tests", "deploy", "roxterm", "kernel", "docs", "server", "db"
+};
+
+static void bench_tab_switch_case(BenchReport *report, const char *name,
+        TabSwitchIndex *tsi, gboolean typing)
+{
+    const char *query = BENCH_TAB_SWITCH_QUERY;
+    int len = strlen(query);
+    gint64 total = 0;
+    gint64 longest = 0;
+    guint matches = 0;
+    int n;
+
+    for (n = 1; n <= len; ++n)
+    {
+        char *prefix = g_strndup(query, typing ? n : len - n + 1);
+        gint64 start = g_get_monotonic_time();
+        gint64 usec;
+
+        matches = tab_switch_index_filter(tsi, prefix);
+        usec = g_get_monotonic_time() - start;
+        total += usec;
+        longest = MAX(longest, usec);
+        g_free(prefix);
+    }
+    bench_report_begin_case(report, name);
+    bench_report_int(report, "keystrokes", len);
+    bench_report_int(report, "total_usec", total);
+    bench_report_int(report, "max_keystroke_usec", longest);
+    bench_report_int(report, "final_matches", matches);
+}
+
+void bench_tab_switch(BenchReport *report)
+{
+    TabSwitchIndex *tsi = tab_switch_index_new();
+    guint nwords = G_N_ELEMENTS(bench_tab_switch_words);
+    GRand *rand = g_rand_new_with_seed(1);
+    gint64 start = g_get_monotonic_time();
+    int n;
+
+    for (n = 0; n < BENCH_TAB_SWITCH_TABS; ++n)
+    {
+        const char *w1 = bench_tab_switch_words[g_rand_int_range(rand,
+                0, nwords)];
+        const char *w2 = bench_tab_switch_words[g_rand_int_range(rand,
+                0, nwords)];
+        char *title = g_strdup_printf("%s: %s ~/src/%s-%d", w1, w2, w2, n);
+        char *cwd = g_strdup_printf("/home/user/src/%s/%s/%d", w2, w1,
+                n % 97);
+
+        tab_switch_index_add(tsi, GINT_TO_POINTER(n + 1), title, cwd,
+                n % 7 ? "Default" : "Remote", g_rand_int(rand));
+        g_free(title);
+        g_free(cwd);
+    }
+    bench_report_int(report, "tabs", BENCH_TAB_SWITCH_TABS);
+    bench_report_int(report, "index_usec", g_get_monotonic_time() - start);
+    tab_switch_index_filter(tsi, "");
+    bench_tab_switch_case(report, "typing", tsi, TRUE);
+    bench_tab_switch_case(report, "deleting", tsi, FALSE);
+    g_rand_free(rand);
+    tab_switch_index_free(tsi);
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
@@ -0,0 +1,167 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "defns.h"
+
+#include "bench.h"
+#include "trigger.h"
+
+/* Feeds the corpus through a trigger matcher with increasing numbers of
+ * triggers, half strings and half regexes, to show that the cost of the
+ * single-pass matcher stays flat. The 0 case is the cost of stripping escape
+ * sequences and splitting lines alone. Nothing is dispatched to the main
+ * loop, so this doesn't need a display.
+ *
+ * It also checks that regexes which can't be combined with others still
+ * fire, and don't stop the others from firing.
+ */
+
+#define BENCH_TRIGGER_CHUNK 4096
+#define BENCH_TRIGGER_PASSES 8
+
+static const char *bench_trigger_strings[] = {
+    "BUILD FAILED", "password:", "Traceback (most recent call last)",
+    "warning: unused variable", "Segmentation fault", "No space left",
+};
+
+static const char *bench_trigger_regexes[] = {
+    "error\\[E[0-9]{4}\\]", "(?i)permission denied",
+    "FAIL(ED)?: [a-z_]+", "\\bpanic: .*",
+    "exit (status|code) [1-9][0-9]*",
+};
+
+static TriggerSet *bench_trigger_set_new(guint count)
+{
+    TriggerSet *ts = trigger_set_new();
+    guint n;
+
+    for (n = 0; n < count; ++n)
+    {
+        guint i = n / 2;
+        char *pattern;
+        gboolean regex = n % 2 == 1;
+
+        if (!regex)
+        {
+            pattern = i < G_N_ELEMENTS(bench_trigger_strings) ?
+                g_strdup(bench_trigger_strings[i]) :
+                g_strdup_printf("marker-%04u done", i);
+        }
+        else
+        {
+            pattern = i < G_N_ELEMENTS(bench_trigger_regexes) ?
+                g_strdup(bench_trigger_regexes[i]) :
+                g_strdup_printf("job %u (finished|aborted) in [0-9]+s", i);
+        }
+        trigger_set_add(ts, pattern, regex, TRIGGER_NOTIFY, NULL, NULL);
+        g_free(pattern);
+    }
+    trigger_set_compile(ts);
+    return ts;
+}
+
+static void bench_trigger_case(BenchReport *report, GPtrArray *corpus,
+        guint count)
+{
+    TriggerSet *ts = bench_trigger_set_new(count);
+    TriggerMatcher *tm = trigger_matcher_new(ts, NULL, NULL);
+    char *name = g_strdup_printf("triggers_%u", count);
+    guint64 total = 0;
+    gint64 start;
+    int pass;
+    guint n;
+
+    start = g_get_monotonic_time();
+    for (pass = 0; pass < BENCH_TRIGGER_PASSES; ++pass)
+    {
+        for (n = 0; n < corpus->len; ++n)
+        {
+            BenchStream *stream = g_ptr_array_index(corpus, n);
+            gsize len;
+            const guint8 *data = g_bytes_get_data(stream->data, &len);
+            gsize offset;
+
+            for (offset = 0; offset < len; offset += BENCH_TRIGGER_CHUNK)
+            {
+                trigger_matcher_feed(tm, data + offset,
+                        MIN(BENCH_TRIGGER_CHUNK, len - offset));
+            }
+            total += len;
+        }
+    }
+    start = g_get_monotonic_time() - start;
+    bench_report_begin_case(report, name);
+    bench_report_int(report, "triggers", count);
+    bench_report_int(report, "bytes", total);
+    bench_report_int(report, "usec", start);
+    bench_report_double(report, "mb_per_sec", bench_mb_per_sec(total, start));
+    bench_report_int(report, "hits", trigger_matcher_get_hits(tm));
+    trigger_matcher_free(tm);
+    trigger_set_unref(ts);
+    g_free(name);
+}
+
+/* The first and third of these regexes would swallow the rest of a combined
+ * regex, and the second's \E would then end the first's \Q. Each line
+ * should fire one trigger.
+ */
+static const char *bench_trigger_uncombinable[] = {
+    "\\Qa.b", "done\\E", "(?x)foo # note", "exit [0-9]+",
+};
+
+static const char bench_trigger_uncombinable_lines[] =
+    "x a.b y\ndone\nfoo\nexit 3\n";
+
+static void bench_trigger_combine_case(BenchReport *report)
+{
+    TriggerSet *ts = trigger_set_new();
+    TriggerMatcher *tm;
+    guint n;
+
+    for (n = 0; n < G_N_ELEMENTS(bench_trigger_uncombinable); ++n)
+    {
+        trigger_set_add(ts, bench_trigger_uncombinable[n], TRUE,
+                TRIGGER_NOTIFY, NULL, NULL);
+    }
+    trigger_set_compile(ts);
+    tm = trigger_matcher_new(ts, NULL, NULL);
+    trigger_matcher_feed(tm, (const guint8 *) bench_trigger_uncombinable_lines,
+            sizeof(bench_trigger_uncombinable_lines) - 1);
+    bench_report_begin_case(report, "uncombinable");
+    bench_report_int(report, "triggers", n);
+    bench_report_int(report, "expected_hits", n);
+    bench_report_int(report, "hits", trigger_matcher_get_hits(tm));
+    trigger_matcher_free(tm);
+    trigger_set_unref(ts);
+}
+
+void bench_triggers(BenchReport *report)
+{
+    static const guint counts[] = { 0, 1, 10, 200 };
+    GPtrArray *corpus = bench_corpus_load();
+    guint n;
+
+    for (n = 0; n < G_N_ELEMENTS(counts); ++n)
+        bench_trigger_case(report, corpus, counts[n]);
+    g_ptr_array_unref(corpus);
+    bench_trigger_combine_case(report);
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
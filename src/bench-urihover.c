@@ -0,0 +1,155 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+
+#include "defns.h"
+
+#include <sys/resource.h>
+
+#include <vte/vte.h>
+
+#include "bench.h"
+
+/* Measures the CPU used by sweeping the pointer over every cell of a screen
+ * full of URLs, with the URI regexes always registered with VTE (eager) and
+ * with lazy URI matching. The motion events are synthesized, so the pointer
+ * never rests long enough for lazy mode to register the regexes.
+ */
+
+#define BENCH_URI_HOVER_SWEEPS 3
+
+static gint64 bench_uri_hover_cpu_usec(void)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return (gint64) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) *
+            G_USEC_PER_SEC + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static void bench_uri_hover_fill(VteTerminal *vte)
+{
+    glong rows = vte_terminal_get_row_count(vte);
+    GString *s = g_string_new(NULL);
+    glong n;
+
+    for (n = 0; n < rows; ++n)
+    {
+        g_string_append_printf(s, "see https://example.com/%ld/page?q=%ld "
+                "and mailto:user%ld@example.org www.example.net/%ld",
+                n, n * 7, n, n * 13);
+        if (n < rows - 1)
+            g_string_append(s, "\r\n");
+    }
+    vte_terminal_feed(vte, s->str, s->len);
+    g_string_free(s, TRUE);
+    bench_drain_main_loop();
+}
+
+/* VTE receives pointer events in its own input-only window */
+static GdkWindow *bench_uri_hover_event_window(GtkWidget *widget)
+{
+    GdkWindow *parent = gtk_widget_get_window(widget);
+    GList *link;
+
+    for (link = gdk_window_peek_children(parent); link;
+            link = g_list_next(link))
+    {
+        gpointer user_data;
+
+        gdk_window_get_user_data(link->data, &user_data);
+        if (user_data == widget)
+            return link->data;
+    }
+    return parent;
+}
+
+static void bench_uri_hover_case(BenchReport *report, const char *name,
+        VteTerminal *vte, gboolean lazy)
+{
+    GtkWidget *widget = GTK_WIDGET(vte);
+    GdkWindow *window = bench_uri_hover_event_window(widget);
+    GdkSeat *seat = gdk_display_get_default_seat(
+            gtk_widget_get_display(widget));
+    glong cw = vte_terminal_get_char_width(vte);
+    glong ch = vte_terminal_get_char_height(vte);
+    glong columns = vte_terminal_get_column_count(vte);
+    glong rows = vte_terminal_get_row_count(vte);
+    gint64 wall, cpu;
+    guint events = 0;
+    int sweep;
+
+    roxterm_set_lazy_uri_matching(lazy);
+    bench_drain_main_loop();
+    wall = g_get_monotonic_time();
+    cpu = bench_uri_hover_cpu_usec();
+    for (sweep = 0; sweep < BENCH_URI_HOVER_SWEEPS; ++sweep)
+    {
+        glong row, column;
+
+        for (row = 0; row < rows; ++row)
+        {
+            for (column = 0; column < columns; ++column)
+            {
+                GdkEvent *event = gdk_event_new(GDK_MOTION_NOTIFY);
+
+                event->motion.window = g_object_ref(window);
+                event->motion.send_event = TRUE;
+                event->motion.time = GDK_CURRENT_TIME;
+                event->motion.x = column * cw + cw / 2;
+                event->motion.y = row * ch + ch / 2;
+                gdk_event_set_device(event, gdk_seat_get_pointer(seat));
+                gtk_widget_event(widget, event);
+                gdk_event_free(event);
+                ++events;
+            }
+            bench_drain_main_loop();
+        }
+    }
+    cpu = bench_uri_hover_cpu_usec() - cpu;
+    wall = g_get_monotonic_time() - wall;
+    bench_report_begin_case(report, name);
+    bench_report_int(report, "motion_events", events);
+    bench_report_int(report, "cpu_usec", cpu);
+    bench_report_int(report, "wall_usec", wall);
+    bench_report_double(report, "cpu_usec_per_event",
+            events ? (double) cpu / events : 0.0);
+}
+
+void bench_uri_hover(BenchReport *report)
+{
+    ROXTermData *roxterm = bench_open_terminal(FALSE);
+    VteTerminal *vte;
+
+    if (!roxterm)
+    {
+        bench_report_string(report, "skipped", "unable to open a terminal");
+        return;
+    }
+    vte = roxterm_get_vte_terminal(roxterm);
+    bench_uri_hover_fill(vte);
+    bench_report_int(report, "columns", vte_terminal_get_column_count(vte));
+    bench_report_int(report, "rows", vte_terminal_get_row_count(vte));
+    bench_uri_hover_case(report, "eager", vte, FALSE);
+    bench_uri_hover_case(report, "lazy", vte, TRUE);
+    roxterm_set_lazy_uri_matching(FALSE);
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
@@ -0,0 +1,90 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+
+#include "defns.h"
+
+#include "bench.h"
+#include "fontcache.h"
+#include "multitab.h"
+
+/* Times zooming a window with many tabs in and out through every zoom level,
+ * including the relayout, with and without the font cache.
+ */
+
+#define BENCH_ZOOM_TABS 100
+#define BENCH_ZOOM_STEPS 3
+
+static void bench_zoom_case(BenchReport *report, const char *name,
+        MultiWin *win, gboolean cached)
+{
+    int normal = multi_win_get_zoom_index(win);
+    int indexes[BENCH_ZOOM_STEPS * 4];
+    gint64 total = 0;
+    gint64 longest = 0;
+    int n;
+
+    for (n = 0; n < BENCH_ZOOM_STEPS; ++n)
+    {
+        indexes[n] = normal + n + 1;
+        indexes[BENCH_ZOOM_STEPS + n] = normal + BENCH_ZOOM_STEPS - n - 1;
+        indexes[BENCH_ZOOM_STEPS * 2 + n] = normal - n - 1;
+        indexes[BENCH_ZOOM_STEPS * 3 + n] = normal - BENCH_ZOOM_STEPS + n + 1;
+    }
+    font_cache_set_enabled(cached);
+    for (n = 0; n < (int) G_N_ELEMENTS(indexes); ++n)
+    {
+        gint64 start = g_get_monotonic_time();
+        gint64 usec;
+
+        multi_win_set_zoom_index(win, indexes[n]);
+        bench_drain_main_loop();
+        usec = g_get_monotonic_time() - start;
+        total += usec;
+        longest = MAX(longest, usec);
+    }
+    bench_report_begin_case(report, name);
+    bench_report_int(report, "zoom_steps", G_N_ELEMENTS(indexes));
+    bench_report_int(report, "total_usec", total);
+    bench_report_int(report, "max_step_usec", longest);
+    bench_report_int(report, "cached_fonts", font_cache_get_n_fonts());
+    font_cache_set_enabled(TRUE);
+}
+
+void bench_zoom(BenchReport *report)
+{
+    MultiWin *win;
+    int n;
+
+    if (!bench_open_terminal(FALSE))
+    {
+        bench_report_string(report, "skipped", "unable to open a terminal");
+        return;
+    }
+    for (n = 1; n < BENCH_ZOOM_TABS; ++n)
+        bench_open_terminal(TRUE);
+    bench_drain_main_loop();
+    win = multi_win_all->data;
+    bench_report_int(report, "tabs", g_list_length(multi_win_get_tabs(win)));
+    bench_zoom_case(report, "uncached", win, FALSE);
+    bench_zoom_case(report, "cached", win, TRUE);
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
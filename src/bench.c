@@ -0,0 +1,197 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "defns.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include "bench.h"
+#include "outputlog.h"
+#include "version.h"
+
+/* Usage: roxterm-bench [--corpus=FILE...] [NAME...]
+ * Runs the named benchmarks, or all of them, and prints the results to
+ * stdout as a JSON object. Benchmarks which replay pty output use FILEs as
+ * well as their built-in corpus.
+ */
+
+struct BenchReport {
+    GString *json;
+    gboolean first_bench;
+    gboolean in_case;
+    gboolean first_field;
+};
+
+static const Bench bench_all[] = {
+    { "output_log", bench_output_log },
+    { "replay", bench_replay },
+    { "pty_reader", bench_pty_reader },
+    { "pool_latency", bench_pool_latency },
+    { "scrollback_budget", bench_scrollback_budget },
+    { "find_all", bench_find_all },
+    { "search_index", bench_search_index },
+    { "paste", bench_paste },
+    { "session_scrollback", bench_session_scrollback },
+    { "triggers", bench_triggers },
+    { "close_tabs", bench_close_tabs },
+    { "config_cache", bench_config_cache },
+    { "tab_switch", bench_tab_switch },
+    { "zoom", bench_zoom },
+    { "uri_hover", bench_uri_hover },
+    { "tab_flash", bench_tab_flash },
+};
+
+static void bench_report_key(BenchReport *report, const char *key)
+{
+    if (!report->first_field)
+        g_string_append(report->json, ",");
+    report->first_field = FALSE;
+    g_string_append_printf(report->json, "\n      %s",
+            report->in_case ? "  " : "");
+    output_log_append_json_string(report->json, key);
+    g_string_append(report->json, ": ");
+}
+
+static void bench_report_end_case(BenchReport *report)
+{
+    if (report->in_case)
+    {
+        g_string_append(report->json, "\n      }");
+        report->in_case = FALSE;
+        report->first_field = FALSE;
+    }
+}
+
+void bench_report_begin_case(BenchReport *report, const char *name)
+{
+    bench_report_end_case(report);
+    bench_report_key(report, name);
+    g_string_append(report->json, "{");
+    report->in_case = TRUE;
+    report->first_field = TRUE;
+}
+
+void bench_report_int(BenchReport *report, const char *key, gint64 value)
+{
+    bench_report_key(report, key);
+    g_string_append_printf(report->json, "%" G_GINT64_FORMAT, value);
+}
+
+void bench_report_double(BenchReport *report, const char *key, double value)
+{
+    char buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+    bench_report_key(report, key);
+    g_string_append(report->json,
+            g_ascii_formatd(buf, sizeof(buf), "%.3f", value));
+}
+
+void bench_report_string(BenchReport *report, const char *key,
+        const char *value)
+{
+    bench_report_key(report, key);
+    output_log_append_json_string(report->json, value);
+}
+
+char *bench_make_tmp_dir(void)
+{
+    GError *error = NULL;
+    char *dir = g_dir_make_tmp("roxterm-bench-XXXXXX", &error);
+
+    if (!dir)
+        g_error("Unable to create temporary directory: %s", error->message);
+    return dir;
+}
+
+void bench_remove_tmp_dir(char *dir)
+{
+    GDir *gdir = g_dir_open(dir, 0, NULL);
+    const char *leaf;
+
+    while (gdir && (leaf = g_dir_read_name(gdir)) != NULL)
+    {
+        char *filename = g_build_filename(dir, leaf, NULL);
+
+        g_remove(filename);
+        g_free(filename);
+    }
+    if (gdir)
+        g_dir_close(gdir);
+    g_rmdir(dir);
+    g_free(dir);
+}
+
+static gboolean bench_selected(const char *name, int argc, char **argv)
+{
+    gboolean any = FALSE;
+    int n;
+
+    for (n = 1; n < argc; ++n)
+    {
+        if (g_str_has_prefix(argv[n], "--"))
+            continue;
+        if (!strcmp(argv[n], name))
+            return TRUE;
+        any = TRUE;
+    }
+    return !any;
+}
+
+int main(int argc, char **argv)
+{
+    BenchReport report;
+    guint n;
+    int a;
+
+    for (a = 1; a < argc; ++a)
+    {
+        if (g_str_has_prefix(argv[a], "--corpus="))
+            bench_corpus_add_file(argv[a] + 9);
+    }
+    report.json = g_string_new(NULL);
+    report.first_bench = TRUE;
+    g_string_append_printf(report.json,
+            "{\n  \"version\": \"%s\",\n  \"benchmarks\": {", VERSION);
+    for (n = 0; n < G_N_ELEMENTS(bench_all); ++n)
+    {
+        const Bench *bench = &bench_all[n];
+
+        if (!bench_selected(bench->name, argc, argv))
+            continue;
+        g_string_append_printf(report.json, "%s\n    ",
+                report.first_bench ? "" : ",");
+        output_log_append_json_string(report.json, bench->name);
+        g_string_append(report.json, ": {");
+        report.first_bench = FALSE;
+        report.in_case = FALSE;
+        report.first_field = TRUE;
+        bench->func(&report);
+        bench_report_end_case(&report);
+        g_string_append(report.json, "\n    }");
+    }
+    g_string_append(report.json, "\n  }\n}\n");
+    fputs(report.json->str, stdout);
+    g_string_free(report.json, TRUE);
+    return 0;
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
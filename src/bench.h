@@ -0,0 +1,126 @@
+#ifndef BENCH_H
+#define BENCH_H
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* Support for roxterm-bench. Each benchmark adds its results to a report,
+ * which is printed as JSON so results can be compared between releases.
+ */
+
+#ifndef DEFNS_H
+#include "defns.h"
+#endif
+
+#include "roxterm.h"
+
+typedef struct BenchReport BenchReport;
+
+typedef void (*BenchFunc)(BenchReport *report);
+
+typedef struct {
+    const char *name;
+    BenchFunc func;
+} Bench;
+
+/* Starts a new group of results within the current benchmark's report */
+void bench_report_begin_case(BenchReport *report, const char *name);
+
+void bench_report_int(BenchReport *report, const char *key, gint64 value);
+
+void bench_report_double(BenchReport *report, const char *key, double value);
+
+void bench_report_string(BenchReport *report, const char *key,
+        const char *value);
+
+/* Bytes per microsecond to MB/s */
+inline static double bench_mb_per_sec(guint64 bytes, gint64 usecs)
+{
+    return usecs > 0 ? (double) bytes / (double) usecs : 0.0;
+}
+
+/* Creates a temporary directory, returning its name */
+char *bench_make_tmp_dir(void);
+
+/* Deletes the files in a directory created by bench_make_tmp_dir, then the
+ * directory itself, and frees dir.
+ */
+void bench_remove_tmp_dir(char *dir);
+
+/* Sets count and bytes to the totals allocated by malloc etc since the
+ * program started. Returns FALSE if allocations can't be counted on this
+ * platform.
+ */
+gboolean bench_alloc_get_counts(guint64 *count, guint64 *bytes);
+
+typedef struct {
+    char *name;
+    GBytes *data;
+} BenchStream;
+
+/* Adds a recording of raw pty output to the corpus */
+void bench_corpus_add_file(const char *filename);
+
+/* Returns an array of BenchStream; free it with g_ptr_array_unref */
+GPtrArray *bench_corpus_load(void);
+
+/* Runs the main loop until there's nothing left for it to do */
+void bench_drain_main_loop(void);
+
+/* Opens a roxterm window, or a tab in an existing window if new_tab is TRUE,
+ * the same way as main(), with a default profile and a command which doesn't
+ * produce any output of its own. Returns the current terminal of the first
+ * window, or NULL if there's no display.
+ */
+ROXTermData *bench_open_terminal(gboolean new_tab);
+
+void bench_output_log(BenchReport *report);
+
+void bench_replay(BenchReport *report);
+
+void bench_pty_reader(BenchReport *report);
+
+void bench_pool_latency(BenchReport *report);
+
+void bench_scrollback_budget(BenchReport *report);
+
+void bench_find_all(BenchReport *report);
+
+void bench_search_index(BenchReport *report);
+
+void bench_paste(BenchReport *report);
+
+void bench_session_scrollback(BenchReport *report);
+
+void bench_triggers(BenchReport *report);
+
+void bench_close_tabs(BenchReport *report);
+
+void bench_config_cache(BenchReport *report);
+
+void bench_tab_switch(BenchReport *report);
+
+void bench_zoom(BenchReport *report);
+
+void bench_uri_hover(BenchReport *report);
+
+void bench_tab_flash(BenchReport *report);
+
+#endif /* BENCH_H */
+
+/* vi:set sw=4 ts=4 et cindent cino= */
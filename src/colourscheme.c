@@ -19,6 +19,7 @@
 
 
 #include "colourscheme.h"
+#include "configcache.h"
 #include "dlg.h"
 #include "dynopts.h"
 
@@ -99,7 +100,7 @@ colour_scheme_parse(ColourScheme * scheme, GdkRGBA *colour,
         const char *colour_name)
 {
     (void) scheme;
-    if (gdk_rgba_parse(colour, colour_name))
+    if (config_cache_parse_colour(colour_name, colour))
     {
         return TRUE;
     }
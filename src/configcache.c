@@ -0,0 +1,675 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+
+#include "defns.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
+
+#include "configcache.h"
+#include "optsfile.h"
+
+/* Change this whenever CONFIG_CACHE_TYPE changes */
+#define CONFIG_CACHE_VERSION 1
+
+/* (version, files, colours, accels). Each file is (leafname, filename, mtime,
+ * size, searched directories with their mtimes, text), where filename is
+ * empty if none of the directories had the file. Each colour is (spec, red,
+ * green, blue, alpha) and each accel is (spec, key, modifiers). The arrays are
+ * sorted by their first member. mtimes are in nanoseconds, -1 for missing.
+ */
+#define CONFIG_CACHE_TYPE "(ua(ssxxa(sx)s)a(sdddd)a(suu))"
+#define CONFIG_CACHE_FILE_TYPE "(ssxxa(sx)s)"
+
+enum {
+    CONFIG_CACHE_FILES = 1,
+    CONFIG_CACHE_COLOURS,
+    CONFIG_CACHE_ACCELS
+};
+
+/* Gives roxterm a chance to open everything it needs for its first window
+ * before the cache is rebuilt.
+ */
+#define CONFIG_CACHE_REBUILD_DELAY 2
+
+typedef struct {
+    guint key;
+    GdkModifierType modifiers;
+} ConfigCacheAccel;
+
+/* Everything the background thread needs, so it doesn't have to touch any
+ * of the statics below.
+ */
+typedef struct {
+    char *filename;
+    char **pathv;
+    char **leafnames;
+    GVariant *colours;
+    GVariant *accels;
+} ConfigCacheJob;
+
+static gboolean config_cache_enabled = TRUE;
+static gboolean config_cache_opened = FALSE;
+static char *config_cache_filename = NULL;
+static GVariant *config_cache_root = NULL;
+
+/* Everything looked up since the cache was opened, which is merged with the
+ * existing contents when it's rebuilt. Values of config_cache_leafnames aren't
+ * used.
+ */
+static GHashTable *config_cache_leafnames = NULL;
+static GHashTable *config_cache_colours = NULL;
+static GHashTable *config_cache_accels = NULL;
+
+static gboolean config_cache_dirty = FALSE;
+static gboolean config_cache_rebuilding = FALSE;
+static guint config_cache_rebuild_tag = 0;
+
+static GdkRGBA *config_cache_copy_colour(const GdkRGBA *colour)
+{
+    GdkRGBA *copy = g_new(GdkRGBA, 1);
+
+    *copy = *colour;
+    return copy;
+}
+
+/* Returns the mtime of filename in nanoseconds, or -1 if it doesn't exist */
+static gint64 config_cache_stat(const char *filename, gint64 *size)
+{
+    GStatBuf st;
+
+    if (g_stat(filename, &st))
+        return -1;
+    if (size)
+        *size = st.st_size;
+    return (gint64) st.st_mtim.tv_sec * G_GINT64_CONSTANT(1000000000) +
+        st.st_mtim.tv_nsec;
+}
+
+static void config_cache_map(void)
+{
+    GError *err = NULL;
+    GMappedFile *mapping;
+    GBytes *bytes;
+    guint32 version = 0;
+
+    if (config_cache_root)
+    {
+        g_variant_unref(config_cache_root);
+        config_cache_root = NULL;
+    }
+    mapping = g_mapped_file_new(config_cache_filename, FALSE, &err);
+    if (!mapping)
+    {
+        /* It won't exist the first time roxterm is run */
+        if (!g_error_matches(err, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        {
+            g_warning(_("Unable to open config cache '%s': %s"),
+                    config_cache_filename, err->message);
+        }
+        g_error_free(err);
+        return;
+    }
+    /* The GBytes keeps the mapping alive for as long as the variant */
+    bytes = g_mapped_file_get_bytes(mapping);
+    g_mapped_file_unref(mapping);
+    config_cache_root = g_variant_ref_sink(g_variant_new_from_bytes(
+            G_VARIANT_TYPE(CONFIG_CACHE_TYPE), bytes, FALSE));
+    g_bytes_unref(bytes);
+
+    /* GVariant copes with corrupt data by returning default values, so a
+     * truncated file would fail this check too.
+     */
+    g_variant_get_child(config_cache_root, 0, "u", &version);
+    if (version != CONFIG_CACHE_VERSION)
+    {
+        g_variant_unref(config_cache_root);
+        config_cache_root = NULL;
+    }
+}
+
+static void config_cache_open(void)
+{
+    if (config_cache_opened)
+        return;
+    config_cache_opened = TRUE;
+    if (!config_cache_filename)
+    {
+        config_cache_filename = g_build_filename(g_get_user_cache_dir(),
+                ROXTERM_LEAF_DIR, "config-cache", NULL);
+    }
+    config_cache_leafnames = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, NULL);
+    config_cache_colours = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, g_free);
+    config_cache_accels = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, g_free);
+    config_cache_map();
+}
+
+static void config_cache_forget(void)
+{
+    if (!config_cache_opened)
+        return;
+    if (config_cache_rebuild_tag)
+    {
+        g_source_remove(config_cache_rebuild_tag);
+        config_cache_rebuild_tag = 0;
+    }
+    if (config_cache_root)
+    {
+        g_variant_unref(config_cache_root);
+        config_cache_root = NULL;
+    }
+    g_hash_table_destroy(config_cache_leafnames);
+    g_hash_table_destroy(config_cache_colours);
+    g_hash_table_destroy(config_cache_accels);
+    config_cache_leafnames = config_cache_colours = config_cache_accels = NULL;
+    config_cache_dirty = FALSE;
+    config_cache_opened = FALSE;
+}
+
+/* Binary searches the given array in the cache for an entry whose first
+ * member is the string key. The result must be unrefed.
+ */
+static GVariant *config_cache_bsearch(int member, const char *key)
+{
+    GVariant *array;
+    GVariant *result = NULL;
+    gsize lo = 0;
+    gsize hi;
+
+    if (!config_cache_root)
+        return NULL;
+    array = g_variant_get_child_value(config_cache_root, member);
+    hi = g_variant_n_children(array);
+    while (lo < hi)
+    {
+        gsize mid = lo + (hi - lo) / 2;
+        GVariant *entry = g_variant_get_child_value(array, mid);
+        GVariant *name = g_variant_get_child_value(entry, 0);
+        int cmp = strcmp(key, g_variant_get_string(name, NULL));
+
+        g_variant_unref(name);
+        if (!cmp)
+        {
+            result = entry;
+            break;
+        }
+        g_variant_unref(entry);
+        if (cmp < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    g_variant_unref(array);
+    return result;
+}
+
+/* Finds leafname the same way as options_file_build_filename(), recording
+ * the mtime of every directory it looks in. Returns NULL if the file can't be
+ * read, so it's left out of the cache and read normally, which reports the
+ * error.
+ */
+static GVariant *config_cache_build_file(char **pathv, const char *leafname)
+{
+    GVariantBuilder searched;
+    char *filename = NULL;
+    char *text = NULL;
+    gsize length = 0;
+    gint64 mtime = -1;
+    gint64 size = 0;
+    GVariant *result;
+    int n;
+
+    g_variant_builder_init(&searched, G_VARIANT_TYPE("a(sx)"));
+    for (n = 0; pathv && pathv[n] && !filename; ++n)
+    {
+        char *candidate = g_build_filename(pathv[n], leafname, NULL);
+        char *dir = g_path_get_dirname(candidate);
+
+        /* Statting before reading means a change made while this is running
+         * makes the entry look stale, rather than the other way round.
+         */
+        g_variant_builder_add(&searched, "(sx)", dir,
+                config_cache_stat(dir, NULL));
+        g_free(dir);
+        mtime = config_cache_stat(candidate, &size);
+        if (mtime != -1)
+            filename = candidate;
+        else
+            g_free(candidate);
+    }
+    if (filename && (!g_file_get_contents(filename, &text, &length, NULL) ||
+            !g_utf8_validate(text, length, NULL)))
+    {
+        g_variant_builder_clear(&searched);
+        g_free(filename);
+        g_free(text);
+        return NULL;
+    }
+    result = g_variant_new(CONFIG_CACHE_FILE_TYPE, leafname,
+            filename ? filename : "", mtime, size,
+            &searched, text ? text : "");
+    g_free(filename);
+    g_free(text);
+    return result;
+}
+
+static gboolean config_cache_build(ConfigCacheJob *job)
+{
+    GVariantBuilder files;
+    GVariant *root;
+    GError *err = NULL;
+    char *dir;
+    gboolean result;
+    int n;
+
+    g_variant_builder_init(&files,
+            G_VARIANT_TYPE("a" CONFIG_CACHE_FILE_TYPE));
+    for (n = 0; job->leafnames[n]; ++n)
+    {
+        GVariant *entry = config_cache_build_file(job->pathv,
+                job->leafnames[n]);
+
+        if (entry)
+            g_variant_builder_add_value(&files, entry);
+    }
+    root = g_variant_ref_sink(g_variant_new("(ua" CONFIG_CACHE_FILE_TYPE
+                "@a(sdddd)@a(suu))", CONFIG_CACHE_VERSION, &files,
+                job->colours, job->accels));
+
+    /* g_file_set_contents() replaces the file by renaming, so a copy that's
+     * already mapped isn't affected.
+     */
+    dir = g_path_get_dirname(job->filename);
+    result = g_mkdir_with_parents(dir, 0755) == 0 &&
+        g_file_set_contents(job->filename, g_variant_get_data(root),
+                g_variant_get_size(root), &err);
+    if (!result)
+    {
+        g_warning(_("Unable to write config cache '%s': %s"), job->filename,
+                err ? err->message : g_strerror(errno));
+        if (err)
+            g_error_free(err);
+    }
+    g_free(dir);
+    g_variant_unref(root);
+    return result;
+}
+
+/* Adds any leafnames in the existing cache to config_cache_leafnames so they
+ * are carried over, and returns them all, sorted.
+ */
+static char **config_cache_merge_leafnames(void)
+{
+    GList *keys;
+    GList *link;
+    char **result;
+    int n = 0;
+
+    if (config_cache_root)
+    {
+        GVariant *files = g_variant_get_child_value(config_cache_root,
+                CONFIG_CACHE_FILES);
+        GVariantIter iter;
+        const char *leafname;
+
+        g_variant_iter_init(&iter, files);
+        while (g_variant_iter_next(&iter, "(&ssxxa(sx)s)", &leafname,
+                    NULL, NULL, NULL, NULL, NULL))
+        {
+            if (!g_hash_table_contains(config_cache_leafnames, leafname))
+            {
+                g_hash_table_add(config_cache_leafnames, g_strdup(leafname));
+            }
+        }
+        g_variant_unref(files);
+    }
+    keys = g_list_sort(g_hash_table_get_keys(config_cache_leafnames),
+            (GCompareFunc) strcmp);
+    result = g_new(char *, g_list_length(keys) + 1);
+    for (link = keys; link; link = g_list_next(link))
+        result[n++] = g_strdup(link->data);
+    result[n] = NULL;
+    g_list_free(keys);
+    return result;
+}
+
+static GVariant *config_cache_merge_colours(void)
+{
+    GVariantBuilder builder;
+    GList *keys;
+    GList *link;
+
+    if (config_cache_root)
+    {
+        GVariant *colours = g_variant_get_child_value(config_cache_root,
+                CONFIG_CACHE_COLOURS);
+        GVariantIter iter;
+        const char *spec;
+        GdkRGBA rgba;
+
+        g_variant_iter_init(&iter, colours);
+        while (g_variant_iter_next(&iter, "(&sdddd)", &spec,
+                    &rgba.red, &rgba.green, &rgba.blue, &rgba.alpha))
+        {
+            if (!g_hash_table_contains(config_cache_colours, spec))
+            {
+                g_hash_table_insert(config_cache_colours, g_strdup(spec),
+                        config_cache_copy_colour(&rgba));
+            }
+        }
+        g_variant_unref(colours);
+    }
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a(sdddd)"));
+    keys = g_list_sort(g_hash_table_get_keys(config_cache_colours),
+            (GCompareFunc) strcmp);
+    for (link = keys; link; link = g_list_next(link))
+    {
+        const GdkRGBA *rgba = g_hash_table_lookup(config_cache_colours,
+                link->data);
+
+        g_variant_builder_add(&builder, "(sdddd)", link->data,
+                rgba->red, rgba->green, rgba->blue, rgba->alpha);
+    }
+    g_list_free(keys);
+    return g_variant_ref_sink(g_variant_builder_end(&builder));
+}
+
+static GVariant *config_cache_merge_accels(void)
+{
+    GVariantBuilder builder;
+    GList *keys;
+    GList *link;
+
+    if (config_cache_root)
+    {
+        GVariant *accels = g_variant_get_child_value(config_cache_root,
+                CONFIG_CACHE_ACCELS);
+        GVariantIter iter;
+        const char *spec;
+        guint32 key, modifiers;
+
+        g_variant_iter_init(&iter, accels);
+        while (g_variant_iter_next(&iter, "(&suu)", &spec, &key, &modifiers))
+        {
+            if (!g_hash_table_contains(config_cache_accels, spec))
+            {
+                ConfigCacheAccel *copy = g_new(ConfigCacheAccel, 1);
+
+                copy->key = key;
+                copy->modifiers = modifiers;
+                g_hash_table_insert(config_cache_accels, g_strdup(spec), copy);
+            }
+        }
+        g_variant_unref(accels);
+    }
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a(suu)"));
+    keys = g_list_sort(g_hash_table_get_keys(config_cache_accels),
+            (GCompareFunc) strcmp);
+    for (link = keys; link; link = g_list_next(link))
+    {
+        const ConfigCacheAccel *accel = g_hash_table_lookup(
+                config_cache_accels, link->data);
+
+        g_variant_builder_add(&builder, "(suu)", link->data,
+                accel->key, (guint32) accel->modifiers);
+    }
+    g_list_free(keys);
+    return g_variant_ref_sink(g_variant_builder_end(&builder));
+}
+
+static ConfigCacheJob *config_cache_new_job(void)
+{
+    ConfigCacheJob *job = g_new(ConfigCacheJob, 1);
+
+    job->filename = g_strdup(config_cache_filename);
+    job->pathv = g_strdupv((char **) options_file_get_pathv());
+    job->leafnames = config_cache_merge_leafnames();
+    job->colours = config_cache_merge_colours();
+    job->accels = config_cache_merge_accels();
+    return job;
+}
+
+static void config_cache_free_job(ConfigCacheJob *job)
+{
+    g_free(job->filename);
+    g_strfreev(job->pathv);
+    g_strfreev(job->leafnames);
+    g_variant_unref(job->colours);
+    g_variant_unref(job->accels);
+    g_free(job);
+}
+
+static void config_cache_rebuild_thread(GTask *task, gpointer source,
+        gpointer job, GCancellable *cancellable)
+{
+    (void) source;
+    (void) cancellable;
+    g_task_return_boolean(task, config_cache_build(job));
+}
+
+static gboolean config_cache_start_rebuild(gpointer data);
+
+static void config_cache_rebuilt(GObject *source, GAsyncResult *result,
+        gpointer data)
+{
+    ConfigCacheJob *job = g_task_get_task_data(G_TASK(result));
+    (void) source;
+    (void) data;
+
+    config_cache_rebuilding = FALSE;
+    if (!g_task_propagate_boolean(G_TASK(result), NULL) ||
+            !config_cache_opened ||
+            strcmp(job->filename, config_cache_filename))
+    {
+        return;
+    }
+    /* Switch to the new file so that entries which were stale can be used
+     * again.
+     */
+    config_cache_map();
+    if (config_cache_dirty && !config_cache_rebuild_tag)
+    {
+        config_cache_rebuild_tag = g_timeout_add_seconds(
+                CONFIG_CACHE_REBUILD_DELAY, config_cache_start_rebuild, NULL);
+    }
+}
+
+static gboolean config_cache_start_rebuild(gpointer data)
+{
+    GTask *task = g_task_new(NULL, NULL, config_cache_rebuilt, NULL);
+    (void) data;
+
+    config_cache_rebuild_tag = 0;
+    config_cache_dirty = FALSE;
+    config_cache_rebuilding = TRUE;
+    g_task_set_task_data(task, config_cache_new_job(),
+            (GDestroyNotify) config_cache_free_job);
+    g_task_run_in_thread(task, config_cache_rebuild_thread);
+    g_object_unref(task);
+    return G_SOURCE_REMOVE;
+}
+
+static void config_cache_schedule_rebuild(void)
+{
+    config_cache_dirty = TRUE;
+    if (!config_cache_rebuild_tag && !config_cache_rebuilding)
+    {
+        config_cache_rebuild_tag = g_timeout_add_seconds(
+                CONFIG_CACHE_REBUILD_DELAY, config_cache_start_rebuild, NULL);
+    }
+}
+
+gboolean config_cache_lookup_file(const char *leafname,
+        const char **filename, const char **text, gsize *length)
+{
+    GVariant *entry;
+    GVariantIter *searched;
+    const char *cached_filename;
+    const char *dir;
+    gint64 mtime, size, dir_mtime;
+    gint64 current_size = 0;
+    gboolean valid = TRUE;
+
+    if (!config_cache_enabled)
+        return FALSE;
+    config_cache_open();
+    if (!g_hash_table_contains(config_cache_leafnames, leafname))
+        g_hash_table_add(config_cache_leafnames, g_strdup(leafname));
+
+    entry = config_cache_bsearch(CONFIG_CACHE_FILES, leafname);
+    if (!entry)
+    {
+        config_cache_schedule_rebuild();
+        return FALSE;
+    }
+    g_variant_get(entry, "(&s&sxxa(sx)&s)", NULL, &cached_filename,
+            &mtime, &size, &searched, text);
+    while (valid && g_variant_iter_next(searched, "(&sx)", &dir, &dir_mtime))
+        valid = config_cache_stat(dir, NULL) == dir_mtime;
+    g_variant_iter_free(searched);
+    if (valid && cached_filename[0])
+    {
+        valid = config_cache_stat(cached_filename, &current_size) == mtime &&
+            current_size == size;
+    }
+    g_variant_unref(entry);
+    if (!valid)
+    {
+        config_cache_schedule_rebuild();
+        return FALSE;
+    }
+    /* These still point into the mapped file, which config_cache_root keeps
+     * alive.
+     */
+    *filename = cached_filename[0] ? cached_filename : NULL;
+    *length = strlen(*text);
+    return TRUE;
+}
+
+gboolean config_cache_parse_colour(const char *spec, GdkRGBA *colour)
+{
+    const GdkRGBA *parsed;
+    GVariant *entry;
+
+    if (!config_cache_enabled)
+        return gdk_rgba_parse(colour, spec);
+    config_cache_open();
+    parsed = g_hash_table_lookup(config_cache_colours, spec);
+    if (parsed)
+    {
+        *colour = *parsed;
+        return TRUE;
+    }
+    entry = config_cache_bsearch(CONFIG_CACHE_COLOURS, spec);
+    if (entry)
+    {
+        g_variant_get(entry, "(&sdddd)", NULL, &colour->red, &colour->green,
+                &colour->blue, &colour->alpha);
+        g_variant_unref(entry);
+        return TRUE;
+    }
+    /* Colours which can't be parsed aren't cached, so they're reported every
+     * time.
+     */
+    if (!gdk_rgba_parse(colour, spec))
+        return FALSE;
+    g_hash_table_insert(config_cache_colours, g_strdup(spec),
+            config_cache_copy_colour(colour));
+    config_cache_schedule_rebuild();
+    return TRUE;
+}
+
+void config_cache_parse_accel(const char *spec,
+        guint *key, GdkModifierType *modifiers)
+{
+    ConfigCacheAccel *parsed;
+    GVariant *entry;
+
+    if (!config_cache_enabled)
+    {
+        gtk_accelerator_parse(spec, key, modifiers);
+        return;
+    }
+    config_cache_open();
+    parsed = g_hash_table_lookup(config_cache_accels, spec);
+    if (parsed)
+    {
+        *key = parsed->key;
+        *modifiers = parsed->modifiers;
+        return;
+    }
+    entry = config_cache_bsearch(CONFIG_CACHE_ACCELS, spec);
+    if (entry)
+    {
+        guint32 mods;
+
+        g_variant_get(entry, "(&suu)", NULL, key, &mods);
+        *modifiers = mods;
+        g_variant_unref(entry);
+        return;
+    }
+    parsed = g_new(ConfigCacheAccel, 1);
+    gtk_accelerator_parse(spec, &parsed->key, &parsed->modifiers);
+    *key = parsed->key;
+    *modifiers = parsed->modifiers;
+    g_hash_table_insert(config_cache_accels, g_strdup(spec), parsed);
+    config_cache_schedule_rebuild();
+}
+
+gboolean config_cache_write_now(void)
+{
+    ConfigCacheJob *job;
+    gboolean result;
+
+    config_cache_open();
+    if (config_cache_rebuild_tag)
+    {
+        g_source_remove(config_cache_rebuild_tag);
+        config_cache_rebuild_tag = 0;
+    }
+    config_cache_dirty = FALSE;
+    job = config_cache_new_job();
+    result = config_cache_build(job);
+    config_cache_free_job(job);
+    if (result)
+        config_cache_map();
+    return result;
+}
+
+void config_cache_set_filename(const char *filename)
+{
+    config_cache_forget();
+    g_free(config_cache_filename);
+    config_cache_filename = g_strdup(filename);
+}
+
+void config_cache_set_enabled(gboolean enabled)
+{
+    config_cache_enabled = enabled;
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
@@ -0,0 +1,66 @@
+#ifndef CONFIGCACHE_H
+#define CONFIGCACHE_H
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+/* A cache of the config files roxterm reads at startup, with the colours and
+ * keyboard shortcuts they contain already parsed. It's a GVariant file in the
+ * user's cache directory, which is mmap'd, and each entry is checked against
+ * the mtimes and sizes of its source file and the directories which were
+ * searched to find it before it's used. When anything is missing or stale the
+ * cache is rebuilt in a background thread.
+ */
+
+#ifndef DEFNS_H
+#include "defns.h"
+#endif
+
+/* If the cache has an up to date copy of the file options_file_open() would
+ * find for leafname, this returns TRUE, sets *filename to its full pathname,
+ * or NULL if there is no such file, and sets *text and *length to its
+ * contents. The strings belong to the cache. Returns FALSE if the file has
+ * to be read from disk, after which it will be added to the cache.
+ */
+gboolean config_cache_lookup_file(const char *leafname,
+        const char **filename, const char **text, gsize *length);
+
+/* Like gdk_rgba_parse(), but uses the cache */
+gboolean config_cache_parse_colour(const char *spec, GdkRGBA *colour);
+
+/* Like gtk_accelerator_parse(), but uses the cache */
+void config_cache_parse_accel(const char *spec,
+        guint *key, GdkModifierType *modifiers);
+
+/* Writes the cache now instead of in the background, including everything
+ * which has been looked up so far. Returns FALSE if it couldn't be written.
+ */
+gboolean config_cache_write_now(void);
+
+/* Uses a different file for the cache, forgetting the current one; NULL
+ * reverts to the default. This is mainly for roxterm-bench.
+ */
+void config_cache_set_filename(const char *filename);
+
+/* Disabling the cache makes everything read and parse from scratch */
+void config_cache_set_enabled(gboolean enabled);
+
+#endif /* CONFIGCACHE_H */
+
+/* vi:set sw=4 ts=4 et cindent cino= */
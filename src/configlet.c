@@ -892,7 +892,7 @@ void on_ui_theme_radio_toggled(GtkToggleButton *button, ConfigletData *cg)
         capplet_set_int(global_options, opt_name, n);
         g_free(opt_name);
         configlet_on_dark_pref_changed(
-            global_options_system_theme_is_dark(),
+            global_options_update_dark_theme(),
             &cg->colours);
     }
 }
@@ -960,7 +960,8 @@ gboolean configlet_open()
     }
     else
     {
-        static char const *build_objs[] = { "Configlet", NULL };
+        static char const *build_objs[] = { "Configlet",
+            "scrollback_budget_adjustment", NULL };
         ConfigletData *cg = configlet_data = g_new0(ConfigletData, 1);
         GError *error = NULL;
 
@@ -1003,6 +1004,9 @@ gboolean configlet_open()
 
         capplet_set_radio(&cg->capp, "warn_close", 3);
         capplet_set_boolean_toggle(&cg->capp, "only_warn_running", FALSE);
+        capplet_set_spin_button(&cg->capp, "scrollback_budget", 0);
+        capplet_set_boolean_toggle(&cg->capp, "tab_menu_items", TRUE);
+        capplet_set_boolean_toggle(&cg->capp, "lazy_uri_matching", FALSE);
 
         const char *hide_widget = NULL;
         if (!global_options_has_gtk_dark_theme_setting())
@@ -0,0 +1,88 @@
+#ifndef ESCSCAN_H
+#define ESCSCAN_H
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <string.h>
+
+#include <glib.h>
+
+/* Skips escape sequences in a terminal's output stream, one byte at a time,
+ * so the plain text can be picked out of it. This only needs to be good
+ * enough for indexing and matching text, not for rendering.
+ */
+
+typedef enum {
+    ESC_SCAN_TEXT,
+    ESC_SCAN_ESC,
+    ESC_SCAN_CSI,
+    ESC_SCAN_STRING,            /* OSC, DCS etc, up to BEL or ST */
+    ESC_SCAN_STRING_ESC,
+    ESC_SCAN_CHARSET            /* ESC ( etc take one more byte */
+} EscScanState;
+
+/* Advances *state over c. Returns TRUE if c is text, FALSE if it's part of
+ * an escape sequence. Callers which need a CSI's parameters can look at the
+ * bytes which leave *state as ESC_SCAN_CSI.
+ */
+static inline gboolean esc_scan_feed(EscScanState *state, guint8 c)
+{
+    switch (*state)
+    {
+        case ESC_SCAN_TEXT:
+            if (c != 0x1b)
+                return TRUE;
+            *state = ESC_SCAN_ESC;
+            break;
+        case ESC_SCAN_ESC:
+            if (c == '[')
+                *state = ESC_SCAN_CSI;
+            else if (c == ']' || c == 'P' || c == '_' || c == '^' || c == 'X')
+                *state = ESC_SCAN_STRING;
+            else if (c && strchr("()*+-./#%", c))
+                *state = ESC_SCAN_CHARSET;
+            else if (c != 0x1b)
+                *state = ESC_SCAN_TEXT;
+            break;
+        case ESC_SCAN_CSI:
+            if (c >= 0x40 && c <= 0x7e)
+                *state = ESC_SCAN_TEXT;
+            else if (c == 0x1b)
+                *state = ESC_SCAN_ESC;
+            break;
+        case ESC_SCAN_STRING:
+            if (c == 7)
+                *state = ESC_SCAN_TEXT;
+            else if (c == 0x1b)
+                *state = ESC_SCAN_STRING_ESC;
+            break;
+        case ESC_SCAN_STRING_ESC:
+            *state = c == 0x1b ? ESC_SCAN_STRING_ESC :
+                    c == '\\' ? ESC_SCAN_TEXT : ESC_SCAN_STRING;
+            break;
+        case ESC_SCAN_CHARSET:
+            *state = ESC_SCAN_TEXT;
+            break;
+    }
+    return FALSE;
+}
+
+#endif /* ESCSCAN_H */
+
+/* vi:set sw=4 ts=4 et cindent cino= */
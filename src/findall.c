@@ -0,0 +1,723 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "defns.h"
+
+#include <string.h>
+
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+
+#include "dlg.h"
+#include "findall.h"
+
+/* Rows copied from VTE in one go */
+#define FIND_ALL_SLICE_ROWS 2000
+
+/* The main thread stops copying after this long and lets the main loop get
+ * on with other things before continuing.
+ */
+#define FIND_ALL_SNAPSHOT_USEC 8000
+
+/* Copying pauses while this many slices per thread are waiting to be
+ * searched, to limit the amount of text held in memory.
+ */
+#define FIND_ALL_JOBS_PER_THREAD 4
+
+#define FIND_ALL_MAX_RESULTS 10000
+
+/* Longer matching lines are truncated in results */
+#define FIND_ALL_MAX_LINE_BYTES 256
+
+typedef struct {
+    ROXTermData *roxterm;
+    MultiTab *tab;
+} FindAllTerm;
+
+struct FindAll {
+    pcre2_code *code;
+    GList *terms;               /* FindAllTerm */
+    GList *current;
+    glong next_row, end_row;
+    guint slice_tag;
+    guint jobs;                 /* Slices being searched */
+    gint cancelled;
+    gboolean freed;
+    GArray *results;            /* FindAllResult */
+    gboolean truncated;
+    FindAllDoneHandler done;
+    gpointer done_data;
+    gint64 main_usec;
+    gint64 longest_slice_usec;
+};
+
+typedef struct {
+    FindAll *fa;
+    FindAllTerm *term;
+    glong first_row;
+    glong end_row;
+    char *text;
+    gsize len;
+    GArray *hits;               /* FindAllResult */
+} FindAllJob;
+
+static GThreadPool *find_all_pool = NULL;
+static int find_all_max_threads = 0;
+
+static int find_all_get_threads(void)
+{
+    return find_all_max_threads > 0 ?
+            find_all_max_threads : (int) g_get_num_processors();
+}
+
+void find_all_set_max_threads(int threads)
+{
+    find_all_max_threads = threads;
+    if (find_all_pool)
+        g_thread_pool_set_max_threads(find_all_pool, find_all_get_threads(),
+                NULL);
+}
+
+static void find_all_result_clear(gpointer data)
+{
+    FindAllResult *result = data;
+
+    g_free(result->text);
+}
+
+static void find_all_add_hit(FindAllJob *job, const char *line,
+        gsize len, glong lines_before)
+{
+    FindAllResult hit;
+
+    if (len > FIND_ALL_MAX_LINE_BYTES)
+    {
+        len = g_utf8_find_prev_char(line, line + FIND_ALL_MAX_LINE_BYTES + 1)
+                - line;
+    }
+    hit.roxterm = job->term->roxterm;
+    hit.tab = job->term->tab;
+    hit.row = job->first_row + lines_before;
+    hit.from_end = job->end_row - hit.row;
+    hit.text = g_strndup(line, len);
+    g_array_append_val(job->hits, hit);
+}
+
+static gboolean find_all_job_done(gpointer data);
+
+/* Runs in a worker thread. Only the first match on each line is recorded. */
+static void find_all_run_job(gpointer data, gpointer user_data)
+{
+    FindAllJob *job = data;
+    FindAll *fa = job->fa;
+    pcre2_match_data *md;
+    PCRE2_SIZE offset = 0;
+    const char *line_start = job->text;
+    glong lines_before = 0;
+    (void) user_data;
+
+    job->hits = g_array_new(FALSE, FALSE, sizeof(FindAllResult));
+    g_array_set_clear_func(job->hits, find_all_result_clear);
+    md = g_atomic_int_get(&fa->cancelled) ? NULL :
+            pcre2_match_data_create_from_pattern(fa->code, NULL);
+    while (md && offset < job->len)
+    {
+        int rc = pcre2_match(fa->code, (PCRE2_SPTR) job->text, job->len,
+                offset, PCRE2_NO_UTF_CHECK | PCRE2_NOTEMPTY, md, NULL);
+        PCRE2_SIZE *ovector;
+        const char *match;
+        const char *line_end;
+        const char *nl;
+
+        if (rc < 0)
+            break;
+        ovector = pcre2_get_ovector_pointer(md);
+        match = job->text + ovector[0];
+        while ((nl = memchr(line_start, '\n', match - line_start)) != NULL)
+        {
+            ++lines_before;
+            line_start = nl + 1;
+        }
+        line_end = memchr(match, '\n', job->text + job->len - match);
+        if (!line_end)
+            line_end = job->text + job->len;
+        find_all_add_hit(job, line_start, line_end - line_start,
+                lines_before);
+        if (g_atomic_int_get(&fa->cancelled))
+            break;
+        offset = line_end - job->text + 1;
+        line_start = line_end + 1;
+        ++lines_before;
+    }
+    if (md)
+        pcre2_match_data_free(md);
+    g_idle_add(find_all_job_done, job);
+}
+
+static void find_all_really_free(FindAll *fa)
+{
+    g_list_free_full(fa->terms, g_free);
+    g_array_unref(fa->results);
+    pcre2_code_free(fa->code);
+    g_free(fa);
+}
+
+static int find_all_compare_results(gconstpointer a, gconstpointer b)
+{
+    const FindAllResult *ra = a;
+    const FindAllResult *rb = b;
+
+    if (ra->from_end != rb->from_end)
+        return ra->from_end < rb->from_end ? -1 : 1;
+    return 0;
+}
+
+static void find_all_check_finished(FindAll *fa)
+{
+    if (fa->current || fa->jobs)
+        return;
+    /* g_array_sort is a merge sort, so ties stay in window and tab order */
+    g_array_sort(fa->results, find_all_compare_results);
+    if (fa->done)
+        fa->done(fa, fa->done_data);
+}
+
+static gboolean find_all_snapshot(gpointer data);
+
+static void find_all_schedule_snapshot(FindAll *fa)
+{
+    if (!fa->slice_tag)
+    {
+        fa->slice_tag = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE,
+                find_all_snapshot, fa, NULL);
+    }
+}
+
+static gboolean find_all_job_done(gpointer data)
+{
+    FindAllJob *job = data;
+    FindAll *fa = job->fa;
+    guint n;
+
+    --fa->jobs;
+    for (n = 0; !fa->cancelled && n < job->hits->len; ++n)
+    {
+        FindAllResult *hit = &g_array_index(job->hits, FindAllResult, n);
+
+        if (fa->results->len >= FIND_ALL_MAX_RESULTS)
+        {
+            fa->truncated = TRUE;
+            break;
+        }
+        g_array_append_val(fa->results, *hit);
+        /* Now owned by results */
+        hit->text = NULL;
+    }
+    g_array_unref(job->hits);
+    g_free(job->text);
+    g_free(job);
+    if (fa->freed)
+    {
+        if (!fa->jobs)
+            find_all_really_free(fa);
+    }
+    else if (fa->current)
+    {
+        find_all_schedule_snapshot(fa);
+    }
+    else
+    {
+        find_all_check_finished(fa);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean find_all_term_is_valid(FindAllTerm *term)
+{
+    return roxterm_is_valid(term->roxterm);
+}
+
+/* Moves on to the next terminal, returning FALSE if there are no more */
+static gboolean find_all_next_term(FindAll *fa, gboolean first)
+{
+    fa->current = first ? fa->terms : g_list_next(fa->current);
+    while (fa->current && !find_all_term_is_valid(fa->current->data))
+        fa->current = g_list_next(fa->current);
+    if (fa->current)
+    {
+        FindAllTerm *term = fa->current->data;
+        GtkAdjustment *vadj = gtk_scrollable_get_vadjustment(
+                GTK_SCROLLABLE(roxterm_get_vte(term->roxterm)));
+
+        fa->next_row = (glong) gtk_adjustment_get_lower(vadj);
+        fa->end_row = (glong) gtk_adjustment_get_upper(vadj);
+    }
+    return fa->current != NULL;
+}
+
+/* Copies slices of text from terminals in the main thread, and passes them to
+ * the thread pool.
+ */
+static gboolean find_all_snapshot(gpointer data)
+{
+    FindAll *fa = data;
+    gint64 start = g_get_monotonic_time();
+    guint max_jobs = find_all_get_threads() * FIND_ALL_JOBS_PER_THREAD;
+
+    while (fa->current && fa->jobs < max_jobs)
+    {
+        FindAllTerm *term = fa->current->data;
+        FindAllJob *job;
+        glong last;
+        gint64 now;
+
+        if (!find_all_term_is_valid(term))
+        {
+            find_all_next_term(fa, FALSE);
+            continue;
+        }
+        last = MIN(fa->next_row + FIND_ALL_SLICE_ROWS, fa->end_row) - 1;
+        job = g_new0(FindAllJob, 1);
+        job->fa = fa;
+        job->term = term;
+        job->first_row = fa->next_row;
+        job->end_row = fa->end_row;
+        job->text = roxterm_get_text_rows(roxterm_get_vte(term->roxterm),
+                fa->next_row, last, &job->len);
+        fa->next_row = last + 1;
+        if (fa->next_row >= fa->end_row)
+            find_all_next_term(fa, FALSE);
+        if (job->text && job->len)
+        {
+            ++fa->jobs;
+            g_thread_pool_push(find_all_pool, job, NULL);
+        }
+        else
+        {
+            g_free(job->text);
+            g_free(job);
+        }
+        now = g_get_monotonic_time();
+        if (now - start >= FIND_ALL_SNAPSHOT_USEC)
+            break;
+    }
+    start = g_get_monotonic_time() - start;
+    fa->main_usec += start;
+    fa->longest_slice_usec = MAX(fa->longest_slice_usec, start);
+    /* If there are too many jobs already, the next one to finish will
+     * reschedule this.
+     */
+    if (fa->current && fa->jobs < max_jobs)
+        return G_SOURCE_CONTINUE;
+    fa->slice_tag = 0;
+    find_all_check_finished(fa);
+    return G_SOURCE_REMOVE;
+}
+
+FindAll *find_all_new(const char *pattern, guint flags, GError **error)
+{
+    FindAll *fa;
+    char *cooked = NULL;
+    pcre2_code *code;
+    int errcode;
+    PCRE2_SIZE erroffset;
+
+    if (!(flags & ROXTERM_SEARCH_AS_REGEX))
+        pattern = cooked = g_regex_escape_string(pattern, -1);
+    if (flags & ROXTERM_SEARCH_ENTIRE_WORD)
+    {
+        char *tmp = cooked;
+
+        pattern = cooked = g_strdup_printf("\\b%s\\b", pattern);
+        g_free(tmp);
+    }
+    code = pcre2_compile((PCRE2_SPTR) pattern, PCRE2_ZERO_TERMINATED,
+            PCRE2_UTF | PCRE2_UCP | PCRE2_MULTILINE |
+            ((flags & ROXTERM_SEARCH_MATCH_CASE) ? 0 : PCRE2_CASELESS),
+            &errcode, &erroffset, NULL);
+    g_free(cooked);
+    if (!code)
+    {
+        PCRE2_UCHAR msg[256];
+
+        pcre2_get_error_message(errcode, msg, sizeof(msg));
+        g_set_error(error, G_REGEX_ERROR, G_REGEX_ERROR_COMPILE,
+                "%s", (const char *) msg);
+        return NULL;
+    }
+    /* If JIT isn't available the interpreter is used */
+    pcre2_jit_compile(code, PCRE2_JIT_COMPLETE);
+    if (!find_all_pool)
+    {
+        find_all_pool = g_thread_pool_new(find_all_run_job, NULL,
+                find_all_get_threads(), FALSE, NULL);
+    }
+    fa = g_new0(FindAll, 1);
+    fa->code = code;
+    fa->results = g_array_new(FALSE, FALSE, sizeof(FindAllResult));
+    g_array_set_clear_func(fa->results, find_all_result_clear);
+    return fa;
+}
+
+void find_all_start(FindAll *fa, FindAllDoneHandler done, gpointer data)
+{
+    GList *wlink;
+
+    fa->done = done;
+    fa->done_data = data;
+    for (wlink = multi_win_all; wlink; wlink = g_list_next(wlink))
+    {
+        GList *tlink;
+
+        for (tlink = multi_win_get_tabs(wlink->data); tlink;
+                tlink = g_list_next(tlink))
+        {
+            FindAllTerm *term = g_new(FindAllTerm, 1);
+
+            term->tab = tlink->data;
+            term->roxterm = multi_tab_get_user_data(term->tab);
+            fa->terms = g_list_prepend(fa->terms, term);
+        }
+    }
+    fa->terms = g_list_reverse(fa->terms);
+    if (find_all_next_term(fa, TRUE))
+        find_all_schedule_snapshot(fa);
+    else
+        find_all_check_finished(fa);
+}
+
+void find_all_free(FindAll *fa)
+{
+    g_atomic_int_set(&fa->cancelled, TRUE);
+    if (fa->slice_tag)
+    {
+        g_source_remove(fa->slice_tag);
+        fa->slice_tag = 0;
+    }
+    fa->current = NULL;
+    if (fa->jobs)
+        fa->freed = TRUE;
+    else
+        find_all_really_free(fa);
+}
+
+guint find_all_get_n_results(FindAll *fa)
+{
+    return fa->results->len;
+}
+
+const FindAllResult *find_all_get_result(FindAll *fa, guint n)
+{
+    return &g_array_index(fa->results, FindAllResult, n);
+}
+
+gboolean find_all_get_truncated(FindAll *fa)
+{
+    return fa->truncated;
+}
+
+void find_all_get_main_thread_usec(FindAll *fa, gint64 *total,
+        gint64 *longest)
+{
+    *total = fa->main_usec;
+    *longest = fa->longest_slice_usec;
+}
+
+gboolean find_all_show_result(const FindAllResult *result)
+{
+    MultiWin *win;
+    GtkAdjustment *vadj;
+    double row;
+
+    if (!roxterm_is_valid(result->roxterm))
+        return FALSE;
+    win = multi_tab_get_parent(result->tab);
+    multi_win_select_tab(win, result->tab);
+    gtk_window_present(GTK_WINDOW(multi_win_get_widget(win)));
+    vadj = gtk_scrollable_get_vadjustment(
+            GTK_SCROLLABLE(roxterm_get_vte(result->roxterm)));
+    row = CLAMP((double) result->row, gtk_adjustment_get_lower(vadj),
+            gtk_adjustment_get_upper(vadj) -
+            gtk_adjustment_get_page_size(vadj));
+    gtk_adjustment_set_value(vadj, row);
+    return TRUE;
+}
+
+/* The dialog */
+
+enum {
+    FIND_ALL_COL_TAB,
+    FIND_ALL_COL_LINE,
+    FIND_ALL_COL_TEXT,
+    FIND_ALL_COL_INDEX,
+    FIND_ALL_N_COLS
+};
+
+static struct {
+    GtkWidget *dialog;
+    GtkEntry *entry;
+    GtkToggleButton *match_case, *entire_word, *as_regex;
+    GtkListStore *store;
+    GtkLabel *status;
+    FindAll *fa;
+    char *pattern;
+    guint flags;
+} find_all_dialog;
+
+static void find_all_dialog_cancel(void)
+{
+    if (find_all_dialog.fa)
+    {
+        find_all_free(find_all_dialog.fa);
+        find_all_dialog.fa = NULL;
+    }
+}
+
+static void find_all_dialog_done(FindAll *fa, gpointer data)
+{
+    guint n;
+    GHashTable *tabs = g_hash_table_new(NULL, NULL);
+    char *status;
+    (void) data;
+
+    for (n = 0; n < find_all_get_n_results(fa); ++n)
+    {
+        const FindAllResult *r = find_all_get_result(fa, n);
+        GtkTreeIter iter;
+
+        g_hash_table_add(tabs, r->tab);
+        gtk_list_store_append(find_all_dialog.store, &iter);
+        gtk_list_store_set(find_all_dialog.store, &iter,
+                FIND_ALL_COL_TAB, multi_tab_get_window_title(r->tab),
+                FIND_ALL_COL_LINE, (int) r->row,
+                FIND_ALL_COL_TEXT, r->text,
+                FIND_ALL_COL_INDEX, n,
+                -1);
+    }
+    status = g_strdup_printf(find_all_get_truncated(fa) ?
+            _("More than %u matches in %u tabs") : _("%u matches in %u tabs"),
+            find_all_get_n_results(fa), g_hash_table_size(tabs));
+    gtk_label_set_text(find_all_dialog.status, status);
+    g_free(status);
+    g_hash_table_unref(tabs);
+}
+
+static void find_all_dialog_search(void)
+{
+    const char *pattern = gtk_entry_get_text(find_all_dialog.entry);
+    GError *error = NULL;
+    guint flags =
+            (gtk_toggle_button_get_active(find_all_dialog.match_case) ?
+                    ROXTERM_SEARCH_MATCH_CASE : 0) |
+            (gtk_toggle_button_get_active(find_all_dialog.as_regex) ?
+                    ROXTERM_SEARCH_AS_REGEX : 0) |
+            (gtk_toggle_button_get_active(find_all_dialog.entire_word) ?
+                    ROXTERM_SEARCH_ENTIRE_WORD : 0);
+
+    find_all_dialog_cancel();
+    gtk_list_store_clear(find_all_dialog.store);
+    if (!pattern || !pattern[0])
+    {
+        gtk_label_set_text(find_all_dialog.status, "");
+        return;
+    }
+    find_all_dialog.fa = find_all_new(pattern, flags, &error);
+    if (!find_all_dialog.fa)
+    {
+        dlg_warning(GTK_WINDOW(find_all_dialog.dialog),
+                _("Invalid search expression: %s"), error->message);
+        g_error_free(error);
+        return;
+    }
+    g_free(find_all_dialog.pattern);
+    find_all_dialog.pattern = g_strdup(pattern);
+    find_all_dialog.flags = flags;
+    gtk_label_set_text(find_all_dialog.status, _("Searching..."));
+    find_all_start(find_all_dialog.fa, find_all_dialog_done, NULL);
+}
+
+static void find_all_row_activated(GtkTreeView *tvw, GtkTreePath *path,
+        GtkTreeViewColumn *column, gpointer data)
+{
+    GtkTreeIter iter;
+    guint n;
+    const FindAllResult *result;
+    (void) tvw;
+    (void) column;
+    (void) data;
+
+    if (!find_all_dialog.fa || !gtk_tree_model_get_iter(
+                GTK_TREE_MODEL(find_all_dialog.store), &iter, path))
+    {
+        return;
+    }
+    gtk_tree_model_get(GTK_TREE_MODEL(find_all_dialog.store), &iter,
+            FIND_ALL_COL_INDEX, &n, -1);
+    result = find_all_get_result(find_all_dialog.fa, n);
+    if (!find_all_show_result(result))
+    {
+        gtk_label_set_text(find_all_dialog.status,
+                _("That tab has been closed"));
+        return;
+    }
+    /* So that Find Next/Previous carry on from here */
+    roxterm_set_search(result->roxterm, find_all_dialog.pattern,
+            find_all_dialog.flags | ROXTERM_SEARCH_WRAP, NULL);
+}
+
+static void find_all_response_cb(GtkWidget *widget, int response,
+        gpointer data)
+{
+    (void) widget;
+    (void) data;
+    if (response == GTK_RESPONSE_ACCEPT)
+    {
+        find_all_dialog_search();
+        return;
+    }
+    find_all_dialog_cancel();
+    gtk_widget_hide(find_all_dialog.dialog);
+}
+
+static void find_all_destroy_cb(GtkWidget *widget, gpointer data)
+{
+    (void) widget;
+    (void) data;
+    find_all_dialog_cancel();
+    g_object_unref(find_all_dialog.store);
+    find_all_dialog.store = NULL;
+    find_all_dialog.dialog = NULL;
+}
+
+static void find_all_add_column(GtkTreeView *tvw, const char *title,
+        int col, gboolean expand)
+{
+    GtkCellRenderer *cell = gtk_cell_renderer_text_new();
+    GtkTreeViewColumn *column = gtk_tree_view_column_new_with_attributes(
+            title, cell, "text", col, NULL);
+
+    if (!expand)
+        g_object_set(cell, "ellipsize", PANGO_ELLIPSIZE_END, NULL);
+    gtk_tree_view_column_set_resizable(column, TRUE);
+    gtk_tree_view_column_set_expand(column, expand);
+    gtk_tree_view_append_column(tvw, column);
+}
+
+void find_all_open_dialog(ROXTermData *roxterm)
+{
+    MultiWin *win = roxterm_get_multi_win(roxterm);
+
+    if (!find_all_dialog.dialog)
+    {
+        GtkWidget *vbox;
+        GtkWidget *hbox;
+        GtkWidget *w = gtk_label_new_with_mnemonic(_("_Search for:"));
+        GtkWidget *entry = gtk_entry_new();
+        GtkWidget *scroll;
+        GtkWidget *tvw;
+
+        find_all_dialog.dialog = gtk_dialog_new_with_buttons(
+                _("Find in All Tabs"),
+                GTK_WINDOW(multi_win_get_widget(win)),
+                GTK_DIALOG_DESTROY_WITH_PARENT,
+                _("_Close"), GTK_RESPONSE_CLOSE,
+                _("_Find"), GTK_RESPONSE_ACCEPT,
+                NULL);
+        gtk_dialog_set_default_response(GTK_DIALOG(find_all_dialog.dialog),
+                GTK_RESPONSE_ACCEPT);
+        gtk_window_set_default_size(GTK_WINDOW(find_all_dialog.dialog),
+                640, 400);
+        vbox = gtk_dialog_get_content_area(GTK_DIALOG(find_all_dialog.dialog));
+
+        find_all_dialog.entry = GTK_ENTRY(entry);
+        gtk_entry_set_width_chars(find_all_dialog.entry, 40);
+        gtk_entry_set_activates_default(find_all_dialog.entry, TRUE);
+        gtk_label_set_mnemonic_widget(GTK_LABEL(w), entry);
+        hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, DLG_SPACING);
+        gtk_box_pack_start(GTK_BOX(hbox), w, FALSE, FALSE, DLG_SPACING);
+        gtk_box_pack_start(GTK_BOX(hbox), entry, TRUE, TRUE, DLG_SPACING);
+        gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, FALSE, DLG_SPACING);
+
+        hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, DLG_SPACING);
+        w = gtk_check_button_new_with_mnemonic(_("Match C_ase"));
+        find_all_dialog.match_case = GTK_TOGGLE_BUTTON(w);
+        gtk_box_pack_start(GTK_BOX(hbox), w, FALSE, FALSE, DLG_SPACING);
+        w = gtk_check_button_new_with_mnemonic(_("Match _Entire Word"));
+        find_all_dialog.entire_word = GTK_TOGGLE_BUTTON(w);
+        gtk_box_pack_start(GTK_BOX(hbox), w, FALSE, FALSE, DLG_SPACING);
+        w = gtk_check_button_new_with_mnemonic(
+                _("Match As _Regular Expression"));
+        find_all_dialog.as_regex = GTK_TOGGLE_BUTTON(w);
+        gtk_box_pack_start(GTK_BOX(hbox), w, FALSE, FALSE, DLG_SPACING);
+        gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, FALSE, DLG_SPACING);
+
+        find_all_dialog.store = gtk_list_store_new(FIND_ALL_N_COLS,
+                G_TYPE_STRING, G_TYPE_INT, G_TYPE_STRING, G_TYPE_UINT);
+        tvw = gtk_tree_view_new_with_model(
+                GTK_TREE_MODEL(find_all_dialog.store));
+        find_all_add_column(GTK_TREE_VIEW(tvw), _("Tab"),
+                FIND_ALL_COL_TAB, FALSE);
+        find_all_add_column(GTK_TREE_VIEW(tvw), _("Line"),
+                FIND_ALL_COL_LINE, FALSE);
+        find_all_add_column(GTK_TREE_VIEW(tvw), _("Text"),
+                FIND_ALL_COL_TEXT, TRUE);
+        gtk_widget_set_tooltip_text(tvw, _("Most recent output first. "
+                "Double-click a match to show it in its tab."));
+        g_signal_connect(tvw, "row-activated",
+                G_CALLBACK(find_all_row_activated), NULL);
+        scroll = gtk_scrolled_window_new(NULL, NULL);
+        gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll),
+                GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+        gtk_container_add(GTK_CONTAINER(scroll), tvw);
+        gtk_box_pack_start(GTK_BOX(vbox), scroll, TRUE, TRUE, DLG_SPACING);
+
+        w = gtk_label_new(NULL);
+        gtk_label_set_xalign(GTK_LABEL(w), 0);
+        find_all_dialog.status = GTK_LABEL(w);
+        gtk_box_pack_start(GTK_BOX(vbox), w, FALSE, FALSE, DLG_SPACING);
+
+        g_signal_connect(find_all_dialog.dialog, "response",
+                G_CALLBACK(find_all_response_cb), NULL);
+        g_signal_connect(find_all_dialog.dialog, "destroy",
+                G_CALLBACK(find_all_destroy_cb), NULL);
+        gtk_widget_show_all(find_all_dialog.dialog);
+    }
+    else
+    {
+        gtk_window_present(GTK_WINDOW(find_all_dialog.dialog));
+    }
+    if (roxterm_get_search_pattern(roxterm) &&
+            !gtk_entry_get_text_length(find_all_dialog.entry))
+    {
+        guint flags = roxterm_get_search_flags(roxterm);
+
+        gtk_entry_set_text(find_all_dialog.entry,
+                roxterm_get_search_pattern(roxterm));
+        gtk_toggle_button_set_active(find_all_dialog.match_case,
+                flags & ROXTERM_SEARCH_MATCH_CASE);
+        gtk_toggle_button_set_active(find_all_dialog.entire_word,
+                flags & ROXTERM_SEARCH_ENTIRE_WORD);
+        gtk_toggle_button_set_active(find_all_dialog.as_regex,
+                flags & ROXTERM_SEARCH_AS_REGEX);
+    }
+    gtk_widget_grab_focus(GTK_WIDGET(find_all_dialog.entry));
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
@@ -0,0 +1,81 @@
+#ifndef FINDALL_H
+#define FINDALL_H
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+/* Searches the text of every terminal in every window. The text is copied
+ * from VTE a slice of rows at a time in the main thread, interleaved with
+ * other events, and the slices are matched with PCRE2 (using its JIT where
+ * available) in a pool of worker threads. Results are ranked with the most
+ * recent output first.
+ */
+
+#include "roxterm.h"
+
+typedef struct FindAll FindAll;
+
+typedef struct {
+    ROXTermData *roxterm;
+    MultiTab *tab;
+    /* Approximate, because soft-wrapped lines count as one row */
+    glong row;
+    /* Rows between the match and the bottom of the terminal */
+    glong from_end;
+    char *text;
+} FindAllResult;
+
+/* Called when all terminals have been searched */
+typedef void (*FindAllDoneHandler)(FindAll *fa, gpointer data);
+
+/* flags are ROXTERM_SEARCH_MATCH_CASE, _ENTIRE_WORD and _AS_REGEX. Returns
+ * NULL if the pattern is invalid.
+ */
+FindAll *find_all_new(const char *pattern, guint flags, GError **error);
+
+/* Starts searching all terminals open at the time this is called */
+void find_all_start(FindAll *fa, FindAllDoneHandler done, gpointer data);
+
+/* Cancels the search if it's still running */
+void find_all_free(FindAll *fa);
+
+guint find_all_get_n_results(FindAll *fa);
+
+const FindAllResult *find_all_get_result(FindAll *fa, guint n);
+
+/* Whether some results were discarded because there were too many */
+gboolean find_all_get_truncated(FindAll *fa);
+
+/* Time spent copying text in the main thread, total and longest slice */
+void find_all_get_main_thread_usec(FindAll *fa, gint64 *total,
+        gint64 *longest);
+
+/* Maximum number of worker threads; 0 for one per processor */
+void find_all_set_max_threads(int threads);
+
+/* Selects result's tab and scrolls to its line. Returns FALSE if the
+ * terminal has been closed.
+ */
+gboolean find_all_show_result(const FindAllResult *result);
+
+void find_all_open_dialog(ROXTermData *roxterm);
+
+#endif /* FINDALL_H */
+
+/* vi:set sw=4 ts=4 et cindent cino= */
@@ -0,0 +1,191 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+
+#include "defns.h"
+
+#include "fontcache.h"
+
+typedef struct {
+    int width, height;
+} FontCacheCell;
+
+/* Keyed by "zoom\tfont_name" */
+static GHashTable *font_cache_descs = NULL;
+
+/* Keyed by "zoom\thspacing\tvspacing\tfont_name" */
+static GHashTable *font_cache_cells = NULL;
+
+static gboolean font_cache_enabled = TRUE;
+
+/* What font_cache_lookup() returned while the cache was disabled */
+static PangoFontDescription *font_cache_uncached = NULL;
+
+void font_cache_resize_for_zoom(PangoFontDescription *desc, double zoom_factor)
+{
+    int size;
+    gboolean abs = FALSE;
+
+    if (zoom_factor == 1.0)
+        return;
+    size = pango_font_description_get_size(desc);
+    if (!size)
+        size = 10 * PANGO_SCALE;
+    else
+        abs = pango_font_description_get_size_is_absolute(desc);
+    size = (int) ((double) size * zoom_factor);
+    if (abs)
+        pango_font_description_set_absolute_size(desc, size);
+    else
+        pango_font_description_set_size(desc, size);
+}
+
+/* Cell sizes depend on the screen's resolution, so they have to be measured
+ * again if it changes.
+ */
+static void font_cache_forget_cells(void)
+{
+    if (font_cache_cells)
+        g_hash_table_remove_all(font_cache_cells);
+}
+
+static void font_cache_init(void)
+{
+    GtkSettings *settings;
+
+    if (font_cache_descs)
+        return;
+    font_cache_descs = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, (GDestroyNotify) pango_font_description_free);
+    font_cache_cells = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, g_free);
+    settings = gtk_settings_get_default();
+    if (settings)
+    {
+        g_signal_connect_swapped(settings, "notify::gtk-xft-dpi",
+                G_CALLBACK(font_cache_forget_cells), NULL);
+    }
+}
+
+static PangoFontDescription *font_cache_new_desc(const char *font_name,
+        double zoom_factor)
+{
+    PangoFontDescription *desc =
+            pango_font_description_from_string(font_name);
+
+    font_cache_resize_for_zoom(desc, zoom_factor);
+    return desc;
+}
+
+const PangoFontDescription *font_cache_lookup(const char *font_name,
+        double zoom_factor)
+{
+    PangoFontDescription *desc;
+    char *key;
+
+    g_return_val_if_fail(font_name != NULL, NULL);
+    if (!font_cache_enabled)
+    {
+        if (font_cache_uncached)
+            pango_font_description_free(font_cache_uncached);
+        font_cache_uncached = font_cache_new_desc(font_name, zoom_factor);
+        return font_cache_uncached;
+    }
+    font_cache_init();
+    key = g_strdup_printf("%g\t%s", zoom_factor, font_name);
+    desc = g_hash_table_lookup(font_cache_descs, key);
+    if (desc)
+    {
+        g_free(key);
+        return desc;
+    }
+    desc = font_cache_new_desc(font_name, zoom_factor);
+    g_hash_table_insert(font_cache_descs, key, desc);
+    return desc;
+}
+
+char *font_cache_unzoomed_name(const PangoFontDescription *desc,
+        double zoom_factor)
+{
+    PangoFontDescription *unzoomed = pango_font_description_copy(desc);
+    char *name;
+
+    if (zoom_factor)
+        font_cache_resize_for_zoom(unzoomed, 1.0 / zoom_factor);
+    name = pango_font_description_to_string(unzoomed);
+    pango_font_description_free(unzoomed);
+    return name;
+}
+
+static char *font_cache_cell_key(const char *font_name, double zoom_factor,
+        int hspacing, int vspacing)
+{
+    return g_strdup_printf("%g\t%d\t%d\t%s",
+            zoom_factor, hspacing, vspacing, font_name);
+}
+
+gboolean font_cache_get_cell_size(const char *font_name, double zoom_factor,
+        int hspacing, int vspacing, int *width, int *height)
+{
+    FontCacheCell *cell;
+    char *key;
+
+    if (!font_cache_enabled || !font_cache_cells || !font_name)
+        return FALSE;
+    key = font_cache_cell_key(font_name, zoom_factor, hspacing, vspacing);
+    cell = g_hash_table_lookup(font_cache_cells, key);
+    g_free(key);
+    if (!cell)
+        return FALSE;
+    *width = cell->width;
+    *height = cell->height;
+    return TRUE;
+}
+
+void font_cache_set_cell_size(const char *font_name, double zoom_factor,
+        int hspacing, int vspacing, int width, int height)
+{
+    FontCacheCell *cell;
+
+    if (!font_cache_enabled || !font_name || width <= 0 || height <= 0)
+        return;
+    font_cache_init();
+    cell = g_new(FontCacheCell, 1);
+    cell->width = width;
+    cell->height = height;
+    g_hash_table_insert(font_cache_cells,
+            font_cache_cell_key(font_name, zoom_factor, hspacing, vspacing),
+            cell);
+}
+
+guint font_cache_get_n_fonts(void)
+{
+    return font_cache_descs ? g_hash_table_size(font_cache_descs) : 0;
+}
+
+void font_cache_set_enabled(gboolean enabled)
+{
+    font_cache_enabled = enabled;
+    if (font_cache_descs)
+        g_hash_table_remove_all(font_cache_descs);
+    font_cache_forget_cells();
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
@@ -0,0 +1,71 @@
+#ifndef FONTCACHE_H
+#define FONTCACHE_H
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+
+/* A process-wide cache of the font descriptions terminals use, already scaled
+ * for each zoom level, and the cell sizes measured for them, so that zooming
+ * or changing the font of many tabs only has to parse and measure each font
+ * once. Fonts are identified by their unzoomed pango font description string.
+ */
+
+#ifndef DEFNS_H
+#include "defns.h"
+#endif
+
+/* Scales a font description's size by zoom_factor */
+void font_cache_resize_for_zoom(PangoFontDescription *desc, double zoom_factor);
+
+/* Returns a description for font_name scaled by zoom_factor. It belongs to the
+ * cache, and is only guaranteed to be valid until the next call if the cache
+ * is disabled, so callers should copy it if they want to keep it.
+ */
+const PangoFontDescription *font_cache_lookup(const char *font_name,
+        double zoom_factor);
+
+/* Returns a new string identifying the unzoomed version of desc, which is
+ * currently scaled by zoom_factor, for use as a font_name.
+ */
+char *font_cache_unzoomed_name(const PangoFontDescription *desc,
+        double zoom_factor);
+
+/* If a terminal has already measured font_name at this zoom level with these
+ * spacings (percentages, as in profiles), sets *width and *height to its cell
+ * size and returns TRUE.
+ */
+gboolean font_cache_get_cell_size(const char *font_name, double zoom_factor,
+        int hspacing, int vspacing, int *width, int *height);
+
+void font_cache_set_cell_size(const char *font_name, double zoom_factor,
+        int hspacing, int vspacing, int width, int height);
+
+/* Returns the number of font descriptions in the cache */
+guint font_cache_get_n_fonts(void);
+
+/* Disabling the cache makes every lookup parse the font from scratch and
+ * makes font_cache_get_cell_size() always fail. This is mainly for
+ * roxterm-bench.
+ */
+void font_cache_set_enabled(gboolean enabled);
+
+#endif /* FONTCACHE_H */
+
+/* vi:set sw=4 ts=4 et cindent cino= */
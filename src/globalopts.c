@@ -44,6 +44,7 @@ gboolean global_options_borderless = FALSE;
 gboolean global_options_tab = FALSE;
 gboolean global_options_fork = FALSE;
 gint global_options_atexit = -1;
+gint global_options_worker = -1;
 
 static void correct_scheme(const char *bad_name, const char *good_name)
 {
@@ -84,13 +85,15 @@ static gboolean global_options_show_usage(const gchar *option_name,
     (void) value;
     (void) option_name;
     puts("roxterm [-?|--help] [--usage] [--geometry=GEOMETRY|-g GEOMETRY]\n"
-      "    [--session=SESSION] [--appdir=DIR]\n"
+      "    [--session=SESSION] [--session-journal] [--appdir=DIR]\n"
+      "    [--stats]\n"
       "    [--profile=PROFILE|-p PROFILE]\n"
       "    [--colour-scheme=SCHEME|--color-scheme=SCHEME|-c SCHEME]\n"
       "    [--shortcut-scheme=SCHEME|-s SCHEME] [--borderless|-b]\n"
       "    [--fullscreen|-f] [--maximise|--maximize|-m] [--zoom=ZOOM|-z ZOOM]\n"
       "    [--title=TITLE|-T TITLE] [--tab-name=NAME|-n NAME]\n"
       "    [--separate] [--replace] [--tab]\n"
+      "    [--workers=N] [--worker-placement=load|profile|round-robin]\n"
       "    [--directory=DIRECTORY|-d DIRECTORY]\n"
       "    [--show-menubar] [--hide-menubar]\n"
       "    [--fork] [--hold] [--atexit=close|hold|respawn|ask]\n"
@@ -126,6 +129,10 @@ static gboolean global_options_set_string(const gchar *option_name,
     {
         option_name = "shortcut_scheme";
     }
+    else if (!strcmp(option_name, "worker-placement"))
+    {
+        option_name = "worker_placement";
+    }
     options_set_string(global_options, option_name, value);
     return TRUE;
 }
@@ -205,6 +212,10 @@ static gboolean global_options_set_bool(const gchar *option_name,
     {
         option_name = "hide_menubar";
     }
+    else if (!strcmp(option_name, "session-journal"))
+    {
+        option_name = "session_journal";
+    }
     options_set_int(global_options, option_name, val);
     return TRUE;
 }
@@ -219,6 +230,16 @@ static gboolean global_options_set_double(const gchar *option_name,
     return TRUE;
 }
 
+static gboolean global_options_set_int(const gchar *option_name,
+        const gchar *value, gpointer data, GError **error)
+{
+    (void) error;
+    (void) data;
+    option_name = process_option_name(option_name);
+    options_set_int(global_options, option_name, atoi(value));
+    return TRUE;
+}
+
 static GOptionEntry global_g_options[] = {
     { "usage", 'u', G_OPTION_FLAG_IN_MAIN | G_OPTION_FLAG_NO_ARG,
         G_OPTION_ARG_CALLBACK, global_options_show_usage,
@@ -290,6 +311,18 @@ static GOptionEntry global_g_options[] = {
         N_("Replace any existing process as ROXTerm's\n"
         "                                   D-BUS service provider"),
         NULL },
+    { "workers", 0, G_OPTION_FLAG_IN_MAIN,
+        G_OPTION_ARG_CALLBACK, global_options_set_int,
+        N_("Share windows between this many processes\n"
+        "                                   (0 to use a single process)"),
+        N_("N") },
+    { "worker-placement", 0, G_OPTION_FLAG_IN_MAIN,
+        G_OPTION_ARG_CALLBACK, global_options_set_string,
+        N_("How to choose a process for each new window:\n"
+        "                                   load, profile or round-robin"),
+        N_("MODE") },
+    { "worker", 0, G_OPTION_FLAG_IN_MAIN | G_OPTION_FLAG_HIDDEN,
+        G_OPTION_ARG_INT, &global_options_worker, NULL, NULL },
     { "title", 'T', G_OPTION_FLAG_IN_MAIN,
         G_OPTION_ARG_CALLBACK, global_options_set_string,
         N_("Set window title"), N_("TITLE") },
@@ -317,6 +350,16 @@ static GOptionEntry global_g_options[] = {
     { "session", 0, G_OPTION_FLAG_IN_MAIN,
         G_OPTION_ARG_STRING, &global_options_user_session_id,
         N_("Restore the named user session"), N_("SESSION") },
+    { "session-journal", 0, G_OPTION_FLAG_IN_MAIN | G_OPTION_FLAG_NO_ARG,
+        G_OPTION_ARG_CALLBACK, global_options_set_bool,
+        N_("Keep a journal of open windows and tabs, and\n"
+        "                                   restore them after a crash"),
+        NULL },
+    { "stats", 0, G_OPTION_FLAG_IN_MAIN | G_OPTION_FLAG_NO_ARG,
+        G_OPTION_ARG_CALLBACK, global_options_set_bool,
+        N_("Print the latency statistics of each terminal\n"
+        "                                   in the running roxterm and exit"),
+        NULL },
     { "role", 0, G_OPTION_FLAG_IN_MAIN,
         G_OPTION_ARG_CALLBACK, global_options_set_string,
         N_("Set X window system 'role' hint"), N_("NAME") },
@@ -586,7 +629,20 @@ static gboolean global_options_gsettings_prefer_dark(GSettings *gsettings)
     return prefer_dark;
 }
 
-gboolean global_options_system_theme_is_dark(void)
+/* The resolved theme, -1 until it's first needed. Colour scheme lookups ask
+ * for it all the time, so it's only resolved again when the GSetting or
+ * prefer_dark_theme changes.
+ */
+static int global_options_theme_is_dark = -1;
+
+typedef struct {
+    GlobalOptionsDarkThemeChangeHandler handler;
+    gpointer handle;
+} DarkThemeChangeClosure;
+
+static GSList *global_options_dark_theme_handlers = NULL;
+
+static gboolean global_options_resolve_theme_is_dark(void)
 {
     gboolean prefer_dark = FALSE;
     GSettings *gsettings = NULL;
@@ -617,6 +673,60 @@ gboolean global_options_system_theme_is_dark(void)
     return prefer_dark;
 }
 
+static void global_options_gsettings_dark_theme_change_handler(
+    GSettings *gsettings, const char *key, gpointer data)
+{
+    gboolean prefer_dark;
+    GSList *link;
+    (void) data;
+
+    /* This gets called when any of the settings in gsettings changes,
+     * so ignore the other keys */
+    if (strcmp(key, global_options_color_scheme_key))
+    {
+        return;
+    }
+    /* Check whether user actually wants to use that setting */
+    int legacy = global_options_lookup_int("prefer_dark_theme");
+    if (legacy != 0) return;
+    prefer_dark = global_options_gsettings_prefer_dark(gsettings);
+    if (prefer_dark == global_options_theme_is_dark)
+        return;
+    global_options_theme_is_dark = prefer_dark;
+    for (link = global_options_dark_theme_handlers; link;
+            link = g_slist_next(link))
+    {
+        DarkThemeChangeClosure *closure = link->data;
+
+        closure->handler(prefer_dark, closure->handle);
+    }
+}
+
+gboolean global_options_system_theme_is_dark(void)
+{
+    if (global_options_theme_is_dark == -1)
+    {
+        GSettings *gsettings = global_options_get_interface_gsettings();
+
+        global_options_theme_is_dark = global_options_resolve_theme_is_dark();
+        if (gsettings)
+        {
+            g_signal_connect(gsettings, "changed",
+                G_CALLBACK(global_options_gsettings_dark_theme_change_handler),
+                NULL);
+        }
+    }
+    return global_options_theme_is_dark;
+}
+
+gboolean global_options_update_dark_theme(void)
+{
+    /* Makes sure the GSettings handler is connected */
+    global_options_system_theme_is_dark();
+    global_options_theme_is_dark = global_options_resolve_theme_is_dark();
+    return global_options_theme_is_dark;
+}
+
 static void apply_dark_theme_from_settings(GSettings *gsettings,
         const char *key, GtkSettings *gtk_settings)
 {
@@ -660,40 +770,18 @@ void global_options_apply_dark_theme(void)
     }
 }
 
-typedef struct {
-    GlobalOptionsDarkThemeChangeHandler handler;
-    gpointer handle;
-} DarkThemeChangeClosure;
-
-static void global_options_gsettings_dark_theme_change_handler(
-    GSettings *gsettings, const char *key, DarkThemeChangeClosure *closure)
-{
-    /* This gets called when any of the settings in gsettings changes,
-     * so ignore the other keys */
-    if (strcmp(key, global_options_color_scheme_key))
-    {
-        return;
-    }
-    /* Check whether user actually wants to use that setting */
-    int legacy = global_options_lookup_int("prefer_dark_theme");
-    if (legacy != 0) return;
-    gboolean prefer_dark = global_options_gsettings_prefer_dark(gsettings);
-    closure->handler(prefer_dark, closure->handle);
-}
-
-
 void global_options_register_dark_theme_change_handler(
     GlobalOptionsDarkThemeChangeHandler handler, gpointer handle)
 {
-    GSettings *gsettings = global_options_get_interface_gsettings();
-    if (gsettings)
+    if (global_options_get_interface_gsettings())
     {
         DarkThemeChangeClosure *closure = g_new(DarkThemeChangeClosure, 1);
+
         closure->handler = handler;
         closure->handle = handle;
-        g_signal_connect(gsettings, "changed",
-                G_CALLBACK(global_options_gsettings_dark_theme_change_handler),
-                closure);
+        global_options_dark_theme_handlers = g_slist_append(
+                global_options_dark_theme_handlers, closure);
+        global_options_system_theme_is_dark();
     }
 }
 
@@ -60,6 +60,11 @@ extern gboolean global_options_fork;
 /* What to do on command exit */
 extern gint global_options_atexit;
 
+/* Index of this process in a pool of workers started by a dispatcher, or -1
+ * if this process wasn't started as a worker.
+ */
+extern gint global_options_worker;
+
 extern char *global_options_user_session_id;
 
 /* Key for dark theme preference in GSettings */
@@ -125,17 +130,24 @@ gboolean global_options_has_gnome_dark_theme_setting(void);
 gboolean global_options_has_gtk_dark_theme_setting();
 
 /* Gets the prefer-dark setting from GNOME's gsettings or roxterm's legacy
- * option.
+ * option. The result is cached, and kept up to date with the GSetting.
  */
 gboolean global_options_system_theme_is_dark(void);
 
+/* Resolves the theme again after the legacy option has been changed, and
+ * returns the result.
+ */
+gboolean global_options_update_dark_theme(void);
+
 /* Applies the dark theme setting now and whenever the Gsetting changes */
 void global_options_apply_dark_theme(void);
 
 typedef void (*GlobalOptionsDarkThemeChangeHandler)(gboolean prefer_dark,
 	gpointer handle);
 
-/* Only works on GSettings, legacy option should be monitored separately. */
+/* Only works on GSettings, legacy option should be monitored separately.
+ * Handlers are only called when the resolved theme actually changes.
+ */
 void global_options_register_dark_theme_change_handler(
 	GlobalOptionsDarkThemeChangeHandler handler, gpointer handle);
 
@@ -0,0 +1,231 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "defns.h"
+
+#include <string.h>
+
+#include "latency.h"
+
+/* Each power of 2 is divided into 2^LATENCY_SUB_BITS buckets, so a value is
+ * recorded to within about 3%. Values below 2^LATENCY_SUB_BITS have exact
+ * buckets, and ones above 2^(LATENCY_MAX_SHIFT + LATENCY_SUB_BITS + 1),
+ * over a minute in microseconds, go in the last bucket.
+ */
+#define LATENCY_SUB_BITS 5
+#define LATENCY_SUB_COUNT (1 << LATENCY_SUB_BITS)
+#define LATENCY_MAX_SHIFT 21
+#define LATENCY_BUCKETS ((LATENCY_MAX_SHIFT + 2) * LATENCY_SUB_COUNT)
+
+/* A key press with no output after this long probably didn't echo */
+#define LATENCY_ECHO_TIMEOUT G_USEC_PER_SEC
+
+typedef struct {
+    guint64 count;
+    guint64 max;
+    guint32 buckets[LATENCY_BUCKETS];
+} LatencyHistogram;
+
+struct LatencyStats {
+    GMutex lock;
+    LatencyHistogram key_to_echo;
+    LatencyHistogram read_to_paint;
+    LatencyHistogram bytes_per_sec;
+    gint64 key_time;            /* 0 if no key is waiting for its echo */
+    gboolean echoed;
+    gint64 read_time;           /* First read since the last frame */
+    guint64 keys_without_echo;
+    guint64 bytes;
+    gint64 second;              /* The second in which second_bytes were read */
+    guint64 second_bytes;
+};
+
+static guint latency_bucket_index(guint64 value)
+{
+    guint shift;
+
+    if (value < LATENCY_SUB_COUNT)
+        return value;
+    shift = g_bit_storage(value) - 1 - LATENCY_SUB_BITS;
+    if (shift > LATENCY_MAX_SHIFT)
+        return LATENCY_BUCKETS - 1;
+    return shift * LATENCY_SUB_COUNT + (value >> shift);
+}
+
+/* The highest value which would go in a bucket */
+static guint64 latency_bucket_value(guint index)
+{
+    guint shift;
+
+    if (index < LATENCY_SUB_COUNT)
+        return index;
+    shift = index / LATENCY_SUB_COUNT - 1;
+    return (((guint64) (index % LATENCY_SUB_COUNT + LATENCY_SUB_COUNT + 1))
+            << shift) - 1;
+}
+
+static void latency_histogram_record(LatencyHistogram *h, guint64 value)
+{
+    ++h->buckets[latency_bucket_index(value)];
+    ++h->count;
+    if (value > h->max)
+        h->max = value;
+}
+
+static guint64 latency_histogram_percentile(LatencyHistogram *h,
+        double percentile)
+{
+    guint64 target = (guint64) (h->count * percentile / 100.0 + 0.5);
+    guint64 total = 0;
+    guint n;
+
+    if (!target)
+        target = 1;
+    for (n = 0; n < LATENCY_BUCKETS; ++n)
+    {
+        total += h->buckets[n];
+        if (total >= target)
+            return MIN(latency_bucket_value(n), h->max);
+    }
+    return h->max;
+}
+
+static void latency_histogram_describe(LatencyHistogram *h,
+        const char *name, GString *s)
+{
+    g_string_append_printf(s, "\"%s\": {\"count\": %" G_GUINT64_FORMAT,
+            name, h->count);
+    if (h->count)
+    {
+        g_string_append_printf(s,
+                ", \"p50\": %" G_GUINT64_FORMAT
+                ", \"p90\": %" G_GUINT64_FORMAT
+                ", \"p99\": %" G_GUINT64_FORMAT
+                ", \"p99.9\": %" G_GUINT64_FORMAT
+                ", \"max\": %" G_GUINT64_FORMAT,
+                latency_histogram_percentile(h, 50),
+                latency_histogram_percentile(h, 90),
+                latency_histogram_percentile(h, 99),
+                latency_histogram_percentile(h, 99.9),
+                h->max);
+    }
+    g_string_append_c(s, '}');
+}
+
+LatencyStats *latency_stats_new(void)
+{
+    LatencyStats *ls = g_new0(LatencyStats, 1);
+
+    g_mutex_init(&ls->lock);
+    return ls;
+}
+
+void latency_stats_free(LatencyStats *ls)
+{
+    if (!ls)
+        return;
+    g_mutex_clear(&ls->lock);
+    g_free(ls);
+}
+
+void latency_stats_note_key(LatencyStats *ls)
+{
+    gint64 now = g_get_monotonic_time();
+
+    g_mutex_lock(&ls->lock);
+    if (ls->key_time && now - ls->key_time > LATENCY_ECHO_TIMEOUT)
+    {
+        ++ls->keys_without_echo;
+        ls->key_time = 0;
+    }
+    /* While typing ahead of the echo, time the first key */
+    if (!ls->key_time)
+    {
+        ls->key_time = now;
+        ls->echoed = FALSE;
+    }
+    g_mutex_unlock(&ls->lock);
+}
+
+void latency_stats_note_read(LatencyStats *ls, gsize bytes)
+{
+    gint64 now = g_get_monotonic_time();
+    gint64 second = now / G_USEC_PER_SEC;
+
+    g_mutex_lock(&ls->lock);
+    if (!ls->read_time)
+        ls->read_time = now;
+    if (ls->key_time && !ls->echoed)
+    {
+        if (now - ls->key_time > LATENCY_ECHO_TIMEOUT)
+        {
+            ++ls->keys_without_echo;
+            ls->key_time = 0;
+        }
+        else
+        {
+            ls->echoed = TRUE;
+        }
+    }
+    ls->bytes += bytes;
+    if (second != ls->second)
+    {
+        if (ls->second_bytes)
+            latency_histogram_record(&ls->bytes_per_sec, ls->second_bytes);
+        ls->second = second;
+        ls->second_bytes = 0;
+    }
+    ls->second_bytes += bytes;
+    g_mutex_unlock(&ls->lock);
+}
+
+void latency_stats_note_paint(LatencyStats *ls, gboolean visible)
+{
+    gint64 now = g_get_monotonic_time();
+
+    g_mutex_lock(&ls->lock);
+    if (visible && ls->read_time)
+        latency_histogram_record(&ls->read_to_paint, now - ls->read_time);
+    ls->read_time = 0;
+    if (ls->key_time && ls->echoed)
+    {
+        if (visible)
+            latency_histogram_record(&ls->key_to_echo, now - ls->key_time);
+        ls->key_time = 0;
+    }
+    g_mutex_unlock(&ls->lock);
+}
+
+void latency_stats_describe(LatencyStats *ls, GString *s)
+{
+    g_mutex_lock(&ls->lock);
+    g_string_append_c(s, '{');
+    latency_histogram_describe(&ls->key_to_echo, "key_to_echo", s);
+    g_string_append(s, ", ");
+    latency_histogram_describe(&ls->read_to_paint, "read_to_paint", s);
+    g_string_append(s, ", ");
+    latency_histogram_describe(&ls->bytes_per_sec, "bytes_per_sec", s);
+    g_string_append_printf(s, ", \"bytes\": %" G_GUINT64_FORMAT
+            ", \"keys_without_echo\": %" G_GUINT64_FORMAT "}",
+            ls->bytes, ls->keys_without_echo);
+    g_mutex_unlock(&ls->lock);
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
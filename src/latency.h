@@ -0,0 +1,66 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+/* Instrumentation to show whether lag comes from roxterm, VTE or the child.
+ * Each terminal keeps HDR-style histograms, with buckets whose width is a
+ * fixed fraction of their value, of:
+ *
+ * key_to_echo     From a key press which isn't a shortcut to the first frame
+ *                 painted after the next read from the pty, ie the echo.
+ * read_to_paint   From the first pty read since the last frame to the next
+ *                 frame, while the terminal is visible.
+ * bytes_per_sec   The number of bytes read in each second with any output.
+ *
+ * Times are in microseconds; frames are timed by the "after-paint" signal
+ * of the window's GdkFrameClock.
+ */
+
+#ifndef DEFNS_H
+#include "defns.h"
+#endif
+
+typedef struct LatencyStats LatencyStats;
+
+LatencyStats *latency_stats_new(void);
+
+void latency_stats_free(LatencyStats *ls);
+
+/* Called in the main thread for a key press which goes to the child */
+void latency_stats_note_key(LatencyStats *ls);
+
+/* Called whenever output is read from the pty. This may be called from any
+ * thread.
+ */
+void latency_stats_note_read(LatencyStats *ls, gsize bytes);
+
+/* Called in the main thread after a frame has been painted; visible is
+ * FALSE if the terminal wasn't drawn, in which case pending timings are
+ * discarded rather than recorded.
+ */
+void latency_stats_note_paint(LatencyStats *ls, gboolean visible);
+
+/* Appends the statistics to s as a JSON object */
+void latency_stats_describe(LatencyStats *ls, GString *s);
+
+#endif /* LATENCY_H */
+
+/* vi:set sw=4 ts=4 et cindent cino= */
@@ -29,14 +29,13 @@
 #include "dlg.h"
 #include "globalopts.h"
 #include "multitab.h"
+#include "outputlog.h"
 #include "roxterm.h"
 #include "rtdbus.h"
+#include "scrollback.h"
 #include "session-file.h"
-
-#define ROXTERM_DBUS_NAME RTDBUS_NAME ".term"
-#define ROXTERM_DBUS_OBJECT_PATH RTDBUS_OBJECT_PATH "/term"
-#define ROXTERM_DBUS_INTERFACE RTDBUS_INTERFACE
-#define ROXTERM_DBUS_METHOD_NAME "NewTerminal"
+#include "session-journal.h"
+#include "workerpool.h"
 
 extern char **environ;
 
@@ -122,6 +121,125 @@ static int run_via_dbus(DBusMessage *message)
     return result;
 }
 
+#define ROXTERM_DBUS_ERROR RTDBUS_ERROR ".TerminalError"
+
+/* Reads one of NewTerminals' a{ss} specs. Strings point into the message, but
+ * commandv is allocated. Returns an error message or NULL.
+ */
+static const char *parse_launch_spec(DBusMessageIter *iter,
+        ROXTermLaunchSpec *spec)
+{
+    DBusMessageIter dict_iter;
+
+    if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_ARRAY ||
+            dbus_message_iter_get_element_type(iter) != DBUS_TYPE_DICT_ENTRY)
+    {
+        return _("Each terminal must be described by a dictionary");
+    }
+    dbus_message_iter_recurse(iter, &dict_iter);
+    for (; dbus_message_iter_get_arg_type(&dict_iter) == DBUS_TYPE_DICT_ENTRY;
+            dbus_message_iter_next(&dict_iter))
+    {
+        DBusMessageIter entry_iter;
+        const char *key;
+        const char *value;
+
+        dbus_message_iter_recurse(&dict_iter, &entry_iter);
+        if (dbus_message_iter_get_arg_type(&entry_iter) != DBUS_TYPE_STRING)
+            return _("Terminal dictionary keys must be strings");
+        dbus_message_iter_get_basic(&entry_iter, &key);
+        dbus_message_iter_next(&entry_iter);
+        if (dbus_message_iter_get_arg_type(&entry_iter) != DBUS_TYPE_STRING)
+            return _("Terminal dictionary values must be strings");
+        dbus_message_iter_get_basic(&entry_iter, &value);
+        if (!strcmp(key, "command"))
+        {
+            g_strfreev(spec->commandv);
+            spec->commandv = NULL;
+            if (!g_shell_parse_argv(value, NULL, &spec->commandv, NULL))
+                return _("Unable to parse terminal command");
+        }
+        else if (!strcmp(key, "directory"))
+        {
+            spec->directory = value;
+        }
+        else if (!strcmp(key, "profile"))
+        {
+            spec->profile = value;
+        }
+        else if (!strcmp(key, "title"))
+        {
+            spec->title = value;
+        }
+        else if (!strcmp(key, "window"))
+        {
+            spec->window = value;
+        }
+        else
+        {
+            g_warning(_("Unknown key '%s' in NewTerminals"), key);
+        }
+    }
+    return NULL;
+}
+
+/* Handles ROXTERM_DBUS_BATCH_METHOD_NAME */
+static void launch_batch(DBusMessage *message)
+{
+    DBusMessageIter iter;
+    DBusMessageIter specs_iter;
+    GArray *specs = g_array_new(FALSE, TRUE, sizeof(ROXTermLaunchSpec));
+    const char *error = NULL;
+    DBusMessage *reply;
+    char **env = NULL;
+    guint n;
+
+    if (worker_pool_is_dispatcher())
+        error = _("NewTerminals isn't supported with --workers");
+    else if (!dbus_message_iter_init(message, &iter) ||
+            !(env = rtdbus_get_message_arg_string_array(&iter)))
+        error = _("NewTerminals needs an environment");
+    else if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY)
+        error = _("NewTerminals needs an array of terminals");
+    if (!error)
+    {
+        dbus_message_iter_recurse(&iter, &specs_iter);
+        for (; !error &&
+                dbus_message_iter_get_arg_type(&specs_iter) != DBUS_TYPE_INVALID;
+                dbus_message_iter_next(&specs_iter))
+        {
+            ROXTermLaunchSpec spec = { NULL, NULL, NULL, NULL, NULL };
+
+            error = parse_launch_spec(&specs_iter, &spec);
+            g_array_append_val(specs, spec);
+        }
+    }
+    if (error)
+    {
+        reply = dbus_message_new_error(message, ROXTERM_DBUS_ERROR, error);
+    }
+    else
+    {
+        char **ids = roxterm_launch_batch(env,
+                (ROXTermLaunchSpec *) specs->data, specs->len);
+
+        reply = dbus_message_new_method_return(message);
+        if (reply)
+        {
+            dbus_message_append_args(reply,
+                    DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &ids, specs->len,
+                    DBUS_TYPE_INVALID);
+        }
+        g_strfreev(ids);
+    }
+    if (reply)
+        rtdbus_send_message(reply);
+    for (n = 0; n < specs->len; ++n)
+        g_strfreev(g_array_index(specs, ROXTermLaunchSpec, n).commandv);
+    g_array_free(specs, TRUE);
+    g_strfreev(env);
+}
+
 static DBusHandlerResult new_term_listener(DBusConnection *connection,
         DBusMessage *message, void *user_data)
 {
@@ -135,6 +253,50 @@ static DBusHandlerResult new_term_listener(DBusConnection *connection,
 
     dbus_error_init(&derror);
 
+    if (worker_pool_handle_message(message))
+        return DBUS_HANDLER_RESULT_HANDLED;
+    if (dbus_message_is_method_call(message, ROXTERM_DBUS_INTERFACE,
+                ROXTERM_DBUS_SCROLLBACK_METHOD_NAME))
+    {
+        char *description = scrollback_describe();
+        DBusMessage *reply = dbus_message_new_method_return(message);
+
+        if (reply)
+        {
+            dbus_message_append_args(reply,
+                    DBUS_TYPE_STRING, &description,
+                    DBUS_TYPE_INVALID);
+            rtdbus_send_message(reply);
+        }
+        g_free(description);
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+    if (dbus_message_is_method_call(message, ROXTERM_DBUS_INTERFACE,
+                ROXTERM_DBUS_STATS_METHOD_NAME) ||
+            dbus_message_is_method_call(message, ROXTERM_DBUS_INTERFACE,
+                ROXTERM_DBUS_MEMORY_METHOD_NAME))
+    {
+        char *description = dbus_message_has_member(message,
+                ROXTERM_DBUS_MEMORY_METHOD_NAME) ?
+                roxterm_describe_memory() : roxterm_describe_latency();
+        DBusMessage *reply = dbus_message_new_method_return(message);
+
+        if (reply)
+        {
+            dbus_message_append_args(reply,
+                    DBUS_TYPE_STRING, &description,
+                    DBUS_TYPE_INVALID);
+            rtdbus_send_message(reply);
+        }
+        g_free(description);
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+    if (dbus_message_is_method_call(message, ROXTERM_DBUS_INTERFACE,
+                ROXTERM_DBUS_BATCH_METHOD_NAME))
+    {
+        launch_batch(message);
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
     if (!dbus_message_is_method_call(message, ROXTERM_DBUS_INTERFACE,
                 ROXTERM_DBUS_METHOD_NAME))
     {
@@ -165,6 +327,48 @@ gboolean listen_for_new_term(void)
             new_term_listener, global_options_lookup_int("replace") > 0);
 }
 
+/* For --stats. Each worker in a pool has its own terminals, so they're asked
+ * in turn after the process which owns ROXTERM_DBUS_NAME; workers are
+ * started in order, so the first one which doesn't answer is the last.
+ */
+static int print_stats(void)
+{
+    int result = 1;
+    int n;
+
+    for (n = -1; n < 256; ++n)
+    {
+        char *name = n < 0 ? g_strdup(ROXTERM_DBUS_NAME) :
+                worker_pool_get_worker_name(n);
+        DBusMessage *message = rtdbus_method_new(name,
+                ROXTERM_DBUS_OBJECT_PATH, ROXTERM_DBUS_INTERFACE,
+                ROXTERM_DBUS_STATS_METHOD_NAME, DBUS_TYPE_INVALID);
+        DBusMessage *reply = NULL;
+        const char *stats = NULL;
+
+        g_free(name);
+        if (message)
+        {
+            dbus_message_set_auto_start(message, FALSE);
+            reply = dbus_connection_send_with_reply_and_block(
+                    rtdbus_connection, message, -1, NULL);
+            dbus_message_unref(message);
+        }
+        if (!reply)
+            break;
+        if (dbus_message_get_args(reply, NULL, DBUS_TYPE_STRING, &stats,
+                    DBUS_TYPE_INVALID))
+        {
+            fputs(stats, stdout);
+            result = 0;
+        }
+        dbus_message_unref(reply);
+    }
+    if (result)
+        g_warning(_("Unable to get statistics from a running roxterm"));
+    return result;
+}
+
 static int wait_for_child(int pipe_r)
 {
     char result;
@@ -230,17 +434,31 @@ roxterm_dbus_service_ready(DBusConnection * connection,
     return DBUS_HANDLER_RESULT_HANDLED;
 }
 
+/* Whether the command line specifies a terminal rather than just opening the
+ * default one.
+ */
+static gboolean command_line_asks_for_terminal(void)
+{
+    return global_options_commandv || global_options_directory ||
+            global_options_tab;
+}
+
 int main(int argc, char **argv)
 {
     gboolean preparse_ok;
     DBusMessage *message = NULL;
     gboolean launched = FALSE;
+    gboolean journal_restored = FALSE;
     gboolean dbus_ok;
+    gboolean owns_dbus_name = FALSE;
     pid_t fork_result = 0;
     static int fork_pipe[2] = { -1, -1};
     gboolean defer_pipe = FALSE;
     const char *session_leafname;
     char *session_filename;
+    char *journal_filename = NULL;
+    /* Kept for starting the first worker with --workers */
+    char **orig_argv = g_strdupv(argv);
 
     global_options_init_appdir(argc, argv);
     global_options_init_bindir(argv[0]);
@@ -311,11 +529,49 @@ int main(int argc, char **argv)
     global_options_init(&argc, &argv, TRUE);
     global_options_apply_dark_theme();
 
-    if (dbus_ok)
+    if (global_options_lookup_int_with_default("stats", 0) > 0)
+    {
+        if (message)
+            dbus_message_unref(message);
+        return roxterm_exit(fork_pipe[1],
+                dbus_ok ? print_stats() : 1);
+    }
+
+    if (worker_pool_is_worker())
+    {
+        /* Started by a dispatcher, so it can't be the one to run this */
+        if (dbus_ok && !worker_pool_start_worker(new_term_listener))
+            g_warning(_("Worker unable to take its D-BUS name"));
+        dbus_ok = FALSE;
+    }
+    else if (dbus_ok)
     {
         dbus_ok = listen_for_new_term();
         /* Only TRUE if another roxterm is providing the service */
+        owns_dbus_name = !dbus_ok && rtdbus_connection;
+        if (!dbus_ok && rtdbus_connection &&
+                global_options_lookup_int("separate") <= 0 &&
+                global_options_lookup_int_with_default("workers", 0) > 0)
+        {
+            if (message)
+                dbus_message_unref(message);
+            if (worker_pool_start_dispatcher(
+                    global_options_lookup_int("workers"),
+                    worker_pool_parse_placement(
+                        global_options_lookup_string("worker_placement")),
+                    orig_argv, environ))
+            {
+                g_strfreev(orig_argv);
+                if (!defer_pipe)
+                    g_idle_add(roxterm_idle_ok, &fork_pipe[1]);
+                SLOG("Entering main loop as worker pool dispatcher");
+                gtk_main();
+                return 0;
+            }
+            message = NULL;
+        }
     }
+    g_strfreev(orig_argv);
 
     dbus_ok = global_options_lookup_int("separate") <= 0 && dbus_ok
             && !global_options_user_session_id;
@@ -341,21 +597,53 @@ int main(int argc, char **argv)
 
     roxterm_init();
 
+    /* Only the instance which owns ROXTERM_DBUS_NAME keeps the journal.
+     * Another instance, eg one run with --separate or one which couldn't
+     * reach the owner via D-BUS, would otherwise reopen the owner's windows
+     * after a crash, and both would overwrite the same journal. Workers don't
+     * own the name either.
+     */
+    if (owns_dbus_name &&
+            global_options_lookup_int_with_default("session_journal", 0) > 0)
+    {
+        journal_filename = session_get_filename("Journal", "UserSessions",
+                TRUE);
+        /* The journal only has windows in it if roxterm didn't exit cleanly */
+        if (journal_filename && !global_options_user_session_id &&
+                g_file_test(journal_filename, G_FILE_TEST_IS_REGULAR))
+        {
+            journal_restored = load_session_from_file(journal_filename,
+                    "Journal");
+        }
+    }
+
     session_leafname = global_options_user_session_id ?
             global_options_user_session_id : "Default";
     session_filename = session_get_filename(session_leafname,
             "UserSessions", FALSE);
-    if (g_file_test(session_filename, G_FILE_TEST_IS_REGULAR))
+    if (!journal_restored)
     {
-        launched = load_session_from_file(session_filename, session_leafname);
+        if (g_file_test(session_filename, G_FILE_TEST_IS_REGULAR))
+        {
+            launched = load_session_from_file(session_filename,
+                    session_leafname);
+        }
+        else if (global_options_user_session_id)
+        {
+            g_critical("Session file '%s' not found", session_filename);
+        }
     }
-    else if (global_options_user_session_id)
+    /* Restoring the journal replaces the default terminal, but not ones the
+     * command line asked for.
+     */
+    if (journal_restored ? command_line_asks_for_terminal() : !launched)
     {
-        g_critical("Session file '%s' not found", session_filename);
+        roxterm_launch(environ);
     }
-    if (!launched)
+    if (journal_filename)
     {
-        roxterm_launch(environ);
+        session_journal_start(journal_filename);
+        g_free(journal_filename);
     }
 
     /* Usually this should be deferred to NameAcquired signal handler */
@@ -367,6 +655,10 @@ int main(int argc, char **argv)
     SLOG("Entering main loop with %d windows", g_list_length(multi_win_all));
     gtk_main();
 
+    /* Don't lose output which the log writer hasn't caught up with yet */
+    output_log_shutdown();
+    session_journal_stop();
+
     SLOG("Exiting normally");
 
     return 0;
@@ -0,0 +1,107 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "defns.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#if __GLIBC_PREREQ(2, 33)
+#define HAVE_MALLINFO2 1
+#endif
+#endif
+
+#include "memstats.h"
+
+/* Fields of smaps_rollup to report, with the keys they're reported as */
+static const struct {
+    const char *field;
+    const char *key;
+} mem_stats_smaps_fields[] = {
+    { "Rss:", "rss_kb" },
+    { "Pss:", "pss_kb" },
+    { "Private_Dirty:", "private_dirty_kb" },
+    { "Anonymous:", "anonymous_kb" },
+    { "Swap:", "swap_kb" },
+};
+
+static void mem_stats_append(GString *s, gboolean *first, const char *key,
+        guint64 value)
+{
+    g_string_append_printf(s, "%s\"%s\": %" G_GUINT64_FORMAT,
+            *first ? "" : ", ", key, value);
+    *first = FALSE;
+}
+
+static void mem_stats_describe_smaps(GString *s, gboolean *first)
+{
+    char *contents = NULL;
+    char **lines;
+    int n;
+
+    if (!g_file_get_contents("/proc/self/smaps_rollup", &contents, NULL,
+                NULL))
+    {
+        return;
+    }
+    lines = g_strsplit(contents, "\n", -1);
+    g_free(contents);
+    for (n = 0; lines[n]; ++n)
+    {
+        guint f;
+
+        for (f = 0; f < G_N_ELEMENTS(mem_stats_smaps_fields); ++f)
+        {
+            const char *field = mem_stats_smaps_fields[f].field;
+
+            if (g_str_has_prefix(lines[n], field))
+            {
+                mem_stats_append(s, first, mem_stats_smaps_fields[f].key,
+                        g_ascii_strtoull(lines[n] + strlen(field), NULL, 10));
+                break;
+            }
+        }
+    }
+    g_strfreev(lines);
+}
+
+void mem_stats_describe_process(GString *s)
+{
+    gboolean first = TRUE;
+#ifdef HAVE_MALLINFO2
+    struct mallinfo2 mi = mallinfo2();
+#endif
+
+    g_string_append_c(s, '{');
+#ifdef HAVE_MALLINFO2
+    /* arena is memory from brk, hblkhd from mmap; uordblks is the part of
+     * the arena in use, fordblks the free part */
+    mem_stats_append(s, &first, "malloc_arena", mi.arena);
+    mem_stats_append(s, &first, "malloc_mmap", mi.hblkhd);
+    mem_stats_append(s, &first, "malloc_in_use", mi.uordblks);
+    mem_stats_append(s, &first, "malloc_free", mi.fordblks);
+#endif
+    mem_stats_describe_smaps(s, &first);
+    g_string_append_c(s, '}');
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
@@ -0,0 +1,42 @@
+#ifndef MEMSTATS_H
+#define MEMSTATS_H
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+
+/* Process-wide memory figures for roxterm_describe_memory(), which adds
+ * per-window and per-terminal ones. These are for finding leaks and for
+ * working out how much scrollback to allow on shared hosts, not for
+ * anything which needs to be exact.
+ */
+
+#ifndef DEFNS_H
+#include "defns.h"
+#endif
+
+/* Appends a JSON object with malloc's statistics, where the C library
+ * provides mallinfo2, and the totals from /proc/self/smaps_rollup in kB,
+ * where it exists.
+ */
+void mem_stats_describe_process(GString *s);
+
+#endif /* MEMSTATS_H */
+
+/* vi:set sw=4 ts=4 et cindent cino= */
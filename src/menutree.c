@@ -290,6 +290,8 @@ void menutree_apply_shortcuts(MenuTree *tree, Options *shortcuts)
             "Tabs/Next Tab");
     menutree_set_accel_path_for_item(tree, MENUTREE_TABS_PREVIOUS_TAB,
             "Tabs/Previous Tab");
+    menutree_set_accel_path_for_item(tree, MENUTREE_TABS_SWITCH_TAB,
+            "Tabs/Switch to Tab...");
     menutree_set_accel_path_for_item(tree, MENUTREE_TABS_MOVE_TAB_LEFT,
             "Tabs/Move Tab Left");
     menutree_set_accel_path_for_item(tree, MENUTREE_TABS_MOVE_TAB_RIGHT,
@@ -409,6 +411,7 @@ static void menutree_build(MenuTree *menu_tree, Options *shortcuts,
         _("_Find..."), MENUTREE_SEARCH_FIND,
         _("Find _Next"), MENUTREE_SEARCH_FIND_NEXT,
         _("Find _Previous"), MENUTREE_SEARCH_FIND_PREVIOUS,
+        _("Find in _All Tabs..."), MENUTREE_SEARCH_FIND_ALL_TABS,
         NULL);
     gtk_menu_item_set_submenu(GTK_MENU_ITEM(menu_tree->item_widgets
             [MENUTREE_SEARCH]), submenu);
@@ -431,6 +434,7 @@ static void menutree_build(MenuTree *menu_tree, Options *shortcuts,
         "_", MENUTREE_NULL_ID,
         _("_Previous Tab"), MENUTREE_TABS_PREVIOUS_TAB,
         _("_Next Tab"), MENUTREE_TABS_NEXT_TAB,
+        _("_Switch to Tab..."), MENUTREE_TABS_SWITCH_TAB,
         "_", MENUTREE_NULL_ID,
         _("Move Tab _Left"), MENUTREE_TABS_MOVE_TAB_LEFT,
         _("Move Tab _Right"), MENUTREE_TABS_MOVE_TAB_RIGHT,
@@ -441,7 +445,8 @@ static void menutree_build(MenuTree *menu_tree, Options *shortcuts,
     submenu = gtk_menu_new();
     menutree_build_shell(menu_tree, GTK_MENU_SHELL(submenu),
         _("Show _Manual"), MENUTREE_HELP_SHOW_MANUAL,
-        _("_About ROXTerm"), MENUTREE_HELP_ABOUT, NULL);
+        _("_About ROXTerm"), MENUTREE_HELP_ABOUT,
+        _("Memory _Usage"), MENUTREE_HELP_MEMORY_USAGE, NULL);
     gtk_menu_item_set_submenu(GTK_MENU_ITEM(menu_tree->item_widgets
             [MENUTREE_HELP]), submenu);
     menutree_apply_shortcuts(menu_tree, shortcuts);
@@ -594,6 +599,15 @@ void menutree_remove_tab(MenuTree *tree, GtkWidget *menu_item)
     menutree_apply_tab_shortcuts(tree);
 }
 
+void menutree_remove_tabs(MenuTree *tree, GList *menu_items)
+{
+    GList *link;
+
+    for (link = menu_items; link; link = g_list_next(link))
+        menutree_remove_tab_without_fixing_accels(tree, link->data);
+    menutree_apply_tab_shortcuts(tree);
+}
+
 static GtkWidget *menutree_tab_menu_item_new(GtkMenuShell *menu,
         const char *title)
 {
@@ -86,6 +86,7 @@ typedef enum {
     MENUTREE_SEARCH_FIND,
     MENUTREE_SEARCH_FIND_NEXT,
     MENUTREE_SEARCH_FIND_PREVIOUS,
+    MENUTREE_SEARCH_FIND_ALL_TABS,
 
     MENUTREE_PREFERENCES_PROFILES,
     MENUTREE_PREFERENCES_SELECT_PROFILE,
@@ -102,11 +103,13 @@ typedef enum {
     MENUTREE_TABS_NAME_TAB,
     MENUTREE_TABS_PREVIOUS_TAB,
     MENUTREE_TABS_NEXT_TAB,
+    MENUTREE_TABS_SWITCH_TAB,
     MENUTREE_TABS_MOVE_TAB_LEFT,
     MENUTREE_TABS_MOVE_TAB_RIGHT,
 
     MENUTREE_HELP_SHOW_MANUAL,
     MENUTREE_HELP_ABOUT,
+    MENUTREE_HELP_MEMORY_USAGE,
 
 
     MENUTREE_NUM_IDS,
@@ -254,10 +257,15 @@ void menutree_find_radio_group(GtkWidget *widget, gpointer data);
  * menutree_add_tab */
 void menutree_remove_tab(MenuTree * tree, GtkWidget * menu_item);
 
+/* Like menutree_remove_tab for a list of menu items, but only fixes up the
+ * remaining tabs' shortcuts once */
+void menutree_remove_tabs(MenuTree *tree, GList *menu_items);
+
 inline static void menutree_select_tab(MenuTree * tree, GtkWidget * menu_item)
 {
     (void) tree;
-    gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(menu_item), TRUE);
+    if (menu_item)
+        gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(menu_item), TRUE);
 }
 
 void menutree_disable_shortcuts(MenuTree *tree, gboolean disable);
@@ -80,14 +80,135 @@ multitab_label_draw (GtkWidget *widget, cairo_t *cr)
     return GTK_WIDGET_CLASS (multitab_label_parent_class)->draw (widget, cr);
 }
 
+/* All flashing labels are driven in phase by one timer, which only runs while
+ * at least one of them is visible.
+ */
+#define MULTITAB_LABEL_FLASH_MS 500
+
+static struct {
+    GList *labels;
+    guint tag;
+    gboolean phase;
+    guint wakeups;
+    gint64 rate_start;
+    guint rate;
+} multitab_label_animator;
+
+static gboolean
+multitab_label_is_showing (MultitabLabel *self)
+{
+    GtkWidget *w = GTK_WIDGET (self);
+    GdkWindow *win;
+
+    if (!gtk_widget_get_mapped (w))
+        return FALSE;
+    win = gtk_widget_get_window (gtk_widget_get_toplevel (w));
+    return win && !(gdk_window_get_state (win) & GDK_WINDOW_STATE_ICONIFIED);
+}
+
+static void
+multitab_label_set_attention (MultitabLabel *self, gboolean attention)
+{
+    if (self->attention != attention)
+    {
+        self->attention = attention;
+        gtk_widget_queue_draw (GTK_WIDGET (self));
+    }
+}
+
 static gboolean
-multitab_label_toggle_attention (gpointer data)
+multitab_label_animator_tick (gpointer data)
 {
-    MultitabLabel *self = MULTITAB_LABEL (data);
+    gint64 now = g_get_monotonic_time ();
+    gboolean showing = FALSE;
+    GList *link;
+    (void) data;
 
-    self->attention = !self->attention;
-    gtk_widget_queue_draw (GTK_WIDGET (data));
-    return TRUE;
+    ++multitab_label_animator.wakeups;
+    if (now - multitab_label_animator.rate_start >= G_USEC_PER_SEC)
+    {
+        multitab_label_animator.rate = multitab_label_animator.wakeups *
+                G_USEC_PER_SEC / (now - multitab_label_animator.rate_start);
+        multitab_label_animator.wakeups = 0;
+        multitab_label_animator.rate_start = now;
+    }
+    multitab_label_animator.phase = !multitab_label_animator.phase;
+    for (link = multitab_label_animator.labels; link;
+            link = g_list_next (link))
+    {
+        MultitabLabel *self = link->data;
+
+        if (multitab_label_is_showing (self))
+        {
+            showing = TRUE;
+            multitab_label_set_attention (self,
+                    multitab_label_animator.phase);
+        }
+    }
+    if (!showing)
+    {
+        multitab_label_animator.tag = 0;
+        multitab_label_animator.rate = 0;
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+/* Starts or stops the timer according to whether any flashing label is
+ * visible.
+ */
+static void
+multitab_label_animator_update (void)
+{
+    gboolean showing = FALSE;
+    GList *link;
+
+    for (link = multitab_label_animator.labels; link && !showing;
+            link = g_list_next (link))
+    {
+        showing = multitab_label_is_showing (link->data);
+    }
+    if (showing && !multitab_label_animator.tag)
+    {
+        multitab_label_animator.wakeups = 0;
+        multitab_label_animator.rate_start = g_get_monotonic_time ();
+        multitab_label_animator.tag = g_timeout_add (MULTITAB_LABEL_FLASH_MS,
+                multitab_label_animator_tick, NULL);
+    }
+    else if (!showing && multitab_label_animator.tag)
+    {
+        g_source_remove (multitab_label_animator.tag);
+        multitab_label_animator.tag = 0;
+        multitab_label_animator.rate = 0;
+    }
+}
+
+void
+multitab_label_animation_resync (void)
+{
+    multitab_label_animator_update ();
+}
+
+guint
+multitab_label_get_animation_wakeup_rate (void)
+{
+    return multitab_label_animator.tag ? multitab_label_animator.rate : 0;
+}
+
+static void
+multitab_label_map (GtkWidget *w)
+{
+    GTK_WIDGET_CLASS (multitab_label_parent_class)->map (w);
+    if (MULTITAB_LABEL (w)->flashing)
+        multitab_label_animator_update ();
+}
+
+static void
+multitab_label_unmap (GtkWidget *w)
+{
+    GTK_WIDGET_CLASS (multitab_label_parent_class)->unmap (w);
+    if (MULTITAB_LABEL (w)->flashing)
+        multitab_label_animator_update ();
 }
 
 static void
@@ -154,6 +275,8 @@ multitab_label_class_init(MultitabLabelClass *klass)
             style, -1, NULL);
 
     wclass->destroy = multitab_label_destroy;
+    wclass->map = multitab_label_map;
+    wclass->unmap = multitab_label_unmap;
     wclass->draw = multitab_label_draw;
     wclass->get_preferred_width = multitab_label_get_preferred_width;
     wclass->get_preferred_width_for_height =
@@ -242,24 +365,30 @@ multitab_label_get_text (MultitabLabel *self)
 void
 multitab_label_draw_attention (MultitabLabel *self)
 {
-    multitab_label_cancel_attention (self);
-    multitab_label_toggle_attention (self);
-    self->timeout_tag = g_timeout_add (500,
-            multitab_label_toggle_attention, self);
+    if (self->flashing)
+        return;
+    self->flashing = TRUE;
+    multitab_label_animator.labels =
+            g_list_prepend (multitab_label_animator.labels, self);
+    /* Join in with any labels which are already flashing */
+    multitab_label_set_attention (self, multitab_label_animator.tag ?
+            multitab_label_animator.phase : TRUE);
+    if (!multitab_label_animator.tag)
+        multitab_label_animator.phase = TRUE;
+    multitab_label_animator_update ();
 }
 
 void
 multitab_label_cancel_attention (MultitabLabel *self)
 {
-    if (self->timeout_tag)
-    {
-        g_source_remove (self->timeout_tag);
-        self->timeout_tag = 0;
-    }
-    if (self->attention)
+    if (self->flashing)
     {
-        multitab_label_toggle_attention (self);
+        self->flashing = FALSE;
+        multitab_label_animator.labels =
+                g_list_remove (multitab_label_animator.labels, self);
+        multitab_label_animator_update ();
     }
+    multitab_label_set_attention (self, FALSE);
 }
 
 void
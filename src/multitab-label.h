@@ -51,7 +51,7 @@ struct _MultitabLabel
     GdkRGBA attention_color;
     GtkLabel *label;
     gboolean attention;
-    guint timeout_tag;
+    gboolean flashing;
     gboolean single;
     gboolean fixed_width;
     GtkWidget *parent;
@@ -89,6 +89,18 @@ multitab_label_draw_attention (MultitabLabel *label);
 void
 multitab_label_cancel_attention (MultitabLabel *label);
 
+/* Call when a window's visibility changes in a way that doesn't map or unmap
+ * its widgets, eg iconifying.
+ */
+void
+multitab_label_animation_resync (void);
+
+/* How often the shared attention timer has been waking up, per second;
+ * 0 while it's stopped.
+ */
+guint
+multitab_label_get_animation_wakeup_rate (void);
+
 void
 multitab_label_set_attention_color (MultitabLabel *label,
         const GdkRGBA *color);
@@ -31,6 +31,7 @@
 #include "multitab-close-button.h"
 #include "multitab-label.h"
 #include "session-file.h"
+#include "session-journal.h"
 #include "shortcuts.h"
 
 #define HORIZ_TAB_WIDTH_CHARS 16
@@ -104,6 +105,7 @@ struct MultiWin {
     int clipboard_flash_frame;
     gulong clipboard_flash_tag;
     GtkWidget *clipboard_indicator_button;
+    gboolean tab_menu_items;
 };
 
 static double multi_win_zoom_factors[] = {
@@ -128,6 +130,7 @@ static double multi_win_zoom_factors[] = {
 
 static char *multi_win_role_prefix = NULL;
 static int multi_win_role_index = 0;
+static gboolean multi_win_tab_menu_items = TRUE;
 
 static MultiTabFiller multi_tab_filler;
 static MultiTabDestructor multi_tab_destructor;
@@ -147,6 +150,8 @@ static MultiWinClipboardButtonHandler multi_win_clipboard_button_handler;
 
 static gboolean multi_win_notify_tab_removed(MultiWin *, MultiTab *);
 
+static void multi_win_tabs_removed(MultiWin *win);
+
 static void multi_win_add_tab(MultiWin *, MultiTab *, int position,
         gboolean notify_only);
 
@@ -363,10 +368,75 @@ static void multi_tab_delete_without_notifying_parent(MultiTab * tab,
         menutree_remove_tab(tab->parent->menu_bar, tab->menu_bar_item);
         tab->menu_bar_item = NULL;
     }
+    session_journal_tab_closed(tab);
     if (!tab->postponed_free)
         multi_tab_free(tab);
 }
 
+/* Destroying a terminal frees its scrollback, which can take a noticeable
+ * time, so when a lot of tabs are closed at once their widgets are queued and
+ * destroyed a few at a time at idle priority.
+ */
+#define MULTI_TAB_DESTROY_BATCH 4
+
+static GQueue multi_tab_doomed_widgets = G_QUEUE_INIT;
+static guint multi_tab_doomed_tag = 0;
+
+static gboolean multi_tab_destroy_doomed_widgets(gpointer data)
+{
+    int n;
+
+    (void) data;
+    for (n = 0; n < MULTI_TAB_DESTROY_BATCH; ++n)
+    {
+        GtkWidget *widget = g_queue_pop_head(&multi_tab_doomed_widgets);
+
+        if (!widget)
+        {
+            multi_tab_doomed_tag = 0;
+            return G_SOURCE_REMOVE;
+        }
+        gtk_widget_destroy(widget);
+        g_object_unref(widget);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+/* Like multi_tab_delete_without_notifying_parent, but takes the tab's widget
+ * out of the notebook and queues it for destruction instead of destroying it
+ * straight away. The caller must remove the tab from win->tabs and deal with
+ * its menu items.
+ */
+static void multi_tab_delete_deferring_widget(MultiTab *tab)
+{
+    MultiWin *win = tab->parent;
+    GtkWidget *widget = tab->widget;
+    GtkWidget *active_widget = tab->active_widget;
+    GtkAdjustment *adjustment = tab->adjustment;
+    gpointer user_data = tab->user_data;
+
+    g_object_ref(widget);
+    g_object_set_data(G_OBJECT(widget), "roxterm_tab", NULL);
+    g_signal_handlers_disconnect_by_data(widget, tab);
+    gtk_container_remove(GTK_CONTAINER(win->notebook), widget);
+    tab->widget = NULL;
+    tab->label = NULL;
+    tab->close_button = NULL;
+    multi_tab_delete_without_notifying_parent(tab, FALSE);
+    /* The client's data has gone, but the widgets it connected signals to
+     * haven't yet */
+    if (active_widget)
+        g_signal_handlers_disconnect_by_data(active_widget, user_data);
+    if (adjustment)
+        g_signal_handlers_disconnect_by_data(adjustment, user_data);
+    g_queue_push_tail(&multi_tab_doomed_widgets, widget);
+    if (!multi_tab_doomed_tag)
+    {
+        multi_tab_doomed_tag = g_idle_add_full(G_PRIORITY_LOW,
+                multi_tab_destroy_doomed_widgets, NULL, NULL);
+    }
+}
+
 void multi_tab_delete(MultiTab * tab)
 {
     MultiWin *win = tab->parent;
@@ -449,6 +519,7 @@ static void multi_tab_set_full_window_title(MultiTab * tab)
     MultiWin *win = tab->parent;
     char *tab_label;
     
+    session_journal_tab_changed(tab);
     tab_label = multi_tab_get_full_window_title(tab);
     if (tab->label)
     {
@@ -654,6 +725,7 @@ void multi_tab_move_to_position(MultiTab *tab, int position, gboolean reorder)
     multi_tab_remove_menutree_items(win, tab);
     multi_tab_add_menutree_items(win, tab, position);
     multi_tab_set_full_window_title(tab);
+    session_journal_win_changed(win);
 }
 
 gboolean multi_tab_remove_from_parent(MultiTab *tab, gboolean notify_only)
@@ -976,6 +1048,9 @@ static gboolean multi_win_state_event_handler(GtkWidget *widget,
         menutree_set_fullscreen_active(win->menu_bar, win->fullscreen);
         menutree_set_fullscreen_active(win->popup_menu, win->fullscreen);
     }
+
+    if (event->changed_mask & GDK_WINDOW_STATE_ICONIFIED)
+        multitab_label_animation_resync();
     return FALSE;
 }
 
@@ -1287,19 +1362,58 @@ static void multi_win_close_tab_action(MultiWin * win)
     multi_win_close_tab_clicked(NULL, win->current_tab);
 }
 
-static void multi_win_close_other_tabs_action(MultiWin * win)
+void multi_win_close_other_tabs(MultiWin *win, MultiTab *keep)
 {
-    GList *link;
+    GList *link = win->tabs;
+    GList *popup_items = NULL;
+    GList *menu_bar_items = NULL;
 
-    while ((link = win->tabs) != NULL)
+    if (!keep)
     {
-        if (link->data == win->current_tab)
-            link = g_list_next(link);
-        if (link)
-            multi_tab_delete(link->data);
-        else
-            break;
+        multi_win_delete(win);
+        return;
     }
+    win->ignore_tabs_moving = TRUE;
+    win->ignore_tab_selections = TRUE;
+    while (link)
+    {
+        MultiTab *tab = link->data;
+        GList *next = g_list_next(link);
+
+        if (tab != keep)
+        {
+            win->tabs = g_list_delete_link(win->tabs, link);
+            --win->ntabs;
+            if (tab->popup_menu_item)
+            {
+                popup_items = g_list_prepend(popup_items,
+                        tab->popup_menu_item);
+                tab->popup_menu_item = NULL;
+            }
+            if (tab->menu_bar_item)
+            {
+                menu_bar_items = g_list_prepend(menu_bar_items,
+                        tab->menu_bar_item);
+                tab->menu_bar_item = NULL;
+            }
+            multi_tab_delete_deferring_widget(tab);
+        }
+        link = next;
+    }
+    if (popup_items)
+        menutree_remove_tabs(win->popup_menu, popup_items);
+    if (menu_bar_items)
+        menutree_remove_tabs(win->menu_bar, menu_bar_items);
+    g_list_free(popup_items);
+    g_list_free(menu_bar_items);
+    win->ignore_tab_selections = FALSE;
+    multi_win_tabs_removed(win);
+    win->ignore_tabs_moving = FALSE;
+}
+
+static void multi_win_close_other_tabs_action(MultiWin * win)
+{
+    multi_win_close_other_tabs(win, win->current_tab);
 }
 
 static void multi_win_name_tab_action(MultiWin * win)
@@ -1569,31 +1683,29 @@ static void multi_win_zoom_changed(MultiWin *win)
     }
 }
 
-static void multi_win_zoom_in_action(MultiWin *win)
+void multi_win_set_zoom_index(MultiWin *win, int index)
 {
-    if (win->zoom_index < MULTI_WIN_N_ZOOM_FACTORS - 1)
+    index = CLAMP(index, 0, MULTI_WIN_N_ZOOM_FACTORS - 1);
+    if (win->zoom_index != index)
     {
-        ++win->zoom_index;
+        win->zoom_index = index;
         multi_win_zoom_changed(win);
     }
 }
 
+static void multi_win_zoom_in_action(MultiWin *win)
+{
+    multi_win_set_zoom_index(win, win->zoom_index + 1);
+}
+
 static void multi_win_zoom_out_action(MultiWin *win)
 {
-    if (win->zoom_index > 0)
-    {
-        --win->zoom_index;
-        multi_win_zoom_changed(win);
-    }
+    multi_win_set_zoom_index(win, win->zoom_index - 1);
 }
 
 static void multi_win_zoom_norm_action(MultiWin *win)
 {
-    if (win->zoom_index != MULTI_WIN_NORMAL_ZOOM_INDEX)
-    {
-        win->zoom_index = MULTI_WIN_NORMAL_ZOOM_INDEX;
-        multi_win_zoom_changed(win);
-    }
+    multi_win_set_zoom_index(win, MULTI_WIN_NORMAL_ZOOM_INDEX);
 }
 
 typedef enum {
@@ -1909,6 +2021,7 @@ MultiWin *multi_win_new_blank(Options *shortcuts,
     char *role = NULL;
 
     win->best_tab_width = G_MAXINT;
+    win->tab_menu_items = multi_win_tab_menu_items;
     win->tab_pos = tab_pos;
     win->always_show_tabs = always_show_tabs;
     win->scroll_bar_pos = MultiWinScrollBar_Query;
@@ -2069,6 +2182,11 @@ void multi_win_set_role_prefix(const char *role_prefix)
     multi_win_role_prefix = g_strdup(role_prefix);
 }
 
+void multi_win_set_tab_menu_items_default(gboolean items)
+{
+    multi_win_tab_menu_items = items;
+}
+
 MultiWin *multi_win_new_full(Options *shortcuts,
         int zoom_index, gpointer user_data_template, const char *geom,
         MultiWinSizing sizing, GtkPositionType tab_pos, gboolean borderless,
@@ -2145,6 +2263,25 @@ static void multi_win_destructor(MultiWin *win, gboolean destroy_widgets)
     {
         win->gtkwin = NULL;
     }
+    else if (win->gtkwin)
+    {
+        /* The terminals are destroyed in the background, so hide the window
+         * now. Its menus are about to be deleted, so there's no need to
+         * remove the tabs' items from them.
+         */
+        gtk_widget_hide(win->gtkwin);
+        win->ignore_tabs_moving = TRUE;
+        for (link = win->tabs; link; link = g_list_next(link))
+        {
+            MultiTab *tab = link->data;
+
+            tab->popup_menu_item = NULL;
+            tab->menu_bar_item = NULL;
+            multi_tab_delete_deferring_widget(tab);
+        }
+        g_list_free(win->tabs);
+        win->tabs = NULL;
+    }
     for (link = win->tabs; link; link = g_list_next(link))
     {
         multi_tab_delete_without_notifying_parent(link->data, destroy_widgets);
@@ -2176,6 +2313,7 @@ static void multi_win_destructor(MultiWin *win, gboolean destroy_widgets)
     UNREF_LOG(options_unref(win->shortcuts));
     g_free(win->title_template);
     g_free(win->child_title);
+    session_journal_win_closed(win);
     g_free(win);
     multi_win_all = g_list_remove(multi_win_all, win);
     if (!multi_win_all)
@@ -2210,23 +2348,27 @@ static gboolean multi_win_notify_tab_removed(MultiWin * win, MultiTab * tab)
         multi_win_delete(win);
         return TRUE;
     }
-    else
+    multi_win_tabs_removed(win);
+    return FALSE;
+}
+
+/* Updates the window after one or more tabs have been removed, leaving at
+ * least one */
+static void multi_win_tabs_removed(MultiWin *win)
+{
+    renumber_tabs(win);
+    if (win->ntabs == 1)
     {
-        renumber_tabs(win);
-        if (win->ntabs == 1)
+        if (win->tab_pos == GTK_POS_TOP || win->tab_pos == GTK_POS_BOTTOM)
+            multi_win_pack_for_single_tab(win);
+        if (!win->always_show_tabs)
         {
-            tab = win->tabs->data;
-            if (win->tab_pos == GTK_POS_TOP || win->tab_pos == GTK_POS_BOTTOM)
-                multi_win_pack_for_single_tab(win);
-            if (!win->always_show_tabs)
-            {
-                multi_win_request_size_restore(win);
-                multi_win_hide_tabs(win);
-            }
+            multi_win_request_size_restore(win);
+            multi_win_hide_tabs(win);
         }
     }
     multi_win_shade_menus_for_tabs(win);
-    return FALSE;
+    session_journal_win_changed(win);
 }
 
 /* Adding or removeing close buttons could cause unwanted resizes, but might
@@ -2278,12 +2420,17 @@ void multi_tab_set_middle_click_tab_action(MultiTab *tab, int action)
 static void multi_tab_add_menutree_items(MultiWin * win, MultiTab * tab,
         int position)
 {
-    char *title = multi_tab_get_full_window_title(tab);
-    gboolean has_num = g_str_has_prefix(tab->window_title_template, "%t. ");
-    char *n_and_title = has_num ?
+    char *title;
+    gboolean has_num;
+    char *n_and_title;
+
+    if (!win->tab_menu_items)
+        return;
+    title = multi_tab_get_full_window_title(tab);
+    has_num = g_str_has_prefix(tab->window_title_template, "%t. ");
+    n_and_title = has_num ?
             g_strdup_printf("%d. %s", multi_tab_get_page_num(tab), title) :
             title;
-
     if (has_num)
         g_free(title);
     tab->popup_menu_item = menutree_add_tab_at_position(win->popup_menu,
@@ -2373,6 +2520,7 @@ static void multi_win_add_tab(MultiWin * win, MultiTab * tab, int position,
     multi_win_shade_menus_for_tabs(win);
     multi_win_select_tab(win, tab);
     win->ignore_tabs_moving = FALSE;
+    session_journal_win_changed(win);
 }
 
 GtkWidget *multi_win_get_widget(MultiWin * win)
@@ -214,6 +214,13 @@ typedef enum {
 /* If this is set all windows will be given a unique role based on it */
 void multi_win_set_role_prefix(const char *role_prefix);
 
+/* Whether windows opened from now on have an item for each tab in their Tabs
+ * menus. Without them a window with hundreds of tabs is much cheaper to
+ * maintain, but the Select_Tab shortcuts, which are attached to those items,
+ * don't work.
+ */
+void multi_win_set_tab_menu_items_default(gboolean items);
+
 /* Create a new window with default settings, adding it to main list */
 MultiWin *multi_win_new_full(Options *shortcuts, int zoom_index,
         gpointer user_data_template, const char *geom,
@@ -283,6 +290,11 @@ void multi_win_show(MultiWin *win);
  * windows are destroyed it calls gtk_main_quit() */
 void multi_win_delete(MultiWin *);
 
+/* Closes all of a window's tabs except keep, renumbering the remaining tab and
+ * updating the menus once rather than after each tab. The closed tabs'
+ * widgets are destroyed in the background. */
+void multi_win_close_other_tabs(MultiWin *win, MultiTab *keep);
+
 void multi_win_set_borderless(MultiWin *win, gboolean borderless);
 
 void multi_win_set_fullscreen(MultiWin *win, gboolean fullscreen);
@@ -301,6 +313,11 @@ double multi_win_get_zoom_factor(MultiWin *win);
 
 int multi_win_get_nearest_index_for_zoom(double factor);
 
+/* Zooms every tab in the window, as if by the View menu's zoom items; the
+ * index is clamped to the available zoom levels.
+ */
+void multi_win_set_zoom_index(MultiWin *win, int index);
+
 /* Adds signal handlers for "activate" to an item in both menus;
  * popup_id and bar_id are for returning the signal handler ids returned by
  * g_signal_connect; they can be NULL if you don't need to know them */
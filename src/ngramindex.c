@@ -0,0 +1,711 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "defns.h"
+
+#include <string.h>
+
+#include "escscan.h"
+#include "ngramindex.h"
+#include "roxterm.h"
+
+#define NGRAM_INDEX_BLOCK_LINES 64
+
+/* With a typical 80 column line there are up to about 5000 trigrams in a
+ * block, but far fewer distinct ones, so most of the bits are still clear.
+ */
+#define NGRAM_INDEX_SIGNATURE_LOG2_BITS 12
+#define NGRAM_INDEX_SIGNATURE_BITS (1 << NGRAM_INDEX_SIGNATURE_LOG2_BITS)
+#define NGRAM_INDEX_SIGNATURE_WORDS (NGRAM_INDEX_SIGNATURE_BITS / 32)
+
+/* The limit for unlimited scrollback, about 64MB or 6 million lines */
+#define NGRAM_INDEX_MAX_BLOCKS 100000
+
+typedef struct {
+    guint32 signature[NGRAM_INDEX_SIGNATURE_WORDS];
+    guint16 cells[NGRAM_INDEX_BLOCK_LINES];
+    int n_lines;
+    glong rows;
+    /* The terminal's row number minus the index's, from the last anchor
+     * while this block was being filled.
+     */
+    glong row_offset;
+    /* Text in this block may have been overwritten, so the signature can't
+     * rule it out.
+     */
+    gboolean overwritten;
+} NgramBlock;
+
+struct NgramIndex {
+    GMutex lock;
+    GQueue blocks;              /* Oldest first; new text goes in the last */
+    glong first_row;
+    glong end_row;
+    int columns, screen_rows;
+    glong scrollback_lines;
+    glong row_offset;           /* From the latest anchor */
+
+    /* State of the stream */
+    EscScanState state;
+    gboolean csi_private;
+    int csi_param;
+    gboolean csi_alt_screen;
+    gboolean alt_screen;
+    guint32 trigram;
+    int trigram_len;
+    int column;
+    int line_cells;
+    gunichar utf8_char;
+    int utf8_remaining;
+};
+
+struct NgramQuery {
+    GArray *bits;
+};
+
+inline static guint ngram_index_hash(guint32 trigram)
+{
+    return (trigram * 2654435761u) >> (32 - NGRAM_INDEX_SIGNATURE_LOG2_BITS);
+}
+
+inline static guint8 ngram_index_fold(guint8 c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + 'a' - 'A' : c;
+}
+
+inline static glong ngram_index_line_rows(NgramIndex *ni, int cells)
+{
+    return cells > ni->columns ? (cells + ni->columns - 1) / ni->columns : 1;
+}
+
+static NgramBlock *ngram_index_add_block(NgramIndex *ni)
+{
+    NgramBlock *block = g_new0(NgramBlock, 1);
+
+    block->row_offset = ni->row_offset;
+    g_queue_push_tail(&ni->blocks, block);
+    return block;
+}
+
+/* The cursor has moved or text has been erased, which could affect any row
+ * on the screen, so the blocks holding them can't be ruled out by their
+ * signatures any more.
+ */
+static void ngram_index_mark_overwritten(NgramIndex *ni)
+{
+    glong rows = 0;
+    GList *link;
+
+    for (link = ni->blocks.tail; link && rows <= ni->screen_rows;
+            link = g_list_previous(link))
+    {
+        NgramBlock *block = link->data;
+
+        block->overwritten = TRUE;
+        rows += block->rows;
+    }
+}
+
+/* Discards whole blocks which are beyond the scrollback, but never the one
+ * being filled.
+ */
+static void ngram_index_evict(NgramIndex *ni)
+{
+    glong limit = ni->scrollback_lines >= 0 ?
+            ni->scrollback_lines + ni->screen_rows : -1;
+
+    while (ni->blocks.length > 1)
+    {
+        NgramBlock *block = g_queue_peek_head(&ni->blocks);
+
+        if (ni->blocks.length <= NGRAM_INDEX_MAX_BLOCKS && (limit < 0 ||
+                    ni->end_row - ni->first_row - block->rows < limit))
+        {
+            break;
+        }
+        ni->first_row += block->rows;
+        g_free(g_queue_pop_head(&ni->blocks));
+    }
+}
+
+NgramIndex *ngram_index_new(void)
+{
+    NgramIndex *ni = g_new0(NgramIndex, 1);
+
+    g_mutex_init(&ni->lock);
+    g_queue_init(&ni->blocks);
+    ni->columns = 80;
+    ni->screen_rows = 24;
+    ni->scrollback_lines = -1;
+    ngram_index_add_block(ni);
+    return ni;
+}
+
+void ngram_index_free(NgramIndex *ni)
+{
+    g_queue_clear_full(&ni->blocks, g_free);
+    g_mutex_clear(&ni->lock);
+    g_free(ni);
+}
+
+void ngram_index_clear(NgramIndex *ni)
+{
+    g_mutex_lock(&ni->lock);
+    g_queue_clear_full(&ni->blocks, g_free);
+    ngram_index_add_block(ni);
+    ni->first_row = ni->end_row = 0;
+    ni->column = ni->line_cells = 0;
+    ni->trigram_len = 0;
+    g_mutex_unlock(&ni->lock);
+}
+
+static void ngram_index_end_line(NgramIndex *ni)
+{
+    NgramBlock *block = g_queue_peek_tail(&ni->blocks);
+    int cells = MAX(ni->line_cells, ni->column);
+    glong rows = ngram_index_line_rows(ni, cells);
+
+    block->cells[block->n_lines++] = MIN(cells, G_MAXUINT16);
+    block->rows += rows;
+    ni->end_row += rows;
+    ni->column = ni->line_cells = 0;
+    ni->trigram_len = 0;
+    if (block->n_lines == NGRAM_INDEX_BLOCK_LINES)
+    {
+        ngram_index_add_block(ni);
+        ngram_index_evict(ni);
+    }
+}
+
+static void ngram_index_add_byte(NgramIndex *ni, guint8 c)
+{
+    ni->trigram = ((ni->trigram << 8) | ngram_index_fold(c)) & 0xffffff;
+    if (++ni->trigram_len >= 3)
+    {
+        NgramBlock *block = g_queue_peek_tail(&ni->blocks);
+        guint bit = ngram_index_hash(ni->trigram);
+
+        block->signature[bit / 32] |= 1u << (bit % 32);
+    }
+    /* Count cells per character, not per byte */
+    if (c < 0x80)
+    {
+        ++ni->column;
+        ni->utf8_remaining = 0;
+    }
+    else if (c >= 0xc0)
+    {
+        ni->utf8_remaining = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : 1;
+        ni->utf8_char = c & (0x3f >> ni->utf8_remaining);
+    }
+    else if (ni->utf8_remaining)
+    {
+        ni->utf8_char = (ni->utf8_char << 6) | (c & 0x3f);
+        if (!--ni->utf8_remaining)
+        {
+            if (g_unichar_iswide(ni->utf8_char))
+                ni->column += 2;
+            else if (!g_unichar_iszerowidth(ni->utf8_char))
+                ++ni->column;
+        }
+    }
+}
+
+static void ngram_index_text(NgramIndex *ni, guint8 c)
+{
+    if (ni->alt_screen)
+        return;
+    switch (c)
+    {
+        case '\n':
+            ngram_index_end_line(ni);
+            break;
+        case '\r':
+            ni->line_cells = MAX(ni->line_cells, ni->column);
+            ni->column = 0;
+            ni->trigram_len = 0;
+            break;
+        case '\b':
+            ni->line_cells = MAX(ni->line_cells, ni->column);
+            if (ni->column)
+                --ni->column;
+            ni->trigram_len = 0;
+            break;
+        case '\t':
+            ni->column = (ni->column + 8) & ~7;
+            ni->trigram_len = 0;
+            break;
+        default:
+            if (c >= 0x20 && c != 0x7f)
+            {
+                /* After a CR or backspace, eg a progress bar */
+                if (ni->column < ni->line_cells)
+                {
+                    NgramBlock *block = g_queue_peek_tail(&ni->blocks);
+
+                    block->overwritten = TRUE;
+                }
+                ngram_index_add_byte(ni, c);
+            }
+            break;
+    }
+}
+
+/* Notes whether a CSI parameter switches to or from the alternate screen */
+static void ngram_index_end_csi_param(NgramIndex *ni)
+{
+    if (ni->csi_private && (ni->csi_param == 47 || ni->csi_param == 1047 ||
+                ni->csi_param == 1049))
+    {
+        ni->csi_alt_screen = TRUE;
+    }
+    ni->csi_param = 0;
+}
+
+static void ngram_index_start_csi(NgramIndex *ni)
+{
+    ni->csi_private = FALSE;
+    ni->csi_param = 0;
+    ni->csi_alt_screen = FALSE;
+}
+
+static void ngram_index_csi_param_byte(NgramIndex *ni, guint8 c)
+{
+    if (c == '?')
+    {
+        ni->csi_private = TRUE;
+    }
+    else if (c >= '0' && c <= '9')
+    {
+        if (ni->csi_param < 100000)
+            ni->csi_param = ni->csi_param * 10 + c - '0';
+    }
+    else if (c == ';')
+    {
+        ngram_index_end_csi_param(ni);
+    }
+}
+
+/* c is the CSI's final byte */
+static void ngram_index_end_csi(NgramIndex *ni, guint8 c)
+{
+    ngram_index_end_csi_param(ni);
+    if (ni->csi_alt_screen && (c == 'h' || c == 'l'))
+        ni->alt_screen = c == 'h';
+    /* Anything but colours, modes, reports and cursor style might move the
+     * cursor or erase text.
+     */
+    else if (!ni->alt_screen && !strchr("mhlncqt", c))
+        ngram_index_mark_overwritten(ni);
+}
+
+void ngram_index_feed(NgramIndex *ni, const guint8 *buf, gsize len)
+{
+    gsize n;
+
+    g_mutex_lock(&ni->lock);
+    for (n = 0; n < len; ++n)
+    {
+        guint8 c = buf[n];
+        EscScanState prev = ni->state;
+
+        if (esc_scan_feed(&ni->state, c))
+            ngram_index_text(ni, c);
+        else if (ni->state == ESC_SCAN_CSI && prev != ESC_SCAN_CSI)
+            ngram_index_start_csi(ni);
+        else if (ni->state == ESC_SCAN_CSI)
+            ngram_index_csi_param_byte(ni, c);
+        else if (prev == ESC_SCAN_CSI && ni->state == ESC_SCAN_TEXT)
+            ngram_index_end_csi(ni, c);
+        /* Restore cursor, index, reverse index, next line, reset */
+        else if (prev == ESC_SCAN_ESC && ni->state == ESC_SCAN_TEXT &&
+                !ni->alt_screen && c && strchr("8DEMc", c))
+        {
+            ngram_index_mark_overwritten(ni);
+        }
+    }
+    g_mutex_unlock(&ni->lock);
+}
+
+void ngram_index_set_geometry(NgramIndex *ni, int columns, int rows)
+{
+    g_mutex_lock(&ni->lock);
+    if (columns > 0 && columns != ni->columns)
+    {
+        GList *link;
+
+        ni->columns = columns;
+        ni->end_row = ni->first_row;
+        for (link = ni->blocks.head; link; link = g_list_next(link))
+        {
+            NgramBlock *block = link->data;
+            int n;
+
+            block->rows = 0;
+            for (n = 0; n < block->n_lines; ++n)
+                block->rows += ngram_index_line_rows(ni, block->cells[n]);
+            ni->end_row += block->rows;
+        }
+    }
+    if (rows > 0)
+        ni->screen_rows = rows;
+    ngram_index_evict(ni);
+    g_mutex_unlock(&ni->lock);
+}
+
+void ngram_index_set_scrollback_lines(NgramIndex *ni, glong lines)
+{
+    g_mutex_lock(&ni->lock);
+    ni->scrollback_lines = lines;
+    ngram_index_evict(ni);
+    g_mutex_unlock(&ni->lock);
+}
+
+void ngram_index_anchor(NgramIndex *ni, glong cursor_row)
+{
+    NgramBlock *block;
+
+    g_mutex_lock(&ni->lock);
+    ni->row_offset = cursor_row - ni->end_row;
+    block = g_queue_peek_tail(&ni->blocks);
+    block->row_offset = ni->row_offset;
+    g_mutex_unlock(&ni->lock);
+}
+
+void ngram_index_get_rows(NgramIndex *ni, glong *first, glong *end)
+{
+    NgramBlock *head;
+
+    g_mutex_lock(&ni->lock);
+    head = g_queue_peek_head(&ni->blocks);
+    *first = ni->first_row + head->row_offset;
+    *end = ni->end_row + ni->row_offset;
+    g_mutex_unlock(&ni->lock);
+}
+
+static gboolean ngram_index_block_matches(NgramBlock *block,
+        NgramQuery *query)
+{
+    guint n;
+
+    if (block->overwritten)
+        return TRUE;
+    for (n = 0; n < query->bits->len; ++n)
+    {
+        guint bit = g_array_index(query->bits, guint, n);
+
+        if (!(block->signature[bit / 32] & (1u << (bit % 32))))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+gboolean ngram_index_find(NgramIndex *ni, NgramQuery *query, glong row,
+        gboolean backwards, glong *first, glong *end)
+{
+    GList *link;
+    glong block_first, block_end;
+    gboolean found = FALSE;
+
+    g_mutex_lock(&ni->lock);
+    if (backwards)
+    {
+        block_end = ni->end_row;
+        for (link = ni->blocks.tail; link && !found;
+                link = g_list_previous(link))
+        {
+            NgramBlock *block = link->data;
+
+            block_first = block_end - block->rows;
+            /* The last block also holds the incomplete line at end_row, and
+             * is still being filled, so it's always a candidate.
+             */
+            if (block_first + block->row_offset <= row &&
+                    (!link->next || ngram_index_block_matches(block, query)))
+            {
+                *first = block_first + block->row_offset;
+                *end = (link->next ? block_end : block_end + 1) +
+                        block->row_offset;
+                found = TRUE;
+            }
+            block_end = block_first;
+        }
+    }
+    else
+    {
+        block_first = ni->first_row;
+        for (link = ni->blocks.head; link && !found;
+                link = g_list_next(link))
+        {
+            NgramBlock *block = link->data;
+
+            block_end = block_first + block->rows;
+            if (!link->next)
+                ++block_end;
+            if (block_end + block->row_offset > row &&
+                    (!link->next || ngram_index_block_matches(block, query)))
+            {
+                *first = block_first + block->row_offset;
+                *end = block_end + block->row_offset;
+                found = TRUE;
+            }
+            block_first = block_end;
+        }
+    }
+    g_mutex_unlock(&ni->lock);
+    return found;
+}
+
+gsize ngram_index_get_size(NgramIndex *ni)
+{
+    gsize size;
+
+    g_mutex_lock(&ni->lock);
+    size = sizeof(NgramIndex) +
+            ni->blocks.length * (sizeof(NgramBlock) + sizeof(GList));
+    g_mutex_unlock(&ni->lock);
+    return size;
+}
+
+/* Adds the trigrams in run to query and empties it */
+static void ngram_query_flush(NgramQuery *query, GString *run)
+{
+    guint32 trigram = 0;
+    gsize n;
+
+    for (n = 0; n < run->len; ++n)
+    {
+        trigram = ((trigram << 8) | ngram_index_fold(run->str[n])) & 0xffffff;
+        if (n >= 2)
+        {
+            guint bit = ngram_index_hash(trigram);
+
+            g_array_append_val(query->bits, bit);
+        }
+    }
+    g_string_truncate(run, 0);
+}
+
+/* Adds the character at p, ending at next, to run. Case folding of non-ASCII
+ * characters isn't simple, so with a caseless search they aren't used.
+ */
+static void ngram_query_add_char(NgramQuery *query, GString *run,
+        gsize *last_char, const char *p, const char *next, gboolean caseless)
+{
+    if (caseless && (guint8) *p >= 0x80)
+    {
+        ngram_query_flush(query, run);
+        return;
+    }
+    *last_char = run->len;
+    g_string_append_len(run, p, next - p);
+}
+
+/* For when the pattern is too complicated to pick any literals out of */
+static NgramQuery *ngram_query_abandon(NgramQuery *query, GString *run)
+{
+    g_string_free(run, TRUE);
+    ngram_query_free(query);
+    return NULL;
+}
+
+/* Skips a lazy or possessive modifier following a quantifier */
+inline static const char *ngram_query_skip_modifier(const char *p)
+{
+    return (*p == '?' || *p == '+') ? p + 1 : p;
+}
+
+NgramQuery *ngram_query_new(const char *pattern, guint flags)
+{
+    gboolean caseless = !(flags & ROXTERM_SEARCH_MATCH_CASE);
+    NgramQuery *query = g_new(NgramQuery, 1);
+    GString *run = g_string_new(NULL);
+    gsize last_char = 0;
+    const char *p = pattern;
+    int depth = 0;
+
+    query->bits = g_array_new(FALSE, FALSE, sizeof(guint));
+    while (*p)
+    {
+        const char *next = g_utf8_next_char(p);
+
+        if (!(flags & ROXTERM_SEARCH_AS_REGEX))
+        {
+            ngram_query_add_char(query, run, &last_char, p, next, caseless);
+            p = next;
+            continue;
+        }
+        switch (*p)
+        {
+            case '\\':
+                if (!p[1])
+                {
+                    ngram_query_flush(query, run);
+                }
+                else if (p[1] == 'Q')
+                {
+                    /* \Q...\E is literal, but it isn't worth handling */
+                    const char *e = strstr(p, "\\E");
+
+                    ngram_query_flush(query, run);
+                    next = e ? e + 2 : p + strlen(p);
+                }
+                else if (g_ascii_isalnum(p[1]))
+                {
+                    /* Classes and assertions such as \d and \b are only
+                     * two characters long, but others, eg \x41, \p{L} and
+                     * backreferences, go on for longer, and the rest of
+                     * them mustn't be mistaken for literal text.
+                     */
+                    if (!strchr("dDwWsShHvVRXbBAzZGKntrfea", p[1]))
+                        return ngram_query_abandon(query, run);
+                    ngram_query_flush(query, run);
+                    next = p + 2;
+                }
+                else
+                {
+                    next = g_utf8_next_char(p + 1);
+                    if (depth)
+                    {
+                        ngram_query_flush(query, run);
+                    }
+                    else
+                    {
+                        ngram_query_add_char(query, run, &last_char,
+                                p + 1, next, caseless);
+                    }
+                }
+                break;
+            case '[':
+                ngram_query_flush(query, run);
+                next = p + 1;
+                if (*next == '^')
+                    ++next;
+                if (*next == ']')
+                    ++next;
+                while (*next && *next != ']')
+                {
+                    if (*next == '\\' && next[1])
+                        ++next;
+                    ++next;
+                }
+                if (*next)
+                    ++next;
+                break;
+            case '(':
+                ngram_query_flush(query, run);
+                ++depth;
+                if (p[1] == '?')
+                {
+                    /* In extended mode, (?x), whitespace and comments aren't
+                     * part of the pattern, which is too much to deal with.
+                     */
+                    const char *o;
+
+                    for (o = p + 2; g_ascii_isalpha(*o) || *o == '-' ||
+                            *o == '^'; ++o)
+                    {
+                        if (*o == 'x')
+                            return ngram_query_abandon(query, run);
+                    }
+                    /* Options such as (?i) could change case sensitivity */
+                    caseless = TRUE;
+                }
+                break;
+            case ')':
+                ngram_query_flush(query, run);
+                if (depth)
+                    --depth;
+                break;
+            case '|':
+                /* Nothing is certain to be in a match */
+                if (!depth)
+                    return ngram_query_abandon(query, run);
+                ngram_query_flush(query, run);
+                break;
+            case '?':
+            case '*':
+                /* The previous character is optional */
+                if (run->len)
+                    g_string_truncate(run, last_char);
+                ngram_query_flush(query, run);
+                next = ngram_query_skip_modifier(p + 1);
+                break;
+            case '{':
+                if (g_ascii_isdigit(p[1]) || p[1] == ',')
+                {
+                    if (run->len)
+                        g_string_truncate(run, last_char);
+                    ngram_query_flush(query, run);
+                    next = strchr(p, '}');
+                    next = next ? ngram_query_skip_modifier(next + 1) :
+                            p + strlen(p);
+                }
+                else if (depth)
+                {
+                    ngram_query_flush(query, run);
+                }
+                else
+                {
+                    ngram_query_add_char(query, run, &last_char, p, next,
+                            caseless);
+                }
+                break;
+            case '+':
+                /* The previous character is still required */
+                ngram_query_flush(query, run);
+                next = ngram_query_skip_modifier(p + 1);
+                break;
+            case '.':
+            case '^':
+            case '$':
+                ngram_query_flush(query, run);
+                break;
+            default:
+                if (depth)
+                {
+                    ngram_query_flush(query, run);
+                }
+                else
+                {
+                    ngram_query_add_char(query, run, &last_char, p, next,
+                            caseless);
+                }
+                break;
+        }
+        p = next;
+    }
+    ngram_query_flush(query, run);
+    g_string_free(run, TRUE);
+    if (!query->bits->len)
+    {
+        ngram_query_free(query);
+        return NULL;
+    }
+    return query;
+}
+
+void ngram_query_free(NgramQuery *query)
+{
+    g_array_unref(query->bits);
+    g_free(query);
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
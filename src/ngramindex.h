@@ -0,0 +1,107 @@
+#ifndef NGRAMINDEX_H
+#define NGRAMINDEX_H
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+/* An index of the trigrams in a terminal's output, built incrementally from
+ * the pty stream, so that searches in a very long scrollback can skip
+ * straight to the parts which might match instead of scanning the lot. Lines
+ * are grouped into blocks, and each block has a signature, a bitmap with one
+ * bit set for (a hash of) each trigram in its text, so a block can't contain
+ * a match unless all of a pattern's trigrams' bits are set. ASCII letters are
+ * folded to lower case. Escape sequences are skipped and text written to the
+ * alternate screen is ignored, because it doesn't go in the scrollback.
+ *
+ * Rows are counted in the same way as VTE's, taking line wrapping into
+ * account, and each block is anchored to the terminal's row numbers while
+ * it's being filled. Text which is overwritten after a CR or backspace, or
+ * after the cursor is moved, isn't indexed the way it ends up on screen, so
+ * the blocks it could affect are marked as always possibly matching. Blocks
+ * are discarded when the rows they contain would have dropped out of the
+ * terminal's scrollback.
+ */
+
+#ifndef DEFNS_H
+#include "defns.h"
+#endif
+
+typedef struct NgramIndex NgramIndex;
+
+typedef struct NgramQuery NgramQuery;
+
+NgramIndex *ngram_index_new(void);
+
+void ngram_index_free(NgramIndex *ni);
+
+/* Adds a chunk of raw pty output. This may be called from any thread, but
+ * only one at a time for each index.
+ */
+void ngram_index_feed(NgramIndex *ni, const guint8 *buf, gsize len);
+
+/* Forgets everything, eg after the terminal has been reset */
+void ngram_index_clear(NgramIndex *ni);
+
+/* Recalculates the number of rows each line occupies if columns has
+ * changed; rows is the height of the screen.
+ */
+void ngram_index_set_geometry(NgramIndex *ni, int columns, int rows);
+
+/* The terminal's scrollback limit; -1 for unlimited, in which case the index
+ * still has a fixed limit on its size.
+ */
+void ngram_index_set_scrollback_lines(NgramIndex *ni, glong lines);
+
+/* Tells the index that the terminal's cursor is on cursor_row, so that rows
+ * in the block being filled can be mapped to the terminal's. Call this from
+ * the GTK thread whenever the terminal's contents change.
+ */
+void ngram_index_anchor(NgramIndex *ni, glong cursor_row);
+
+/* Gets the range of the terminal's rows covered by the index. end is one
+ * after the last complete line.
+ */
+void ngram_index_get_rows(NgramIndex *ni, glong *first, glong *end);
+
+/* Finds the nearest block which might contain a match, starting with the one
+ * containing row and moving towards older output if backwards. Sets first
+ * and end to the rows it covers. All rows are the terminal's. The block
+ * still being filled is always a candidate. Returns FALSE if there isn't
+ * one.
+ */
+gboolean ngram_index_find(NgramIndex *ni, NgramQuery *query, glong row,
+        gboolean backwards, glong *first, glong *end);
+
+/* Approximate memory used by the index */
+gsize ngram_index_get_size(NgramIndex *ni);
+
+/* Extracts the trigrams which any match for pattern must contain. flags are
+ * ROXTERM_SEARCH_*. Regular expressions are understood well enough to pick
+ * out the literal text which isn't optional. Returns NULL if there isn't
+ * enough of that for the index to be any use, or the pattern uses syntax
+ * which could be mistaken for literal text, such as multi-character escapes
+ * or (?x).
+ */
+NgramQuery *ngram_query_new(const char *pattern, guint flags);
+
+void ngram_query_free(NgramQuery *query);
+
+#endif /* NGRAMINDEX_H */
+
+/* vi:set sw=4 ts=4 et cindent cino= */
@@ -36,6 +36,53 @@ void options_reload_keyfile(Options *options)
 	options->kf_dirty = FALSE;
 }
 
+/* Adds keys in kf1's group to changed if they are missing from kf2's group or,
+ * if compare is TRUE, have a different value there */
+static void options_diff_keys(GKeyFile *kf1, GKeyFile *kf2,
+		const char *group_name, GPtrArray *changed, gboolean compare)
+{
+	char **keys = kf1 ? g_key_file_get_keys(kf1, group_name, NULL, NULL)
+			: NULL;
+	char **pkey;
+
+	for (pkey = keys; pkey && *pkey; ++pkey)
+	{
+		char *v2 = kf2 ? g_key_file_get_value(kf2, group_name, *pkey, NULL)
+				: NULL;
+
+		if (!v2)
+		{
+			g_ptr_array_add(changed, g_strdup(*pkey));
+		}
+		else if (compare)
+		{
+			char *v1 = g_key_file_get_value(kf1, group_name, *pkey, NULL);
+
+			if (g_strcmp0(v1, v2))
+				g_ptr_array_add(changed, g_strdup(*pkey));
+			g_free(v1);
+		}
+		g_free(v2);
+	}
+	g_strfreev(keys);
+}
+
+char **options_reload_keyfile_diff(Options *options)
+{
+	GKeyFile *old_kf = options->kf;
+	GPtrArray *changed = g_ptr_array_new();
+
+	options->kf = NULL;
+	options_reload_keyfile(options);
+	options_diff_keys(options->kf, old_kf, options->group_name, changed, TRUE);
+	options_diff_keys(old_kf, options->kf, options->group_name, changed,
+			FALSE);
+	if (old_kf)
+		options_file_delete(old_kf);
+	g_ptr_array_add(changed, NULL);
+	return (char **) g_ptr_array_free(changed, FALSE);
+}
+
 Options *options_open(const char *leafname, const char *group_name)
 {
 	Options *options = g_new0(Options, 1);
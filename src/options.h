@@ -53,6 +53,10 @@ void options_delete_keyfile(Options *options);
 
 void options_reload_keyfile(Options *options);
 
+/* Reloads the keyfile and returns the keys whose values are different, or
+ * which have been added or removed; g_strfreev the result */
+char **options_reload_keyfile_diff(Options *options);
+
 /* Options start off with one reference when opened; this adds a reference */
 inline static void options_ref(Options *options)
 {
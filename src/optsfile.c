@@ -24,6 +24,7 @@
 #include <stdarg.h>
 #include <string.h>
 
+#include "configcache.h"
 #include "dlg.h"
 #include "globalopts.h"
 #include "optsfile.h"
@@ -222,14 +223,47 @@ char *options_file_build_filename(const char *first_element, ...)
 	return result;
 }
 
+/* Returns kf if it starts with group_name, otherwise frees it and returns a
+ * new empty GKeyFile */
+static GKeyFile *options_file_check_group(GKeyFile *kf, const char *filename,
+		const char *group_name)
+{
+	char *first_group = g_key_file_get_start_group(kf);
+
+	if (!first_group || strcmp(first_group, group_name))
+	{
+		dlg_critical(NULL, _("Options file %s does not start with group '%s'"),
+				filename, group_name);
+		g_key_file_free(kf);
+		kf = g_key_file_new();
+	}
+	g_free(first_group);
+	return kf;
+}
+
 GKeyFile *options_file_open(const char *leafname, const char *group_name)
 {
 	char *filename;
 	GKeyFile *kf = g_key_file_new();
 	GError *err = NULL;
-	char *first_group;
+
+	const char *cached_filename;
+	const char *text;
+	gsize length;
 
 	options_file_init_paths();
+	if (config_cache_lookup_file(leafname, &cached_filename, &text, &length))
+	{
+		if (!cached_filename)
+			return kf;
+		if (g_key_file_load_from_data(kf, text, length,
+					G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS,
+					NULL))
+		{
+			return options_file_check_group(kf, cached_filename,
+					group_name);
+		}
+	}
 	filename = options_file_build_filename(leafname, NULL);
     g_debug("options_file_open: Generated filename '%s' for leafname '%s', "
             "group_name '%s'", filename, leafname, group_name);
@@ -252,16 +286,7 @@ GKeyFile *options_file_open(const char *leafname, const char *group_name)
 		return kf;
 	}
 
-	first_group = g_key_file_get_start_group(kf);
-	if (!first_group || strcmp(first_group, group_name))
-	{
-		dlg_critical(NULL, _("Options file %s does not start with group '%s'"),
-				filename, group_name);
-		g_key_file_free(kf);
-		kf = g_key_file_new();
-	}
-
-	g_free(first_group);
+	kf = options_file_check_group(kf, filename, group_name);
 	g_free(filename);
 
 	return kf;
@@ -404,10 +429,10 @@ char *options_file_lookup_string_with_default(
             /* When looking up colour_scheme, try dark/light first, falling
              * back to old default
              */
-            alt_key = global_options_system_theme_is_dark() ?
-                "colour_scheme_dark" : "colour_scheme_light";
-            default_value = global_options_system_theme_is_dark() ?
-                "Nocturne" : "GTK";
+            gboolean dark = global_options_system_theme_is_dark();
+
+            alt_key = dark ? "colour_scheme_dark" : "colour_scheme_light";
+            default_value = dark ? "Nocturne" : "GTK";
         }
         else if (g_str_has_prefix(key, "colour_scheme_"))
         {
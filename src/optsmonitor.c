@@ -0,0 +1,142 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+
+#include "defns.h"
+
+#include "optsfile.h"
+#include "optsmonitor.h"
+
+#define OPTS_MONITOR_DELAY 250
+
+/* Shortcuts aren't watched here, because shortcuts_edit() already watches
+ * the file it's editing.
+ */
+static const char *opts_monitor_families[] = {
+    "Profiles", "Colours"
+};
+
+static OptsMonitorHandler opts_monitor_handler = NULL;
+
+/* Keys are "family/name", values unused */
+static GHashTable *opts_monitor_pending = NULL;
+
+static guint opts_monitor_tag = 0;
+
+static gboolean opts_monitor_dispatch(gpointer data)
+{
+    GHashTable *pending = opts_monitor_pending;
+    GHashTableIter iter;
+    gpointer key;
+    (void) data;
+
+    opts_monitor_tag = 0;
+    /* The handler might cause more files to be written */
+    opts_monitor_pending = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, NULL);
+    g_hash_table_iter_init(&iter, pending);
+    while (g_hash_table_iter_next(&iter, &key, NULL))
+    {
+        char **family_name = g_strsplit(key, "/", 2);
+
+        opts_monitor_handler(family_name[0], family_name[1]);
+        g_strfreev(family_name);
+    }
+    g_hash_table_destroy(pending);
+    return G_SOURCE_REMOVE;
+}
+
+static void opts_monitor_changed(GFileMonitor *monitor,
+        GFile *file, GFile *other_file, GFileMonitorEvent event_type,
+        gpointer family)
+{
+    char *name;
+    (void) monitor;
+    (void) other_file;
+
+    switch (event_type)
+    {
+        case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+        case G_FILE_MONITOR_EVENT_CREATED:
+        case G_FILE_MONITOR_EVENT_DELETED:
+            break;
+        default:
+            return;
+    }
+    name = g_file_get_basename(file);
+    /* Editors' temporary and backup files */
+    if (name[0] != '.' && !g_str_has_suffix(name, "~"))
+    {
+        g_hash_table_add(opts_monitor_pending,
+                g_strdup_printf("%s/%s", (const char *) family, name));
+        if (opts_monitor_tag)
+            g_source_remove(opts_monitor_tag);
+        opts_monitor_tag = g_timeout_add(OPTS_MONITOR_DELAY,
+                opts_monitor_dispatch, NULL);
+    }
+    g_free(name);
+}
+
+void opts_monitor_start(OptsMonitorHandler handler)
+{
+    const char * const *pathv = options_file_get_pathv();
+    int n;
+
+    g_return_if_fail(!opts_monitor_handler);
+    opts_monitor_handler = handler;
+    opts_monitor_pending = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, NULL);
+    for (n = 0; pathv && pathv[n]; ++n)
+    {
+        guint f;
+
+        for (f = 0; f < G_N_ELEMENTS(opts_monitor_families); ++f)
+        {
+            char *dirname = g_build_filename(pathv[n],
+                    opts_monitor_families[f], NULL);
+            GFile *dir = g_file_new_for_path(dirname);
+            GError *error = NULL;
+            /* The monitors last for the lifetime of the process. Directories
+             * that don't exist yet are still watched, so a user's first
+             * profile is picked up.
+             */
+            GFileMonitor *monitor = g_file_monitor_directory(dir,
+                    G_FILE_MONITOR_NONE, NULL, &error);
+
+            if (monitor)
+            {
+                g_signal_connect(monitor, "changed",
+                        G_CALLBACK(opts_monitor_changed),
+                        (gpointer) opts_monitor_families[f]);
+            }
+            else
+            {
+                g_debug("Unable to monitor '%s': %s", dirname,
+                        error ? error->message : "unknown reason");
+            }
+            if (error)
+                g_error_free(error);
+            g_object_unref(dir);
+            g_free(dirname);
+        }
+    }
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
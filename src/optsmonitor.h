@@ -0,0 +1,43 @@
+#ifndef OPTSMONITOR_H
+#define OPTSMONITOR_H
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+/* Watches the directories profiles and colour schemes are loaded from, so
+ * files edited by other programs are picked up.
+ */
+
+#ifndef DEFNS_H
+#include "defns.h"
+#endif
+
+/* family is "Profiles" or "Colours" */
+typedef void (*OptsMonitorHandler)(const char *family, const char *name);
+
+/* Starts monitoring each family's subdirectory in every element of the
+ * options path. handler is called once for each file that's been changed,
+ * created or deleted, after a short delay so that an editor's burst of
+ * writes and renames only counts as one change.
+ */
+void opts_monitor_start(OptsMonitorHandler handler);
+
+#endif /* OPTSMONITOR_H */
+
+/* vi:set sw=4 ts=4 et cindent cino= */
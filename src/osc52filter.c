@@ -27,6 +27,7 @@
 
 #include "glib.h"
 #include "intptrmap.h"
+#include "ngramindex.h"
 #include "roxterm.h"
 #include "vte/vte.h"
 #include "osc52filter.h"
@@ -84,6 +85,11 @@ static inline void osc52filter_free(Osc52Filter *oflt)
 
 typedef struct {
     IntPointerMap fd_map;
+    IntPointerMap log_map;
+    IntPointerMap index_map;
+    IntPointerMap paste_map;
+    IntPointerMap trigger_map;
+    IntPointerMap latency_map;
 } Osc52Global;
 
 static Osc52Global osc52filter_global;
@@ -94,6 +100,11 @@ static Osc52Global *
 osc52filter_global_init(Osc52Global *og)
 {
     int_pointer_map_init(&og->fd_map);
+    int_pointer_map_init(&og->log_map);
+    int_pointer_map_init(&og->index_map);
+    int_pointer_map_init(&og->paste_map);
+    int_pointer_map_init(&og->trigger_map);
+    int_pointer_map_init(&og->latency_map);
     return og;
 }
 
@@ -116,6 +127,12 @@ Osc52Filter *osc52filter_create(ROXTermData *roxterm, size_t buflen)
         g_debug("Pty not available yet for roxterm %p", roxterm);
         return NULL;
     }
+    return osc52filter_create_for_fd(roxterm, fd, buflen);
+}
+
+Osc52Filter *osc52filter_create_for_fd(ROXTermData *roxterm, int fd,
+                                       size_t buflen)
+{
     osc52filter_ensure_global_init();
     Osc52Filter *oflt = g_new0(Osc52Filter, 1);
     oflt->roxterm = roxterm;
@@ -126,6 +143,15 @@ Osc52Filter *osc52filter_create(ROXTermData *roxterm, size_t buflen)
     return oflt;
 }
 
+Osc52Filter *osc52filter_new(ROXTermData *roxterm, size_t buflen)
+{
+    Osc52Filter *oflt = g_new0(Osc52Filter, 1);
+    oflt->roxterm = roxterm;
+    oflt->pts_fd = -1;
+    oflt->max_buflen = buflen;
+    return oflt;
+}
+
 static void osc52filter_cancel_copy(Osc52Filter *oflt)
 {
     g_debug("osc52: cancelling");
@@ -148,9 +174,60 @@ void osc52filter_set_buffer_size(Osc52Filter *oflt, size_t buflen)
     }
 }
 
+size_t osc52filter_get_capture_size(Osc52Filter *oflt)
+{
+    return oflt->data_len;
+}
+
+void osc52filter_set_output_log(int fd, OutputLog *olog)
+{
+    osc52filter_ensure_global_init();
+    if (olog)
+        int_pointer_map_insert(&osc52filter_global.log_map, fd, olog);
+    else
+        int_pointer_map_remove(&osc52filter_global.log_map, fd);
+}
+
+void osc52filter_set_ngram_index(int fd, NgramIndex *ni)
+{
+    osc52filter_ensure_global_init();
+    if (ni)
+        int_pointer_map_insert(&osc52filter_global.index_map, fd, ni);
+    else
+        int_pointer_map_remove(&osc52filter_global.index_map, fd);
+}
+
+void osc52filter_set_paste_tracker(int fd, PasteTracker *tracker)
+{
+    osc52filter_ensure_global_init();
+    if (tracker)
+        int_pointer_map_insert(&osc52filter_global.paste_map, fd, tracker);
+    else
+        int_pointer_map_remove(&osc52filter_global.paste_map, fd);
+}
+
+void osc52filter_set_trigger_matcher(int fd, TriggerMatcher *tm)
+{
+    osc52filter_ensure_global_init();
+    if (tm)
+        int_pointer_map_insert(&osc52filter_global.trigger_map, fd, tm);
+    else
+        int_pointer_map_remove(&osc52filter_global.trigger_map, fd);
+}
+
+void osc52filter_set_latency_stats(int fd, LatencyStats *ls)
+{
+    osc52filter_ensure_global_init();
+    if (ls)
+        int_pointer_map_insert(&osc52filter_global.latency_map, fd, ls);
+    else
+        int_pointer_map_remove(&osc52filter_global.latency_map, fd);
+}
+
 void osc52filter_remove(Osc52Filter *oflt)
 {
-    int_pointer_map_remove(&osc52filter_global.fd_map, oflt->pts_fd);
+    if (oflt->pts_fd >= 0)
+        int_pointer_map_remove(&osc52filter_global.fd_map, oflt->pts_fd);
     osc52filter_free(oflt);
 }
 
@@ -320,24 +397,10 @@ static void osc52filter_capture_buffer(Osc52Filter *oflt)
     }
 }
 
-// This overrides the system read. When it's called on an fd in the map of
-// pts fds it pushes a chunk containing a copy of the data read.
-ssize_t read(int fd, void *buf, size_t nbytes)
+void osc52filter_scan(Osc52Filter *oflt, const guint8 *buf, size_t len)
 {
-    static ssize_t (*real_read)(int, void *, size_t) = NULL;
-    if (!real_read) {
-        real_read = dlsym(RTLD_NEXT, "read");
-    }
-    ssize_t n = real_read(fd, buf, nbytes);
-    if (!osc52filter_global_initialised)
-        return n;
-    if (n <= 0 || !int_pointer_map_contains(&osc52filter_global.fd_map, fd))
-        return n;
-    Osc52Filter *oflt =
-        int_pointer_map_lookup(&osc52filter_global.fd_map, fd);
-    g_return_val_if_fail(oflt != NULL, n);
     oflt->buf = buf;
-    oflt->buflen = n;
+    oflt->buflen = len;
     while (oflt->buflen)
     {
         guint8 byte = osc52filter_get_next_byte(oflt);
@@ -423,6 +486,65 @@ ssize_t read(int fd, void *buf, size_t nbytes)
                 break;
         }
     }
+}
+
+static ssize_t (*osc52filter_real_read)(int, void *, size_t) = NULL;
+
+static inline void osc52filter_ensure_real_read(void)
+{
+    if (!osc52filter_real_read)
+        osc52filter_real_read = dlsym(RTLD_NEXT, "read");
+}
+
+ssize_t osc52filter_unfiltered_read(int fd, void *buf, size_t nbytes)
+{
+    osc52filter_ensure_real_read();
+    return osc52filter_real_read(fd, buf, nbytes);
+}
+
+// This overrides the system read. When it's called on an fd in the map of
+// pts fds it pushes a chunk containing a copy of the data read. It also
+// passes a copy to the fd's output log, search index, paste tracker and
+// triggers, if any, and notes the time for its latency stats.
+ssize_t read(int fd, void *buf, size_t nbytes)
+{
+    osc52filter_ensure_real_read();
+    ssize_t n = osc52filter_real_read(fd, buf, nbytes);
+    if (!osc52filter_global_initialised)
+        return n;
+    if (n <= 0)
+        return n;
+    if (int_pointer_map_contains(&osc52filter_global.latency_map, fd))
+    {
+        latency_stats_note_read(int_pointer_map_lookup(
+                    &osc52filter_global.latency_map, fd), n);
+    }
+    if (int_pointer_map_contains(&osc52filter_global.log_map, fd))
+    {
+        output_log_write(int_pointer_map_lookup(&osc52filter_global.log_map,
+                    fd), buf, n);
+    }
+    if (int_pointer_map_contains(&osc52filter_global.index_map, fd))
+    {
+        ngram_index_feed(int_pointer_map_lookup(&osc52filter_global.index_map,
+                    fd), buf, n);
+    }
+    if (int_pointer_map_contains(&osc52filter_global.paste_map, fd))
+    {
+        paste_tracker_feed(int_pointer_map_lookup(
+                    &osc52filter_global.paste_map, fd), buf, n);
+    }
+    if (int_pointer_map_contains(&osc52filter_global.trigger_map, fd))
+    {
+        trigger_matcher_feed(int_pointer_map_lookup(
+                    &osc52filter_global.trigger_map, fd), buf, n);
+    }
+    if (!int_pointer_map_contains(&osc52filter_global.fd_map, fd))
+        return n;
+    Osc52Filter *oflt =
+        int_pointer_map_lookup(&osc52filter_global.fd_map, fd);
+    g_return_val_if_fail(oflt != NULL, n);
+    osc52filter_scan(oflt, buf, n);
     return n;
 }
 
@@ -19,16 +19,66 @@
     Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
+#include <sys/types.h>
+
+#include "latency.h"
+#include "ngramindex.h"
+#include "outputlog.h"
+#include "paste.h"
 #include "roxterm.h"
+#include "trigger.h"
 
 typedef struct Osc52Filter Osc52Filter;
 
 Osc52Filter *osc52filter_create(ROXTermData *roxterm, size_t buflen);
 
+/* Filters reads from an arbitrary fd instead of roxterm's pty, for
+ * roxterm-bench.
+ */
+Osc52Filter *osc52filter_create_for_fd(ROXTermData *roxterm, int fd,
+                                       size_t buflen);
+
+/* Creates a filter which isn't attached to any fd; data must be passed to it
+ * with osc52filter_scan instead. This is used by PtyReader.
+ */
+Osc52Filter *osc52filter_new(ROXTermData *roxterm, size_t buflen);
+
+/* Processes a chunk of the terminal's output. This may be called from any
+ * thread, but only one at a time for each filter; a completed capture is
+ * handed to the main thread.
+ */
+void osc52filter_scan(Osc52Filter *oflt, const guint8 *buf, size_t len);
+
+/* Calls the real read(), bypassing the wrapper */
+ssize_t osc52filter_unfiltered_read(int fd, void *buf, size_t nbytes);
+
 void osc52filter_remove(Osc52Filter *oflt);
 
 void osc52filter_set_buffer_size(Osc52Filter *oflt, size_t buflen);
 
+/* The number of bytes of an OSC 52 payload captured so far. When a PtyReader
+ * is in use this is read without synchronisation, so it's only suitable for
+ * statistics.
+ */
+size_t osc52filter_get_capture_size(Osc52Filter *oflt);
+
+/* The read() wrapper also copies everything read from a pty to its log if it
+ * has one. olog may be NULL to stop logging.
+ */
+void osc52filter_set_output_log(int fd, OutputLog *olog);
+
+/* Likewise for a terminal's search index */
+void osc52filter_set_ngram_index(int fd, NgramIndex *ni);
+
+/* And for watching whether it's in bracketed paste mode */
+void osc52filter_set_paste_tracker(int fd, PasteTracker *tracker);
+
+/* And for matching triggers */
+void osc52filter_set_trigger_matcher(int fd, TriggerMatcher *tm);
+
+/* And for timing reads */
+void osc52filter_set_latency_stats(int fd, LatencyStats *ls);
+
 #endif /* OSC52FILTER_H */
 
 /* vi:set sw=4 ts=4 et cindent cino= */
@@ -0,0 +1,554 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "defns.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include "outputlog.h"
+
+#define OUTPUT_LOG_MIN_RING (64 * 1024)
+#define OUTPUT_LOG_MAX_RING (1u << 30)
+
+/* In case the writer misses a wakeup it polls this often while it has any
+ * logs.
+ */
+#define OUTPUT_LOG_POLL_USEC (100 * 1000)
+
+/* Space reserved in front of the scratch buffer for an incomplete UTF-8
+ * sequence left over from the previous chunk.
+ */
+#define OUTPUT_LOG_CARRY_MAX 4
+
+typedef struct {
+    gint64 time;            /* g_get_monotonic_time() when read */
+    guint32 len;
+} OutputLogChunk;
+
+struct OutputLog {
+    char *filename;
+    OutputLogFormat format;
+    gboolean compress;
+    gsize max_size;
+    int columns, rows;
+
+    /* head is only advanced by the producer (the thread calling read()), tail
+     * only by the writer. Both run freely and are masked to index the ring.
+     */
+    guint8 *ring;
+    guint ring_mask;
+    guint head;
+    guint tail;
+    gint dropped_chunks;
+    guint64 dropped_bytes;  /* Only written by the producer */
+    gint unreported_bytes;  /* Dropped since the writer's last marker */
+    gint closing;
+
+    /* The rest is only used by the writer thread after opening */
+    GOutputStream *stream;
+    gsize file_size;
+    gint64 base_time;
+    gint reported_drops;
+    guint8 *scratch;
+    gsize scratch_size;
+    guint8 carry[OUTPUT_LOG_CARRY_MAX];
+    gsize carry_len;
+    GString *line;
+};
+
+static struct {
+    GMutex lock;
+    GCond cond;
+    GThread *thread;
+    GList *logs;
+    gint wake;
+    gint parked;    /* Set while the writer is waiting on cond */
+} output_log_writer;
+
+/* The writer sets parked before it checks wake, while holding the lock, so
+ * either it sees wake and doesn't wait, or this sees parked and signals cond
+ * after the writer has started waiting. The lock is only taken when the
+ * writer is idle, never while it's busy draining.
+ */
+static void output_log_wake_writer(void)
+{
+    g_atomic_int_set(&output_log_writer.wake, TRUE);
+    if (g_atomic_int_get(&output_log_writer.parked))
+    {
+        g_mutex_lock(&output_log_writer.lock);
+        g_cond_broadcast(&output_log_writer.cond);
+        g_mutex_unlock(&output_log_writer.lock);
+    }
+}
+
+static void output_log_ring_put(OutputLog *olog, guint pos,
+        const void *data, gsize len)
+{
+    guint offset = pos & olog->ring_mask;
+    gsize first = MIN(len, olog->ring_mask + 1 - offset);
+
+    memcpy(olog->ring + offset, data, first);
+    if (first < len)
+        memcpy(olog->ring, (const guint8 *) data + first, len - first);
+}
+
+static void output_log_ring_get(OutputLog *olog, guint pos,
+        void *data, gsize len)
+{
+    guint offset = pos & olog->ring_mask;
+    gsize first = MIN(len, olog->ring_mask + 1 - offset);
+
+    memcpy(data, olog->ring + offset, first);
+    if (first < len)
+        memcpy((guint8 *) data + first, olog->ring, len - first);
+}
+
+void output_log_write(OutputLog *olog, const guint8 *buf, gsize len)
+{
+    guint head = olog->head;
+    guint tail = g_atomic_int_get(&olog->tail);
+    gsize space = (gsize) olog->ring_mask + 1 - (head - tail);
+    OutputLogChunk chunk;
+
+    if (!len)
+        return;
+    if (len + sizeof(chunk) > space)
+    {
+        olog->dropped_bytes += len;
+        g_atomic_int_add(&olog->unreported_bytes,
+                (gint) MIN(len, G_MAXINT / 2));
+        g_atomic_int_inc(&olog->dropped_chunks);
+        return;
+    }
+    chunk.time = g_get_monotonic_time();
+    chunk.len = (guint32) len;
+    output_log_ring_put(olog, head, &chunk, sizeof(chunk));
+    output_log_ring_put(olog, head + sizeof(chunk), buf, len);
+    g_atomic_int_set(&olog->head, head + (guint) (sizeof(chunk) + len));
+    /* This can't be skipped when the ring looked busy, because the writer
+     * may have emptied it and be about to park without having seen this.
+     * It's cheap unless the writer is parked.
+     */
+    output_log_wake_writer();
+}
+
+/* Writer thread functions */
+
+static gboolean output_log_put(OutputLog *olog, const void *data, gsize len);
+
+static GOutputStream *output_log_open_stream(OutputLog *olog, GError **error)
+{
+    GFile *gfile = g_file_new_for_path(olog->filename);
+    GOutputStream *stream = (GOutputStream *) g_file_replace(gfile,
+            NULL, FALSE, G_FILE_CREATE_PRIVATE, NULL, error);
+
+    g_object_unref(gfile);
+    if (stream && olog->compress)
+    {
+        GZlibCompressor *zlib = g_zlib_compressor_new(
+                G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1);
+        GOutputStream *zstream = g_converter_output_stream_new(stream,
+                G_CONVERTER(zlib));
+
+        g_object_unref(zlib);
+        g_object_unref(stream);
+        stream = zstream;
+    }
+    olog->stream = stream;
+    olog->file_size = 0;
+    olog->base_time = g_get_monotonic_time();
+    if (stream && olog->format == OUTPUT_LOG_ASCIICAST)
+    {
+        char *header = g_strdup_printf("{\"version\": 2, \"width\": %d, "
+                "\"height\": %d, \"timestamp\": %" G_GINT64_FORMAT "}\n",
+                olog->columns, olog->rows,
+                g_get_real_time() / G_USEC_PER_SEC);
+
+        output_log_put(olog, header, strlen(header));
+        g_free(header);
+    }
+    return stream;
+}
+
+static void output_log_close_stream(OutputLog *olog)
+{
+    GError *error = NULL;
+
+    if (!olog->stream)
+        return;
+    if (!g_output_stream_close(olog->stream, NULL, &error))
+    {
+        g_warning(_("Error closing log '%s': %s"),
+                olog->filename, error->message);
+        g_error_free(error);
+    }
+    g_object_unref(olog->stream);
+    olog->stream = NULL;
+}
+
+static void output_log_rotate(OutputLog *olog)
+{
+    char *old_name = g_strdup_printf("%s.1", olog->filename);
+    GError *error = NULL;
+
+    output_log_close_stream(olog);
+    if (g_rename(olog->filename, old_name))
+    {
+        g_warning(_("Unable to rotate log '%s': %s"),
+                olog->filename, g_strerror(errno));
+    }
+    g_free(old_name);
+    if (!output_log_open_stream(olog, &error))
+    {
+        g_warning(_("Unable to reopen log '%s': %s"),
+                olog->filename, error->message);
+        g_error_free(error);
+    }
+}
+
+/* Returns FALSE and closes the stream if there's an error */
+static gboolean output_log_put(OutputLog *olog, const void *data, gsize len)
+{
+    GError *error = NULL;
+
+    if (!olog->stream)
+        return FALSE;
+    if (!g_output_stream_write_all(olog->stream, data, len, NULL,
+            NULL, &error))
+    {
+        g_warning(_("Error writing log '%s': %s"),
+                olog->filename, error->message);
+        g_error_free(error);
+        output_log_close_stream(olog);
+        return FALSE;
+    }
+    olog->file_size += len;
+    return TRUE;
+}
+
+gsize output_log_append_json(GString *s, const guint8 *data, gsize len)
+{
+    const guint8 *end = data + len;
+
+    while (data < end)
+    {
+        guint8 c = *data;
+
+        if (c < 0x80)
+        {
+            switch (c)
+            {
+                case '"':
+                    g_string_append(s, "\\\"");
+                    break;
+                case '\\':
+                    g_string_append(s, "\\\\");
+                    break;
+                case '\n':
+                    g_string_append(s, "\\n");
+                    break;
+                case '\r':
+                    g_string_append(s, "\\r");
+                    break;
+                case '\t':
+                    g_string_append(s, "\\t");
+                    break;
+                default:
+                    if (c < 0x20 || c == 0x7f)
+                        g_string_append_printf(s, "\\u%04x", c);
+                    else
+                        g_string_append_c(s, (char) c);
+                    break;
+            }
+            ++data;
+        }
+        else
+        {
+            gunichar u = g_utf8_get_char_validated((const char *) data,
+                    end - data);
+
+            if (u == (gunichar) -2 && end - data < OUTPUT_LOG_CARRY_MAX)
+                return end - data;
+            if (u == (gunichar) -1 || u == (gunichar) -2)
+            {
+                g_string_append(s, "\\ufffd");
+                ++data;
+            }
+            else
+            {
+                const guint8 *next = (const guint8 *)
+                        g_utf8_next_char((const char *) data);
+
+                g_string_append_len(s, (const char *) data, next - data);
+                data = next;
+            }
+        }
+    }
+    return 0;
+}
+
+void output_log_append_json_string(GString *s, const char *str)
+{
+    gsize len = str ? strlen(str) : 0;
+
+    g_string_append_c(s, '"');
+    if (output_log_append_json(s, (const guint8 *) str, len))
+        g_string_append(s, "\\ufffd");
+    g_string_append_c(s, '"');
+}
+
+static void output_log_emit_asciicast(OutputLog *olog, gint64 time,
+        const char *type, guint8 *data, gsize len)
+{
+    char secs[G_ASCII_DTOSTR_BUF_SIZE];
+    gint64 elapsed = MAX(time - olog->base_time, 0);
+
+    g_ascii_formatd(secs, sizeof(secs), "%.6f",
+            (double) elapsed / G_USEC_PER_SEC);
+    g_string_printf(olog->line, "[%s, \"%s\", \"", secs, type);
+    /* data has room for the carry in front of it */
+    if (olog->carry_len)
+    {
+        data -= olog->carry_len;
+        len += olog->carry_len;
+        memcpy(data, olog->carry, olog->carry_len);
+    }
+    olog->carry_len = output_log_append_json(olog->line, data, len);
+    memcpy(olog->carry, data + len - olog->carry_len, olog->carry_len);
+    g_string_append(olog->line, "\"]\n");
+    output_log_put(olog, olog->line->str, olog->line->len);
+}
+
+static void output_log_report_drops(OutputLog *olog, gint64 time)
+{
+    gint bytes = g_atomic_int_get(&olog->unreported_bytes);
+    char *marker;
+    gsize marker_len;
+
+    g_atomic_int_add(&olog->unreported_bytes, -bytes);
+    marker = g_strdup_printf("roxterm: %d bytes of output dropped", bytes);
+    marker_len = strlen(marker);
+    if (!olog->reported_drops)
+    {
+        g_warning(_("Log '%s' can't keep up with output; "
+                "some output is being dropped"), olog->filename);
+    }
+    if (olog->format == OUTPUT_LOG_ASCIICAST)
+    {
+        /* The carry belongs to the output stream, not the marker */
+        gsize carry_len = olog->carry_len;
+        guint8 *buf = g_malloc(OUTPUT_LOG_CARRY_MAX + marker_len);
+
+        olog->carry_len = 0;
+        memcpy(buf + OUTPUT_LOG_CARRY_MAX, marker, marker_len);
+        output_log_emit_asciicast(olog, time, "m",
+                buf + OUTPUT_LOG_CARRY_MAX, marker_len);
+        olog->carry_len = carry_len;
+        g_free(buf);
+    }
+    else
+    {
+        char *s = g_strdup_printf("\r\n[%s]\r\n", marker);
+
+        output_log_put(olog, s, strlen(s));
+        g_free(s);
+    }
+    g_free(marker);
+}
+
+static void output_log_drain(OutputLog *olog)
+{
+    guint tail = olog->tail;
+    guint head = g_atomic_int_get(&olog->head);
+    gint drops = g_atomic_int_get(&olog->dropped_chunks);
+
+    if (drops != olog->reported_drops)
+    {
+        output_log_report_drops(olog, g_get_monotonic_time());
+        olog->reported_drops = drops;
+    }
+    while (tail != head)
+    {
+        OutputLogChunk chunk;
+        guint8 *data;
+
+        output_log_ring_get(olog, tail, &chunk, sizeof(chunk));
+        if (chunk.len + OUTPUT_LOG_CARRY_MAX > olog->scratch_size)
+        {
+            olog->scratch_size = chunk.len + OUTPUT_LOG_CARRY_MAX;
+            olog->scratch = g_realloc(olog->scratch, olog->scratch_size);
+        }
+        data = olog->scratch + OUTPUT_LOG_CARRY_MAX;
+        output_log_ring_get(olog, tail + sizeof(chunk), data, chunk.len);
+        /* Free the space for the producer before waiting for the disk */
+        tail += sizeof(chunk) + chunk.len;
+        g_atomic_int_set(&olog->tail, tail);
+
+        if (olog->format == OUTPUT_LOG_ASCIICAST)
+            output_log_emit_asciicast(olog, chunk.time, "o", data, chunk.len);
+        else
+            output_log_put(olog, data, chunk.len);
+        if (olog->stream && olog->max_size &&
+                olog->file_size >= olog->max_size)
+        {
+            output_log_rotate(olog);
+        }
+        if (tail == head)
+            head = g_atomic_int_get(&olog->head);
+    }
+}
+
+static void output_log_free(OutputLog *olog)
+{
+    output_log_close_stream(olog);
+    g_free(olog->ring);
+    g_free(olog->scratch);
+    g_string_free(olog->line, TRUE);
+    g_free(olog->filename);
+    g_free(olog);
+}
+
+static gpointer output_log_writer_thread(gpointer data)
+{
+    (void) data;
+    for (;;)
+    {
+        GList *logs, *link;
+
+        g_mutex_lock(&output_log_writer.lock);
+        g_atomic_int_set(&output_log_writer.parked, TRUE);
+        if (!g_atomic_int_get(&output_log_writer.wake))
+        {
+            if (output_log_writer.logs)
+            {
+                g_cond_wait_until(&output_log_writer.cond,
+                        &output_log_writer.lock,
+                        g_get_monotonic_time() + OUTPUT_LOG_POLL_USEC);
+            }
+            else
+            {
+                g_cond_wait(&output_log_writer.cond,
+                        &output_log_writer.lock);
+            }
+        }
+        g_atomic_int_set(&output_log_writer.parked, FALSE);
+        g_atomic_int_set(&output_log_writer.wake, FALSE);
+        logs = g_list_copy(output_log_writer.logs);
+        g_mutex_unlock(&output_log_writer.lock);
+
+        for (link = logs; link; link = g_list_next(link))
+        {
+            OutputLog *olog = link->data;
+            /* Read this before draining so nothing written before closing is
+             * missed.
+             */
+            gboolean closing = g_atomic_int_get(&olog->closing);
+
+            output_log_drain(olog);
+            if (closing)
+            {
+                g_mutex_lock(&output_log_writer.lock);
+                output_log_writer.logs = g_list_remove(output_log_writer.logs,
+                        olog);
+                g_cond_broadcast(&output_log_writer.cond);
+                g_mutex_unlock(&output_log_writer.lock);
+                output_log_free(olog);
+            }
+        }
+        g_list_free(logs);
+    }
+    return NULL;
+}
+
+OutputLog *output_log_open(const char *filename, OutputLogFormat format,
+        gboolean compress, gsize ring_size, gsize max_size,
+        int columns, int rows, GError **error)
+{
+    OutputLog *olog = g_new0(OutputLog, 1);
+    gsize size = OUTPUT_LOG_MIN_RING;
+
+    while (size < ring_size && size < OUTPUT_LOG_MAX_RING)
+        size <<= 1;
+    olog->filename = compress ? g_strdup_printf("%s.gz", filename) :
+            g_strdup(filename);
+    olog->format = format;
+    olog->compress = compress;
+    olog->max_size = max_size;
+    olog->columns = columns;
+    olog->rows = rows;
+    olog->ring = g_malloc(size);
+    olog->ring_mask = (guint) (size - 1);
+    olog->line = g_string_new(NULL);
+    if (!output_log_open_stream(olog, error))
+    {
+        output_log_free(olog);
+        return NULL;
+    }
+
+    g_mutex_lock(&output_log_writer.lock);
+    if (!output_log_writer.thread)
+    {
+        output_log_writer.thread = g_thread_new("roxterm-log",
+                output_log_writer_thread, NULL);
+    }
+    output_log_writer.logs = g_list_prepend(output_log_writer.logs, olog);
+    g_mutex_unlock(&output_log_writer.lock);
+    return olog;
+}
+
+void output_log_close(OutputLog *olog)
+{
+    g_atomic_int_set(&olog->closing, TRUE);
+    output_log_wake_writer();
+}
+
+void output_log_shutdown(void)
+{
+    GList *link;
+
+    g_mutex_lock(&output_log_writer.lock);
+    for (link = output_log_writer.logs; link; link = g_list_next(link))
+    {
+        OutputLog *olog = link->data;
+
+        g_atomic_int_set(&olog->closing, TRUE);
+    }
+    while (output_log_writer.logs)
+    {
+        g_atomic_int_set(&output_log_writer.wake, TRUE);
+        g_cond_broadcast(&output_log_writer.cond);
+        g_cond_wait(&output_log_writer.cond, &output_log_writer.lock);
+    }
+    g_mutex_unlock(&output_log_writer.lock);
+}
+
+guint64 output_log_get_dropped_bytes(OutputLog *olog)
+{
+    return olog->dropped_bytes;
+}
+
+const char *output_log_get_filename(OutputLog *olog)
+{
+    return olog->filename;
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
@@ -0,0 +1,83 @@
+#ifndef OUTPUTLOG_H
+#define OUTPUTLOG_H
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* Logs a terminal's output to a file. Chunks read from the pty are copied
+ * into a single-producer/single-consumer ring buffer, which is drained by
+ * a writer thread shared by all logs, so the GTK thread never waits for the
+ * disk. If the writer can't keep up, chunks which don't fit in the ring are
+ * dropped instead of blocking, and a marker saying how many bytes were lost
+ * is written into the log where they would have been.
+ */
+
+#ifndef DEFNS_H
+#include "defns.h"
+#endif
+
+typedef enum {
+    OUTPUT_LOG_OFF,
+    OUTPUT_LOG_RAW,         /* Bytes exactly as read from the pty */
+    OUTPUT_LOG_ASCIICAST    /* asciicast v2 with timestamps */
+} OutputLogFormat;
+
+typedef struct OutputLog OutputLog;
+
+/* filename is the base name of the log; ".gz" is appended if compressed.
+ * ring_size is rounded up to a power of 2. max_size is the size (before
+ * compression) at which the file is rotated, 0 for no limit; the previous
+ * file is kept with ".1" appended to its name. columns and rows are only
+ * used for the asciicast header.
+ */
+OutputLog *output_log_open(const char *filename, OutputLogFormat format,
+        gboolean compress, gsize ring_size, gsize max_size,
+        int columns, int rows, GError **error);
+
+/* Copies a chunk into the ring; never blocks. */
+void output_log_write(OutputLog *olog, const guint8 *buf, gsize len);
+
+/* The writer thread flushes any remaining data then frees olog, so it must
+ * not be used after this.
+ */
+void output_log_close(OutputLog *olog);
+
+/* Blocks until all logs which are open or being closed have been flushed and
+ * closed, for use at exit.
+ */
+void output_log_shutdown(void);
+
+/* Number of bytes dropped because the ring was full */
+guint64 output_log_get_dropped_bytes(OutputLog *olog);
+
+const char *output_log_get_filename(OutputLog *olog);
+
+/* Appends data as the contents of a JSON string, replacing invalid UTF-8
+ * with U+FFFD. Returns the length of an incomplete UTF-8 sequence at the end
+ * of data, which isn't consumed.
+ */
+gsize output_log_append_json(GString *s, const guint8 *data, gsize len);
+
+/* Appends a complete nul-terminated string as a quoted JSON string; str may
+ * be NULL, giving "".
+ */
+void output_log_append_json_string(GString *s, const char *str);
+
+#endif /* OUTPUTLOG_H */
+
+/* vi:set sw=4 ts=4 et cindent cino= */
@@ -0,0 +1,335 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "defns.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib-unix.h>
+
+#include "paste.h"
+
+/* Amount of text converted at a time */
+#define PASTE_SLICE 16384
+
+/* Most that's written each time the pty is ready, so the main loop gets a
+ * look in even if the child reads very quickly.
+ */
+#define PASTE_MAX_PER_WAKEUP (256 * 1024)
+
+#define PASTE_BRACKET_START "\033[200~"
+#define PASTE_BRACKET_END "\033[201~"
+
+/* Bracketed paste mode's DEC private mode number */
+#define PASTE_DECSET_BRACKETED 2004
+
+typedef enum {
+    PASTE_TRACK_GROUND,
+    PASTE_TRACK_ESC,
+    PASTE_TRACK_CSI,
+    PASTE_TRACK_PRIVATE
+} PasteTrackState;
+
+struct PasteTracker {
+    PasteTrackState state;
+    guint param;
+    gboolean set_bracketed;     /* Whether the params so far include 2004 */
+    gint bracketed;             /* Read from the main thread */
+};
+
+struct PasteStream {
+    int fd;
+    char *text;
+    gsize len;
+    gsize pos;                  /* Amount of text converted so far */
+    gsize written;              /* Amount of output written so far */
+    GByteArray *out;            /* Converted, but not written yet */
+    gboolean bracketed;
+    gboolean opened;
+    gboolean closed;
+    gboolean last_cr;
+    guint tag;
+    PasteStreamProgress progress;
+    gpointer data;
+};
+
+PasteTracker *paste_tracker_new(void)
+{
+    return g_new0(PasteTracker, 1);
+}
+
+void paste_tracker_free(PasteTracker *tracker)
+{
+    g_free(tracker);
+}
+
+void paste_tracker_feed(PasteTracker *tracker, const guint8 *buf, gsize len)
+{
+    PasteTrackState state = tracker->state;
+    gsize n;
+
+    for (n = 0; n < len; ++n)
+    {
+        guint8 c = buf[n];
+
+        if (c == 0x1b)
+        {
+            state = PASTE_TRACK_ESC;
+            continue;
+        }
+        switch (state)
+        {
+            case PASTE_TRACK_GROUND:
+                break;
+            case PASTE_TRACK_ESC:
+                if (c == '[')
+                {
+                    state = PASTE_TRACK_CSI;
+                    continue;
+                }
+                /* RIS */
+                if (c == 'c')
+                    g_atomic_int_set(&tracker->bracketed, FALSE);
+                break;
+            case PASTE_TRACK_CSI:
+                if (c == '?')
+                {
+                    tracker->param = 0;
+                    tracker->set_bracketed = FALSE;
+                    state = PASTE_TRACK_PRIVATE;
+                    continue;
+                }
+                break;
+            case PASTE_TRACK_PRIVATE:
+                if (c >= '0' && c <= '9')
+                {
+                    tracker->param = MIN(tracker->param * 10 + (c - '0'),
+                            G_MAXUINT16);
+                    continue;
+                }
+                if (tracker->param == PASTE_DECSET_BRACKETED)
+                    tracker->set_bracketed = TRUE;
+                if (c == ';')
+                {
+                    tracker->param = 0;
+                    continue;
+                }
+                if ((c == 'h' || c == 'l') && tracker->set_bracketed)
+                    g_atomic_int_set(&tracker->bracketed, c == 'h');
+                break;
+        }
+        state = PASTE_TRACK_GROUND;
+    }
+    tracker->state = state;
+}
+
+void paste_tracker_reset(PasteTracker *tracker)
+{
+    g_atomic_int_set(&tracker->bracketed, FALSE);
+}
+
+gboolean paste_tracker_get_bracketed(PasteTracker *tracker)
+{
+    return g_atomic_int_get(&tracker->bracketed);
+}
+
+/* Converts the next slice of text, adding the brackets at the start and
+ * end if necessary.
+ */
+static void paste_stream_fill(PasteStream *ps)
+{
+    gsize end = MIN(ps->pos + PASTE_SLICE, ps->len);
+    gsize n;
+
+    /* Don't split a UTF-8 sequence in case the paste is cancelled. Invalid
+     * UTF-8 may not have a boundary for a while, but it's not worth worrying
+     * about that.
+     */
+    for (n = end; n < ps->len && n > ps->pos + PASTE_SLICE - 4; --n)
+    {
+        if ((ps->text[n] & 0xc0) != 0x80)
+        {
+            end = n;
+            break;
+        }
+    }
+
+    if (!ps->opened)
+    {
+        ps->opened = TRUE;
+        if (ps->bracketed)
+        {
+            g_byte_array_append(ps->out, (const guint8 *) PASTE_BRACKET_START,
+                    strlen(PASTE_BRACKET_START));
+        }
+    }
+    for (n = ps->pos; n < end; ++n)
+    {
+        guint8 c = ps->text[n];
+
+        if (c == '\n')
+        {
+            if (!ps->last_cr)
+                g_byte_array_append(ps->out, (const guint8 *) "\r", 1);
+        }
+        /* Control characters other than tab and line endings are dropped
+         * whether the paste is bracketed or not, as VTE does, because they
+         * could end a bracketed paste early or run commands in an
+         * application which doesn't support it. That includes C1 controls,
+         * which are 2 bytes in UTF-8.
+         */
+        else if ((c < 0x20 && c != '\t' && c != '\r') || c == 0x7f)
+        {
+            continue;
+        }
+        else if (c == 0xc2 && n + 1 < end &&
+                (guint8) ps->text[n + 1] >= 0x80 &&
+                (guint8) ps->text[n + 1] < 0xa0)
+        {
+            ++n;
+            continue;
+        }
+        else
+        {
+            g_byte_array_append(ps->out, &c, 1);
+        }
+        ps->last_cr = (c == '\r');
+    }
+    ps->pos = end;
+    if (ps->pos == ps->len && !ps->closed)
+    {
+        ps->closed = TRUE;
+        if (ps->bracketed)
+        {
+            g_byte_array_append(ps->out, (const guint8 *) PASTE_BRACKET_END,
+                    strlen(PASTE_BRACKET_END));
+        }
+    }
+}
+
+static gboolean paste_stream_write(int fd, GIOCondition condition,
+        gpointer data)
+{
+    PasteStream *ps = data;
+    gsize budget = PASTE_MAX_PER_WAKEUP;
+    (void) condition;
+
+    while (budget)
+    {
+        gssize n;
+
+        if (!ps->out->len)
+            paste_stream_fill(ps);
+        if (!ps->out->len)
+            break;
+        n = write(fd, ps->out->data, MIN(ps->out->len, budget));
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR)
+                break;
+            /* Probably because the child has exited */
+            g_debug("Paste abandoned: %s", g_strerror(errno));
+            ps->len = ps->pos;
+            ps->closed = TRUE;
+            g_byte_array_set_size(ps->out, 0);
+            break;
+        }
+        g_byte_array_remove_range(ps->out, 0, n);
+        ps->written += n;
+        budget -= n;
+    }
+    if (ps->closed && !ps->out->len)
+    {
+        ps->tag = 0;
+        ps->progress(ps, ps->len, ps->len, TRUE, ps->data);
+        return G_SOURCE_REMOVE;
+    }
+    ps->progress(ps, ps->pos, ps->len, FALSE, ps->data);
+    return G_SOURCE_CONTINUE;
+}
+
+PasteStream *paste_stream_new(int fd, const char *text, gsize len,
+        gboolean bracketed, PasteStreamProgress progress, gpointer data)
+{
+    PasteStream *ps = g_new0(PasteStream, 1);
+    int flags = fcntl(fd, F_GETFL);
+
+    /* VTE normally does this already */
+    if (flags != -1 && !(flags & O_NONBLOCK))
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    ps->fd = fd;
+    ps->text = g_malloc(len);
+    memcpy(ps->text, text, len);
+    ps->len = len;
+    ps->out = g_byte_array_sized_new(PASTE_SLICE +
+            strlen(PASTE_BRACKET_START) + strlen(PASTE_BRACKET_END));
+    ps->bracketed = bracketed;
+    ps->progress = progress;
+    ps->data = data;
+    ps->tag = g_unix_fd_add(fd, G_IO_OUT, paste_stream_write, ps);
+    return ps;
+}
+
+void paste_stream_cancel(PasteStream *ps)
+{
+    gsize start_len = ps->bracketed ? strlen(PASTE_BRACKET_START) : 0;
+    gsize keep = 0;
+
+    /* Once part of the closing bracket has been written the rest of it has
+     * to follow.
+     */
+    if (ps->closed && ps->bracketed &&
+            ps->out->len <= strlen(PASTE_BRACKET_END))
+    {
+        return;
+    }
+    ps->len = ps->pos;
+    if (!ps->written)
+    {
+        /* Nothing has been sent, not even the opening bracket */
+        g_byte_array_set_size(ps->out, 0);
+        ps->closed = TRUE;
+        return;
+    }
+    /* Finish off the opening bracket and any UTF-8 sequence which have been
+     * partly written, but drop everything else.
+     */
+    if (ps->written < start_len)
+        keep = start_len - ps->written;
+    while (keep < ps->out->len && (ps->out->data[keep] & 0xc0) == 0x80)
+        ++keep;
+    g_byte_array_set_size(ps->out, keep);
+    ps->closed = FALSE;
+    paste_stream_fill(ps);
+}
+
+void paste_stream_free(PasteStream *ps)
+{
+    if (ps->tag)
+        g_source_remove(ps->tag);
+    g_byte_array_unref(ps->out);
+    g_free(ps->text);
+    g_free(ps);
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
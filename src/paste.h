@@ -0,0 +1,79 @@
+#ifndef PASTE_H
+#define PASTE_H
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+/* Pastes which are too big to hand to VTE in one go, because it would hold up
+ * the main loop and flood the pty, are streamed to the pty in slices as the
+ * child reads them instead. Line endings are converted to CR and other
+ * control characters are dropped, as VTE does.
+ *
+ * To honour bracketed paste mode (DECSET 2004) the terminal's output has to
+ * be watched with a PasteTracker, because VTE doesn't say whether the mode is
+ * set.
+ */
+
+#ifndef DEFNS_H
+#include "defns.h"
+#endif
+
+typedef struct PasteTracker PasteTracker;
+
+typedef struct PasteStream PasteStream;
+
+PasteTracker *paste_tracker_new(void);
+
+void paste_tracker_free(PasteTracker *tracker);
+
+/* Watches a chunk of raw pty output for changes to bracketed paste mode. This
+ * may be called from any thread, but only one at a time for each tracker.
+ */
+void paste_tracker_feed(PasteTracker *tracker, const guint8 *buf, gsize len);
+
+/* For when the terminal is reset */
+void paste_tracker_reset(PasteTracker *tracker);
+
+gboolean paste_tracker_get_bracketed(PasteTracker *tracker);
+
+/* Called in the main thread after each batch of slices is written. done is
+ * the amount of text converted so far. Once finished is TRUE the stream may
+ * be freed.
+ */
+typedef void (*PasteStreamProgress)(PasteStream *ps,
+        gsize done, gsize total, gboolean finished, gpointer data);
+
+/* Starts pasting len bytes of text (which is copied) to the pty master fd,
+ * wrapped in bracketed paste markers if bracketed is TRUE.
+ */
+PasteStream *paste_stream_new(int fd, const char *text, gsize len,
+        gboolean bracketed, PasteStreamProgress progress, gpointer data);
+
+/* Stops pasting the text, dropping anything which hasn't been written yet,
+ * but still sends the closing bracket if necessary, so the paste finishes
+ * shortly afterwards.
+ */
+void paste_stream_cancel(PasteStream *ps);
+
+/* Stops immediately without calling progress again */
+void paste_stream_free(PasteStream *ps);
+
+#endif /* PASTE_H */
+
+/* vi:set sw=4 ts=4 et cindent cino= */
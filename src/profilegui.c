@@ -491,6 +491,8 @@ static void profilegui_fill_in_dialog(ProfileGUI * pg)
             "hide_menubar", FALSE));
     capplet_set_boolean_toggle(&pg->capp, "audible_bell", TRUE);
     capplet_set_boolean_toggle(&pg->capp, "bell_highlights_tab", TRUE);
+    capplet_set_spin_button(&pg->capp, "silence_alert", 0);
+    capplet_set_boolean_toggle(&pg->capp, "pty_reader_thread", FALSE);
     {
         /* Use legacy cursor_blinks if cursor_blink_mode has not been set */
         int o = options_lookup_int(profile, "cursor_blinks") + 1;
@@ -523,6 +525,8 @@ static void profilegui_fill_in_dialog(ProfileGUI * pg)
     capplet_set_radio(&pg->capp, "scrollbar_pos", 1);
     profilegui_set_scrollbar_shading(pg);
     capplet_set_boolean_toggle(&pg->capp, "limit_scrollback", FALSE);
+    capplet_set_boolean_toggle(&pg->capp, "search_index", FALSE);
+    capplet_set_boolean_toggle(&pg->capp, "session_scrollback", FALSE);
     capplet_set_spin_button(&pg->capp, "scrollback_lines", 1000);
     capplet_set_boolean_toggle(&pg->capp, "scroll_on_output", FALSE);
     capplet_set_boolean_toggle(&pg->capp, "scroll_on_keystroke", FALSE);
@@ -556,6 +560,11 @@ static void profilegui_fill_in_dialog(ProfileGUI * pg)
     capplet_set_text_entry(&pg->capp, "win_title", "%s");
     capplet_set_radio(&pg->capp, "allow_osc52", 0);
     capplet_set_spin_button(&pg->capp, "osc52_buffer_size", 100);
+    capplet_set_combo(&pg->capp, "log_output", 0);
+    capplet_set_text_entry(&pg->capp, "log_directory", NULL);
+    capplet_set_spin_button(&pg->capp, "log_max_size", 0);
+    capplet_set_spin_button(&pg->capp, "log_buffer_size", 4096);
+    capplet_set_boolean_toggle(&pg->capp, "log_compress", FALSE);
     exit_action_changed(
         GTK_COMBO_BOX(capplet_lookup_widget(&pg->capp, "exit_action")),
         pg);
@@ -584,6 +593,7 @@ static void profilegui_setup_list_store(ProfileGUI *pg)
     static char const *labels[] = {
             N_("Text"), N_("Appearance"), N_("Command"), N_("General"),
             N_("Scrolling"), N_("Keyboard"), N_("Tabs"), N_("Clipboard"),
+            N_("Logging"),
     };
     GtkTreeIter iter;
     guint n;
@@ -641,7 +651,8 @@ ProfileGUI *profilegui_open(const char *profile_name)
             "exit_pause_adjustment", "scrollback_lines_adjustment",
             "saturation_adjustment", "ssh_port_adjustment",
             "hspacing_adjustment", "vspacing_adjustment",
-            "osc52_buffer_adjustment",
+            "osc52_buffer_adjustment", "silence_alert_adjustment",
+            "log_max_size_adjustment", "log_buffer_size_adjustment",
             NULL };
     static const char *obj_names[] = {
             "Profile_Editor", "ssh_dialog",
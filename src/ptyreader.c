@@ -0,0 +1,395 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "defns.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <glib-unix.h>
+
+#include "osc52filter.h"
+#include "ptyreader.h"
+
+/* Size of each read from the pty */
+#define PTY_READER_CHUNK 16384
+
+/* The main thread stops feeding the sink after this long and lets the main
+ * loop get on with other things, such as redrawing, before continuing.
+ */
+#define PTY_READER_FEED_USEC 8000
+
+typedef struct {
+    PtyReaderFilter filter;
+    gpointer data;
+    GDestroyNotify destroy;
+} PtyReaderFilterEntry;
+
+struct PtyReader {
+    int fd;
+    int wake_pipe[2];
+    GThread *thread;
+    gint stop;
+
+    /* Held by the reader thread while it runs the filters */
+    GMutex filter_lock;
+    GList *filters;
+
+    /* Everything from here to feed_tag is protected by lock */
+    GMutex lock;
+    GCond cond;
+    GQueue chunks;
+    gsize queued;
+    gsize max_queued;
+    guint stalls;
+    gboolean eof;
+    guint feed_tag;
+
+    PtyReaderSink sink;
+    PtyReaderEofHandler eof_handler;
+    gpointer data;
+    gboolean eof_reported;
+
+    GByteArray *pending_input;
+    guint input_tag;
+};
+
+static gboolean pty_reader_feed(gpointer data);
+
+/* Must be called with reader->lock held */
+static void pty_reader_schedule_feed(PtyReader *reader)
+{
+    if (!reader->feed_tag)
+    {
+        reader->feed_tag = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE,
+                pty_reader_feed, reader, NULL);
+    }
+}
+
+static void pty_reader_filter_chunk(PtyReader *reader, GByteArray *chunk)
+{
+    GList *link;
+
+    g_mutex_lock(&reader->filter_lock);
+    for (link = reader->filters; link && chunk->len; link = g_list_next(link))
+    {
+        PtyReaderFilterEntry *entry = link->data;
+
+        entry->filter(chunk, entry->data);
+    }
+    g_mutex_unlock(&reader->filter_lock);
+}
+
+static void pty_reader_push(PtyReader *reader, GByteArray *chunk)
+{
+    g_mutex_lock(&reader->lock);
+    if (reader->queued >= reader->max_queued)
+    {
+        ++reader->stalls;
+        while (reader->queued >= reader->max_queued &&
+                !g_atomic_int_get(&reader->stop))
+        {
+            g_cond_wait(&reader->cond, &reader->lock);
+        }
+    }
+    g_queue_push_tail(&reader->chunks, chunk);
+    reader->queued += chunk->len;
+    pty_reader_schedule_feed(reader);
+    g_mutex_unlock(&reader->lock);
+}
+
+static gpointer pty_reader_thread(gpointer handle)
+{
+    PtyReader *reader = handle;
+    struct pollfd fds[2];
+
+    fds[0].fd = reader->fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = reader->wake_pipe[0];
+    fds[1].events = POLLIN;
+    while (!g_atomic_int_get(&reader->stop))
+    {
+        GByteArray *chunk;
+        ssize_t n;
+
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            g_warning("pty reader: poll failed: %s", g_strerror(errno));
+            break;
+        }
+        if (fds[1].revents)
+            break;
+        chunk = g_byte_array_sized_new(PTY_READER_CHUNK);
+        g_byte_array_set_size(chunk, PTY_READER_CHUNK);
+        n = osc52filter_unfiltered_read(reader->fd, chunk->data,
+                PTY_READER_CHUNK);
+        if (n < 0 && (errno == EAGAIN || errno == EINTR))
+        {
+            g_byte_array_unref(chunk);
+            continue;
+        }
+        if (n <= 0)
+        {
+            /* EIO means the child has closed the slave */
+            g_byte_array_unref(chunk);
+            break;
+        }
+        g_byte_array_set_size(chunk, n);
+        pty_reader_filter_chunk(reader, chunk);
+        if (chunk->len)
+            pty_reader_push(reader, chunk);
+        else
+            g_byte_array_unref(chunk);
+    }
+    g_mutex_lock(&reader->lock);
+    reader->eof = TRUE;
+    if (!g_atomic_int_get(&reader->stop))
+        pty_reader_schedule_feed(reader);
+    g_mutex_unlock(&reader->lock);
+    return NULL;
+}
+
+static gboolean pty_reader_feed(gpointer data)
+{
+    PtyReader *reader = data;
+    gint64 deadline = g_get_monotonic_time() + PTY_READER_FEED_USEC;
+    gboolean eof;
+
+    for (;;)
+    {
+        GByteArray *chunk;
+
+        g_mutex_lock(&reader->lock);
+        chunk = g_queue_pop_head(&reader->chunks);
+        if (chunk)
+        {
+            reader->queued -= chunk->len;
+            g_cond_signal(&reader->cond);
+        }
+        else
+        {
+            reader->feed_tag = 0;
+            eof = reader->eof;
+        }
+        g_mutex_unlock(&reader->lock);
+        if (!chunk)
+            break;
+        reader->sink(chunk->data, chunk->len, reader->data);
+        g_byte_array_unref(chunk);
+        if (g_get_monotonic_time() >= deadline)
+            return G_SOURCE_CONTINUE;
+    }
+    if (eof && !reader->eof_reported)
+    {
+        /* The handler may free reader */
+        reader->eof_reported = TRUE;
+        if (reader->eof_handler)
+            reader->eof_handler(reader->data);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+PtyReader *pty_reader_new(int fd, gsize max_queued,
+        PtyReaderSink sink, PtyReaderEofHandler eof_handler, gpointer data)
+{
+    PtyReader *reader;
+    GError *error = NULL;
+    int wake_pipe[2];
+
+    if (!g_unix_open_pipe(wake_pipe, FD_CLOEXEC, &error))
+    {
+        g_warning("pty reader: unable to create pipe: %s", error->message);
+        g_error_free(error);
+        return NULL;
+    }
+    if (!g_unix_set_fd_nonblocking(fd, TRUE, &error))
+    {
+        g_warning("pty reader: %s", error->message);
+        g_clear_error(&error);
+    }
+    reader = g_new0(PtyReader, 1);
+    reader->fd = fd;
+    reader->wake_pipe[0] = wake_pipe[0];
+    reader->wake_pipe[1] = wake_pipe[1];
+    g_mutex_init(&reader->filter_lock);
+    g_mutex_init(&reader->lock);
+    g_cond_init(&reader->cond);
+    g_queue_init(&reader->chunks);
+    reader->max_queued = max_queued ? max_queued : PTY_READER_CHUNK;
+    reader->sink = sink;
+    reader->eof_handler = eof_handler;
+    reader->data = data;
+    reader->thread = g_thread_new("roxterm-pty", pty_reader_thread, reader);
+    return reader;
+}
+
+static void pty_reader_filter_entry_free(PtyReaderFilterEntry *entry)
+{
+    if (entry->destroy)
+        entry->destroy(entry->data);
+    g_free(entry);
+}
+
+void pty_reader_free(PtyReader *reader)
+{
+    g_atomic_int_set(&reader->stop, TRUE);
+    if (write(reader->wake_pipe[1], "", 1) < 0)
+        g_warning("pty reader: unable to wake thread: %s", g_strerror(errno));
+    g_mutex_lock(&reader->lock);
+    g_cond_broadcast(&reader->cond);
+    g_mutex_unlock(&reader->lock);
+    g_thread_join(reader->thread);
+
+    if (reader->feed_tag)
+        g_source_remove(reader->feed_tag);
+    if (reader->input_tag)
+        g_source_remove(reader->input_tag);
+    g_queue_clear_full(&reader->chunks, (GDestroyNotify) g_byte_array_unref);
+    g_list_free_full(reader->filters,
+            (GDestroyNotify) pty_reader_filter_entry_free);
+    if (reader->pending_input)
+        g_byte_array_unref(reader->pending_input);
+    close(reader->wake_pipe[0]);
+    close(reader->wake_pipe[1]);
+    g_cond_clear(&reader->cond);
+    g_mutex_clear(&reader->lock);
+    g_mutex_clear(&reader->filter_lock);
+    g_free(reader);
+}
+
+void pty_reader_add_filter(PtyReader *reader, int position,
+        PtyReaderFilter filter, gpointer data, GDestroyNotify destroy)
+{
+    PtyReaderFilterEntry *entry = g_new(PtyReaderFilterEntry, 1);
+
+    entry->filter = filter;
+    entry->data = data;
+    entry->destroy = destroy;
+    g_mutex_lock(&reader->filter_lock);
+    reader->filters = g_list_insert(reader->filters, entry, position);
+    g_mutex_unlock(&reader->filter_lock);
+}
+
+void pty_reader_remove_filter(PtyReader *reader, gpointer data)
+{
+    GList *link;
+    PtyReaderFilterEntry *entry = NULL;
+
+    g_mutex_lock(&reader->filter_lock);
+    for (link = reader->filters; link; link = g_list_next(link))
+    {
+        entry = link->data;
+        if (entry->data == data)
+        {
+            reader->filters = g_list_delete_link(reader->filters, link);
+            break;
+        }
+        entry = NULL;
+    }
+    g_mutex_unlock(&reader->filter_lock);
+    if (entry)
+        pty_reader_filter_entry_free(entry);
+}
+
+/* Returns the number of bytes written, or -1 if the pty is unusable */
+static gssize pty_reader_write_some(PtyReader *reader,
+        const guint8 *buf, gsize len)
+{
+    gssize n = write(reader->fd, buf, len);
+
+    if (n < 0)
+    {
+        if (errno == EAGAIN || errno == EINTR)
+            return 0;
+        return -1;
+    }
+    return n;
+}
+
+static gboolean pty_reader_flush_input(int fd, GIOCondition condition,
+        gpointer data)
+{
+    PtyReader *reader = data;
+    GByteArray *pending = reader->pending_input;
+    gssize n = pty_reader_write_some(reader, pending->data, pending->len);
+    (void) fd;
+    (void) condition;
+
+    if (n < 0)
+    {
+        g_byte_array_set_size(pending, 0);
+    }
+    else if (n)
+    {
+        g_byte_array_remove_range(pending, 0, n);
+    }
+    if (pending->len)
+        return G_SOURCE_CONTINUE;
+    reader->input_tag = 0;
+    return G_SOURCE_REMOVE;
+}
+
+void pty_reader_write(PtyReader *reader, const char *buf, gsize len)
+{
+    if (!reader->pending_input)
+        reader->pending_input = g_byte_array_new();
+    if (!reader->pending_input->len)
+    {
+        gssize n = pty_reader_write_some(reader, (const guint8 *) buf, len);
+
+        if (n < 0)
+            return;
+        buf += n;
+        len -= n;
+    }
+    if (!len)
+        return;
+    g_byte_array_append(reader->pending_input, (const guint8 *) buf, len);
+    if (!reader->input_tag)
+    {
+        reader->input_tag = g_unix_fd_add(reader->fd, G_IO_OUT,
+                pty_reader_flush_input, reader);
+    }
+}
+
+gsize pty_reader_get_queued(PtyReader *reader)
+{
+    gsize queued;
+
+    g_mutex_lock(&reader->lock);
+    queued = reader->queued;
+    g_mutex_unlock(&reader->lock);
+    return queued;
+}
+
+guint pty_reader_get_stalls(PtyReader *reader)
+{
+    guint stalls;
+
+    g_mutex_lock(&reader->lock);
+    stalls = reader->stalls;
+    g_mutex_unlock(&reader->lock);
+    return stalls;
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
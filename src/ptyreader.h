@@ -0,0 +1,84 @@
+#ifndef PTYREADER_H
+#define PTYREADER_H
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* Reads a pty master in a dedicated thread instead of leaving it to VTE.
+ * Each chunk is passed through an ordered pipeline of filters in the reader
+ * thread, then queued for the main thread, which hands it to a sink (normally
+ * vte_terminal_feed) in time-limited batches. When the queue is full the
+ * reader stops reading, so a flood of output is throttled by the pty instead
+ * of using unlimited memory.
+ */
+
+#ifndef DEFNS_H
+#include "defns.h"
+#endif
+
+typedef struct PtyReader PtyReader;
+
+/* Called in the reader thread. The filter may inspect and/or modify chunk;
+ * if it's left empty nothing is queued.
+ */
+typedef void (*PtyReaderFilter)(GByteArray *chunk, gpointer data);
+
+/* Called in the main thread with filtered output */
+typedef void (*PtyReaderSink)(const guint8 *buf, gsize len, gpointer data);
+
+/* Called in the main thread once the pty has been closed (normally because the
+ * child exited) and all output has been passed to the sink.
+ */
+typedef void (*PtyReaderEofHandler)(gpointer data);
+
+/* Starts a thread reading fd, which the caller continues to own, but must not
+ * close until after pty_reader_free. max_queued is the number of bytes which
+ * may be waiting for the main thread before the reader blocks.
+ */
+PtyReader *pty_reader_new(int fd, gsize max_queued,
+        PtyReaderSink sink, PtyReaderEofHandler eof_handler, gpointer data);
+
+/* Stops the thread and discards pending output without calling the sink */
+void pty_reader_free(PtyReader *reader);
+
+/* Inserts a filter at position, as for g_list_insert, so -1 appends it.
+ * destroy, if not NULL, is called on data when the filter is removed or the
+ * reader is freed.
+ */
+void pty_reader_add_filter(PtyReader *reader, int position,
+        PtyReaderFilter filter, gpointer data, GDestroyNotify destroy);
+
+/* Removes the first filter with the given data. On return the filter is
+ * guaranteed not to be running in the reader thread.
+ */
+void pty_reader_remove_filter(PtyReader *reader, gpointer data);
+
+/* Sends input to the pty. This never blocks; data which can't be written
+ * immediately is kept until the pty is ready for it.
+ */
+void pty_reader_write(PtyReader *reader, const char *buf, gsize len);
+
+/* Number of bytes currently queued for the main thread */
+gsize pty_reader_get_queued(PtyReader *reader);
+
+/* Number of times the reader thread has had to wait for the queue to drain */
+guint pty_reader_get_stalls(PtyReader *reader);
+
+#endif /* PTYREADER_H */
+
+/* vi:set sw=4 ts=4 et cindent cino= */
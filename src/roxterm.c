@@ -26,6 +26,7 @@
 #include <sys/fcntl.h>
 #include <errno.h>
 #include <pwd.h>
+#include <signal.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -39,21 +40,36 @@
 #define PCRE2_CODE_UNIT_WIDTH 8
 #include <pcre2.h>
 #include "about.h"
+#include "activity.h"
 #include "colourscheme.h"
 #include "dlg.h"
 #include "dragrcv.h"
 #include "dynopts.h"
+#include "findall.h"
+#include "fontcache.h"
 #include "globalopts.h"
+#include "latency.h"
+#include "memstats.h"
 #include "optsfile.h"
 #include "optsdbus.h"
+#include "optsmonitor.h"
 #include "osc52filter.h"
+#include "outputlog.h"
+#include "paste.h"
+#include "ptyreader.h"
 #include "roxterm.h"
 #include "multitab.h"
+#include "ngramindex.h"
 #include "roxterm-regex.h"
+#include "scrollback.h"
 #include "search.h"
 #include "session-file.h"
+#include "session-journal.h"
 #include "shortcuts.h"
+#include "tabswitch.h"
+#include "trigger.h"
 #include "uri.h"
+#include "workerpool.h"
 #include "resources.h"
 
 #ifndef VTE_VERSION_NUMERIC 
@@ -87,11 +103,17 @@ typedef enum {
     Roxterm_ChildExitNotOverridden
 } RoxtermChildExitAction;
 
-
+/* A compiled search pattern, shared by terminals searching for the same
+ * thing and cached for search-as-you-type.
+ */
 typedef struct {
-    int tag;
-    ROXTerm_MatchType type;
-} ROXTerm_MatchMap;
+    char *key;
+    VteRegex *regex;
+    /* For the search index; NULL if the index can't be used */
+    NgramQuery *query;
+    pcre2_code *code;
+    int refcount;
+} ROXTermSearchRegex;
 
 struct ROXTermData {
     /* We do not own references to tab or widget */
@@ -109,7 +131,18 @@ struct ROXTermData {
     char **commandv;            /* Copied from --execute args */
     char **actual_commandv;     /* The actual command used */
     char *directory;            /* Copied from global_options_directory */
-    GArray *match_map;
+    /* URI matching; see roxterm_set_lazy_uri_matching() */
+    gboolean uri_matches_active;    /* Regexes registered with VTE */
+    int *uri_tags;              /* The tag VTE gave each of those regexes */
+    guint uri_rest_tag;
+    gint64 uri_motion_time;
+    GdkEvent *uri_motion_event;
+    /* The last span of cells tested for a URI; end is exclusive and url is
+     * NULL if there's no URI there.
+     */
+    glong uri_hit_row, uri_hit_start, uri_hit_end;
+    char *uri_hit_url;
+    ROXTerm_MatchType uri_hit_type;
     gboolean no_respawn;
     gboolean running;
     DragReceiveData *drd;
@@ -128,8 +161,7 @@ struct ROXTermData {
     gulong win_state_changed_tag;
     GtkWidget *replace_task_dialog;
     gboolean postponed_free;
-    PangoFontDescription *pango_desc;
-    gboolean dont_lookup_dimensions;
+    char *font_name;    /* Unzoomed, for font_cache_lookup() */
     char *reply;
     int columns, rows;
     char **env;
@@ -154,10 +186,77 @@ struct ROXTermData {
     gsize clipboard_offset;
     gsize clipboard_size;
     gboolean clipboard_primary;
+
+    OutputLog *output_log;
+    int output_log_fd;
+
+    /* Only used when the profile's search_index option is set */
+    NgramIndex *search_index;
+    int search_index_fd;
+    ROXTermSearchRegex *search_regex;
+    glong search_row;           /* Of the last match found with the index */
+
+    /* For large pastes, which are streamed to the pty */
+    PasteTracker *paste_tracker;
+    int paste_tracker_fd;
+    PasteStream *paste_stream;
+    gint64 paste_start;
+    GtkWidget *paste_dialog;
+    GtkProgressBar *paste_progress;
+
+    LatencyStats *latency;
+    int latency_fd;
+    GdkFrameClock *frame_clock;
+    gulong after_paint_tag;
+
+    /* Only used when the profile has triggers */
+    TriggerMatcher *triggers;
+    int triggers_fd;
+
+    /* A session file's copy of the scrollback, which is loaded, and the
+     * command started, when the tab is first shown.
+     */
+    char *restore_scrollback;
+    guint restore_scrollback_tag;
+
+    /* Set for terminals opened by roxterm_launch_batch */
+    gboolean stagger_spawn;
+    gboolean report_spawn;
+
+    /* Only used when the profile's pty_reader_thread option is set, in which
+     * case the pty isn't attached to VTE.
+     */
+    VtePty *own_pty;
+    PtyReader *pty_reader;
+    guint child_watch_tag;
+    guint exit_wait_tag;
+    int child_status;
+    gboolean child_gone;
+    gboolean pty_eof;
+    int pty_columns, pty_rows;
+
+    ActivityMonitor *activity;
+    /* Cached because they're needed for every bell or burst of output */
+    gboolean show_tab_status;
+    gboolean bell_highlights_tab;
+
+    ScrollbackClient *scrollback;
 };
 
 #define PROFILE_NAME_KEY "roxterm_profile_name"
 
+/* Bigger pastes are streamed to the pty instead of being passed to VTE */
+#define ROXTERM_PASTE_STREAM_MIN (64 * 1024)
+
+/* Progress is only shown for pastes which take longer than this */
+#define ROXTERM_PASTE_PROGRESS_DELAY (500 * 1000)
+
+/* Smaller buffers are searched by VTE even if there's a search index */
+#define ROXTERM_SEARCH_INDEX_MIN_ROWS 10000
+
+/* Number of compiled search patterns kept for reuse */
+#define ROXTERM_SEARCH_CACHE_SIZE 16
+
 static GList *roxterm_terms = NULL;
 
 static DynamicOptions *roxterm_profiles = NULL;
@@ -172,58 +271,86 @@ inline static MultiWin *roxterm_get_win(ROXTermData *roxterm)
 
 /*********************** URI handling ***********************/
 
-static int roxterm_match_add(ROXTermData *roxterm, VteTerminal *vte,
-        const char *match, ROXTerm_MatchType type)
+/* The URI regexes are compiled once and shared by every terminal */
+static VteRegex **roxterm_uri_regexes = NULL;
+static ROXTerm_MatchType *roxterm_uri_match_types = NULL;
+static int roxterm_n_uri_regexes = 0;
+
+static gboolean roxterm_lazy_uri_matching = FALSE;
+
+/* How long the pointer has to rest before looking for a URI under it in lazy
+ * mode.
+ */
+#define ROXTERM_URI_REST_MS 300
+
+static void roxterm_compile_uri_regexes(void)
 {
-    ROXTerm_MatchMap map;
-    VteRegex *regex;
-    GError *err = NULL;
+    int n;
 
-    regex = vte_regex_new_for_match(match, -1, PCRE2_MULTILINE, &err);
-    if (!regex || err)
+    if (roxterm_uri_regexes)
+        return;
+    for (n = 0; roxterm_regexes[n].regex; ++n);
+    roxterm_uri_regexes = g_new(VteRegex *, n);
+    roxterm_uri_match_types = g_new(ROXTerm_MatchType, n);
+    for (n = 0; roxterm_regexes[n].regex; ++n)
     {
-        g_warning("Failed to compile regex '%s': %s",
-                match, err ? err->message : "");
-        return -1;
+        GError *err = NULL;
+        VteRegex *regex = vte_regex_new_for_match(roxterm_regexes[n].regex,
+                -1, PCRE2_MULTILINE, &err);
+
+        if (!regex || err)
+        {
+            g_warning("Failed to compile regex '%s': %s",
+                    roxterm_regexes[n].regex, err ? err->message : "");
+            g_clear_error(&err);
+            if (regex)
+                vte_regex_unref(regex);
+            continue;
+        }
+        roxterm_uri_regexes[roxterm_n_uri_regexes] = regex;
+        roxterm_uri_match_types[roxterm_n_uri_regexes++] =
+                roxterm_regexes[n].match_type;
     }
-    map.type = type;
-    map.tag = vte_terminal_match_add_regex(vte, regex, 0);
-    vte_terminal_match_set_cursor_name(vte, map.tag, "pointer");
-    g_array_append_val(roxterm->match_map, map);
-    return map.tag;
 }
 
-/*
-static void roxterm_match_remove(ROXTermData *roxterm, VteTerminal *vte,
-        int tag)
+/* Registers the URI regexes with VTE so it highlights them under the pointer
+ * and can report them for events.
+ */
+static void roxterm_add_uri_matches(ROXTermData *roxterm, VteTerminal *vte)
 {
-    guint n;
+    int n;
 
-    vte_terminal_match_remove(vte, tag);
-    for (n = 0; n < roxterm->match_map->len; ++n)
+    if (roxterm->uri_matches_active)
+        return;
+    roxterm_compile_uri_regexes();
+    if (!roxterm->uri_tags)
+        roxterm->uri_tags = g_new(int, roxterm_n_uri_regexes);
+    for (n = 0; n < roxterm_n_uri_regexes; ++n)
     {
-        if (g_array_index(roxterm->match_map, ROXTerm_MatchMap, n).tag == tag)
-        {
-            g_array_remove_index_fast(roxterm->match_map, n);
-            break;
-        }
+        roxterm->uri_tags[n] = vte_terminal_match_add_regex(vte,
+                roxterm_uri_regexes[n], 0);
+        vte_terminal_match_set_cursor_name(vte, roxterm->uri_tags[n],
+                "pointer");
     }
+    roxterm->uri_matches_active = TRUE;
 }
-*/
 
-static void roxterm_add_matches(ROXTermData *roxterm, VteTerminal *vte)
+static void roxterm_remove_uri_matches(ROXTermData *roxterm, VteTerminal *vte)
 {
-    int n;
+    if (!roxterm->uri_matches_active)
+        return;
+    vte_terminal_match_remove_all(vte);
+    roxterm->uri_matches_active = FALSE;
+}
 
+static void roxterm_add_matches(ROXTermData *roxterm, VteTerminal *vte)
+{
 #if VTE_CHECK_VERSION(0,50,0)
     vte_terminal_set_allow_hyperlink(vte, roxterm_enable_hyperlinks());
 #endif
 
-    for (n = 0; roxterm_regexes[n].regex; ++n)
-    {
-        roxterm_match_add(roxterm, vte, roxterm_regexes[n].regex,
-                roxterm_regexes[n].match_type);
-    }
+    if (!roxterm_lazy_uri_matching)
+        roxterm_add_uri_matches(roxterm, vte);
 }
 
 /*
@@ -250,17 +377,22 @@ static void roxterm_remove_file_matches(ROXTermData *roxterm, VteTerminal *vte)
 }
 */
 
+/* VTE allocates tags consecutively, so the type can usually be found without
+ * searching.
+ */
 static ROXTerm_MatchType roxterm_get_match_type(ROXTermData *roxterm, int tag)
 {
-    guint n;
+    int n;
 
-    for (n = 0; n < roxterm->match_map->len; ++n)
+    if (!roxterm->uri_matches_active || !roxterm_n_uri_regexes)
+        return ROXTerm_Match_Invalid;
+    n = tag - roxterm->uri_tags[0];
+    if (n >= 0 && n < roxterm_n_uri_regexes && roxterm->uri_tags[n] == tag)
+        return roxterm_uri_match_types[n];
+    for (n = 0; n < roxterm_n_uri_regexes; ++n)
     {
-        ROXTerm_MatchMap *m = &g_array_index(roxterm->match_map,
-                ROXTerm_MatchMap, n);
-
-        if (m->tag == tag)
-            return m->type;
+        if (roxterm->uri_tags[n] == tag)
+            return roxterm_uri_match_types[n];
     }
     return ROXTerm_Match_Invalid;
 }
@@ -336,7 +468,6 @@ static ROXTermData *roxterm_data_clone(ROXTermData *old_gt)
     new_gt->tab = NULL;
     new_gt->running = FALSE;
     new_gt->postponed_free = FALSE;
-    new_gt->dont_lookup_dimensions = FALSE;
     new_gt->actual_commandv = NULL;
     new_gt->env = roxterm_strv_copy(old_gt->env);
     new_gt->child_exited_tag = 0;
@@ -349,6 +480,39 @@ static ROXTermData *roxterm_data_clone(ROXTermData *old_gt)
     new_gt->pending_clipboard = NULL;
     new_gt->clipboard_offset = 0;
     new_gt->clipboard_size = 0;
+    new_gt->output_log = NULL;
+    new_gt->output_log_fd = -1;
+    new_gt->search_index = NULL;
+    new_gt->search_index_fd = -1;
+    new_gt->search_regex = NULL;
+    new_gt->search_row = -1;
+    new_gt->paste_tracker = NULL;
+    new_gt->paste_tracker_fd = -1;
+    new_gt->paste_stream = NULL;
+    new_gt->paste_dialog = NULL;
+    new_gt->paste_progress = NULL;
+    new_gt->triggers = NULL;
+    new_gt->triggers_fd = -1;
+    new_gt->latency = NULL;
+    new_gt->latency_fd = -1;
+    new_gt->frame_clock = NULL;
+    new_gt->after_paint_tag = 0;
+    /* Like special_command, restore_scrollback is transferred from a session
+     * template to its tab.
+     */
+    if (old_gt->tab)
+        new_gt->restore_scrollback = NULL;
+    else
+        old_gt->restore_scrollback = NULL;
+    new_gt->restore_scrollback_tag = 0;
+    new_gt->stagger_spawn = FALSE;
+    new_gt->report_spawn = FALSE;
+    new_gt->own_pty = NULL;
+    new_gt->pty_reader = NULL;
+    new_gt->child_watch_tag = 0;
+    new_gt->exit_wait_tag = 0;
+    new_gt->activity = NULL;
+    new_gt->scrollback = NULL;
 
     if (old_gt->colour_scheme)
     {
@@ -379,13 +543,15 @@ static ROXTermData *roxterm_data_clone(ROXTermData *old_gt)
         new_gt->directory = g_strdup(old_gt->directory);
     }
 
-    new_gt->match_map = g_array_new(FALSE, FALSE, sizeof(ROXTerm_MatchMap));
     new_gt->matched_url = NULL;
-
-    if (old_gt->pango_desc)
-    {
-        new_gt->pango_desc = pango_font_description_copy(old_gt->pango_desc);
-    }
+    new_gt->uri_matches_active = FALSE;
+    new_gt->uri_tags = NULL;
+    new_gt->uri_rest_tag = 0;
+    new_gt->uri_motion_event = NULL;
+    new_gt->uri_hit_row = -1;
+    new_gt->uri_hit_url = NULL;
+
+    new_gt->font_name = g_strdup(old_gt->font_name);
     if (old_gt->widget && gtk_widget_get_realized(old_gt->widget))
     {
         VteTerminal *vte = VTE_TERMINAL(old_gt->widget);
@@ -489,109 +655,1028 @@ static GtkWindow *roxterm_get_toplevel(ROXTermData *roxterm)
         if (tl && gtk_widget_is_toplevel(tl))
             return GTK_WINDOW(tl);
     }
-    return NULL;
+    return NULL;
+}
+
+static char *get_default_command(ROXTermData *roxterm)
+{
+    char *command = NULL;
+    struct passwd *pinfo = getpwuid(getuid());
+
+    if (pinfo)
+    {
+        command = g_strdup(pinfo->pw_shell);
+    }
+    else
+    {
+        dlg_warning(roxterm_get_toplevel(roxterm),
+                _("Unable to look up login details: %s"), strerror(errno));
+    }
+    if (!command || !command[0])
+        command = g_strdup("/bin/sh");
+    return command;
+}
+
+static void roxterm_show_status(ROXTermData *roxterm, const char *name)
+{
+    if (name && !strcmp(name, "dialog-information") &&
+            roxterm->status_icon_name &&
+            (!strcmp(roxterm->status_icon_name, "dialog-warning") ||
+            !strcmp(roxterm->status_icon_name, "dialog_error")))
+
+    {
+        return;
+    }
+    roxterm->status_icon_name = name;
+    if (roxterm->tab && roxterm->show_tab_status)
+    {
+        multi_tab_set_status_icon_name(roxterm->tab, name);
+    }
+}
+
+static gboolean roxterm_command_failed(ROXTermData *roxterm)
+{
+    MultiWin *win = roxterm_get_win(roxterm);
+    GtkWidget *w = win ? multi_win_get_widget(win) : NULL;
+
+    dlg_critical(w ? GTK_WINDOW(w) : NULL, "%s", roxterm->reply);
+    g_free(roxterm->reply);
+    multi_tab_delete(roxterm->tab);
+    return FALSE;
+}
+
+/* Returns NULL if cwd is apparently inaccessible */
+static const char *check_cwd(const char *cwd)
+{
+    return (cwd && g_file_test(cwd, G_FILE_TEST_IS_DIR) &&
+            g_file_test(cwd, G_FILE_TEST_IS_EXECUTABLE)) ?
+            cwd : NULL;
+}
+
+/* Returns home dir if cwd is inaccessible. If home is also inaccessible
+ * returns NULL. */
+static const char *roxterm_check_cwd(const char *cwd)
+{
+    return check_cwd(cwd) ? cwd : check_cwd(g_get_home_dir());
+}
+
+static void roxterm_report_launch_error_async(ROXTermData *roxterm,
+        const char *msg, GError *error)
+{
+    roxterm->reply = g_strdup_printf("%s: %s",
+            msg, error ? error->message : "?");
+    g_idle_add((GSourceFunc) roxterm_command_failed, roxterm);
+}
+
+/* The pty is either owned by VTE or by roxterm itself for pty_reader_thread */
+static VtePty *roxterm_get_pty(ROXTermData *roxterm)
+{
+    if (roxterm->own_pty)
+        return roxterm->own_pty;
+    return roxterm->widget ?
+        vte_terminal_get_pty(VTE_TERMINAL(roxterm->widget)) : NULL;
+}
+
+/* Runs in the pty reader thread */
+static void roxterm_output_log_filter(GByteArray *chunk, gpointer olog)
+{
+    output_log_write(olog, chunk->data, chunk->len);
+}
+
+/* Runs in the pty reader thread */
+static void roxterm_osc52_filter(GByteArray *chunk, gpointer oflt)
+{
+    osc52filter_scan(oflt, chunk->data, chunk->len);
+}
+
+static void roxterm_stop_output_log(ROXTermData *roxterm)
+{
+    if (roxterm->output_log)
+    {
+        if (roxterm->pty_reader)
+            pty_reader_remove_filter(roxterm->pty_reader, roxterm->output_log);
+        else
+            osc52filter_set_output_log(roxterm->output_log_fd, NULL);
+        output_log_close(roxterm->output_log);
+        roxterm->output_log = NULL;
+        roxterm->output_log_fd = -1;
+    }
+}
+
+/* (Re)starts logging according to the profile; the pty must already exist */
+static void roxterm_update_output_log(ROXTermData *roxterm)
+{
+    static int serial = 0;
+    OutputLogFormat format = options_lookup_int_with_default(roxterm->profile,
+            "log_output", OUTPUT_LOG_OFF);
+    VteTerminal *vte;
+    VtePty *pty;
+    int fd;
+    const char *dir;
+    char *default_dir = NULL;
+    char *stamp;
+    char *leaf;
+    char *filename;
+    GDateTime *now;
+    GError *error = NULL;
+
+    roxterm_stop_output_log(roxterm);
+    if (format == OUTPUT_LOG_OFF || !roxterm->widget)
+        return;
+    vte = VTE_TERMINAL(roxterm->widget);
+    pty = roxterm_get_pty(roxterm);
+    fd = pty ? vte_pty_get_fd(pty) : -1;
+    if (fd <= 0)
+        return;
+
+    dir = options_lookup_string(roxterm->profile, "log_directory");
+    if (!dir || !dir[0])
+    {
+        default_dir = g_build_filename(g_get_user_cache_dir(),
+                ROXTERM_LEAF_DIR, "logs", NULL);
+        dir = default_dir;
+    }
+    if (g_mkdir_with_parents(dir, 0700))
+    {
+        g_warning(_("Unable to create log directory '%s': %s"),
+                dir, g_strerror(errno));
+        g_free(default_dir);
+        return;
+    }
+    now = g_date_time_new_now_local();
+    stamp = g_date_time_format(now, "%Y%m%d-%H%M%S");
+    g_date_time_unref(now);
+    leaf = g_strdup_printf("roxterm-%s-%d-%d.%s", stamp, (int) getpid(),
+            ++serial, format == OUTPUT_LOG_ASCIICAST ? "cast" : "log");
+    filename = g_build_filename(dir, leaf, NULL);
+    g_free(leaf);
+    g_free(stamp);
+    g_free(default_dir);
+
+    roxterm->output_log = output_log_open(filename, format,
+            options_lookup_int_with_default(roxterm->profile,
+                    "log_compress", FALSE),
+            (gsize) options_lookup_int_with_default(roxterm->profile,
+                    "log_buffer_size", 4096) * 1024,
+            (gsize) options_lookup_int_with_default(roxterm->profile,
+                    "log_max_size", 0) * 1024 * 1024,
+            (int) vte_terminal_get_column_count(vte),
+            (int) vte_terminal_get_row_count(vte),
+            &error);
+    if (roxterm->output_log)
+    {
+        roxterm->output_log_fd = fd;
+        if (roxterm->pty_reader)
+        {
+            pty_reader_add_filter(roxterm->pty_reader, -1,
+                    roxterm_output_log_filter, roxterm->output_log, NULL);
+        }
+        else
+        {
+            osc52filter_set_output_log(fd, roxterm->output_log);
+        }
+    }
+    else
+    {
+        dlg_warning(roxterm_get_toplevel(roxterm),
+                _("Unable to open log '%s': %s"), filename, error->message);
+        g_error_free(error);
+    }
+    g_free(filename);
+}
+
+/* Runs in the pty reader thread */
+static void roxterm_search_index_filter(GByteArray *chunk, gpointer ni)
+{
+    ngram_index_feed(ni, chunk->data, chunk->len);
+}
+
+/* Stops feeding the search index, but keeps what's already in it */
+static void roxterm_detach_search_index(ROXTermData *roxterm)
+{
+    if (!roxterm->search_index)
+        return;
+    if (roxterm->pty_reader)
+        pty_reader_remove_filter(roxterm->pty_reader, roxterm->search_index);
+    else if (roxterm->search_index_fd >= 0)
+        osc52filter_set_ngram_index(roxterm->search_index_fd, NULL);
+    roxterm->search_index_fd = -1;
+}
+
+static GHashTable *roxterm_search_cache = NULL;
+
+/* Most recently used first */
+static GQueue roxterm_search_lru = G_QUEUE_INIT;
+
+static void roxterm_search_regex_unref(ROXTermSearchRegex *sr)
+{
+    if (--sr->refcount)
+        return;
+    vte_regex_unref(sr->regex);
+    if (sr->query)
+        ngram_query_free(sr->query);
+    if (sr->code)
+        pcre2_code_free(sr->code);
+    g_free(sr->key);
+    g_free(sr);
+}
+
+static ROXTermSearchRegex *roxterm_search_regex_compile(const char *pattern,
+        guint flags, GError **error)
+{
+    ROXTermSearchRegex *sr;
+    VteRegex *regex;
+    char *cooked_pattern = NULL;
+    const char *raw_pattern = pattern;
+    guint32 caseless =
+            (flags & ROXTERM_SEARCH_MATCH_CASE) ? 0 : PCRE2_CASELESS;
+
+    if (!(flags & ROXTERM_SEARCH_AS_REGEX))
+    {
+        cooked_pattern = g_regex_escape_string(pattern, -1);
+        pattern = cooked_pattern;
+    }
+    if (flags & ROXTERM_SEARCH_ENTIRE_WORD)
+    {
+        char *tmp = cooked_pattern;
+
+        cooked_pattern = g_strdup_printf("\\<%s\\>", pattern);
+        pattern = cooked_pattern;
+        g_free(tmp);
+    }
+
+    regex = vte_regex_new_for_search(pattern, -1,
+            caseless | PCRE2_NOTEMPTY | PCRE2_MULTILINE, error);
+    if (!regex)
+    {
+        g_free(cooked_pattern);
+        return NULL;
+    }
+    sr = g_new0(ROXTermSearchRegex, 1);
+    sr->regex = regex;
+    sr->query = ngram_query_new(raw_pattern, flags);
+    if (sr->query)
+    {
+        /* The same pattern as VTE's, to check the index's candidates */
+        int errcode;
+        PCRE2_SIZE erroffset;
+
+        sr->code = pcre2_compile((PCRE2_SPTR) pattern, PCRE2_ZERO_TERMINATED,
+                caseless | PCRE2_UTF | PCRE2_UCP | PCRE2_MULTILINE,
+                &errcode, &erroffset, NULL);
+        if (sr->code)
+            pcre2_jit_compile(sr->code, PCRE2_JIT_COMPLETE);
+    }
+    g_free(cooked_pattern);
+    return sr;
+}
+
+/* Returns a new reference to a compiled pattern, reusing a cached one if
+ * possible.
+ */
+static ROXTermSearchRegex *roxterm_search_regex_lookup(const char *pattern,
+        guint flags, GError **error)
+{
+    ROXTermSearchRegex *sr;
+    char *key;
+
+    flags &= ROXTERM_SEARCH_MATCH_CASE | ROXTERM_SEARCH_ENTIRE_WORD |
+            ROXTERM_SEARCH_AS_REGEX;
+    key = g_strdup_printf("%u:%s", flags, pattern);
+    if (!roxterm_search_cache)
+        roxterm_search_cache = g_hash_table_new(g_str_hash, g_str_equal);
+    sr = g_hash_table_lookup(roxterm_search_cache, key);
+    if (sr)
+    {
+        g_free(key);
+        g_queue_remove(&roxterm_search_lru, sr);
+        g_queue_push_head(&roxterm_search_lru, sr);
+        ++sr->refcount;
+        return sr;
+    }
+    sr = roxterm_search_regex_compile(pattern, flags, error);
+    if (!sr)
+    {
+        g_free(key);
+        return NULL;
+    }
+    sr->key = key;
+    /* One for the cache and one for the caller */
+    sr->refcount = 2;
+    g_hash_table_insert(roxterm_search_cache, sr->key, sr);
+    g_queue_push_head(&roxterm_search_lru, sr);
+    if (roxterm_search_lru.length > ROXTERM_SEARCH_CACHE_SIZE)
+    {
+        ROXTermSearchRegex *old = g_queue_pop_tail(&roxterm_search_lru);
+
+        g_hash_table_remove(roxterm_search_cache, old->key);
+        roxterm_search_regex_unref(old);
+    }
+    return sr;
+}
+
+static void roxterm_clear_search_regex(ROXTermData *roxterm)
+{
+    if (roxterm->search_regex)
+    {
+        roxterm_search_regex_unref(roxterm->search_regex);
+        roxterm->search_regex = NULL;
+    }
+    roxterm->search_row = -1;
+}
+
+/* Creates or deletes the search index according to the profile, and attaches
+ * it to the current pty.
+ */
+static void roxterm_update_search_index(ROXTermData *roxterm)
+{
+    VteTerminal *vte;
+    VtePty *pty;
+    int fd;
+
+    roxterm_detach_search_index(roxterm);
+    if (!roxterm->widget || !options_lookup_int_with_default(roxterm->profile,
+                "search_index", FALSE))
+    {
+        if (roxterm->search_index)
+        {
+            ngram_index_free(roxterm->search_index);
+            roxterm->search_index = NULL;
+        }
+        return;
+    }
+    vte = VTE_TERMINAL(roxterm->widget);
+    if (!roxterm->search_index)
+    {
+        roxterm->search_index = ngram_index_new();
+        ngram_index_set_geometry(roxterm->search_index,
+                (int) vte_terminal_get_column_count(vte),
+                (int) vte_terminal_get_row_count(vte));
+        ngram_index_set_scrollback_lines(roxterm->search_index,
+                vte_terminal_get_scrollback_lines(vte));
+    }
+    pty = roxterm_get_pty(roxterm);
+    fd = pty ? vte_pty_get_fd(pty) : -1;
+    if (fd <= 0)
+        return;
+    roxterm->search_index_fd = fd;
+    if (roxterm->pty_reader)
+    {
+        pty_reader_add_filter(roxterm->pty_reader, -1,
+                roxterm_search_index_filter, roxterm->search_index, NULL);
+    }
+    else
+    {
+        osc52filter_set_ngram_index(fd, roxterm->search_index);
+    }
+}
+
+/* Runs in the pty reader thread */
+static void roxterm_paste_tracker_filter(GByteArray *chunk, gpointer tracker)
+{
+    paste_tracker_feed(tracker, chunk->data, chunk->len);
+}
+
+static void roxterm_detach_paste_tracker(ROXTermData *roxterm)
+{
+    if (!roxterm->paste_tracker)
+        return;
+    if (roxterm->pty_reader)
+        pty_reader_remove_filter(roxterm->pty_reader, roxterm->paste_tracker);
+    else if (roxterm->paste_tracker_fd >= 0)
+        osc52filter_set_paste_tracker(roxterm->paste_tracker_fd, NULL);
+    roxterm->paste_tracker_fd = -1;
+}
+
+/* Starts watching a new pty for bracketed paste mode */
+static void roxterm_attach_paste_tracker(ROXTermData *roxterm)
+{
+    VtePty *pty;
+    int fd;
+
+    roxterm_detach_paste_tracker(roxterm);
+    if (!roxterm->paste_tracker)
+        roxterm->paste_tracker = paste_tracker_new();
+    else
+        paste_tracker_reset(roxterm->paste_tracker);
+    pty = roxterm_get_pty(roxterm);
+    fd = pty ? vte_pty_get_fd(pty) : -1;
+    if (fd <= 0)
+        return;
+    roxterm->paste_tracker_fd = fd;
+    if (roxterm->pty_reader)
+    {
+        pty_reader_add_filter(roxterm->pty_reader, -1,
+                roxterm_paste_tracker_filter, roxterm->paste_tracker, NULL);
+    }
+    else
+    {
+        osc52filter_set_paste_tracker(fd, roxterm->paste_tracker);
+    }
+}
+
+/* Runs in the pty reader thread */
+static void roxterm_latency_filter(GByteArray *chunk, gpointer ls)
+{
+    latency_stats_note_read(ls, chunk->len);
+}
+
+static void roxterm_detach_latency_stats(ROXTermData *roxterm)
+{
+    if (!roxterm->latency)
+        return;
+    if (roxterm->pty_reader)
+        pty_reader_remove_filter(roxterm->pty_reader, roxterm->latency);
+    else if (roxterm->latency_fd >= 0)
+        osc52filter_set_latency_stats(roxterm->latency_fd, NULL);
+    roxterm->latency_fd = -1;
+}
+
+/* Starts timing reads from a new pty */
+static void roxterm_attach_latency_stats(ROXTermData *roxterm)
+{
+    VtePty *pty;
+    int fd;
+
+    roxterm_detach_latency_stats(roxterm);
+    if (!roxterm->latency)
+        return;
+    pty = roxterm_get_pty(roxterm);
+    fd = pty ? vte_pty_get_fd(pty) : -1;
+    if (fd <= 0)
+        return;
+    roxterm->latency_fd = fd;
+    if (roxterm->pty_reader)
+    {
+        pty_reader_add_filter(roxterm->pty_reader, -1,
+                roxterm_latency_filter, roxterm->latency, NULL);
+    }
+    else
+    {
+        osc52filter_set_latency_stats(fd, roxterm->latency);
+    }
+}
+
+static void roxterm_after_paint_handler(GdkFrameClock *clock,
+        ROXTermData *roxterm)
+{
+    (void) clock;
+    latency_stats_note_paint(roxterm->latency,
+            gtk_widget_is_drawable(roxterm->widget));
+}
+
+static void roxterm_unrealize_handler(GtkWidget *widget, ROXTermData *roxterm)
+{
+    (void) widget;
+    if (roxterm->after_paint_tag)
+    {
+        g_signal_handler_disconnect(roxterm->frame_clock,
+                roxterm->after_paint_tag);
+        roxterm->after_paint_tag = 0;
+    }
+    roxterm->frame_clock = NULL;
+}
+
+/* The frame clock belongs to the toplevel, so it changes if the tab is
+ * dragged to another window, which unrealizes it and realizes it again.
+ */
+static void roxterm_realize_handler(GtkWidget *widget, ROXTermData *roxterm)
+{
+    roxterm_unrealize_handler(widget, roxterm);
+    roxterm->frame_clock = gtk_widget_get_frame_clock(widget);
+    if (roxterm->frame_clock)
+    {
+        roxterm->after_paint_tag = g_signal_connect(roxterm->frame_clock,
+                "after-paint", G_CALLBACK(roxterm_after_paint_handler),
+                roxterm);
+    }
+}
+
+static void roxterm_draw_attention(ROXTermData *roxterm, gboolean background);
+
+static void roxterm_send_notification(const char *summary, const char *body)
+{
+    static const char *no_actions[] = { NULL };
+    GDBusConnection *bus = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+    GVariantBuilder hints;
+
+    if (!bus)
+        return;
+    g_variant_builder_init(&hints, G_VARIANT_TYPE("a{sv}"));
+    g_dbus_connection_call(bus, "org.freedesktop.Notifications",
+            "/org/freedesktop/Notifications", "org.freedesktop.Notifications",
+            "Notify", g_variant_new("(susss^asa{sv}i)", "ROXTerm", 0,
+                "utilities-terminal", summary, body, no_actions, &hints, -1),
+            NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+    g_object_unref(bus);
+}
+
+static void roxterm_run_trigger_command(ROXTermData *roxterm,
+        const char *command, const char *text)
+{
+    char *argv[] = { "/bin/sh", "-c", (char *) command, NULL };
+    char **env = g_environ_setenv(roxterm->env ?
+                roxterm_strv_copy(roxterm->env) : g_get_environ(),
+            "ROXTERM_TRIGGER_MATCH", text, TRUE);
+    char *cwd = roxterm_get_cwd(roxterm);
+    GError *error = NULL;
+
+    if (!g_spawn_async(cwd, argv, env, G_SPAWN_DEFAULT, NULL, NULL, NULL,
+                &error))
+    {
+        g_warning(_("Unable to run trigger command '%s': %s"),
+                command, error->message);
+        g_error_free(error);
+    }
+    g_free(cwd);
+    g_strfreev(env);
+}
+
+static void roxterm_trigger_handler(TriggerSet *ts, guint index,
+        const char *text, gpointer data)
+{
+    ROXTermData *roxterm = data;
+    guint actions = trigger_set_get_actions(ts, index);
+    MultiWin *win;
+
+    if (!g_list_find(roxterm_terms, roxterm) || !roxterm->tab)
+        return;
+    win = roxterm_get_win(roxterm);
+    if (actions & TRIGGER_NOTIFY)
+    {
+        const char *title = multi_tab_get_window_title(roxterm->tab);
+
+        roxterm_send_notification(title ? title : _("ROXTerm"), text);
+    }
+    if (actions & TRIGGER_FLASH)
+    {
+        roxterm_draw_attention(roxterm,
+                win && roxterm->tab != multi_win_get_current_tab(win));
+    }
+    if (actions & TRIGGER_ICON)
+        roxterm_show_status(roxterm, "dialog-information");
+    if ((actions & TRIGGER_COMMAND) && trigger_set_get_command(ts, index))
+    {
+        roxterm_run_trigger_command(roxterm,
+                trigger_set_get_command(ts, index), text);
+    }
+}
+
+/* Runs in the pty reader thread */
+static void roxterm_trigger_filter(GByteArray *chunk, gpointer tm)
+{
+    trigger_matcher_feed(tm, chunk->data, chunk->len);
+}
+
+static void roxterm_stop_triggers(ROXTermData *roxterm)
+{
+    if (!roxterm->triggers)
+        return;
+    if (roxterm->pty_reader)
+        pty_reader_remove_filter(roxterm->pty_reader, roxterm->triggers);
+    else if (roxterm->triggers_fd >= 0)
+        osc52filter_set_trigger_matcher(roxterm->triggers_fd, NULL);
+    trigger_matcher_free(roxterm->triggers);
+    roxterm->triggers = NULL;
+    roxterm->triggers_fd = -1;
+}
+
+/* (Re)compiles the profile's triggers and attaches them to the current pty */
+static void roxterm_update_triggers(ROXTermData *roxterm)
+{
+    TriggerSet *ts;
+    VtePty *pty;
+    int fd;
+
+    roxterm_stop_triggers(roxterm);
+    if (!roxterm->widget)
+        return;
+    pty = roxterm_get_pty(roxterm);
+    fd = pty ? vte_pty_get_fd(pty) : -1;
+    if (fd <= 0)
+        return;
+    ts = trigger_set_new_for_profile(roxterm->profile);
+    if (!ts)
+        return;
+    roxterm->triggers = trigger_matcher_new(ts, roxterm_trigger_handler,
+            roxterm);
+    trigger_set_unref(ts);
+    roxterm->triggers_fd = fd;
+    if (roxterm->pty_reader)
+    {
+        pty_reader_add_filter(roxterm->pty_reader, -1,
+                roxterm_trigger_filter, roxterm->triggers, NULL);
+    }
+    else
+    {
+        osc52filter_set_trigger_matcher(fd, roxterm->triggers);
+    }
+}
+
+static void roxterm_stop_paste(ROXTermData *roxterm)
+{
+    if (roxterm->paste_stream)
+    {
+        paste_stream_free(roxterm->paste_stream);
+        roxterm->paste_stream = NULL;
+    }
+    if (roxterm->paste_dialog)
+        gtk_widget_destroy(roxterm->paste_dialog);
+}
+
+static void roxterm_paste_dialog_response(GtkDialog *dialog, int response,
+        ROXTermData *roxterm)
+{
+    (void) dialog;
+    (void) response;
+    if (roxterm->paste_stream)
+        paste_stream_cancel(roxterm->paste_stream);
+}
+
+static void roxterm_paste_dialog_destroyed(GtkWidget *dialog,
+        ROXTermData *roxterm)
+{
+    (void) dialog;
+    roxterm->paste_dialog = NULL;
+    roxterm->paste_progress = NULL;
+}
+
+static void roxterm_show_paste_progress(ROXTermData *roxterm)
+{
+    GtkWidget *dialog = gtk_dialog_new_with_buttons(_("Pasting"),
+            roxterm_get_toplevel(roxterm), GTK_DIALOG_DESTROY_WITH_PARENT,
+            _("_Cancel"), GTK_RESPONSE_CANCEL,
+            NULL);
+    GtkWidget *progress = gtk_progress_bar_new();
+
+    gtk_progress_bar_set_show_text(GTK_PROGRESS_BAR(progress), TRUE);
+    gtk_widget_set_size_request(progress, 300, -1);
+    gtk_box_pack_start(
+            GTK_BOX(gtk_dialog_get_content_area(GTK_DIALOG(dialog))),
+            progress, FALSE, FALSE, DLG_SPACING);
+    /* Escape cancels too while the dialog has the focus */
+    g_signal_connect(dialog, "response",
+            G_CALLBACK(roxterm_paste_dialog_response), roxterm);
+    g_signal_connect(dialog, "destroy",
+            G_CALLBACK(roxterm_paste_dialog_destroyed), roxterm);
+    roxterm->paste_dialog = dialog;
+    roxterm->paste_progress = GTK_PROGRESS_BAR(progress);
+    gtk_widget_show_all(dialog);
+}
+
+static void roxterm_paste_progress(PasteStream *ps,
+        gsize done, gsize total, gboolean finished, gpointer data)
+{
+    ROXTermData *roxterm = data;
+    (void) ps;
+
+    if (finished)
+    {
+        roxterm_stop_paste(roxterm);
+        return;
+    }
+    if (!roxterm->paste_dialog)
+    {
+        if (g_get_monotonic_time() - roxterm->paste_start <
+                ROXTERM_PASTE_PROGRESS_DELAY)
+        {
+            return;
+        }
+        roxterm_show_paste_progress(roxterm);
+    }
+    gtk_progress_bar_set_fraction(roxterm->paste_progress,
+            (double) done / (double) total);
+}
+
+static void roxterm_clipboard_text_received(GtkClipboard *clipboard,
+        const char *text, gpointer data)
+{
+    ROXTermData *roxterm = data;
+    VtePty *pty;
+    gsize len;
+    (void) clipboard;
+
+    if (!text || !g_list_find(roxterm_terms, roxterm) || !roxterm->widget ||
+            roxterm->paste_stream)
+    {
+        return;
+    }
+    len = strlen(text);
+    pty = roxterm_get_pty(roxterm);
+    if (len < ROXTERM_PASTE_STREAM_MIN || !pty || !roxterm->paste_tracker)
+    {
+#if VTE_CHECK_VERSION(0,68,0)
+        vte_terminal_paste_text(VTE_TERMINAL(roxterm->widget), text);
+#else
+        vte_terminal_paste_clipboard(VTE_TERMINAL(roxterm->widget));
+#endif
+        return;
+    }
+    roxterm->paste_start = g_get_monotonic_time();
+    roxterm->paste_stream = paste_stream_new(vte_pty_get_fd(pty), text, len,
+            paste_tracker_get_bracketed(roxterm->paste_tracker),
+            roxterm_paste_progress, roxterm);
+}
+
+/* Large pastes are streamed to the pty so that they don't block the UI */
+static void roxterm_paste(ROXTermData *roxterm)
+{
+    if (roxterm->paste_stream)
+        return;
+    gtk_clipboard_request_text(
+            gtk_widget_get_clipboard(roxterm->widget, GDK_SELECTION_CLIPBOARD),
+            roxterm_clipboard_text_received, roxterm);
+}
+
+static Osc52Filter *roxterm_create_osc52_filter(ROXTermData *roxterm)
+{
+    int buflen = options_lookup_int_with_default(roxterm->profile,
+                                                 "osc52_buffer_size", 100);
+    if (roxterm->pty_reader)
+    {
+        /* OSC 52 goes first in case later filters change the data */
+        roxterm->osc52_filter = osc52filter_new(roxterm,
+                                                (size_t) buflen * 1024);
+        pty_reader_add_filter(roxterm->pty_reader, 0,
+                              roxterm_osc52_filter, roxterm->osc52_filter,
+                              NULL);
+    }
+    else
+    {
+        roxterm->osc52_filter = osc52filter_create(roxterm,
+                                                   (size_t) buflen * 1024);
+    }
+    return roxterm->osc52_filter;
+}
+
+static void roxterm_remove_osc52_filter(ROXTermData *roxterm)
+{
+    if (roxterm->osc52_filter)
+    {
+        if (roxterm->pty_reader)
+        {
+            pty_reader_remove_filter(roxterm->pty_reader,
+                                     roxterm->osc52_filter);
+        }
+        osc52filter_remove(roxterm->osc52_filter);
+        roxterm->osc52_filter = NULL;
+    }
+}
+
+/* Tells whoever opened the terminal with NewTerminals how its command
+ * started */
+static void roxterm_report_spawn(ROXTermData *roxterm, GPid pid,
+        GError *error)
+{
+    char *id = g_strdup_printf("%p", roxterm);
+    dbus_int32_t ipid = pid;
+    const char *message = pid == -1 ?
+            (error ? error->message : _("Failed to run command")) : "";
+    DBusMessage *signal;
+
+    if (!rtdbus_ok)
+    {
+        g_free(id);
+        return;
+    }
+    signal = rtdbus_signal_new(ROXTERM_DBUS_OBJECT_PATH,
+            ROXTERM_DBUS_INTERFACE, ROXTERM_DBUS_SPAWNED_SIGNAL_NAME,
+            DBUS_TYPE_STRING, &id,
+            DBUS_TYPE_INT32, &ipid,
+            DBUS_TYPE_STRING, &message,
+            DBUS_TYPE_INVALID);
+    if (signal)
+        rtdbus_send_message(signal);
+    g_free(id);
 }
 
-static char *get_default_command(ROXTermData *roxterm)
+/* Mustn't free this error: https://bugzilla.gnome.org/show_bug.cgi?id=793675 */
+static void roxterm_fork_callback(VteTerminal *vte,
+        GPid pid, GError *error, gpointer user_data)
 {
-    char *command = NULL;
-    struct passwd *pinfo = getpwuid(getuid());
+    ROXTermData *roxterm = user_data;
 
-    if (pinfo)
+    roxterm->pid = pid;
+    if (!vte)
     {
-        command = g_strdup(pinfo->pw_shell);
+        roxterm->widget = NULL;
     }
     else
     {
-        dlg_warning(roxterm_get_toplevel(roxterm),
-                _("Unable to look up login details: %s"), strerror(errno));
+        if (roxterm->allow_osc52)
+            roxterm_create_osc52_filter(roxterm);
+        roxterm_update_output_log(roxterm);
+        roxterm_update_search_index(roxterm);
+        roxterm_attach_paste_tracker(roxterm);
+        roxterm_update_triggers(roxterm);
+        roxterm_attach_latency_stats(roxterm);
+    }
+    if (pid == -1)
+    {
+        roxterm_report_launch_error_async(roxterm,
+                _("Failed to run command"), error);
+    }
+    if (roxterm->report_spawn)
+    {
+        roxterm->report_spawn = FALSE;
+        roxterm_report_spawn(roxterm, pid, error);
     }
-    if (!command || !command[0])
-        command = g_strdup("/bin/sh");
-    return command;
 }
 
-static void roxterm_show_status(ROXTermData *roxterm, const char *name)
-{
-    if (name && !strcmp(name, "dialog-information") &&
-            roxterm->status_icon_name &&
-            (!strcmp(roxterm->status_icon_name, "dialog-warning") ||
-            !strcmp(roxterm->status_icon_name, "dialog_error")))
+static void roxterm_child_exited(VteTerminal *vte, int status,
+        ROXTermData *roxterm);
 
-    {
+static void roxterm_stop_pty_reader(ROXTermData *roxterm)
+{
+    if (!roxterm->own_pty)
         return;
+    roxterm_remove_osc52_filter(roxterm);
+    roxterm_stop_output_log(roxterm);
+    roxterm_detach_search_index(roxterm);
+    roxterm_detach_paste_tracker(roxterm);
+    roxterm_stop_triggers(roxterm);
+    roxterm_detach_latency_stats(roxterm);
+    roxterm_stop_paste(roxterm);
+    if (roxterm->child_watch_tag)
+    {
+        g_source_remove(roxterm->child_watch_tag);
+        roxterm->child_watch_tag = 0;
     }
-    roxterm->status_icon_name = name;
-    if (roxterm->tab && options_lookup_int_with_default(roxterm->profile,
-            "show_tab_status", FALSE))
+    if (roxterm->exit_wait_tag)
     {
-        multi_tab_set_status_icon_name(roxterm->tab, name);
+        g_source_remove(roxterm->exit_wait_tag);
+        roxterm->exit_wait_tag = 0;
+    }
+    if (roxterm->pty_reader)
+    {
+        pty_reader_free(roxterm->pty_reader);
+        roxterm->pty_reader = NULL;
     }
+    g_object_unref(roxterm->own_pty);
+    roxterm->own_pty = NULL;
 }
 
-static gboolean roxterm_command_failed(ROXTermData *roxterm)
+/* Reports the child's exit once its output has been fed to VTE, or after a
+ * short wait if something else is keeping the pty open.
+ */
+static gboolean roxterm_report_threaded_exit(gpointer data)
 {
-    MultiWin *win = roxterm_get_win(roxterm);
-    GtkWidget *w = win ? multi_win_get_widget(win) : NULL;
+    ROXTermData *roxterm = data;
 
-    dlg_critical(w ? GTK_WINDOW(w) : NULL, "%s", roxterm->reply);
-    g_free(roxterm->reply);
-    multi_tab_delete(roxterm->tab);
-    return FALSE;
+    roxterm->exit_wait_tag = 0;
+    roxterm->child_gone = FALSE;
+    roxterm_child_exited(VTE_TERMINAL(roxterm->widget),
+            roxterm->child_status, roxterm);
+    return G_SOURCE_REMOVE;
 }
 
-/* Returns NULL if cwd is apparently inaccessible */
-static const char *check_cwd(const char *cwd)
+static void roxterm_threaded_child_watch(GPid pid, int status, gpointer data)
 {
-    return (cwd && g_file_test(cwd, G_FILE_TEST_IS_DIR) &&
-            g_file_test(cwd, G_FILE_TEST_IS_EXECUTABLE)) ?
-            cwd : NULL;
+    ROXTermData *roxterm = data;
+
+    g_spawn_close_pid(pid);
+    roxterm->child_watch_tag = 0;
+    roxterm->child_status = status;
+    roxterm->child_gone = TRUE;
+    if (roxterm->pty_eof)
+        roxterm_report_threaded_exit(roxterm);
+    else
+        roxterm->exit_wait_tag = g_timeout_add(250,
+                roxterm_report_threaded_exit, roxterm);
 }
 
-/* Returns home dir if cwd is inaccessible. If home is also inaccessible
- * returns NULL. */
-static const char *roxterm_check_cwd(const char *cwd)
+static void roxterm_pty_reader_sink(const guint8 *buf, gsize len,
+        gpointer data)
 {
-    return check_cwd(cwd) ? cwd : check_cwd(g_get_home_dir());
+    ROXTermData *roxterm = data;
+
+    vte_terminal_feed(VTE_TERMINAL(roxterm->widget), (const char *) buf, len);
 }
 
-static void roxterm_report_launch_error_async(ROXTermData *roxterm,
-        const char *msg, GError *error)
+static void roxterm_pty_reader_eof(gpointer data)
 {
-    roxterm->reply = g_strdup_printf("%s: %s",
-            msg, error ? error->message : "?");
-    g_idle_add((GSourceFunc) roxterm_command_failed, roxterm);
+    ROXTermData *roxterm = data;
+
+    roxterm->pty_eof = TRUE;
+    if (roxterm->child_gone)
+    {
+        g_source_remove(roxterm->exit_wait_tag);
+        roxterm_report_threaded_exit(roxterm);
+    }
 }
 
-static Osc52Filter *roxterm_create_osc52_filter(ROXTermData *roxterm)
+/* Input and replies to queries from VTE; with no pty attached VTE doesn't
+ * send them anywhere itself.
+ */
+static void roxterm_commit_handler(VteTerminal *vte,
+        const char *text, guint size, ROXTermData *roxterm)
 {
-    int buflen = options_lookup_int_with_default(roxterm->profile,
-                                                 "osc52_buffer_size", 100);
-    roxterm->osc52_filter = osc52filter_create(roxterm,
-                                               (size_t) buflen * 1024);
-    return roxterm->osc52_filter;
+    (void) vte;
+    if (roxterm->pty_reader)
+        pty_reader_write(roxterm->pty_reader, text, size);
 }
 
-/* Mustn't free this error: https://bugzilla.gnome.org/show_bug.cgi?id=793675 */
-static void roxterm_fork_callback(VteTerminal *vte,
-        GPid pid, GError *error, gpointer user_data)
+static void roxterm_sync_own_pty_size(ROXTermData *roxterm)
 {
-    ROXTermData *roxterm = user_data;
+    VteTerminal *vte = VTE_TERMINAL(roxterm->widget);
+    int columns = (int) vte_terminal_get_column_count(vte);
+    int rows = (int) vte_terminal_get_row_count(vte);
 
-    roxterm->pid = pid;
-    if (!vte)
+    if (roxterm->own_pty &&
+            (columns != roxterm->pty_columns || rows != roxterm->pty_rows))
     {
-        roxterm->widget = NULL;
+        GError *error = NULL;
+
+        roxterm->pty_columns = columns;
+        roxterm->pty_rows = rows;
+        if (!vte_pty_set_size(roxterm->own_pty, rows, columns, &error))
+        {
+            g_warning(_("Unable to set pty size: %s"), error->message);
+            g_error_free(error);
+        }
     }
-    else if (roxterm->allow_osc52)
+}
+
+static void roxterm_vte_size_allocate(GtkWidget *widget,
+        GdkRectangle *alloc, ROXTermData *roxterm)
+{
+    (void) widget;
+    (void) alloc;
+    roxterm_sync_own_pty_size(roxterm);
+    if (roxterm->search_index)
     {
-        roxterm_create_osc52_filter(roxterm);
+        VteTerminal *vte = VTE_TERMINAL(roxterm->widget);
+
+        ngram_index_set_geometry(roxterm->search_index,
+                (int) vte_terminal_get_column_count(vte),
+                (int) vte_terminal_get_row_count(vte));
     }
-    if (pid == -1)
+}
+
+/* The scrollback can be changed by the profile or the scrollback governor */
+static void roxterm_scrollback_lines_changed(GObject *vte,
+        GParamSpec *pspec, ROXTermData *roxterm)
+{
+    (void) pspec;
+    if (roxterm->search_index)
     {
-        roxterm_report_launch_error_async(roxterm,
-                _("Failed to run command"), error);
+        ngram_index_set_scrollback_lines(roxterm->search_index,
+                vte_terminal_get_scrollback_lines(VTE_TERMINAL(vte)));
+    }
+}
+
+static void roxterm_threaded_spawn_callback(GObject *source,
+        GAsyncResult *result, gpointer data)
+{
+    ROXTermData *roxterm = data;
+    GPid pid = -1;
+    GError *error = NULL;
+
+    if (!vte_pty_spawn_finish(VTE_PTY(source), result, &pid, &error))
+        pid = -1;
+    /* The reader isn't started until now because there's nothing to read and
+     * the pty may appear to be hung up until the child has opened it.
+     */
+    if (pid != -1)
+    {
+        roxterm->pty_reader = pty_reader_new(vte_pty_get_fd(roxterm->own_pty),
+                (gsize) options_lookup_int_with_default(roxterm->profile,
+                        "pty_reader_queue_size", 1024) * 1024,
+                roxterm_pty_reader_sink, roxterm_pty_reader_eof, roxterm);
+        roxterm->child_watch_tag = g_child_watch_add(pid,
+                roxterm_threaded_child_watch, roxterm);
+    }
+    roxterm_fork_callback(VTE_TERMINAL(roxterm->widget), pid, error, roxterm);
+    if (error)
+        g_error_free(error);
+}
+
+/* Creates a pty which isn't attached to VTE, then spawns the command; a thread
+ * to read the pty is started when that has succeeded. Returns FALSE if the pty
+ * couldn't be created.
+ */
+static gboolean roxterm_fork_command_threaded(ROXTermData *roxterm,
+        char **argv, char **envv,
+        const char *working_directory, GSpawnFlags flags)
+{
+    GError *error = NULL;
+    VtePty *pty = vte_pty_new_sync(VTE_PTY_DEFAULT, NULL, &error);
+    if (!pty)
+    {
+        g_warning(_("Unable to create pty: %s"), error->message);
+        g_error_free(error);
+        return FALSE;
     }
+    roxterm->own_pty = pty;
+    roxterm->child_gone = FALSE;
+    roxterm->pty_eof = FALSE;
+    roxterm->pty_columns = roxterm->pty_rows = -1;
+    roxterm_sync_own_pty_size(roxterm);
+    vte_pty_spawn_async(pty, working_directory, argv, envv, flags,
+            NULL, NULL, NULL,
+            -1, NULL,
+            roxterm_threaded_spawn_callback, roxterm);
+    return TRUE;
 }
 
 static void roxterm_fork_command(ROXTermData *roxterm, VteTerminal *vte,
@@ -599,6 +1684,7 @@ static void roxterm_fork_command(ROXTermData *roxterm, VteTerminal *vte,
         const char *working_directory,
         gboolean login)
 {
+    GSpawnFlags flags;
     char *filename = argv[0];
     char **new_argv = NULL;
 
@@ -629,13 +1715,20 @@ static void roxterm_fork_command(ROXTermData *roxterm, VteTerminal *vte,
      * appears to prevent our process' env from being merged into the envv we're
      * passing in here, which is behaviour we want.
      */
-    vte_terminal_spawn_async(vte, VTE_PTY_DEFAULT,
-            working_directory, argv, envv, 
-            (login ? G_SPAWN_FILE_AND_ARGV_ZERO : G_SPAWN_SEARCH_PATH) |
-            VTE_SPAWN_NO_PARENT_ENVV,
-            NULL, NULL, NULL,
-            -1, NULL,
-            roxterm_fork_callback, roxterm);
+    flags = (login ? G_SPAWN_FILE_AND_ARGV_ZERO : G_SPAWN_SEARCH_PATH) |
+            VTE_SPAWN_NO_PARENT_ENVV;
+    roxterm_stop_pty_reader(roxterm);
+    if (!options_lookup_int_with_default(roxterm->profile,
+                "pty_reader_thread", FALSE) ||
+            !roxterm_fork_command_threaded(roxterm, argv, envv,
+                working_directory, flags))
+    {
+        vte_terminal_spawn_async(vte, VTE_PTY_DEFAULT,
+                working_directory, argv, envv, flags,
+                NULL, NULL, NULL,
+                -1, NULL,
+                roxterm_fork_callback, roxterm);
+    }
     if (new_argv)
     {
         g_free(new_argv[1]);
@@ -903,6 +1996,29 @@ static void roxterm_launch_matched_uri(ROXTermData *roxterm, guint32 timestamp)
     g_free(mod);
 }
 
+/* Terminals opened in bulk start their commands one at a time at this
+ * interval in ms, so opening dozens of them doesn't cause a fork storm.
+ */
+#define ROXTERM_SPAWN_INTERVAL 20
+
+static GQueue roxterm_spawn_queue = G_QUEUE_INIT;
+static guint roxterm_spawn_queue_tag = 0;
+
+static gboolean roxterm_spawn_next(gpointer data)
+{
+    ROXTermData *roxterm = g_queue_pop_head(&roxterm_spawn_queue);
+
+    (void) data;
+    if (roxterm && !roxterm->running && roxterm->widget)
+        roxterm_run_command(roxterm, VTE_TERMINAL(roxterm->widget));
+    if (g_queue_is_empty(&roxterm_spawn_queue))
+    {
+        roxterm_spawn_queue_tag = 0;
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
 static void roxterm_data_delete(ROXTermData *roxterm)
 {
     /* This doesn't delete widgets because they're deleted when removed from
@@ -926,8 +2042,16 @@ static void roxterm_data_delete(ROXTermData *roxterm)
     {
         g_signal_handler_disconnect(gwin, roxterm->win_state_changed_tag);
     }
+    /* When a lot of tabs are closed at once their widgets are destroyed in the
+     * background, so hang up the child now instead of waiting for VTE to */
+    if (roxterm->running && roxterm->pid > 0)
+        kill(roxterm->pid, SIGHUP);
     if (roxterm->post_exit_tag)
         g_source_remove(roxterm->post_exit_tag);
+    if (roxterm->restore_scrollback_tag)
+        g_source_remove(roxterm->restore_scrollback_tag);
+    g_free(roxterm->restore_scrollback);
+    g_queue_remove(&roxterm_spawn_queue, roxterm);
     if (roxterm->colour_scheme)
     {
         UNREF_LOG(colour_scheme_unref(roxterm->colour_scheme));
@@ -944,13 +2068,47 @@ static void roxterm_data_delete(ROXTermData *roxterm)
         g_strfreev(roxterm->commandv);
     g_free(roxterm->directory);
     g_strfreev(roxterm->env);
-    if (roxterm->pango_desc)
-        pango_font_description_free(roxterm->pango_desc);
+    g_free(roxterm->font_name);
+    g_free(roxterm->matched_url);
+    g_free(roxterm->uri_tags);
+    if (roxterm->uri_rest_tag)
+        g_source_remove(roxterm->uri_rest_tag);
+    if (roxterm->uri_motion_event)
+        gdk_event_free(roxterm->uri_motion_event);
+    g_free(roxterm->uri_hit_url);
     g_free(roxterm->buffer_file_name);
-    if (roxterm->osc52_filter)
+    roxterm_stop_pty_reader(roxterm);
+    roxterm_remove_osc52_filter(roxterm);
+    roxterm_stop_output_log(roxterm);
+    roxterm_detach_search_index(roxterm);
+    if (roxterm->search_index)
     {
-        osc52filter_remove(roxterm->osc52_filter);
-        roxterm->osc52_filter = NULL;
+        ngram_index_free(roxterm->search_index);
+        roxterm->search_index = NULL;
+    }
+    roxterm_clear_search_regex(roxterm);
+    roxterm_stop_paste(roxterm);
+    roxterm_detach_paste_tracker(roxterm);
+    if (roxterm->paste_tracker)
+    {
+        paste_tracker_free(roxterm->paste_tracker);
+        roxterm->paste_tracker = NULL;
+    }
+    roxterm_stop_triggers(roxterm);
+    roxterm_detach_latency_stats(roxterm);
+    if (roxterm->widget)
+        roxterm_unrealize_handler(roxterm->widget, roxterm);
+    latency_stats_free(roxterm->latency);
+    roxterm->latency = NULL;
+    if (roxterm->scrollback)
+    {
+        scrollback_client_delete(roxterm->scrollback);
+        roxterm->scrollback = NULL;
+    }
+    if (roxterm->activity)
+    {
+        activity_monitor_delete(roxterm->activity);
+        roxterm->activity = NULL;
     }
     if (roxterm->replace_task_dialog)
     {
@@ -1147,15 +2305,52 @@ roxterm_get_padding(ROXTermData *roxterm, int *width, int *height)
     *height = padding.top + padding.bottom + 2;
 }
 
+static int roxterm_lookup_spacing(ROXTermData *roxterm, const char *key)
+{
+    return CLAMP(options_lookup_int_with_default(roxterm->profile, key, 0),
+            0, 100);
+}
+
+/* Gets the size of a character cell, including spacing (cell-*-scale). Other
+ * terminals using the same font, zoom and spacing share the measurement via
+ * the font cache.
+ */
+static void roxterm_get_cell_size(ROXTermData *roxterm, VteTerminal *vte,
+        int *width, int *height)
+{
+    gboolean cacheable = roxterm->font_name &&
+            roxterm->current_zoom_factor == roxterm->target_zoom_factor;
+    int hspacing = 0, vspacing = 0;
+
+    if (cacheable)
+    {
+        hspacing = roxterm_lookup_spacing(roxterm, "hspacing");
+        vspacing = roxterm_lookup_spacing(roxterm, "vspacing");
+        if (font_cache_get_cell_size(roxterm->font_name,
+                roxterm->current_zoom_factor, hspacing, vspacing,
+                width, height))
+        {
+            return;
+        }
+    }
+    *width = vte_terminal_get_char_width(vte);
+    *height = vte_terminal_get_char_height(vte);
+    /* VTE can't measure the font properly until it's realized */
+    if (cacheable && gtk_widget_get_realized(roxterm->widget))
+    {
+        font_cache_set_cell_size(roxterm->font_name,
+                roxterm->current_zoom_factor, hspacing, vspacing,
+                *width, *height);
+    }
+}
+
 static void roxterm_geometry_func(ROXTermData *roxterm,
         GdkGeometry *geom, GdkWindowHints *hints)
 {
     VteTerminal *vte = VTE_TERMINAL(roxterm->widget);
 
     roxterm_get_padding(roxterm, &geom->base_width, &geom->base_height);
-    /* The following results include spacing (cell-*-scale) */
-    geom->width_inc = vte_terminal_get_char_width(vte);
-    geom->height_inc = vte_terminal_get_char_height(vte);
+    roxterm_get_cell_size(roxterm, vte, &geom->width_inc, &geom->height_inc);
     geom->min_width = geom->base_width + 4 * geom->width_inc;
     geom->min_height = geom->base_height + 4 * geom->height_inc;
     if (hints)
@@ -1174,11 +2369,12 @@ static void roxterm_size_func(ROXTermData *roxterm, gboolean pixels,
     if (pixels)
     {
         int px, py;
+        int cw, ch;
 
         roxterm_get_padding(roxterm, &px, &py);
-        /* The following results include spacing (cell-*-scale) */
-        *pwidth = *pwidth * vte_terminal_get_char_width(vte) + px;
-        *pheight = *pheight * vte_terminal_get_char_height(vte) + py;
+        roxterm_get_cell_size(roxterm, vte, &cw, &ch);
+        *pwidth = *pwidth * cw + px;
+        *pheight = *pheight * ch + py;
     }
 }
 
@@ -1208,121 +2404,78 @@ static void roxterm_update_size(ROXTermData * roxterm, VteTerminal * vte)
     roxterm_update_geometry(roxterm, vte);
 }
 
-static void resize_pango_for_zoom(PangoFontDescription *pango_desc,
-        double zf)
-{
-    int size;
-    gboolean abs = FALSE;
-
-    if (zf == 1.0)
-        return;
-    size = pango_font_description_get_size(pango_desc);
-    if (!size)
-        size = 10 * PANGO_SCALE;
-    else
-        abs = pango_font_description_get_size_is_absolute(pango_desc);
-    size = (int) ((double) size * zf);
-    if (abs)
-        pango_font_description_set_absolute_size(pango_desc, size);
-    else
-        pango_font_description_set_size(pango_desc, size);
-}
-
 /* The spacing apply functions don't need to explicitly resize the window
  * because VTE triggers the apropriate signal.
  */
 static void
 roxterm_apply_vspacing(ROXTermData *roxterm, VteTerminal *vte)
 {
-    double spacing = (double) options_lookup_int_with_default(roxterm->profile,
-            "vspacing", 0) / 100.0;
+    double spacing =
+            (double) roxterm_lookup_spacing(roxterm, "vspacing") / 100.0;
 
-    vte_terminal_set_cell_height_scale(vte, CLAMP(spacing, 0.0, 1.0) + 1.0);
+    vte_terminal_set_cell_height_scale(vte, spacing + 1.0);
 }
 
 static void
 roxterm_apply_hspacing(ROXTermData *roxterm, VteTerminal *vte)
 {
-    double spacing = (double) options_lookup_int_with_default(roxterm->profile,
-            "hspacing", 0) / 100.0;
+    double spacing =
+            (double) roxterm_lookup_spacing(roxterm, "hspacing") / 100.0;
 
-    vte_terminal_set_cell_width_scale(vte, CLAMP(spacing, 0.0, 1.0) + 1.0);
+    vte_terminal_set_cell_width_scale(vte, spacing + 1.0);
 }
 
+static void
+roxterm_update_font(ROXTermData *roxterm, VteTerminal *vte,
+    gboolean update_geometry);
+
 static void
 roxterm_apply_profile_font(ROXTermData *roxterm, VteTerminal *vte,
     gboolean update_geometry)
 {
-    char *fdesc;
-    PangoFontDescription *pango_desc = NULL;
-    int w = vte_terminal_get_column_count(vte);
-    int h = vte_terminal_get_row_count(vte);
-
-    if (roxterm->pango_desc)
-    {
-        pango_font_description_free(roxterm->pango_desc);
-        roxterm->pango_desc = NULL;
-    }
-    fdesc = options_lookup_string(roxterm->profile, "font");
-    double zf = roxterm->target_zoom_factor;
+    char *fdesc = options_lookup_string(roxterm->profile, "font");
 
+    g_free(roxterm->font_name);
+    roxterm->font_name = NULL;
     if (fdesc && fdesc[0])
     {
-        pango_desc = pango_font_description_from_string(fdesc);
-        if (!pango_desc)
-            g_warning(_("Couldn't create a font from '%s'"), fdesc);
-    }
-    if (!pango_desc)
-    {
-        if (zf == roxterm->current_zoom_factor)
-        {
-            if (fdesc)
-                g_free(fdesc);
-            return;
-        }
-        pango_desc = pango_font_description_copy(
-                vte_terminal_get_font(vte));
-        zf /= roxterm->current_zoom_factor;
-    }
-    if (!pango_desc)
-    {
-        g_free(fdesc);
-        g_return_if_fail(pango_desc != NULL);
+        roxterm->font_name = fdesc;
+        fdesc = NULL;
     }
-    resize_pango_for_zoom(pango_desc, zf);
-    vte_terminal_set_font(vte, pango_desc);
-    roxterm->pango_desc = pango_desc;
     g_free(fdesc);
-    roxterm->current_zoom_factor = roxterm->target_zoom_factor;
-    roxterm_apply_vspacing(roxterm, vte);
-    roxterm_apply_hspacing(roxterm, vte);
-    if (update_geometry)
+    if (!roxterm->font_name)
     {
-        roxterm_set_vte_size(roxterm, vte, w, h);
+        /* Leave VTE's default font alone unless it's being zoomed */
+        if (roxterm->target_zoom_factor == roxterm->current_zoom_factor)
+            return;
+        roxterm->font_name = font_cache_unzoomed_name(
+                vte_terminal_get_font(vte), roxterm->current_zoom_factor);
     }
+    roxterm_update_font(roxterm, vte, update_geometry);
 }
 
+/* Every terminal using the same font at the same zoom level shares one font
+ * description from the font cache, so they don't each have to parse and scale
+ * it. VTE shares its measurements of equal descriptions too.
+ */
 static void
 roxterm_update_font(ROXTermData *roxterm, VteTerminal *vte,
     gboolean update_geometry)
 {
-    PangoFontDescription *pango_desc = NULL;
-    double zf;
+    const PangoFontDescription *pango_desc;
     int w, h;
 
-    if (!roxterm->pango_desc)
+    if (!roxterm->font_name)
     {
         roxterm_apply_profile_font(roxterm, vte, update_geometry);
         return;
     }
     w = vte_terminal_get_column_count(vte);
     h = vte_terminal_get_row_count(vte);
-    zf = roxterm->target_zoom_factor /
-            (roxterm->current_zoom_factor ?
-                    roxterm->current_zoom_factor : 1);
-    pango_desc = roxterm->pango_desc;
-    resize_pango_for_zoom(pango_desc, zf);
-    vte_terminal_set_font(vte, pango_desc);
+    pango_desc = font_cache_lookup(roxterm->font_name,
+            roxterm->target_zoom_factor);
+    if (!pango_font_description_equal(vte_terminal_get_font(vte), pango_desc))
+        vte_terminal_set_font(vte, pango_desc);
     roxterm->current_zoom_factor = roxterm->target_zoom_factor;
     roxterm_apply_vspacing(roxterm, vte);
     roxterm_apply_hspacing(roxterm, vte);
@@ -1363,24 +2516,163 @@ static void roxterm_match_text_size(ROXTermData *roxterm, ROXTermData *other)
     {
         vte_terminal_set_font(vte, fd);
     }
-    roxterm_set_vte_size(roxterm, VTE_TERMINAL(roxterm->widget),
-            width, height);
+    roxterm_set_vte_size(roxterm, VTE_TERMINAL(roxterm->widget),
+            width, height);
+}
+
+static gboolean roxterm_about_uri_hook(GtkAboutDialog *about,
+        gchar *link, gpointer data)
+{
+    (void) about;
+    roxterm_launch_uri(data, link, gtk_get_current_event_time());
+    return TRUE;
+}
+
+static gboolean roxterm_popup_handler(GtkWidget * widget, ROXTermData * roxterm)
+{
+    (void) widget;
+    roxterm_set_show_uri_menu_items(roxterm, ROXTerm_DontShowURIMenuItems);
+    multi_tab_popup_menu_at_pointer(roxterm->tab);
+    return TRUE;
+}
+
+/* Converts an event's position to a row in the whole buffer and a column */
+static gboolean roxterm_get_event_cell(ROXTermData *roxterm, VteTerminal *vte,
+        GdkEvent *event, glong *row, glong *column)
+{
+    GtkAdjustment *vadj = gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(vte));
+    glong cw = vte_terminal_get_char_width(vte);
+    glong ch = vte_terminal_get_char_height(vte);
+    GtkBorder padding;
+    double x, y;
+
+    if (!gdk_event_get_coords(event, &x, &y) || cw <= 0 || ch <= 0)
+        return FALSE;
+    gtk_style_context_get_padding(gtk_widget_get_style_context(roxterm->widget),
+            gtk_widget_get_state_flags(roxterm->widget), &padding);
+    x -= padding.left;
+    y -= padding.top;
+    if (x < 0 || y < 0)
+        return FALSE;
+    *column = (glong) x / cw;
+    *row = (glong) y / ch + (glong) gtk_adjustment_get_value(vadj);
+    return TRUE;
+}
+
+inline static gboolean roxterm_uri_hit_contains(ROXTermData *roxterm,
+        glong row, glong column)
+{
+    return row == roxterm->uri_hit_row &&
+            column >= roxterm->uri_hit_start && column < roxterm->uri_hit_end;
+}
+
+static void roxterm_forget_uri_hit(ROXTermData *roxterm)
+{
+    roxterm->uri_hit_row = -1;
+    g_free(roxterm->uri_hit_url);
+    roxterm->uri_hit_url = NULL;
+}
+
+/* Works out which cells of row the URI under column occupies, so that
+ * following tests along the same URI can use the cached result. If the text
+ * has wide characters, or the URI is wrapped from another row, only the
+ * tested cell is cached.
+ */
+static void roxterm_cache_uri_hit(ROXTermData *roxterm, VteTerminal *vte,
+        glong row, glong column, char *url, ROXTerm_MatchType type)
+{
+    gsize len;
+    char *text = url ? roxterm_get_text_rows(vte, row, row, &len) : NULL;
+    const char *p;
+
+    roxterm_forget_uri_hit(roxterm);
+    roxterm->uri_hit_row = row;
+    roxterm->uri_hit_start = column;
+    roxterm->uri_hit_end = column + 1;
+    roxterm->uri_hit_url = url;
+    roxterm->uri_hit_type = type;
+    if (!text)
+        return;
+    for (p = text; *p; p = g_utf8_next_char(p))
+    {
+        if (g_unichar_iswide(g_utf8_get_char(p)))
+        {
+            g_free(text);
+            return;
+        }
+    }
+    for (p = strstr(text, url); p; p = strstr(p + 1, url))
+    {
+        glong start = g_utf8_pointer_to_offset(text, p);
+        glong end = start + g_utf8_strlen(url, -1);
+
+        if (column >= start && column < end)
+        {
+            roxterm->uri_hit_start = start;
+            roxterm->uri_hit_end = end;
+            break;
+        }
+    }
+    g_free(text);
+}
+
+/* Finds a URI under an event's position without needing the regexes to be
+ * registered with VTE. The result is cached until the pointer leaves its span
+ * or the terminal's contents change. Returns a copy of the URI or NULL.
+ */
+static char *roxterm_uri_hit_test(ROXTermData *roxterm, VteTerminal *vte,
+        GdkEvent *event, ROXTerm_MatchType *type)
+{
+    glong row, column;
+    char **matches;
+    char *url = NULL;
+    int n;
+
+    if (!roxterm_get_event_cell(roxterm, vte, event, &row, &column))
+        return NULL;
+    if (!roxterm_uri_hit_contains(roxterm, row, column))
+    {
+        ROXTerm_MatchType match_type = ROXTerm_Match_Invalid;
+
+        roxterm_compile_uri_regexes();
+        matches = g_new0(char *, roxterm_n_uri_regexes);
+        if (vte_terminal_event_check_regex_simple(vte, event,
+                roxterm_uri_regexes, roxterm_n_uri_regexes, 0, matches))
+        {
+            /* Like VTE, the earliest regex wins */
+            for (n = 0; n < roxterm_n_uri_regexes; ++n)
+            {
+                if (matches[n] && !url)
+                {
+                    url = matches[n];
+                    match_type = roxterm_uri_match_types[n];
+                }
+                else
+                {
+                    g_free(matches[n]);
+                }
+            }
+        }
+        g_free(matches);
+        roxterm_cache_uri_hit(roxterm, vte, row, column, url, match_type);
+    }
+    if (type)
+        *type = roxterm->uri_hit_type;
+    return g_strdup(roxterm->uri_hit_url);
 }
 
-static gboolean roxterm_about_uri_hook(GtkAboutDialog *about,
-        gchar *link, gpointer data)
+static void roxterm_contents_changed_handler(VteTerminal *vte,
+        ROXTermData *roxterm)
 {
-    (void) about;
-    roxterm_launch_uri(data, link, gtk_get_current_event_time());
-    return TRUE;
-}
+    if (roxterm->uri_hit_row != -1)
+        roxterm_forget_uri_hit(roxterm);
+    if (roxterm->search_index)
+    {
+        glong row;
 
-static gboolean roxterm_popup_handler(GtkWidget * widget, ROXTermData * roxterm)
-{
-    (void) widget;
-    roxterm_set_show_uri_menu_items(roxterm, ROXTerm_DontShowURIMenuItems);
-    multi_tab_popup_menu_at_pointer(roxterm->tab);
-    return TRUE;
+        vte_terminal_get_cursor_position(vte, NULL, &row);
+        ngram_index_anchor(roxterm->search_index, row);
+    }
 }
 
 /* Checks whether a button event position is over a matched expression; if so
@@ -1397,13 +2689,20 @@ static gboolean roxterm_check_match(ROXTermData *roxterm, VteTerminal *vte,
     g_free(roxterm->matched_url);
     /* If we're over a hyperlink we should also have a pattern match; be lazy
      * and use that to work out the type of link */
-    roxterm->matched_url = vte_terminal_match_check_event(vte, event, &tag);
-    if (roxterm->matched_url)
+    if (roxterm_lazy_uri_matching)
+    {
+        roxterm->matched_url = roxterm_uri_hit_test(roxterm, vte, event,
+                &roxterm->match_type);
+    }
+    else
     {
-        roxterm->match_type = roxterm_get_match_type(roxterm, tag);
+        roxterm->matched_url = vte_terminal_match_check_event(vte, event,
+                &tag);
+        if (roxterm->matched_url)
+            roxterm->match_type = roxterm_get_match_type(roxterm, tag);
     }
 #if VTE_CHECK_VERSION(0,50,0)
-    else if (hyper)
+    if (!roxterm->matched_url && hyper)
     {
         roxterm->match_type = ROXTerm_Match_FullURI;
     }
@@ -1416,6 +2715,92 @@ static gboolean roxterm_check_match(ROXTermData *roxterm, VteTerminal *vte,
     return roxterm->matched_url != NULL;
 }
 
+static gboolean roxterm_uri_rest_timeout(ROXTermData *roxterm)
+{
+    VteTerminal *vte = VTE_TERMINAL(roxterm->widget);
+    gint64 idle = (g_get_monotonic_time() - roxterm->uri_motion_time) / 1000;
+    char *url;
+
+    /* Motion doesn't restart the timer, it just moves the goalposts */
+    if (idle < ROXTERM_URI_REST_MS)
+    {
+        roxterm->uri_rest_tag = g_timeout_add(ROXTERM_URI_REST_MS - idle,
+                (GSourceFunc) roxterm_uri_rest_timeout, roxterm);
+        return G_SOURCE_REMOVE;
+    }
+    roxterm->uri_rest_tag = 0;
+    if (!roxterm_lazy_uri_matching || !roxterm->uri_motion_event)
+        return G_SOURCE_REMOVE;
+    url = roxterm_uri_hit_test(roxterm, vte, roxterm->uri_motion_event, NULL);
+    if (url)
+    {
+        /* VTE highlights it as soon as the pointer moves within the URI */
+        roxterm_add_uri_matches(roxterm, vte);
+        g_free(url);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+/* In lazy mode the URI regexes are only registered with VTE while Ctrl is
+ * held, or while the pointer stays on a URI it has rested on, so VTE doesn't
+ * have to run them as the pointer moves over dense output.
+ */
+static gboolean roxterm_uri_motion_handler(GtkWidget *widget,
+        GdkEventMotion *event, ROXTermData *roxterm)
+{
+    VteTerminal *vte = VTE_TERMINAL(widget);
+
+    if (!roxterm_lazy_uri_matching)
+        return FALSE;
+    if (event->state & GDK_CONTROL_MASK)
+    {
+        roxterm_add_uri_matches(roxterm, vte);
+        return FALSE;
+    }
+    if (roxterm->uri_matches_active)
+    {
+        glong row, column;
+
+        if (roxterm_get_event_cell(roxterm, vte, (GdkEvent *) event,
+                &row, &column) && roxterm->uri_hit_url &&
+                roxterm_uri_hit_contains(roxterm, row, column))
+        {
+            return FALSE;
+        }
+        roxterm_remove_uri_matches(roxterm, vte);
+    }
+    if (roxterm->uri_motion_event)
+        gdk_event_free(roxterm->uri_motion_event);
+    roxterm->uri_motion_event = gdk_event_copy((GdkEvent *) event);
+    roxterm->uri_motion_time = g_get_monotonic_time();
+    if (!roxterm->uri_rest_tag)
+    {
+        roxterm->uri_rest_tag = g_timeout_add(ROXTERM_URI_REST_MS,
+                (GSourceFunc) roxterm_uri_rest_timeout, roxterm);
+    }
+    return FALSE;
+}
+
+static gboolean roxterm_uri_key_release_handler(GtkWidget *widget,
+        GdkEventKey *event, ROXTermData *roxterm)
+{
+    if (roxterm_lazy_uri_matching && (event->keyval == GDK_KEY_Control_L ||
+            event->keyval == GDK_KEY_Control_R))
+    {
+        roxterm_remove_uri_matches(roxterm, VTE_TERMINAL(widget));
+    }
+    return FALSE;
+}
+
+static gboolean roxterm_uri_focus_out_handler(GtkWidget *widget,
+        GdkEvent *event, ROXTermData *roxterm)
+{
+    (void) event;
+    if (roxterm_lazy_uri_matching)
+        roxterm_remove_uri_matches(roxterm, VTE_TERMINAL(widget));
+    return FALSE;
+}
+
 static void roxterm_clear_hold_over_uri(ROXTermData *roxterm)
 {
     if (roxterm->hold_over_uri)
@@ -1691,12 +3076,397 @@ static void roxterm_shade_save_buffer_menu_item(ROXTermData *roxterm)
         MENUTREE_FILE_SAVE_BUFFER, shade);
 }
 
+#define ROXTERM_RESTORE_CHUNK 65536
+
+/* Feeds the scrollback saved with a session to the terminal. VTE treats it
+ * as pty output, so newlines have to be converted to CRLF.
+ */
+static void roxterm_restore_scrollback(ROXTermData *roxterm)
+{
+    char *filename = roxterm->restore_scrollback;
+    VteTerminal *vte = VTE_TERMINAL(roxterm->widget);
+    GFile *gfile;
+    GFileInputStream *fstream;
+    GZlibDecompressor *zlib;
+    GInputStream *stream;
+    GError *error = NULL;
+    char *buf;
+    char *crlf;
+    gssize nread;
+
+    if (!filename)
+        return;
+    roxterm->restore_scrollback = NULL;
+    gfile = g_file_new_for_path(filename);
+    fstream = g_file_read(gfile, NULL, &error);
+    g_object_unref(gfile);
+    if (!fstream)
+    {
+        g_warning(_("Unable to restore scrollback from '%s': %s"),
+                filename, error->message);
+        g_error_free(error);
+        g_free(filename);
+        return;
+    }
+    zlib = g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP);
+    stream = g_converter_input_stream_new(G_INPUT_STREAM(fstream),
+            G_CONVERTER(zlib));
+    g_object_unref(zlib);
+    g_object_unref(fstream);
+    buf = g_malloc(ROXTERM_RESTORE_CHUNK);
+    crlf = g_malloc(ROXTERM_RESTORE_CHUNK * 2);
+    while ((nread = g_input_stream_read(stream, buf, ROXTERM_RESTORE_CHUNK,
+                    NULL, &error)) > 0)
+    {
+        gssize n;
+        gssize len = 0;
+
+        for (n = 0; n < nread; ++n)
+        {
+            if (buf[n] == '\n')
+                crlf[len++] = '\r';
+            crlf[len++] = buf[n];
+        }
+        vte_terminal_feed(vte, crlf, len);
+    }
+    if (nread < 0)
+    {
+        g_warning(_("Unable to restore scrollback from '%s': %s"),
+                filename, error->message);
+        g_error_free(error);
+    }
+    g_free(crlf);
+    g_free(buf);
+    g_object_unref(stream);
+    g_free(filename);
+}
+
+static gboolean run_child_when_idle(ROXTermData *roxterm)
+{
+    roxterm->restore_scrollback_tag = 0;
+    if (roxterm->restore_scrollback)
+    {
+        /* Restoring the scrollback of every tab in a big session would make
+         * loading it slow, so a tab which isn't showing waits until it's
+         * selected, and so does its command.
+         */
+        if (multi_win_get_current_tab(roxterm_get_win(roxterm)) !=
+                roxterm->tab)
+        {
+            return FALSE;
+        }
+        roxterm_restore_scrollback(roxterm);
+    }
+    if (roxterm->stagger_spawn)
+    {
+        roxterm->stagger_spawn = FALSE;
+        g_queue_push_tail(&roxterm_spawn_queue, roxterm);
+        if (!roxterm_spawn_queue_tag)
+        {
+            roxterm_spawn_queue_tag = g_timeout_add(ROXTERM_SPAWN_INTERVAL,
+                    roxterm_spawn_next, NULL);
+        }
+        return FALSE;
+    }
+    if (!roxterm->running)
+        roxterm_run_command(roxterm, VTE_TERMINAL(roxterm->widget));
+    return FALSE;
+}
+
+char *roxterm_describe_latency(void)
+{
+    GString *s = g_string_new(NULL);
+    GList *link;
+    gboolean first = TRUE;
+
+    g_string_append_printf(s, "{\"pid\": %d, \"terminals\": [",
+            (int) getpid());
+    for (link = roxterm_terms; link; link = g_list_next(link))
+    {
+        ROXTermData *roxterm = link->data;
+        const char *title = roxterm->tab ?
+                multi_tab_get_window_title(roxterm->tab) : NULL;
+
+        if (!roxterm->latency && !roxterm->activity)
+            continue;
+        g_string_append_printf(s, "%s\n  {\"title\": ", first ? "" : ",");
+        output_log_append_json_string(s, title);
+        /* Bells dropped by the rate limit, so a flood of them shows up */
+        if (roxterm->activity)
+        {
+            g_string_append_printf(s, ", \"dropped_bells\": %u",
+                    activity_monitor_get_dropped_bells(roxterm->activity));
+        }
+        if (roxterm->latency)
+        {
+            g_string_append(s, ", \"stats\": ");
+            latency_stats_describe(roxterm->latency, s);
+        }
+        g_string_append_c(s, '}');
+        first = FALSE;
+    }
+    g_string_append(s, "\n]}\n");
+    return g_string_free(s, FALSE);
+}
+
+/* A rough figure for the memory used by each cell of scrollback. VTE stores
+ * scrollback compressed in unlinked temporary files, so depending on where
+ * those are, this may be disk or tmpfs rather than heap.
+ */
+#define ROXTERM_SCROLLBACK_CELL_BYTES 2
+#define ROXTERM_SCROLLBACK_ROW_BYTES 16
+
+typedef struct {
+    guint widgets;
+    guint menu_items;
+} ROXTermWidgetCount;
+
+static void roxterm_count_widgets(GtkWidget *widget, gpointer data)
+{
+    ROXTermWidgetCount *count = data;
+
+    ++count->widgets;
+    if (GTK_IS_MENU_ITEM(widget))
+    {
+        GtkWidget *submenu = gtk_menu_item_get_submenu(GTK_MENU_ITEM(widget));
+
+        ++count->menu_items;
+        if (submenu)
+            roxterm_count_widgets(submenu, data);
+    }
+    if (GTK_IS_CONTAINER(widget))
+    {
+        gtk_container_forall(GTK_CONTAINER(widget), roxterm_count_widgets,
+                data);
+    }
+}
+
+static void roxterm_describe_window_memory(MultiWin *win, GString *s)
+{
+    GtkWidget *gwin = multi_win_get_widget(win);
+    MenuTree *menus[3];
+    ROXTermWidgetCount window_count = { 0, 0 };
+    ROXTermWidgetCount menu_count = { 0, 0 };
+    guint n;
+
+    menus[0] = multi_win_get_menu_bar(win);
+    menus[1] = multi_win_get_popup_menu(win);
+    menus[2] = multi_win_get_short_popup_menu(win);
+    roxterm_count_widgets(gwin, &window_count);
+    for (n = 0; n < G_N_ELEMENTS(menus); ++n)
+    {
+        if (menus[n])
+        {
+            roxterm_count_widgets(menutree_get_top_level_widget(menus[n]),
+                    &menu_count);
+        }
+    }
+    g_string_append(s, "{\"title\": ");
+    output_log_append_json_string(s, gtk_window_get_title(GTK_WINDOW(gwin)));
+    g_string_append_printf(s, ", \"tabs\": %u, "
+            "\"widgets\": %u, \"menu_widgets\": %u, \"menu_items\": %u}",
+            multi_win_get_ntabs(win), window_count.widgets,
+            menu_count.widgets, menu_count.menu_items);
+}
+
+static void roxterm_describe_terminal_memory(ROXTermData *roxterm, GString *s)
+{
+    glong lines = 0;
+    int limit = 0;
+    glong columns = 0;
+
+    if (roxterm->widget)
+    {
+        VteTerminal *vte = VTE_TERMINAL(roxterm->widget);
+        GtkAdjustment *adj = gtk_scrollable_get_vadjustment(
+                GTK_SCROLLABLE(roxterm->widget));
+
+        lines = (glong) (gtk_adjustment_get_upper(adj) -
+                gtk_adjustment_get_lower(adj) -
+                gtk_adjustment_get_page_size(adj));
+        if (lines < 0)
+            lines = 0;
+        columns = vte_terminal_get_column_count(vte);
+        g_object_get(vte, "scrollback-lines", &limit, NULL);
+    }
+    g_string_append_printf(s, "{\"id\": \"%p\", \"title\": ",
+            (void *) roxterm);
+    output_log_append_json_string(s, roxterm->tab ?
+            multi_tab_get_window_title(roxterm->tab) : NULL);
+    g_string_append_printf(s, ", "
+            "\"scrollback_lines\": %ld, \"scrollback_limit\": %d, "
+            "\"scrollback_allocated\": %ld, "
+            "\"scrollback_bytes_estimate\": %ld, "
+            "\"pending_clipboard_bytes\": %" G_GSIZE_FORMAT ", "
+            "\"osc52_capture_bytes\": %" G_GSIZE_FORMAT ", "
+            "\"match_regexes\": %u}",
+            lines, limit,
+            roxterm->scrollback ?
+                    scrollback_client_get_allocated(roxterm->scrollback) :
+                    (glong) limit,
+            lines * (columns * ROXTERM_SCROLLBACK_CELL_BYTES +
+                    ROXTERM_SCROLLBACK_ROW_BYTES),
+            roxterm->pending_clipboard ?
+                    roxterm->clipboard_offset + roxterm->clipboard_size : 0,
+            roxterm->osc52_filter ?
+                    (gsize) osc52filter_get_capture_size(roxterm->osc52_filter)
+                    : 0,
+            roxterm->uri_matches_active ? roxterm_n_uri_regexes : 0);
+}
+
+char *roxterm_describe_memory(void)
+{
+    GString *s = g_string_new(NULL);
+    GList *link;
+
+    g_string_append_printf(s, "{\"pid\": %d, \"process\": ",
+            (int) getpid());
+    mem_stats_describe_process(s);
+    g_string_append(s, ",\n\"windows\": [");
+    for (link = multi_win_all; link; link = g_list_next(link))
+    {
+        g_string_append(s, link == multi_win_all ? "\n  " : ",\n  ");
+        roxterm_describe_window_memory(link->data, s);
+    }
+    g_string_append(s, "\n],\n\"terminals\": [");
+    for (link = roxterm_terms; link; link = g_list_next(link))
+    {
+        g_string_append(s, link == roxterm_terms ? "\n  " : ",\n  ");
+        roxterm_describe_terminal_memory(link->data, s);
+    }
+    g_string_append(s, "\n]}\n");
+    return g_string_free(s, FALSE);
+}
+
+static void roxterm_fill_memory_dialog(GtkTextBuffer *buffer)
+{
+    char *description = roxterm_describe_memory();
+
+    gtk_text_buffer_set_text(buffer, description, -1);
+    g_free(description);
+}
+
+static void roxterm_memory_dialog_response(GtkDialog *dialog, int response,
+        GtkTextBuffer *buffer)
+{
+    if (response == GTK_RESPONSE_APPLY)
+        roxterm_fill_memory_dialog(buffer);
+    else
+        gtk_widget_destroy(GTK_WIDGET(dialog));
+}
+
+static void roxterm_show_memory_usage(MultiWin *win)
+{
+    GtkWidget *dialog = gtk_dialog_new_with_buttons(_("Memory Usage"),
+            GTK_WINDOW(multi_win_get_widget(win)),
+            GTK_DIALOG_DESTROY_WITH_PARENT,
+            _("_Refresh"), GTK_RESPONSE_APPLY,
+            _("_Close"), GTK_RESPONSE_CLOSE,
+            NULL);
+    GtkWidget *scrolled = gtk_scrolled_window_new(NULL, NULL);
+    GtkWidget *text = gtk_text_view_new();
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(text));
+
+    gtk_text_view_set_editable(GTK_TEXT_VIEW(text), FALSE);
+    gtk_text_view_set_monospace(GTK_TEXT_VIEW(text), TRUE);
+    gtk_container_add(GTK_CONTAINER(scrolled), text);
+    gtk_widget_set_size_request(scrolled, 600, 400);
+    gtk_box_pack_start(
+            GTK_BOX(gtk_dialog_get_content_area(GTK_DIALOG(dialog))),
+            scrolled, TRUE, TRUE, DLG_SPACING);
+    roxterm_fill_memory_dialog(buffer);
+    g_signal_connect(dialog, "response",
+            G_CALLBACK(roxterm_memory_dialog_response), buffer);
+    gtk_widget_show_all(dialog);
+}
+
+gboolean roxterm_get_session_scrollback(ROXTermData *roxterm)
+{
+    return options_lookup_int_with_default(roxterm->profile,
+            "session_scrollback", FALSE);
+}
+
+gboolean roxterm_save_scrollback(ROXTermData *roxterm, const char *filename)
+{
+    GFile *gfile = g_file_new_for_path(filename);
+    GError *error = NULL;
+    gboolean result = FALSE;
+
+    if (roxterm->restore_scrollback)
+    {
+        /* Not shown since the session was loaded, so the old copy is still
+         * current.
+         */
+        GFile *src = g_file_new_for_path(roxterm->restore_scrollback);
+
+        result = g_file_copy(src, gfile, G_FILE_COPY_OVERWRITE,
+                NULL, NULL, NULL, &error);
+        g_object_unref(src);
+    }
+    else
+    {
+        GFileOutputStream *fstream = g_file_replace(gfile, NULL, FALSE,
+                G_FILE_CREATE_PRIVATE, NULL, &error);
+
+        if (fstream)
+        {
+            GZlibCompressor *zlib = g_zlib_compressor_new(
+                    G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1);
+            GOutputStream *stream = g_converter_output_stream_new(
+                    G_OUTPUT_STREAM(fstream), G_CONVERTER(zlib));
+
+            g_object_unref(zlib);
+            g_object_unref(fstream);
+            result = vte_terminal_write_contents_sync(
+                    VTE_TERMINAL(roxterm->widget), stream,
+                    VTE_WRITE_DEFAULT, NULL, &error);
+            /* Don't overwrite write error if close fails too */
+            if (!g_output_stream_close(stream, NULL,
+                        result ? &error : NULL))
+            {
+                result = FALSE;
+            }
+            g_object_unref(stream);
+        }
+    }
+    if (!result)
+    {
+        g_warning(_("Unable to save scrollback to '%s': %s"), filename,
+                error ? error->message : _("Unknown error"));
+    }
+    if (error)
+        g_error_free(error);
+    g_object_unref(gfile);
+    return result;
+}
+
+void roxterm_scrollback_moved(ROXTermData *roxterm, const char *filename)
+{
+    if (roxterm->restore_scrollback)
+    {
+        g_free(roxterm->restore_scrollback);
+        roxterm->restore_scrollback = g_strdup(filename);
+    }
+}
+
 static void roxterm_tab_selection_handler(ROXTermData * roxterm, MultiTab * tab)
 {
     MultiWin *win = roxterm_get_win(roxterm);
     (void) tab;
 
     roxterm->status_icon_name = NULL;
+    /* Tabs are selected while a session is being loaded, so wait until it's
+     * clear which one ends up showing.
+     */
+    if (roxterm->restore_scrollback && !roxterm->restore_scrollback_tag)
+    {
+        roxterm->restore_scrollback_tag = g_idle_add(
+                (GSourceFunc) run_child_when_idle, roxterm);
+    }
+    if (roxterm->activity)
+        activity_monitor_reset(roxterm->activity);
+    if (roxterm->scrollback)
+        scrollback_client_note_selected(roxterm->scrollback);
     check_preferences_submenu_pair(roxterm,
             MENUTREE_PREFERENCES_SELECT_PROFILE,
             options_get_leafname(roxterm->profile));
@@ -1713,13 +3483,6 @@ static void roxterm_tab_selection_handler(ROXTermData * roxterm, MultiTab * tab)
     multi_win_set_ignore_toggles(win, FALSE);
 }
 
-static gboolean run_child_when_idle(ROXTermData *roxterm)
-{
-    if (!roxterm->running)
-        roxterm_run_command(roxterm, VTE_TERMINAL(roxterm->widget));
-    return FALSE;
-}
-
 static void roxterm_launch_uri_action(MultiWin * win)
 {
     ROXTermData *roxterm = multi_win_get_user_data_for_current_tab(win);
@@ -1770,7 +3533,7 @@ static void roxterm_paste_clipboard_action(MultiWin * win)
     ROXTermData *roxterm = multi_win_get_user_data_for_current_tab(win);
 
     g_return_if_fail(roxterm);
-    vte_terminal_paste_clipboard(VTE_TERMINAL(roxterm->widget));
+    roxterm_paste(roxterm);
 }
 
 static void roxterm_copy_and_paste_action(MultiWin * win)
@@ -1784,7 +3547,7 @@ static void roxterm_copy_and_paste_action(MultiWin * win)
 #else
     vte_terminal_copy_clipboard(VTE_TERMINAL(roxterm->widget));
 #endif
-    vte_terminal_paste_clipboard(VTE_TERMINAL(roxterm->widget));
+    roxterm_paste(roxterm);
     multi_win_hide_clipboard_indicator(win);
 }
 
@@ -1794,6 +3557,8 @@ static void roxterm_reset_action(MultiWin * win)
 
     g_return_if_fail(roxterm);
     vte_terminal_reset(VTE_TERMINAL(roxterm->widget), TRUE, FALSE);
+    if (roxterm->paste_tracker)
+        paste_tracker_reset(roxterm->paste_tracker);
 }
 
 static void roxterm_reset_and_clear_action(MultiWin * win)
@@ -1802,6 +3567,11 @@ static void roxterm_reset_and_clear_action(MultiWin * win)
 
     g_return_if_fail(roxterm);
     vte_terminal_reset(VTE_TERMINAL(roxterm->widget), TRUE, TRUE);
+    if (roxterm->paste_tracker)
+        paste_tracker_reset(roxterm->paste_tracker);
+    if (roxterm->search_index)
+        ngram_index_clear(roxterm->search_index);
+    roxterm->search_row = -1;
 }
 
 static void roxterm_respawn_action(MultiWin * win)
@@ -1885,7 +3655,7 @@ static void roxterm_find_next_action(MultiWin *win)
     ROXTermData *roxterm = multi_win_get_user_data_for_current_tab(win);
 
     g_return_if_fail(roxterm);
-    vte_terminal_search_find_next(VTE_TERMINAL(roxterm->widget));
+    roxterm_search_find(roxterm, FALSE);
 }
 
 static void roxterm_find_prev_action(MultiWin *win)
@@ -1893,7 +3663,23 @@ static void roxterm_find_prev_action(MultiWin *win)
     ROXTermData *roxterm = multi_win_get_user_data_for_current_tab(win);
 
     g_return_if_fail(roxterm);
-    vte_terminal_search_find_previous(VTE_TERMINAL(roxterm->widget));
+    roxterm_search_find(roxterm, TRUE);
+}
+
+static void roxterm_open_find_all_action(MultiWin *win)
+{
+    ROXTermData *roxterm = multi_win_get_user_data_for_current_tab(win);
+
+    g_return_if_fail(roxterm);
+    find_all_open_dialog(roxterm);
+}
+
+static void roxterm_open_tab_switcher_action(MultiWin *win)
+{
+    ROXTermData *roxterm = multi_win_get_user_data_for_current_tab(win);
+
+    g_return_if_fail(roxterm);
+    tab_switch_open_dialog(roxterm);
 }
 
 static void roxterm_show_about(MultiWin * win)
@@ -2142,13 +3928,11 @@ static void roxterm_change_profile(ROXTermData *roxterm, Options *profile)
         roxterm->profile = profile;
         options_ref(roxterm->profile);
         /* Force profile's font */
-        if (roxterm->pango_desc)
-        {
-            pango_font_description_free(roxterm->pango_desc);
-            roxterm->pango_desc = NULL;
-        }
+        g_free(roxterm->font_name);
+        roxterm->font_name = NULL;
         roxterm_apply_profile(roxterm, VTE_TERMINAL(roxterm->widget), FALSE);
         roxterm_update_size(roxterm, VTE_TERMINAL(roxterm->widget));
+        session_journal_tab_changed(roxterm->tab);
     }
 }
 
@@ -2359,34 +4143,74 @@ static void roxterm_shortcuts_selected(GtkCheckMenuItem *mitem,
     shortcuts_unref(shortcuts);
 }
 
+/* These two just record the event; the activity monitor calls
+ * roxterm_activity_handler later, at most once per frame.
+ */
 static void roxterm_text_changed_handler(VteTerminal *vte, ROXTermData *roxterm)
 {
     (void) vte;
-    if (roxterm->tab != multi_win_get_current_tab(roxterm_get_win(roxterm)))
+    if (roxterm->activity)
+        activity_monitor_note_output(roxterm->activity);
+}
+
+static void roxterm_bell_handler(VteTerminal *vte, ROXTermData *roxterm)
+{
+    (void) vte;
+    if (roxterm->activity)
+        activity_monitor_note_bell(roxterm->activity);
+}
+
+static void roxterm_draw_attention(ROXTermData *roxterm, gboolean background)
+{
+    GtkWindow *gwin = roxterm_get_toplevel(roxterm);
+
+    if (background)
+        multi_tab_draw_attention(roxterm->tab);
+    if (gwin && !gtk_window_is_active(gwin))
+        gtk_window_set_urgency_hint(gwin, TRUE);
+}
+
+static void roxterm_activity_handler(ROXTermData *roxterm, guint bells)
+{
+    MultiWin *win = roxterm_get_win(roxterm);
+    gboolean background;
+
+    if (!win)
+        return;
+    background = roxterm->tab != multi_win_get_current_tab(win);
+    if (bells)
+    {
+        if (background)
+            roxterm_show_status(roxterm, "dialog-warning");
+        if (roxterm->bell_highlights_tab)
+            roxterm_draw_attention(roxterm, background);
+    }
+    else if (background)
     {
         roxterm_show_status(roxterm, "dialog-information");
     }
 }
 
-static void roxterm_bell_handler(VteTerminal *vte, ROXTermData *roxterm)
+static void roxterm_silence_handler(ROXTermData *roxterm)
 {
     MultiWin *win = roxterm_get_win(roxterm);
-    (void) vte;
 
-    if (roxterm->tab != multi_win_get_current_tab(win))
+    if (win)
     {
-        roxterm_show_status(roxterm, "dialog-warning");
+        roxterm_draw_attention(roxterm,
+                roxterm->tab != multi_win_get_current_tab(win));
     }
-    if (options_lookup_int_with_default(roxterm->profile,
-            "bell_highlights_tab", TRUE))
-    {
-        GtkWindow *gwin = GTK_WINDOW(multi_win_get_widget(win));
+}
+
+static gboolean roxterm_is_focused(ROXTermData *roxterm)
+{
+    MultiWin *win = roxterm_get_win(roxterm);
+    GtkWindow *gwin;
 
-        if (roxterm->tab != multi_win_get_current_tab(win))
-            multi_tab_draw_attention(roxterm->tab);
-        if (!gtk_window_is_active(gwin))
-            gtk_window_set_urgency_hint(gwin, TRUE);
-    }
+    if (!win || roxterm->tab != multi_win_get_current_tab(win))
+        return FALSE;
+    gwin = roxterm_get_toplevel(roxterm);
+    return gwin && gtk_window_is_active(gwin);
 }
 
 /* Ignore keys which are shortcuts, otherwise they get sent to terminal
@@ -2397,7 +4221,6 @@ static gboolean roxterm_key_press_handler(GtkWidget *widget,
 {
     Options *shortcuts = multi_win_get_shortcut_scheme(
             roxterm_get_win(roxterm));
-    (void) widget;
     guint mod = event->state & GDK_MODIFIER_MASK;
 
     if ((event->keyval == GDK_KEY_Tab || event->keyval == GDK_KEY_ISO_Left_Tab)
@@ -2414,6 +4237,13 @@ static gboolean roxterm_key_press_handler(GtkWidget *widget,
     {
         return TRUE;
     }
+    if (!event->is_modifier && roxterm->latency)
+        latency_stats_note_key(roxterm->latency);
+    if (roxterm_lazy_uri_matching && (event->keyval == GDK_KEY_Control_L ||
+            event->keyval == GDK_KEY_Control_R))
+    {
+        roxterm_add_uri_matches(roxterm, VTE_TERMINAL(widget));
+    }
     return FALSE;
 }
 
@@ -2715,6 +4545,8 @@ static void roxterm_connect_menu_signals(MultiWin * win)
         G_CALLBACK(roxterm_show_about), win, NULL, NULL, NULL);
     multi_win_menu_connect_swapped(win, MENUTREE_HELP_SHOW_MANUAL,
         G_CALLBACK(roxterm_show_manual), win, NULL, NULL, NULL);
+    multi_win_menu_connect_swapped(win, MENUTREE_HELP_MEMORY_USAGE,
+        G_CALLBACK(roxterm_show_memory_usage), win, NULL, NULL, NULL);
 
     multi_win_menu_connect(win, MENUTREE_PREFERENCES_CONFIG_MANAGER,
         G_CALLBACK(roxterm_open_config_manager), NULL, NULL, NULL, NULL);
@@ -2735,6 +4567,10 @@ static void roxterm_connect_menu_signals(MultiWin * win)
         G_CALLBACK(roxterm_find_next_action), win, NULL, NULL, NULL);
     multi_win_menu_connect_swapped(win, MENUTREE_SEARCH_FIND_PREVIOUS,
         G_CALLBACK(roxterm_find_prev_action), win, NULL, NULL, NULL);
+    multi_win_menu_connect_swapped(win, MENUTREE_SEARCH_FIND_ALL_TABS,
+        G_CALLBACK(roxterm_open_find_all_action), win, NULL, NULL, NULL);
+    multi_win_menu_connect_swapped(win, MENUTREE_TABS_SWITCH_TAB,
+        G_CALLBACK(roxterm_open_tab_switcher_action), win, NULL, NULL, NULL);
 
     roxterm_add_all_pref_submenus(win);
 }
@@ -2873,10 +4709,22 @@ static void roxterm_clipboard_button_handler(ROXTermData *roxterm)
     }
 }
 
+static void roxterm_cwd_changed(VteTerminal *vte, ROXTermData *roxterm)
+{
+    (void) vte;
+    session_journal_tab_changed(roxterm->tab);
+}
+
 static void roxterm_connect_misc_signals(ROXTermData * roxterm)
 {
     roxterm->child_exited_tag = g_signal_connect(roxterm->widget,
             "child-exited", G_CALLBACK(roxterm_child_exited), roxterm);
+    g_signal_connect(roxterm->widget, "commit",
+            G_CALLBACK(roxterm_commit_handler), roxterm);
+    g_signal_connect_after(roxterm->widget, "size-allocate",
+            G_CALLBACK(roxterm_vte_size_allocate), roxterm);
+    g_signal_connect(roxterm->widget, "notify::scrollback-lines",
+            G_CALLBACK(roxterm_scrollback_lines_changed), roxterm);
     g_signal_connect(roxterm->widget, "popup-menu",
             G_CALLBACK(roxterm_popup_handler), roxterm);
     g_signal_connect(roxterm->widget, "button-press-event",
@@ -2894,6 +4742,8 @@ static void roxterm_connect_misc_signals(ROXTermData * roxterm)
         G_CALLBACK(roxterm_uri_drag_data_get), roxterm);
     g_signal_connect(roxterm->widget, "bell",
             G_CALLBACK(roxterm_bell_handler), roxterm);
+    g_signal_connect(roxterm->widget, "current-directory-uri-changed",
+            G_CALLBACK(roxterm_cwd_changed), roxterm);
     /* None of these seem to get raised on text output */
     /*
     g_signal_connect(roxterm->widget, "text-modified",
@@ -2911,6 +4761,18 @@ static void roxterm_connect_misc_signals(ROXTermData * roxterm)
             G_CALLBACK(roxterm_composited_changed_handler), roxterm);
     g_signal_connect(roxterm->widget, "key-press-event",
             G_CALLBACK(roxterm_key_press_handler), roxterm);
+    g_signal_connect(roxterm->widget, "key-release-event",
+            G_CALLBACK(roxterm_uri_key_release_handler), roxterm);
+    g_signal_connect(roxterm->widget, "motion-notify-event",
+            G_CALLBACK(roxterm_uri_motion_handler), roxterm);
+    g_signal_connect(roxterm->widget, "focus-out-event",
+            G_CALLBACK(roxterm_uri_focus_out_handler), roxterm);
+    g_signal_connect(roxterm->widget, "contents-changed",
+            G_CALLBACK(roxterm_contents_changed_handler), roxterm);
+    g_signal_connect(roxterm->widget, "realize",
+            G_CALLBACK(roxterm_realize_handler), roxterm);
+    g_signal_connect(roxterm->widget, "unrealize",
+            G_CALLBACK(roxterm_unrealize_handler), roxterm);
 }
 
 inline static void
@@ -2967,7 +4829,12 @@ static void roxterm_set_scrollback_lines(ROXTermData * roxterm,
             options_lookup_int_with_default(roxterm->profile,
                     "scrollback_lines", 1000) :
             -1;
-    vte_terminal_set_scrollback_lines(vte, lines);
+
+    /* The governor may give it less if there's a global budget */
+    if (roxterm->scrollback)
+        scrollback_client_set_lines(roxterm->scrollback, lines);
+    else
+        vte_terminal_set_scrollback_lines(vte, lines);
 }
 
 static void roxterm_set_scroll_on_output(ROXTermData * roxterm,
@@ -3072,14 +4939,29 @@ static void roxterm_apply_title_template(ROXTermData *roxterm)
     g_free(win_title);
 }
 
+static void roxterm_apply_activity_options(ROXTermData *roxterm)
+{
+    roxterm->show_tab_status = options_lookup_int_with_default(
+            roxterm->profile, "show_tab_status", FALSE);
+    roxterm->bell_highlights_tab = options_lookup_int_with_default(
+            roxterm->profile, "bell_highlights_tab", TRUE);
+    if (roxterm->activity)
+    {
+        activity_monitor_configure(roxterm->activity,
+                options_lookup_int_with_default(roxterm->profile,
+                        "silence_alert", 0),
+                options_lookup_int_with_default(roxterm->profile,
+                        "bell_rate_limit", 10));
+    }
+}
+
 static void roxterm_apply_show_tab_status(ROXTermData *roxterm)
 {
     if (roxterm->tab)
     {
         const char *name;
 
-        if (options_lookup_int_with_default(roxterm->profile,
-                "show_tab_status", FALSE))
+        if (roxterm->show_tab_status)
         {
             name = roxterm->status_icon_name;
         }
@@ -3195,10 +5077,9 @@ roxterm_update_osc52_options(ROXTermData * roxterm)
 {
     roxterm->allow_osc52 = options_lookup_int_with_default(roxterm->profile,
                                                            "allow_osc52", 0);
-    if (roxterm->allow_osc52 == 0 && roxterm->osc52_filter)
+    if (roxterm->allow_osc52 == 0)
     {
-        osc52filter_remove(roxterm->osc52_filter);
-        roxterm->osc52_filter = NULL;
+        roxterm_remove_osc52_filter(roxterm);
     }
     else if (roxterm->allow_osc52)
     {
@@ -3206,6 +5087,14 @@ roxterm_update_osc52_options(ROXTermData * roxterm)
         {
             roxterm_create_osc52_filter(roxterm);
         }
+        else if (roxterm->pty_reader)
+        {
+            /* The filter may be in use by the reader thread, so replace it
+             * instead of changing its size.
+             */
+            roxterm_remove_osc52_filter(roxterm);
+            roxterm_create_osc52_filter(roxterm);
+        }
         else
         {
             int buflen = options_lookup_int_with_default(roxterm->profile,
@@ -3339,6 +5228,7 @@ static void roxterm_apply_profile(ROXTermData *roxterm, VteTerminal *vte,
     roxterm_apply_disable_menu_access(roxterm);
 
     roxterm_apply_title_template(roxterm);
+    roxterm_apply_activity_options(roxterm);
     roxterm_apply_show_tab_status(roxterm);
     /*roxterm_apply_match_files(roxterm, vte);*/
     roxterm_apply_middle_click_tab(roxterm);
@@ -3515,6 +5405,10 @@ static GtkWidget *roxterm_multi_tab_filler(MultiWin * win, MultiTab * tab,
 
     roxterm_add_matches(roxterm, vte);
 
+    roxterm->activity = activity_monitor_new(roxterm);
+    roxterm->latency = latency_stats_new();
+    roxterm->scrollback = scrollback_client_new(roxterm, vte,
+            roxterm->activity);
     roxterm_apply_profile(roxterm, vte, FALSE);
     tab_name = global_options_lookup_string("tab-name");
     if (tab_name)
@@ -3549,7 +5443,15 @@ static GtkWidget *roxterm_multi_tab_filler(MultiWin * win, MultiTab * tab,
 
     roxterm_attach_state_changed_handler(roxterm);
 
-    g_idle_add((GSourceFunc) run_child_when_idle, roxterm);
+    if (roxterm->restore_scrollback)
+    {
+        roxterm->restore_scrollback_tag = g_idle_add(
+                (GSourceFunc) run_child_when_idle, roxterm);
+    }
+    else
+    {
+        g_idle_add((GSourceFunc) run_child_when_idle, roxterm);
+    }
 
     return viewport ? viewport : roxterm->widget;
 }
@@ -3717,6 +5619,10 @@ static void roxterm_reflect_profile_change(Options * profile, const char *key)
         {
             roxterm_set_scrollback_lines(roxterm, vte);
         }
+        else if (!strcmp(key, "search_index"))
+        {
+            roxterm_update_search_index(roxterm);
+        }
         else if (!strcmp(key, "scroll_on_output"))
         {
             roxterm_set_scroll_on_output(roxterm, vte);
@@ -3792,8 +5698,15 @@ static void roxterm_reflect_profile_change(Options * profile, const char *key)
         }
         else if (!strcmp(key, "show_tab_status"))
         {
+            roxterm_apply_activity_options(roxterm);
             roxterm_apply_show_tab_status(roxterm);
         }
+        else if (!strcmp(key, "bell_highlights_tab") ||
+                !strcmp(key, "silence_alert") ||
+                !strcmp(key, "bell_rate_limit"))
+        {
+            roxterm_apply_activity_options(roxterm);
+        }
         /*
         else if (!strcmp(key, "match_plain_files"))
         {
@@ -3813,6 +5726,14 @@ static void roxterm_reflect_profile_change(Options * profile, const char *key)
         {
             roxterm_update_osc52_options(roxterm);
         }
+        else if (!strncmp(key, "log_", 4))
+        {
+            roxterm_update_output_log(roxterm);
+        }
+        else if (!strncmp(key, "trigger", 7))
+        {
+            roxterm_update_triggers(roxterm);
+        }
         if (apply_to_win)
         {
             multi_win_foreach_tab(win, match_text_size_foreach_tab, roxterm);
@@ -3906,28 +5827,52 @@ static void roxterm_reflect_colour_change(Options *scheme, const char *key)
     }
 }
 
+static void roxterm_unref_colour_scheme(gpointer scheme)
+{
+    if (scheme)
+        colour_scheme_unref(scheme);
+}
+
+/* Each profile's scheme for the new theme is only looked up once, however
+ * many terminals use it.
+ */
 static void on_dark_theme_pref_changed(gboolean prefer_dark, gpointer handle)
 {
     (void) handle;
 
     const char *pref_key = prefer_dark ?
         "colour_scheme_dark" : "colour_scheme_light";
+    GHashTable *schemes = g_hash_table_new_full(NULL, NULL,
+            NULL, roxterm_unref_colour_scheme);
     GList *link;
     for (link = roxterm_terms; link; link = g_list_next(link))
     {
         ROXTermData *roxterm = link->data;
+        Options *scheme;
+
         if (roxterm->colour_scheme_overridden) {
             continue;
         }
-        char *theme = options_lookup_string(roxterm->profile, pref_key);
-        if (!theme)
-            theme = global_options_lookup_string(pref_key);
-        if (theme)
+        if (!g_hash_table_lookup_extended(schemes, roxterm->profile,
+                NULL, (gpointer *) &scheme))
         {
-            roxterm_change_colour_scheme_by_name(roxterm, theme);
+            char *theme = options_lookup_string(roxterm->profile, pref_key);
+
+            if (!theme)
+                theme = global_options_lookup_string(pref_key);
+            scheme = theme ? colour_scheme_lookup_and_ref(theme) : NULL;
+            if (theme && !scheme)
+            {
+                dlg_warning(roxterm_get_toplevel(roxterm),
+                        _("Unknown colour scheme '%s'"), theme);
+            }
             g_free(theme);
+            g_hash_table_insert(schemes, roxterm->profile, scheme);
         }
+        if (scheme)
+            roxterm_change_colour_scheme(roxterm, scheme);
     }
+    g_hash_table_destroy(schemes);
 }
 
 static void
@@ -3966,11 +5911,21 @@ roxterm_opt_signal_handler(const char *profile_name, const char *key,
     else if (!strcmp(profile_name, "Global") &&
             (!strcmp(key, "warn_close") ||
             !strcmp(key, "only_warn_running") ||
-            !strcmp(key, "prefer_dark_theme")))
+            !strcmp(key, "prefer_dark_theme") ||
+            !strcmp(key, "scrollback_budget") ||
+            !strcmp(key, "tab_menu_items") ||
+            !strcmp(key, "lazy_uri_matching")))
     {
         options_set_int(global_options, key, val.i);
-        if (!strcmp(key, "prefer_dark_theme"))
-        {
+        if (!strcmp(key, "scrollback_budget"))
+            scrollback_set_budget(val.i);
+        else if (!strcmp(key, "tab_menu_items"))
+            multi_win_set_tab_menu_items_default(val.i);
+        else if (!strcmp(key, "lazy_uri_matching"))
+            roxterm_set_lazy_uri_matching(val.i);
+        else if (!strcmp(key, "prefer_dark_theme"))
+        {
+            global_options_update_dark_theme();
             global_options_apply_dark_theme();
             on_dark_theme_pref_changed(global_options_system_theme_is_dark(),
                 NULL);
@@ -4117,40 +6072,102 @@ static void stuff_changed_do_menu(MenuTree *mtree,
     }
 }
 
-void roxterm_stuff_changed_handler(const char *what_happened,
-        const char *family_name, const char *current_name,
-        const char *new_name)
+/* Reloads a profile that's been changed on disk and only applies the keys
+ * whose values are different, so a small edit to a profile doesn't reapply the
+ * font and geometry of every terminal using it.
+ */
+static void roxterm_reload_profile(const char *profile_name)
+{
+    Options *profile = dynamic_options_lookup(roxterm_profiles,
+            profile_name);
+    char **keys;
+    char **pkey;
+
+    /* Not in use, so it will be loaded from scratch when it's needed */
+    if (!profile)
+        return;
+    keys = options_reload_keyfile_diff(profile);
+    for (pkey = keys; *pkey; ++pkey)
+        roxterm_reflect_profile_change(profile, *pkey);
+    g_strfreev(keys);
+}
+
+static void roxterm_reload_colour_scheme(const char *scheme_name)
 {
+    Options *scheme = dynamic_options_lookup(dynamic_options_get("Colours"),
+            scheme_name);
+    char **keys;
+    char **pkey;
+    gboolean full = FALSE;
     GList *link;
-    DynamicOptions *dynopts = NULL;
-    Options *options = NULL;
 
-    if (!strcmp(what_happened, OPTSDBUS_CHANGED) &&
-            strcmp(family_name, "Shortcuts"))
+    if (!scheme)
+        return;
+    keys = options_reload_keyfile_diff(scheme);
+    if (!keys[0])
+    {
+        g_strfreev(keys);
+        return;
+    }
+    colour_scheme_reset_cached_data(scheme);
+    /* Each palette entry would reapply the whole scheme, so do that once */
+    for (pkey = keys; *pkey && !full; ++pkey)
+    {
+        full = strcmp(*pkey, "cursor") && strcmp(*pkey, "cursorfg") &&
+                strcmp(*pkey, "bold");
+    }
+    if (full)
     {
         for (link = roxterm_terms; link; link = g_list_next(link))
         {
             ROXTermData *roxterm = link->data;
 
-            if (!strcmp(family_name, "Profiles"))
-            {
-                if (!strcmp(options_get_leafname(roxterm->profile),
-                        current_name))
-                {
-                    roxterm_apply_profile(roxterm,
-                            VTE_TERMINAL(roxterm->widget), TRUE);
-                }
-            }
-            else if (!strcmp(family_name, "Colours"))
+            if (roxterm->colour_scheme == scheme)
             {
-                if (!strcmp(options_get_leafname(roxterm->colour_scheme),
-                        current_name))
-                {
-                    roxterm_apply_colour_scheme(roxterm,
-                            VTE_TERMINAL(roxterm->widget));
-                }
+                roxterm_apply_colour_scheme(roxterm,
+                        VTE_TERMINAL(roxterm->widget));
             }
         }
+    }
+    else
+    {
+        for (pkey = keys; *pkey; ++pkey)
+            roxterm_reflect_colour_change(scheme, *pkey);
+    }
+    g_strfreev(keys);
+}
+
+static void roxterm_reload_shortcuts(const char *scheme_name)
+{
+    Options *shortcuts = shortcuts_open(scheme_name, TRUE);
+    GList *link;
+
+    for (link = multi_win_all; link; link = g_list_next(link))
+    {
+        MultiWin *win = link->data;
+
+        if (multi_win_get_shortcut_scheme(win) == shortcuts)
+            multi_win_set_shortcut_scheme(win, shortcuts);
+    }
+    shortcuts_unref(shortcuts);
+}
+
+void roxterm_stuff_changed_handler(const char *what_happened,
+        const char *family_name, const char *current_name,
+        const char *new_name)
+{
+    GList *link;
+    DynamicOptions *dynopts = NULL;
+    Options *options = NULL;
+
+    if (!strcmp(what_happened, OPTSDBUS_CHANGED))
+    {
+        if (!strcmp(family_name, "Profiles"))
+            roxterm_reload_profile(current_name);
+        else if (!strcmp(family_name, "Colours"))
+            roxterm_reload_colour_scheme(current_name);
+        else if (!strcmp(family_name, "Shortcuts"))
+            roxterm_reload_shortcuts(current_name);
         return;
     }
 
@@ -4174,34 +6191,33 @@ void roxterm_stuff_changed_handler(const char *what_happened,
     for (link = multi_win_all; link; link = g_list_next(link))
     {
         MultiWin *win = (MultiWin *) link->data;
+        MenuTree *mtree = multi_win_get_menu_bar(win);
 
-        if (strcmp(what_happened, OPTSDBUS_CHANGED))
+        multi_win_set_ignore_toggles(win, TRUE);
+        if (mtree)
         {
-            MenuTree *mtree = multi_win_get_menu_bar(win);
-
-            multi_win_set_ignore_toggles(win, TRUE);
-            if (mtree)
-            {
-                stuff_changed_do_menu(mtree, what_happened, family_name,
-                        current_name, new_name);
-            }
-            mtree = multi_win_get_popup_menu(win);
-            if (mtree)
-            {
-                stuff_changed_do_menu(mtree, what_happened, family_name,
-                        current_name, new_name);
-            }
-            multi_win_set_ignore_toggles(win, FALSE);
+            stuff_changed_do_menu(mtree, what_happened, family_name,
+                    current_name, new_name);
         }
-        else if (!strcmp(family_name, "Shortcuts"))
+        mtree = multi_win_get_popup_menu(win);
+        if (mtree)
         {
-            Options *shortcuts = shortcuts_open(current_name, TRUE);
-            multi_win_set_shortcut_scheme(win, shortcuts);
-            shortcuts_unref(shortcuts);
+            stuff_changed_do_menu(mtree, what_happened, family_name,
+                    current_name, new_name);
         }
+        multi_win_set_ignore_toggles(win, FALSE);
     }
 }
 
+/* Only files which are in use need to be reloaded; dynamic_options_lookup()
+ * doesn't load anything.
+ */
+static void roxterm_options_file_changed(const char *family, const char *name)
+{
+    if (dynamic_options_lookup(dynamic_options_get(family), name))
+        roxterm_stuff_changed_handler(OPTSDBUS_CHANGED, family, name, NULL);
+}
+
 static gboolean roxterm_verify_id(ROXTermData *roxterm)
 {
     GList *link;
@@ -4211,6 +6227,11 @@ static gboolean roxterm_verify_id(ROXTermData *roxterm)
         if (link->data == roxterm)
             return TRUE;
     }
+    /* With --workers the signal is broadcast to every worker, but only one of
+     * them has the terminal.
+     */
+    if (global_options_worker >= 0)
+        return FALSE;
     g_warning(_("Invalid ROXTERM_ID %p in D-Bus message "
             "(this is expected if you used roxterm's --separate option)"),
             roxterm);
@@ -4439,13 +6460,11 @@ void roxterm_launch(char **env)
         {
             GtkWidget *gwin = multi_win_get_widget(win);
 
-            roxterm->dont_lookup_dimensions = TRUE;
             roxterm->target_zoom_factor = partner->target_zoom_factor;
             roxterm->zoom_index = partner->zoom_index;
-            if (partner->pango_desc)
+            if (partner->font_name)
             {
-                roxterm->pango_desc =
-                        pango_font_description_copy(partner->pango_desc);
+                roxterm->font_name = g_strdup(partner->font_name);
                 roxterm->current_zoom_factor = partner->current_zoom_factor;
             }
             else
@@ -4530,6 +6549,101 @@ void roxterm_launch(char **env)
     //roxterm_force_resize_now(win);
 }
 
+char **roxterm_launch_batch(char **env, const ROXTermLaunchSpec *specs,
+        guint nspecs)
+{
+    /* Target windows by title template, looked up once for the batch; ""
+     * is the new window for specs with no target */
+    GHashTable *wins = g_hash_table_new(g_str_hash, g_str_equal);
+    GList *new_wins = NULL;
+    GList *link;
+    char **ids = g_new0(char *, nspecs + 1);
+    char *shortcut_scheme = global_options_lookup_string_with_default(
+            "shortcut_scheme", "Default");
+    guint n;
+
+    for (link = multi_win_all; link; link = g_list_next(link))
+    {
+        const char *tt = multi_win_get_title_template(link->data);
+
+        if (tt && tt[0] && !g_hash_table_contains(wins, tt))
+            g_hash_table_insert(wins, (gpointer) tt, link->data);
+    }
+    for (n = 0; n < nspecs; ++n)
+    {
+        const ROXTermLaunchSpec *spec = &specs[n];
+        const char *key = spec->window ? spec->window : "";
+        const char *profile_name = spec->profile ? spec->profile : "Default";
+        Options *profile = dynamic_options_lookup_and_ref(
+                roxterm_get_profiles(), profile_name, "roxterm profile");
+        char *colour_scheme_name = profile ?
+                options_lookup_string(profile, "colour_scheme") : NULL;
+        MultiWin *win = g_hash_table_lookup(wins, key);
+        char *geom = NULL;
+        ROXTermData *roxterm;
+        ROXTermData *new_roxterm;
+        MultiTab *tab;
+
+        if (!colour_scheme_name)
+        {
+            colour_scheme_name = global_options_lookup_string_with_default(
+                    "colour_scheme", "GTK");
+        }
+        roxterm = roxterm_data_new(0, spec->directory,
+                (char *) profile_name, profile, FALSE, colour_scheme_name,
+                &geom, NULL, env);
+        if (spec->commandv && spec->commandv[0])
+            roxterm->commandv = global_options_copy_strv(spec->commandv);
+        if (!win)
+        {
+            Options *shortcuts = shortcuts_open(shortcut_scheme, FALSE);
+
+            win = multi_win_new_blank(shortcuts, roxterm->zoom_index,
+                    FALSE, FALSE, roxterm_get_tab_pos(roxterm),
+                    roxterm_get_always_show_tabs(roxterm),
+                    options_lookup_int_with_default(roxterm->profile,
+                            "show_add_tab_btn", 1));
+            shortcuts_unref(shortcuts);
+            g_hash_table_insert(wins, (gpointer) key, win);
+            new_wins = g_list_prepend(new_wins, win);
+        }
+        tab = multi_tab_new(win, roxterm);
+        new_roxterm = multi_tab_get_user_data(tab);
+        new_roxterm->stagger_spawn = TRUE;
+        new_roxterm->report_spawn = TRUE;
+        ids[n] = g_strdup_printf("%p", new_roxterm);
+        if (spec->title && spec->title[0])
+        {
+            multi_tab_set_window_title_template(tab, spec->title);
+            multi_tab_set_title_template_locked(tab, TRUE);
+        }
+        roxterm_data_delete(roxterm);
+        g_free(colour_scheme_name);
+    }
+    for (link = new_wins; link; link = g_list_next(link))
+    {
+        MultiWin *win = link->data;
+        GHashTableIter iter;
+        gpointer key, value;
+
+        g_hash_table_iter_init(&iter, wins);
+        while (g_hash_table_iter_next(&iter, &key, &value))
+        {
+            if (value == win && ((char *) key)[0])
+            {
+                multi_win_set_title_template(win, key);
+                multi_win_set_title_template_locked(win, TRUE);
+            }
+        }
+        multi_win_show(win);
+        multi_win_select_tab(win, multi_win_get_tabs(win)->data);
+    }
+    g_list_free(new_wins);
+    g_hash_table_destroy(wins);
+    g_free(shortcut_scheme);
+    return ids;
+}
+
 static void roxterm_tab_to_new_window(MultiWin *win, MultiTab *tab,
         MultiWin *old_win)
 {
@@ -4738,6 +6852,16 @@ void roxterm_init(void)
             (OptsDBusSetProfileHandler) roxterm_set_colour_scheme_handler);
     optsdbus_listen_for_set_shortcut_scheme_signals(
             (OptsDBusSetProfileHandler) roxterm_set_shortcut_scheme_handler);
+    opts_monitor_start(roxterm_options_file_changed);
+
+    activity_init(roxterm_activity_handler, roxterm_silence_handler);
+    scrollback_init(roxterm_is_focused);
+    scrollback_set_budget(global_options_lookup_int_with_default(
+            "scrollback_budget", 0));
+    multi_win_set_tab_menu_items_default(
+            global_options_lookup_int_with_default("tab_menu_items", TRUE));
+    roxterm_set_lazy_uri_matching(
+            global_options_lookup_int_with_default("lazy_uri_matching", FALSE));
 
     multi_tab_init((MultiTabFiller) roxterm_multi_tab_filler,
         (MultiTabDestructor) roxterm_multi_tab_destructor,
@@ -5013,7 +7137,6 @@ static void parse_open_win(_ROXTermParseContext *rctx,
     if (font && font[0])
     {
         rctx->fdesc = pango_font_description_from_string(font);
-        resize_pango_for_zoom(rctx->fdesc, rctx->zoom_factor);
     }
     multi_win_set_borderless(win, rctx->borderless);
     multi_win_set_show_menu_bar(win, show_mbar);
@@ -5100,6 +7223,7 @@ static void parse_open_tab(_ROXTermParseContext *rctx,
     const char *profile_name = "Default";
     const char *colours_name = "GTK";
     const char *cwd = NULL;
+    const char *scrollback = NULL;
     int n;
     ROXTermData *roxterm;
     Options *profile;
@@ -5125,6 +7249,8 @@ static void parse_open_tab(_ROXTermParseContext *rctx,
             rctx->current = (strcmp(v, "0") != 0);
         else if (!strcmp(a, "title_template_locked"))
             rctx->tab_title_template_locked = atoi(v);
+        else if (!strcmp(a, "scrollback"))
+            scrollback = v;
         /* Ignore unknown tags, probably caused by deprecated settings
         else
         {
@@ -5143,9 +7269,14 @@ static void parse_open_tab(_ROXTermParseContext *rctx,
             rctx->maximised, colours_name,
             &rctx->geom, NULL, environ);
     roxterm->from_session = TRUE;
-    roxterm->dont_lookup_dimensions = TRUE;
+    if (scrollback && g_file_test(scrollback, G_FILE_TEST_IS_REGULAR))
+        roxterm->restore_scrollback = g_strdup(scrollback);
     if (rctx->fdesc)
-        roxterm->pango_desc = pango_font_description_copy(rctx->fdesc);
+    {
+        /* The saved font is already zoomed */
+        roxterm->font_name = font_cache_unzoomed_name(rctx->fdesc,
+                rctx->zoom_factor);
+    }
     rctx->roxterm = roxterm;
 }
 
@@ -5499,48 +7630,207 @@ VteTerminal *roxterm_get_vte(ROXTermData *roxterm)
 gboolean roxterm_set_search(ROXTermData *roxterm,
         const char *pattern, guint flags, GError **error)
 {
-    VteRegex *regex = NULL;
-    char *cooked_pattern = NULL;
+    ROXTermSearchRegex *sr = NULL;
+
+    if (pattern && pattern[0])
+    {
+        sr = roxterm_search_regex_lookup(pattern, flags, error);
+        if (!sr)
+            return FALSE;
+    }
 
     roxterm->search_flags = flags;
+    g_free(roxterm->search_pattern);
+    roxterm->search_pattern = sr ? g_strdup(pattern) : NULL;
+    roxterm_clear_search_regex(roxterm);
+    roxterm->search_regex = sr;
+
+    vte_terminal_search_set_regex(VTE_TERMINAL(roxterm->widget),
+            sr ? sr->regex : NULL, 0);
+    vte_terminal_search_set_wrap_around(VTE_TERMINAL(roxterm->widget),
+            flags & ROXTERM_SEARCH_WRAP);
+    roxterm_shade_search_menu_items(roxterm);
+    return TRUE;
+}
 
-    if (roxterm->search_pattern)
+char *roxterm_get_text_rows(VteTerminal *vte, glong first, glong last,
+        gsize *len)
+{
+    glong columns = vte_terminal_get_column_count(vte);
+    char *text;
+
+#if VTE_CHECK_VERSION(0, 72, 0)
+    text = vte_terminal_get_text_range_format(vte, VTE_FORMAT_TEXT,
+            first, 0, last, columns, len);
+#else
+    text = vte_terminal_get_text_range(vte, first, 0, last, columns,
+            NULL, NULL, NULL);
+    *len = text ? strlen(text) : 0;
+#endif
+    return text;
+}
+
+/* Returns the row of the match nearest to start, but not before it in the
+ * direction of the search, in rows first to last, or -1 if there isn't one.
+ */
+static glong roxterm_search_rows(ROXTermData *roxterm,
+        glong first, glong last, glong start, gboolean backwards)
+{
+    VteTerminal *vte = VTE_TERMINAL(roxterm->widget);
+    glong columns = MAX(vte_terminal_get_column_count(vte), 1);
+    pcre2_code *code = roxterm->search_regex->code;
+    gsize len;
+    char *text = roxterm_get_text_rows(vte, first, last, &len);
+    pcre2_match_data *md;
+    PCRE2_SIZE offset = 0;
+    const char *line_start = text;
+    glong line_row = first;
+    glong result = -1;
+
+    if (!text)
+        return -1;
+    md = pcre2_match_data_create_from_pattern(code, NULL);
+    while (offset < len && pcre2_match(code,
+                (PCRE2_SPTR) text, len, offset,
+                PCRE2_NO_UTF_CHECK | PCRE2_NOTEMPTY, md, NULL) >= 0)
     {
-        g_free(roxterm->search_pattern);
-        roxterm->search_pattern = NULL;
+        PCRE2_SIZE *ovector = pcre2_get_ovector_pointer(md);
+        const char *match = text + ovector[0];
+        const char *nl;
+        glong row;
+
+        while ((nl = memchr(line_start, '\n', match - line_start)) != NULL)
+        {
+            /* Wrapped lines don't have a newline at the end of each row */
+            glong chars = g_utf8_strlen(line_start, nl - line_start);
+
+            line_row += 1 + MAX(chars - 1, 0) / columns;
+            line_start = nl + 1;
+        }
+        row = line_row + g_utf8_strlen(line_start, match - line_start) /
+                columns;
+        if (backwards ? row <= start : row >= start)
+        {
+            result = row;
+            if (!backwards)
+                break;
+        }
+        else if (backwards)
+        {
+            break;
+        }
+        offset = MAX(ovector[1], ovector[0] + 1);
     }
+    pcre2_match_data_free(md);
+    g_free(text);
+    return result;
+}
 
-    if (pattern && pattern[0])
+/* Scrolls to a match found with the help of the index */
+static gboolean roxterm_search_found(ROXTermData *roxterm, glong row)
+{
+    GtkAdjustment *vadj = gtk_scrollable_get_vadjustment(
+            GTK_SCROLLABLE(roxterm->widget));
+    double lower = gtk_adjustment_get_lower(vadj);
+    double upper = gtk_adjustment_get_upper(vadj);
+    double page = gtk_adjustment_get_page_size(vadj);
+
+    roxterm->search_row = row;
+    gtk_adjustment_set_value(vadj, CLAMP(row - page / 2, lower, upper - page));
+    return TRUE;
+}
+
+/* Returns FALSE if the index can't be used or doesn't lead to a match. The
+ * index is only worth using, and losing VTE's selection of the match, if the
+ * buffer is large. Candidate blocks are checked in order from the starting
+ * row, so the first match confirmed is the nearest one. Rows which the index
+ * doesn't cover, eg output from before it was created, are searched
+ * directly.
+ */
+static gboolean roxterm_search_indexed(ROXTermData *roxterm,
+        gboolean backwards)
+{
+    VteTerminal *vte;
+    GtkAdjustment *vadj;
+    glong lower, upper, index_first, index_end, slack;
+    glong start;
+    gboolean wrapped = FALSE;
+
+    if (!roxterm->search_index || !roxterm->search_regex ||
+            !roxterm->search_regex->code)
+    {
+        return FALSE;
+    }
+    vte = VTE_TERMINAL(roxterm->widget);
+    vadj = gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(vte));
+    lower = (glong) gtk_adjustment_get_lower(vadj);
+    upper = (glong) gtk_adjustment_get_upper(vadj);
+    if (upper - lower < ROXTERM_SEARCH_INDEX_MIN_ROWS)
+        return FALSE;
+    ngram_index_get_rows(roxterm->search_index, &index_first, &index_end);
+    /* Each block's rows are mapped from the last time it was anchored, but
+     * output the index had already seen and VTE hadn't yet could put that
+     * out by a little, so the rows around each candidate are searched too.
+     */
+    slack = vte_terminal_get_row_count(vte);
+    if (roxterm->search_row >= lower && roxterm->search_row < upper)
+        start = roxterm->search_row + (backwards ? -1 : 1);
+    else
+        start = backwards ? upper - 1 : lower;
+    for (;;)
     {
-        roxterm->search_pattern = g_strdup(pattern);
-        if (!(flags & ROXTERM_SEARCH_AS_REGEX))
+        glong first, end, row;
+
+        if (start < lower || start >= upper)
         {
-            cooked_pattern = g_regex_escape_string(pattern, -1);
-            pattern = cooked_pattern;
+            if (wrapped || !(roxterm->search_flags & ROXTERM_SEARCH_WRAP))
+                return FALSE;
+            wrapped = TRUE;
+            start = backwards ? upper - 1 : lower;
+            continue;
         }
-        if (flags & ROXTERM_SEARCH_ENTIRE_WORD)
+        if (start < index_first + slack)
         {
-            char *tmp = cooked_pattern;
-
-            cooked_pattern = g_strdup_printf("\\<%s\\>", pattern);
-            pattern = cooked_pattern;
-            g_free(tmp);
+            /* Older than anything the index can rule out */
+            first = backwards ? lower : start;
+            end = MIN(index_first + slack, upper);
+            row = roxterm_search_rows(roxterm, first, end - 1, start,
+                    backwards);
+            if (row >= 0)
+                return roxterm_search_found(roxterm, row);
+            start = backwards ? lower - 1 : end;
+            continue;
         }
-
-        regex = vte_regex_new_for_search(pattern, -1,
-                ((flags & ROXTERM_SEARCH_MATCH_CASE) ? 0 : PCRE2_CASELESS) |
-                PCRE2_NOTEMPTY | PCRE2_MULTILINE,
-                error);
-        g_free(cooked_pattern);
-        if (!regex)
-            return FALSE;
+        if (!ngram_index_find(roxterm->search_index,
+                    roxterm->search_regex->query, start, backwards,
+                    &first, &end))
+        {
+            /* Nothing more in the index, only older rows */
+            start = backwards ? index_first + slack - 1 : upper;
+            continue;
+        }
+        row = roxterm_search_rows(roxterm, MAX(first - slack, lower),
+                MIN(end + slack, upper) - 1, start, backwards);
+        if (row >= 0)
+            return roxterm_search_found(roxterm, row);
+        start = backwards ? MIN(first - 1, start - 1) : MAX(end, start + 1);
     }
+}
 
-    vte_terminal_search_set_regex(VTE_TERMINAL(roxterm->widget), regex, 0);
-    vte_terminal_search_set_wrap_around(VTE_TERMINAL(roxterm->widget),
-            flags & ROXTERM_SEARCH_WRAP);
-    roxterm_shade_search_menu_items(roxterm);
-    return TRUE;
+gboolean roxterm_search_find(ROXTermData *roxterm, gboolean backwards)
+{
+    VteTerminal *vte = VTE_TERMINAL(roxterm->widget);
+
+    if (roxterm_search_indexed(roxterm, backwards))
+        return TRUE;
+    /* Either there's no index or it may have missed something */
+    return backwards ? vte_terminal_search_find_previous(vte) :
+            vte_terminal_search_find_next(vte);
+}
+
+NgramIndex *roxterm_get_search_index(ROXTermData *roxterm)
+{
+    return roxterm->search_index;
 }
 
 const char *roxterm_get_search_pattern(ROXTermData *roxterm)
@@ -5567,4 +7857,41 @@ gboolean roxterm_is_valid(ROXTermData *roxterm)
     return FALSE;
 }
 
+gint64 roxterm_get_last_output(ROXTermData *roxterm)
+{
+    return roxterm->activity ?
+        activity_monitor_get_last_output(roxterm->activity) : 0;
+}
+
+void roxterm_set_lazy_uri_matching(gboolean lazy)
+{
+    GList *link;
+
+    if (lazy == roxterm_lazy_uri_matching)
+        return;
+    roxterm_lazy_uri_matching = lazy;
+    for (link = roxterm_terms; link; link = g_list_next(link))
+    {
+        ROXTermData *roxterm = link->data;
+        VteTerminal *vte;
+
+        if (!roxterm->widget)
+            continue;
+        vte = VTE_TERMINAL(roxterm->widget);
+        if (lazy)
+        {
+            roxterm_remove_uri_matches(roxterm, vte);
+        }
+        else
+        {
+            if (roxterm->uri_rest_tag)
+            {
+                g_source_remove(roxterm->uri_rest_tag);
+                roxterm->uri_rest_tag = 0;
+            }
+            roxterm_add_uri_matches(roxterm, vte);
+        }
+    }
+}
+
 /* vi:set sw=4 ts=4 et cindent cino= */
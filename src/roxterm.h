@@ -27,6 +27,7 @@
 #include <vte/vte.h>
 
 #include "multitab.h"
+#include "ngramindex.h"
 
 typedef struct ROXTermData ROXTermData;
 
@@ -41,6 +42,26 @@ void roxterm_init(void);
  */
 void roxterm_launch(char **env);
 
+/* One terminal for roxterm_launch_batch. Any member may be NULL. */
+typedef struct {
+    char **commandv;
+    const char *directory;
+    const char *profile;
+    const char *title;      /* Locked title template for the tab */
+    /* Specs with the same window go in the same window: an existing one
+     * whose title template matches, otherwise a new one with window as its
+     * title template. Specs without a window share one new window.
+     */
+    const char *window;
+} ROXTermLaunchSpec;
+
+/* Opens the terminals in a single pass. Their commands are started at
+ * intervals, and each one's outcome is reported by a D-Bus signal. Returns
+ * each terminal's ID, in the same form as ROXTERM_ID; free with g_strfreev.
+ */
+char **roxterm_launch_batch(char **env, const ROXTermLaunchSpec *specs,
+        guint nspecs);
+
 /* Ways of spawning a command */
 typedef enum {
 	ROXTerm_SpawnExternal,		/* Run independently of ROXterm,
@@ -77,6 +98,26 @@ void roxterm_stuff_changed_handler(const char *what_happened,
 gboolean roxterm_load_session(const char *xml, gssize len,
         const char *client_id);
 
+/* Describes the latency statistics and dropped bells of every terminal as
+ * JSON
+ */
+char *roxterm_describe_latency(void);
+
+/* Describes memory use by the process, each window and each terminal as
+ * JSON */
+char *roxterm_describe_memory(void);
+
+/* Whether the profile's session_scrollback option is set */
+gboolean roxterm_get_session_scrollback(ROXTermData *roxterm);
+
+/* Saves the terminal's text, gzipped, for restoring with a session */
+gboolean roxterm_save_scrollback(ROXTermData *roxterm, const char *filename);
+
+/* If the tab hasn't been shown since its session was loaded its scrollback
+ * is still waiting to be restored. This tells it the file has been moved.
+ */
+void roxterm_scrollback_moved(ROXTermData *roxterm, const char *filename);
+
 MultiWin *roxterm_get_multi_win(ROXTermData *roxterm);
 
 VteTerminal *roxterm_get_vte(ROXTermData *roxterm);
@@ -93,6 +134,21 @@ typedef enum {
 gboolean roxterm_set_search(ROXTermData *roxterm,
         const char *pattern, guint flags, GError **error);
 
+/* Finds the next or previous match for the current search and scrolls to it,
+ * using the terminal's search index if it has one. Returns FALSE if there
+ * isn't a match.
+ */
+gboolean roxterm_search_find(ROXTermData *roxterm, gboolean backwards);
+
+/* Gets the text of a range of rows, with a newline at the end of each line
+ * which isn't wrapped. Free with g_free.
+ */
+char *roxterm_get_text_rows(VteTerminal *vte, glong first, glong last,
+        gsize *len);
+
+/* Returns NULL unless the profile's search_index option is set */
+NgramIndex *roxterm_get_search_index(ROXTermData *roxterm);
+
 const char *roxterm_get_search_pattern(ROXTermData *roxterm);
 guint roxterm_get_search_flags(ROXTermData *roxterm);
 
@@ -106,6 +162,15 @@ void roxterm_osc52_handler(ROXTermData * roxterm, const char *clipboards,
 /* Returns FALSE if this roxterm has been destroyed */
 gboolean roxterm_is_valid(ROXTermData *roxterm);
 
+/* g_get_monotonic_time() of the terminal's last output, or 0 */
+gint64 roxterm_get_last_output(ROXTermData *roxterm);
+
+/* When lazy is TRUE terminals only register their URI regexes with VTE while
+ * Ctrl is held or the pointer has rested on a URI, so moving the pointer over
+ * dense output doesn't keep running them. Clicks are still hit-tested.
+ */
+void roxterm_set_lazy_uri_matching(gboolean lazy);
+
 #endif /* ROXTERM_H */
 
 /* vi:set sw=4 ts=4 et cindent cino= */
@@ -0,0 +1,313 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "defns.h"
+
+#include "scrollback.h"
+
+/* How often allocations are recalculated while there's a budget */
+#define SCROLLBACK_REBALANCE_MS 2000
+
+/* No terminal is reduced below this many lines */
+#define SCROLLBACK_MIN_LINES 100
+
+/* Allocations are rounded down to a multiple of this so that small changes
+ * in weight don't cause VTE to be reconfigured every time.
+ */
+#define SCROLLBACK_GRANULARITY 64
+
+#define SCROLLBACK_FOCUSED_WEIGHT 8.0
+
+/* An unfocused terminal's weight starts at 4 and drops towards 1 as it stays
+ * idle, reaching 2.5 after this long.
+ */
+#define SCROLLBACK_IDLE_SECS 60.0
+
+struct ScrollbackClient {
+    ROXTermData *roxterm;
+    VteTerminal *vte;
+    ActivityMonitor *am;
+    glong requested;
+    glong allocated;
+    gint64 last_selected;
+    double weight;
+    glong cap;
+    glong target;
+};
+
+typedef struct {
+    ScrollbackFocusFunc is_focused;
+    GList *clients;
+    glong budget;
+    guint timer_tag;
+    guint idle_tag;
+} ScrollbackGlobal;
+
+static ScrollbackGlobal scrollback_global;
+
+void scrollback_init(ScrollbackFocusFunc is_focused)
+{
+    scrollback_global.is_focused = is_focused;
+}
+
+static void scrollback_client_apply(ScrollbackClient *sc, glong lines)
+{
+    if (lines != sc->allocated)
+    {
+        sc->allocated = lines;
+        vte_terminal_set_scrollback_lines(sc->vte, lines);
+    }
+}
+
+static double scrollback_client_weight(ScrollbackClient *sc, gint64 now)
+{
+    gint64 last = sc->last_selected;
+    double idle;
+
+    if (scrollback_global.is_focused &&
+            scrollback_global.is_focused(sc->roxterm))
+    {
+        return SCROLLBACK_FOCUSED_WEIGHT;
+    }
+    if (sc->am)
+        last = MAX(last, activity_monitor_get_last_output(sc->am));
+    idle = last ? (double) (now - last) / G_USEC_PER_SEC :
+            SCROLLBACK_IDLE_SECS * 100;
+    return 1.0 + 3.0 * SCROLLBACK_IDLE_SECS / (SCROLLBACK_IDLE_SECS + idle);
+}
+
+/* Gives every terminal the minimum, then shares out the rest in proportion to
+ * weight, redistributing whatever is left over by terminals which don't want
+ * their full share.
+ */
+static void scrollback_rebalance(void)
+{
+    glong budget = scrollback_global.budget;
+    glong remaining = budget;
+    double total_weight = 0;
+    gint64 now = g_get_monotonic_time();
+    GList *open = NULL;
+    GList *link;
+    GList *next;
+
+    for (link = scrollback_global.clients; link; link = g_list_next(link))
+    {
+        ScrollbackClient *sc = link->data;
+
+        sc->weight = scrollback_client_weight(sc, now);
+        sc->cap = sc->requested < 0 ? budget : MIN(sc->requested, budget);
+        sc->target = MIN(sc->cap, SCROLLBACK_MIN_LINES);
+        remaining -= sc->target;
+        if (sc->cap > sc->target)
+        {
+            open = g_list_prepend(open, sc);
+            total_weight += sc->weight;
+        }
+    }
+    while (open && remaining > 0)
+    {
+        double per_weight = (double) remaining / total_weight;
+        gboolean capped = FALSE;
+
+        for (link = open; link; link = next)
+        {
+            ScrollbackClient *sc = link->data;
+
+            next = g_list_next(link);
+            if (sc->target + per_weight * sc->weight >= sc->cap)
+            {
+                remaining -= sc->cap - sc->target;
+                sc->target = sc->cap;
+                total_weight -= sc->weight;
+                open = g_list_delete_link(open, link);
+                capped = TRUE;
+            }
+        }
+        if (!capped)
+        {
+            for (link = open; link; link = g_list_next(link))
+            {
+                ScrollbackClient *sc = link->data;
+
+                sc->target += (glong) (per_weight * sc->weight);
+            }
+            break;
+        }
+    }
+    g_list_free(open);
+
+    for (link = scrollback_global.clients; link; link = g_list_next(link))
+    {
+        ScrollbackClient *sc = link->data;
+        glong lines = sc->target;
+
+        if (lines < sc->cap)
+        {
+            lines = MAX(lines - lines % SCROLLBACK_GRANULARITY,
+                    MIN(sc->cap, SCROLLBACK_MIN_LINES));
+        }
+        scrollback_client_apply(sc, lines);
+    }
+}
+
+static gboolean scrollback_rebalance_timeout(gpointer data)
+{
+    (void) data;
+    scrollback_rebalance();
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean scrollback_rebalance_idle(gpointer data)
+{
+    (void) data;
+    scrollback_global.idle_tag = 0;
+    scrollback_rebalance();
+    return G_SOURCE_REMOVE;
+}
+
+/* Starts or stops the timer and schedules a rebalance if necessary */
+static void scrollback_update(void)
+{
+    gboolean active = scrollback_global.budget > 0 &&
+            scrollback_global.clients;
+
+    if (active && !scrollback_global.timer_tag)
+    {
+        scrollback_global.timer_tag = g_timeout_add(SCROLLBACK_REBALANCE_MS,
+                scrollback_rebalance_timeout, NULL);
+    }
+    else if (!active && scrollback_global.timer_tag)
+    {
+        g_source_remove(scrollback_global.timer_tag);
+        scrollback_global.timer_tag = 0;
+    }
+    if (active && !scrollback_global.idle_tag)
+    {
+        scrollback_global.idle_tag = g_idle_add(scrollback_rebalance_idle,
+                NULL);
+    }
+    else if (!active && scrollback_global.idle_tag)
+    {
+        g_source_remove(scrollback_global.idle_tag);
+        scrollback_global.idle_tag = 0;
+    }
+}
+
+void scrollback_set_budget(glong lines)
+{
+    GList *link;
+
+    lines = MAX(lines, 0);
+    if (lines == scrollback_global.budget)
+        return;
+    scrollback_global.budget = lines;
+    if (!lines)
+    {
+        for (link = scrollback_global.clients; link; link = g_list_next(link))
+        {
+            ScrollbackClient *sc = link->data;
+
+            scrollback_client_apply(sc, sc->requested);
+        }
+    }
+    scrollback_update();
+}
+
+glong scrollback_get_budget(void)
+{
+    return scrollback_global.budget;
+}
+
+ScrollbackClient *scrollback_client_new(ROXTermData *roxterm,
+        VteTerminal *vte, ActivityMonitor *am)
+{
+    ScrollbackClient *sc = g_new0(ScrollbackClient, 1);
+
+    sc->roxterm = roxterm;
+    sc->vte = vte;
+    sc->am = am;
+    sc->requested = sc->allocated = vte_terminal_get_scrollback_lines(vte);
+    sc->last_selected = g_get_monotonic_time();
+    scrollback_global.clients = g_list_prepend(scrollback_global.clients, sc);
+    scrollback_update();
+    return sc;
+}
+
+void scrollback_client_delete(ScrollbackClient *sc)
+{
+    scrollback_global.clients = g_list_remove(scrollback_global.clients, sc);
+    g_free(sc);
+    scrollback_update();
+}
+
+void scrollback_client_set_lines(ScrollbackClient *sc, glong lines)
+{
+    sc->requested = lines;
+    if (scrollback_global.budget)
+        scrollback_update();
+    else
+        scrollback_client_apply(sc, lines);
+}
+
+void scrollback_client_note_selected(ScrollbackClient *sc)
+{
+    sc->last_selected = g_get_monotonic_time();
+}
+
+glong scrollback_client_get_allocated(ScrollbackClient *sc)
+{
+    return sc->allocated;
+}
+
+glong scrollback_get_allocated_total(void)
+{
+    GList *link;
+    glong total = 0;
+
+    for (link = scrollback_global.clients; link; link = g_list_next(link))
+    {
+        ScrollbackClient *sc = link->data;
+
+        if (sc->allocated < 0)
+            return -1;
+        total += sc->allocated;
+    }
+    return total;
+}
+
+char *scrollback_describe(void)
+{
+    GString *s = g_string_new(NULL);
+    GList *link;
+
+    g_string_append_printf(s, "budget %ld allocated %ld\n",
+            scrollback_global.budget, scrollback_get_allocated_total());
+    for (link = scrollback_global.clients; link; link = g_list_next(link))
+    {
+        ScrollbackClient *sc = link->data;
+
+        g_string_append_printf(s, "%p requested %ld allocated %ld "
+                "weight %.2f\n", (void *) sc->roxterm,
+                sc->requested, sc->allocated, sc->weight);
+    }
+    return g_string_free(s, FALSE);
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
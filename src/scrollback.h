@@ -0,0 +1,72 @@
+#ifndef SCROLLBACK_H
+#define SCROLLBACK_H
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* Shares a process-wide budget of scrollback lines between terminals. Each
+ * terminal asks for the number of lines in its profile, and while there's no
+ * budget that's what it gets. With a budget the governor periodically divides
+ * it between terminals in proportion to a weight, which is highest for the
+ * focused terminal and decays the longer a terminal goes without output or
+ * being selected, so idle background tabs shrink to make room for busy ones.
+ * No terminal is reduced below a small minimum, so the budget may be exceeded
+ * if it's too small for the number of terminals.
+ */
+
+#include "activity.h"
+
+typedef struct ScrollbackClient ScrollbackClient;
+
+/* Returns whether roxterm is the current tab of the active window */
+typedef gboolean (*ScrollbackFocusFunc)(ROXTermData *roxterm);
+
+void scrollback_init(ScrollbackFocusFunc is_focused);
+
+/* Total lines for all terminals, 0 for no budget */
+void scrollback_set_budget(glong lines);
+
+glong scrollback_get_budget(void);
+
+/* am may be NULL, in which case only selection counts as activity */
+ScrollbackClient *scrollback_client_new(ROXTermData *roxterm,
+        VteTerminal *vte, ActivityMonitor *am);
+
+void scrollback_client_delete(ScrollbackClient *sc);
+
+/* Sets the number of lines requested by the terminal's profile, -1 for
+ * unlimited.
+ */
+void scrollback_client_set_lines(ScrollbackClient *sc, glong lines);
+
+void scrollback_client_note_selected(ScrollbackClient *sc);
+
+/* The number of lines currently allowed, -1 for unlimited */
+glong scrollback_client_get_allocated(ScrollbackClient *sc);
+
+/* Sum of all terminals' allocations, -1 if any are unlimited */
+glong scrollback_get_allocated_total(void);
+
+/* Describes the current allocations, one line per terminal, with the same
+ * form of ID as ROXTERM_ID. Free with g_free.
+ */
+char *scrollback_describe(void);
+
+#endif /* SCROLLBACK_H */
+
+/* vi:set sw=4 ts=4 et cindent cino= */
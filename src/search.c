@@ -27,6 +27,13 @@
 /* Too many completions may be distracting */
 #define SEARCH_MAX_COMPLETIONS 32
 
+/* How long to wait after typing stops before searching as you type. If
+ * searches are slow this is increased, up to the maximum, so that keystrokes
+ * aren't held up.
+ */
+#define SEARCH_DEBOUNCE_MS 150
+#define SEARCH_MAX_DEBOUNCE_MS 1000
+
 static GtkWidget *search_dialog = NULL;
 
 struct {
@@ -38,6 +45,11 @@ struct {
     ROXTermData *roxterm;
     VteTerminal *vte;
     MultiWin *win;
+    guint pending_tag;
+    guint debounce_ms;
+    gboolean filling_in;
+    /* Whether the current pattern and options have already been searched */
+    gboolean searched;
 } search_data;
 
 static char *search_get_filename(gboolean create_dir)
@@ -225,10 +237,83 @@ static void search_update_completion(const char *pattern)
     search_save_completion();
 }
 
+static void search_cancel_pending(void)
+{
+    if (search_data.pending_tag)
+    {
+        g_source_remove(search_data.pending_tag);
+        search_data.pending_tag = 0;
+    }
+}
+
+static guint search_get_flags(void)
+{
+    return (gtk_toggle_button_get_active(search_data.match_case) ?
+                    ROXTERM_SEARCH_MATCH_CASE : 0) |
+            (gtk_toggle_button_get_active(search_data.as_regex) ?
+                    ROXTERM_SEARCH_AS_REGEX : 0) |
+            (gtk_toggle_button_get_active(search_data.entire_word) ?
+                    ROXTERM_SEARCH_ENTIRE_WORD : 0) |
+            (gtk_toggle_button_get_active(search_data.backwards) ?
+                    ROXTERM_SEARCH_BACKWARDS : 0) |
+            (gtk_toggle_button_get_active(search_data.wrap) ?
+                    ROXTERM_SEARCH_WRAP : 0);
+}
+
+static gboolean search_as_you_type(gpointer handle)
+{
+    const char *pattern = gtk_entry_get_text(search_data.entry);
+    guint flags = search_get_flags();
+    GtkStyleContext *style =
+            gtk_widget_get_style_context(GTK_WIDGET(search_data.entry));
+    gint64 start;
+
+    (void) handle;
+    search_data.pending_tag = 0;
+    if (!search_data.vte)
+        return G_SOURCE_REMOVE;
+    if (!roxterm_set_search(search_data.roxterm, pattern, flags, NULL))
+    {
+        /* Probably an incomplete regular expression, so don't nag */
+        gtk_style_context_add_class(style, GTK_STYLE_CLASS_ERROR);
+        return G_SOURCE_REMOVE;
+    }
+    gtk_style_context_remove_class(style, GTK_STYLE_CLASS_ERROR);
+    search_data.searched = TRUE;
+    if (!pattern[0])
+        return G_SOURCE_REMOVE;
+    /* Start again from the end, so that a longer pattern can match the same
+     * text as before.
+     */
+    vte_terminal_unselect_all(search_data.vte);
+    start = g_get_monotonic_time();
+    roxterm_search_find(search_data.roxterm,
+            flags & ROXTERM_SEARCH_BACKWARDS);
+    search_data.debounce_ms = CLAMP((g_get_monotonic_time() - start) / 500,
+            SEARCH_DEBOUNCE_MS, SEARCH_MAX_DEBOUNCE_MS);
+    return G_SOURCE_REMOVE;
+}
+
+/* Handles changes to the pattern and options. Each change supersedes any
+ * search which hasn't started yet.
+ */
+static void search_changed_cb(GtkWidget *widget, void *handle)
+{
+    (void) widget;
+    (void) handle;
+    if (search_data.filling_in)
+        return;
+    search_data.searched = FALSE;
+    search_cancel_pending();
+    search_data.pending_tag = g_timeout_add(search_data.debounce_ms,
+            search_as_you_type, NULL);
+}
+
 static void search_destroy_cb(GtkWidget *widget, void *handle)
 {
     (void) handle;
     (void) widget;
+    search_cancel_pending();
     search_data.vte = NULL;
     search_dialog = NULL;
 }
@@ -238,6 +323,7 @@ static void search_vte_destroyed_cb(VteTerminal *widget, void *handle)
     (void) handle;
     if (search_data.vte == widget)
     {
+        search_cancel_pending();
         search_data.vte = NULL;
         if (search_dialog)
             gtk_widget_hide(search_dialog);
@@ -249,43 +335,33 @@ static void search_response_cb(GtkWidget *widget,
 {
     (void) handle;
     (void) widget;
+    search_cancel_pending();
     if (response == (guint) GTK_RESPONSE_ACCEPT)
     {
         GError *error = NULL;
         const char *pattern = gtk_entry_get_text(search_data.entry);
         gboolean backwards =
                 gtk_toggle_button_get_active(search_data.backwards);
-        guint flags =
-                (gtk_toggle_button_get_active(search_data.match_case) ?
-                        ROXTERM_SEARCH_MATCH_CASE : 0) |
-                (gtk_toggle_button_get_active(search_data.as_regex) ?
-                        ROXTERM_SEARCH_AS_REGEX : 0) |
-                (gtk_toggle_button_get_active(search_data.entire_word) ?
-                        ROXTERM_SEARCH_ENTIRE_WORD : 0) |
-                (backwards ?
-                        ROXTERM_SEARCH_BACKWARDS : 0) |
-                (gtk_toggle_button_get_active(search_data.wrap) ?
-                        ROXTERM_SEARCH_WRAP : 0);
+        guint flags = search_get_flags();
 
         if (pattern && pattern[0])
             search_update_completion(pattern);
-        if (roxterm_set_search(search_data.roxterm, pattern, flags, &error))
+        /* If the search was already done while typing there's nothing more
+         * to do.
+         */
+        if (!search_data.searched)
         {
-            if (pattern && pattern[0])
+            if (!roxterm_set_search(search_data.roxterm, pattern, flags,
+                        &error))
             {
-                if (backwards)
-                    vte_terminal_search_find_previous(search_data.vte);
-                else
-                    vte_terminal_search_find_next(search_data.vte);
+                dlg_warning(GTK_WINDOW(search_dialog),
+                        _("Invalid search expression: %s"), error->message);
+                g_error_free(error);
+                /* Keep dialog open if there was an error */
+                return;
             }
-        }
-        else
-        {
-            dlg_warning(GTK_WINDOW(search_dialog),
-                    _("Invalid search expression: %s"), error->message);
-            g_error_free(error);
-            /* Keep dialog open if there was an error */
-            return;
+            if (pattern && pattern[0])
+                roxterm_search_find(search_data.roxterm, backwards);
         }
     }
     gtk_widget_hide(search_dialog);
@@ -372,9 +448,23 @@ void search_open_dialog(ROXTermData *roxterm)
                 G_CALLBACK(search_response_cb), NULL);
         g_signal_connect(search_dialog, "destroy",
                 G_CALLBACK(search_destroy_cb), NULL);
-
+        g_signal_connect(entry, "changed",
+                G_CALLBACK(search_changed_cb), NULL);
+        g_signal_connect(search_data.match_case, "toggled",
+                G_CALLBACK(search_changed_cb), NULL);
+        g_signal_connect(search_data.entire_word, "toggled",
+                G_CALLBACK(search_changed_cb), NULL);
+        g_signal_connect(search_data.as_regex, "toggled",
+                G_CALLBACK(search_changed_cb), NULL);
+        g_signal_connect(search_data.backwards, "toggled",
+                G_CALLBACK(search_changed_cb), NULL);
+        g_signal_connect(search_data.wrap, "toggled",
+                G_CALLBACK(search_changed_cb), NULL);
+        search_data.debounce_ms = SEARCH_DEBOUNCE_MS;
     }
 
+    search_cancel_pending();
+    search_data.filling_in = TRUE;
     if (pattern)
     {
         gtk_entry_set_text(search_data.entry, pattern);
@@ -396,6 +486,11 @@ void search_open_dialog(ROXTermData *roxterm)
             flags & ROXTERM_SEARCH_BACKWARDS);
     gtk_toggle_button_set_active(search_data.wrap,
             flags & ROXTERM_SEARCH_WRAP);
+    search_data.filling_in = FALSE;
+    search_data.searched = FALSE;
+    gtk_style_context_remove_class(
+            gtk_widget_get_style_context(GTK_WIDGET(search_data.entry)),
+            GTK_STYLE_CLASS_ERROR);
 
     if (gtk_widget_get_visible(search_dialog))
     {
@@ -22,10 +22,14 @@
 #endif
 
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "multitab.h"
 #include "roxterm.h"
 #include "session-file.h"
+#include "session-journal.h"
+#include "workerpool.h"
 
 /*
 #include <stdarg.h>
@@ -73,21 +77,174 @@ char *session_get_filename(const char *leafname, const char *subdir,
     return pathname;
 }
 
-static void save_tab_to_fp(MultiTab *tab, gpointer handle)
+typedef struct {
+    ROXTermData *roxterm;
+    char *tmp_name;
+    char *filename;
+} SavedScrollback;
+
+typedef struct {
+    GString *str;
+    /* NULL if scrollback isn't being saved, eg for the journal */
+    const char *scrollback_dir;
+    GPtrArray *scrollback;      /* of SavedScrollback */
+} SaveTabContext;
+
+static void saved_scrollback_free(SavedScrollback *saved)
+{
+    g_free(saved->tmp_name);
+    g_free(saved->filename);
+    g_free(saved);
+}
+
+/* Makes sure a file's contents are on disk before it's renamed into place */
+static gboolean sync_file(const char *filename)
+{
+    int fd = open(filename, O_RDONLY);
+    gboolean result = fd != -1 && !fsync(fd);
+
+    if (fd != -1)
+        close(fd);
+    return result;
+}
+
+/* Saves the tab's scrollback to a temporary file, returning the name of the
+ * file it will be renamed to if the session is saved successfully. The name
+ * is new for each save, and reserved by creating an empty file, so a session
+ * file can't end up referring to a file which has been overwritten by a
+ * later save.
+ */
+static const char *save_tab_scrollback(ROXTermData *roxterm,
+        SaveTabContext *ctx)
+{
+    SavedScrollback *saved;
+    int fd;
+
+    if (!ctx->scrollback_dir || !roxterm_get_session_scrollback(roxterm))
+        return NULL;
+    if (!g_file_test(ctx->scrollback_dir, G_FILE_TEST_IS_DIR) &&
+            g_mkdir_with_parents(ctx->scrollback_dir, 0700))
+    {
+        g_warning(_("Unable to create directory '%s': %s"),
+                ctx->scrollback_dir, strerror(errno));
+        return NULL;
+    }
+    saved = g_new(SavedScrollback, 1);
+    saved->roxterm = roxterm;
+    saved->filename = g_build_filename(ctx->scrollback_dir, "tab-XXXXXX.gz",
+            NULL);
+    saved->tmp_name = NULL;
+    fd = g_mkstemp_full(saved->filename, O_RDWR, 0600);
+    if (fd == -1)
+    {
+        g_warning(_("Unable to create '%s': %s"),
+                saved->filename, strerror(errno));
+        saved_scrollback_free(saved);
+        return NULL;
+    }
+    close(fd);
+    saved->tmp_name = g_strdup_printf("%s.tmp", saved->filename);
+    if (!roxterm_save_scrollback(roxterm, saved->tmp_name) ||
+            !sync_file(saved->tmp_name))
+    {
+        unlink(saved->tmp_name);
+        unlink(saved->filename);
+        saved_scrollback_free(saved);
+        return NULL;
+    }
+    g_ptr_array_add(ctx->scrollback, saved);
+    return saved->filename;
+}
+
+/* Renames the scrollback files saved by save_tab_scrollback into place. This
+ * has to be done before the session file which refers to them is renamed.
+ */
+static gboolean rename_saved_scrollback(SaveTabContext *ctx)
+{
+    guint n;
+
+    for (n = 0; ctx->scrollback && n < ctx->scrollback->len; ++n)
+    {
+        SavedScrollback *saved = g_ptr_array_index(ctx->scrollback, n);
+
+        if (rename(saved->tmp_name, saved->filename))
+        {
+            g_warning(_("Unable to rename '%s' to '%s': %s"),
+                    saved->tmp_name, saved->filename, strerror(errno));
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* After the session file has been renamed into place, deletes the scrollback
+ * files left over from earlier saves, or deletes the new ones if the session
+ * couldn't be saved.
+ */
+static void finish_saving_scrollback(SaveTabContext *ctx, gboolean success)
+{
+    GHashTable *keep;
+    GDir *gdir;
+    const char *leaf;
+    guint n;
+
+    if (!ctx->scrollback_dir)
+        return;
+    keep = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    for (n = 0; n < ctx->scrollback->len; ++n)
+    {
+        SavedScrollback *saved = g_ptr_array_index(ctx->scrollback, n);
+
+        if (success)
+        {
+            roxterm_scrollback_moved(saved->roxterm, saved->filename);
+            g_hash_table_add(keep, g_path_get_basename(saved->filename));
+        }
+        else
+        {
+            unlink(saved->tmp_name);
+            unlink(saved->filename);
+        }
+    }
+    if (success)
+    {
+        gdir = g_dir_open(ctx->scrollback_dir, 0, NULL);
+        while (gdir && (leaf = g_dir_read_name(gdir)) != NULL)
+        {
+            if (!g_hash_table_contains(keep, leaf))
+            {
+                char *filename = g_build_filename(ctx->scrollback_dir, leaf,
+                        NULL);
+
+                unlink(filename);
+                g_free(filename);
+            }
+        }
+        if (gdir)
+            g_dir_close(gdir);
+        if (!g_hash_table_size(keep))
+            g_rmdir(ctx->scrollback_dir);
+    }
+    g_hash_table_unref(keep);
+}
+
+static void save_tab_to_string(MultiTab *tab, gpointer handle)
 {
-    FILE *fp = handle;
+    SaveTabContext *ctx = handle;
+    GString *str = ctx->str;
     ROXTermData *roxterm = multi_tab_get_user_data(tab);
     char const * const *commandv = roxterm_get_actual_commandv(roxterm);
     const char *name = multi_tab_get_window_title_template(tab);
     const char *title = multi_tab_get_window_title(tab);
     char *cwd = roxterm_get_cwd(roxterm);
+    const char *scrollback = save_tab_scrollback(roxterm, ctx);
     const char *profile_name = roxterm_get_profile_name(roxterm);
     const char *colour_scheme_name = roxterm_get_colour_scheme_name(roxterm);
     char *s = colour_scheme_name ?
         g_markup_printf_escaped("    <tab profile='%s' colour_scheme='%s'\n",
                                 profile_name, colour_scheme_name) :
         g_markup_printf_escaped("    <tab profile='%s'\n", profile_name);
-    fputs(s, fp);
+    g_string_append(str, s);
     g_free(s);
     s = g_markup_printf_escaped("        cwd='%s'\n"
             "        title_template='%s' window_title='%s'\n"
@@ -97,9 +254,15 @@ static void save_tab_to_fp(MultiTab *tab, gpointer handle)
             title ? title : "",
             multi_tab_get_title_template_locked(tab));
     g_free(cwd);
-    fputs(s, fp);
+    g_string_append(str, s);
     g_free(s);
-    fprintf(fp, " current='%d'%s>\n",
+    if (scrollback)
+    {
+        s = g_markup_printf_escaped("\n        scrollback='%s'", scrollback);
+        g_string_append(str, s);
+        g_free(s);
+    }
+    g_string_append_printf(str, " current='%d'%s>\n",
             tab == multi_win_get_current_tab(multi_tab_get_parent(tab)),
             commandv ? "" : " /");
     if (commandv)
@@ -107,110 +270,245 @@ static void save_tab_to_fp(MultiTab *tab, gpointer handle)
         int n;
 
         for (n = 0; commandv[n]; ++n);
-        fprintf(fp, "      <command argc='%d'>\n", n);
+        g_string_append_printf(str, "      <command argc='%d'>\n", n);
         for (n = 0; commandv[n]; ++n)
         {
             s = g_markup_printf_escaped("        <arg s='%s' />\n",
                     commandv[n]);
-            fputs(s, fp);
+            g_string_append(str, s);
             g_free(s);
         }
-        fputs("      </command>\n", fp);
-        fputs("    </tab>\n", fp);
+        g_string_append(str, "      </command>\n");
+        g_string_append(str, "    </tab>\n");
     }
 }
 
-static gboolean save_session_to_fp(FILE *fp, const char *session_id)
+char *session_file_get_tab_element(MultiTab *tab)
+{
+    SaveTabContext ctx = { g_string_new(NULL), NULL, NULL };
+
+    save_tab_to_string(tab, &ctx);
+    return g_string_free(ctx.str, FALSE);
+}
+
+char *session_file_get_window_start_tag(MultiWin *win)
+{
+    GtkWindow *gwin = GTK_WINDOW(multi_win_get_widget(win));
+    int w, h;
+    int x, y;
+    const char *tt = multi_win_get_title_template(win);
+    const char *title = multi_win_get_title(win);
+    gpointer user_data = multi_win_get_user_data_for_current_tab(win);
+    VteTerminal *vte;
+    char *font_name;
+    gboolean disable_menu_shortcuts, disable_tab_shortcuts;
+    char *s;
+
+    SLOG("Saving window with title '%s'", title);
+    if (!user_data)
+    {
+        g_warning(_("Window with no user data"));
+        return NULL;
+    }
+    vte = roxterm_get_vte_terminal(user_data);
+    font_name = pango_font_description_to_string(
+            vte_terminal_get_font(vte));
+    multi_win_get_disable_menu_shortcuts(user_data,
+            &disable_menu_shortcuts, &disable_tab_shortcuts);
+    roxterm_get_nonfs_dimensions(user_data, &w, &h);
+    gtk_window_get_position(gwin, &x, &y);
+    s = g_markup_printf_escaped("  <window geometry='%dx%d+%d+%d'\n"
+            "      title_template='%s' font='%s'\n"
+            "      title_template_locked='%d'\n"
+            "      title='%s' role='%s'\n"
+            "      shortcut_scheme='%s' show_menubar='%d'\n"
+            "      always_show_tabs='%d' tab_pos='%d'\n"
+            "      show_add_tab_btn='%d'\n"
+            "      disable_menu_shortcuts='%d' disable_tab_shortcuts='%d'\n"
+            "      maximised='%d' fullscreen='%d' borderless='%d' zoom='%f'>\n",
+            w, h, x, y,
+            tt ? tt : "", font_name,
+            multi_win_get_title_template_locked(win),
+            title, gtk_window_get_role(gwin),
+            multi_win_get_shortcuts_scheme_name(win),
+            multi_win_get_show_menu_bar(win),
+            multi_win_get_always_show_tabs(win),
+            multi_win_get_tab_pos(win),
+            multi_win_get_show_add_tab_button(win),
+            disable_menu_shortcuts, disable_tab_shortcuts,
+            multi_win_is_maximised(win),
+            multi_win_is_fullscreen(win),
+            multi_win_is_borderless(win),
+            roxterm_get_zoom_factor(user_data));
+    g_free(font_name);
+    return s;
+}
+
+/* Saves this process' windows without the enclosing roxterm_session element */
+static gboolean save_windows_to_fp(FILE *fp, SaveTabContext *ctx)
 {
     GList *wlink;
 
-    SLOG("Saving session with id %s", sd->client_id);
-    if (fprintf(fp, "<roxterm_session id='%s'>\n", session_id) < 0)
-        return FALSE;
     for (wlink = multi_win_all; wlink; wlink = g_list_next(wlink))
     {
         MultiWin *win = wlink->data;
-        GtkWindow *gwin = GTK_WINDOW(multi_win_get_widget(win));
-        int w, h;
-        int x, y;
+        char *s = session_file_get_window_start_tag(win);
         int result;
-        const char *tt = multi_win_get_title_template(win);
-        const char *title = multi_win_get_title(win);
-        gpointer user_data = multi_win_get_user_data_for_current_tab(win);
-        VteTerminal *vte;
-        char *font_name;
-        gboolean disable_menu_shortcuts, disable_tab_shortcuts;
-        char *s;
-
-        SLOG("Saving window with title '%s'", title);
-        if (!user_data)
-        {
-            g_warning(_("Window with no user data"));
+
+        if (!s)
             continue;
-        }
-        vte = roxterm_get_vte_terminal(user_data);
-        font_name = pango_font_description_to_string(
-                vte_terminal_get_font(vte));
-        multi_win_get_disable_menu_shortcuts(user_data,
-                &disable_menu_shortcuts, &disable_tab_shortcuts);
-        roxterm_get_nonfs_dimensions(user_data, &w, &h);
-        gtk_window_get_position(gwin, &x, &y);
-        s = g_markup_printf_escaped("  <window geometry='%dx%d+%d+%d'\n"
-                "      title_template='%s' font='%s'\n"
-                "      title_template_locked='%d'\n"
-                "      title='%s' role='%s'\n"
-                "      shortcut_scheme='%s' show_menubar='%d'\n"
-                "      always_show_tabs='%d' tab_pos='%d'\n"
-                "      show_add_tab_btn='%d'\n"
-                "      disable_menu_shortcuts='%d' disable_tab_shortcuts='%d'\n"
-                "      maximised='%d' fullscreen='%d' borderless='%d' zoom='%f'>\n",
-                w, h, x, y,
-                tt ? tt : "", font_name,
-                multi_win_get_title_template_locked(win),
-                title, gtk_window_get_role(gwin),
-                multi_win_get_shortcuts_scheme_name(win),
-                multi_win_get_show_menu_bar(win),
-                multi_win_get_always_show_tabs(win),
-                multi_win_get_tab_pos(win),
-                multi_win_get_show_add_tab_button(win),
-                disable_menu_shortcuts, disable_tab_shortcuts,
-                multi_win_is_maximised(win),
-                multi_win_is_fullscreen(win),
-                multi_win_is_borderless(win),
-                roxterm_get_zoom_factor(user_data));
         result = fputs(s, fp);
         g_free(s);
-        g_free(font_name);
         SLOG("Saved the window");
         if (result < 0)
         {
             SLOG("But it failed!");
             return FALSE;
         }
-        multi_win_foreach_tab(win, save_tab_to_fp, fp);
-        if (fprintf(fp, "  </window>\n") < 0)
+        ctx->str = g_string_new(NULL);
+        multi_win_foreach_tab(win, save_tab_to_string, ctx);
+        result = fputs(ctx->str->str, fp);
+        g_string_free(ctx->str, TRUE);
+        ctx->str = NULL;
+        if (result < 0 || fprintf(fp, "  </window>\n") < 0)
             return FALSE;
     }
+    return TRUE;
+}
+
+static gboolean save_session_to_fp(FILE *fp, const char *session_id,
+        SaveTabContext *ctx)
+{
+    SLOG("Saving session with id %s", sd->client_id);
+    if (fprintf(fp, "<roxterm_session id='%s'>\n", session_id) < 0)
+        return FALSE;
+    if (!save_windows_to_fp(fp, ctx))
+        return FALSE;
     return fprintf(fp, "</roxterm_session>\n") > 0;
 }
 
 gboolean save_session_to_file(const char *filename, const char *id)
 {
     gboolean result;
-    FILE *fp = fopen(filename, "w");
+    char *tmp_name;
+    char *scrollback_dir;
+    SaveTabContext ctx;
+    FILE *fp;
+
+    /* A worker only knows about its own windows, so the dispatcher has to
+     * collect them from the whole pool.
+     */
+    if (worker_pool_is_worker())
+        return worker_pool_save_session(filename, id);
+    /* Save to a temporary file first so a crash can't leave a partial file */
+    tmp_name = g_strdup_printf("%s.tmp", filename);
+    fp = fopen(tmp_name, "w");
 
     if (!fp)
     {
         SLOG("Failed to open '%s' to save session: %s",
-                filename, strerror(errno));
+                tmp_name, strerror(errno));
+        g_free(tmp_name);
         return FALSE;
     }
-    result = save_session_to_fp(fp, id);
+    /* Scrollback is saved in a directory alongside the session file, with
+     * new names each time. They're renamed into place before the session
+     * file, and the old ones are only deleted after it, so whichever session
+     * file survives a crash refers to the files saved with it.
+     */
+    scrollback_dir = g_strdup_printf("%s.scrollback", filename);
+    ctx.str = NULL;
+    ctx.scrollback_dir = scrollback_dir;
+    ctx.scrollback = g_ptr_array_new_with_free_func(
+            (GDestroyNotify) saved_scrollback_free);
+    result = save_session_to_fp(fp, id, &ctx);
     if (!result)
     {
         SLOG("Failed to save session to '%s': %s", filename, strerror(errno));
     }
-    fclose(fp);
+    if (fflush(fp) || fsync(fileno(fp)))
+        result = FALSE;
+    if (fclose(fp))
+        result = FALSE;
+    if (result && !rename_saved_scrollback(&ctx))
+        result = FALSE;
+    if (result && rename(tmp_name, filename))
+        result = FALSE;
+    if (!result)
+        unlink(tmp_name);
+    finish_saving_scrollback(&ctx, result);
+    g_ptr_array_unref(ctx.scrollback);
+    g_free(scrollback_dir);
+    g_free(tmp_name);
+    return result;
+}
+
+gboolean save_session_part_to_file(const char *filename)
+{
+    gboolean result;
+    FILE *fp = fopen(filename, "w");
+    /* Tabs' scrollback isn't saved with a worker pool; the parts are written
+     * to temporary files which don't say where the session will end up.
+     */
+    SaveTabContext ctx = { NULL, NULL, NULL };
+
+    if (!fp)
+    {
+        g_warning(_("Unable to open '%s' to save session: %s"),
+                filename, strerror(errno));
+        return FALSE;
+    }
+    result = save_windows_to_fp(fp, &ctx);
+    if (fclose(fp))
+        result = FALSE;
+    return result;
+}
+
+gboolean save_session_from_parts(const char *filename, const char *id,
+        char **parts)
+{
+    char *tmp_name = g_strdup_printf("%s.tmp", filename);
+    FILE *fp = fopen(tmp_name, "w");
+    gboolean result;
+    int n;
+
+    if (!fp)
+    {
+        g_warning(_("Unable to open '%s' to save session: %s"),
+                tmp_name, strerror(errno));
+        g_free(tmp_name);
+        return FALSE;
+    }
+    result = fprintf(fp, "<roxterm_session id='%s'>\n", id) > 0;
+    for (n = 0; result && parts[n]; ++n)
+    {
+        char *buf;
+        gsize len;
+        GError *error = NULL;
+
+        /* A part may be missing if its worker exited before saving */
+        if (!g_file_get_contents(parts[n], &buf, &len, &error))
+        {
+            g_warning(_("Unable to load session part: %s"), error->message);
+            g_error_free(error);
+            continue;
+        }
+        result = fwrite(buf, 1, len, fp) == len;
+        g_free(buf);
+    }
+    if (result)
+        result = fprintf(fp, "</roxterm_session>\n") > 0;
+    if (fclose(fp))
+        result = FALSE;
+    if (result && rename(tmp_name, filename))
+    {
+        g_warning(_("Unable to rename '%s' to '%s': %s"),
+                tmp_name, filename, strerror(errno));
+        result = FALSE;
+    }
+    if (!result)
+        unlink(tmp_name);
+    g_free(tmp_name);
     return result;
 }
 
@@ -230,6 +528,16 @@ gboolean load_session_from_file(const char *filename, const char *client_id)
         g_error_free(err);
         return FALSE;
     }
+    if (g_str_has_prefix(buf, SESSION_JOURNAL_MAGIC))
+    {
+        char *session = session_journal_to_session(buf, buflen, client_id);
+
+        g_free(buf);
+        if (!session)
+            return FALSE;
+        buf = session;
+        buflen = strlen(buf);
+    }
     result = roxterm_load_session(buf, buflen, client_id);
     g_free(buf);
     return result;
@@ -25,11 +25,32 @@
 #include "defns.h"
 #endif
 
+#include "multitab.h"
+
 char *session_get_filename(const char *leafname, const char *dir,
         gboolean create_dir);
 
+/* The parts of a session file describing a single window or tab, for the
+ * session journal. The window's element is left open. Free with g_free.
+ */
+char *session_file_get_window_start_tag(MultiWin *win);
+
+char *session_file_get_tab_element(MultiTab *tab);
+
 gboolean save_session_to_file(const char *filename, const char *client_id);
 
+/* Saves this process' windows only, for merging with other workers' windows
+ * by save_session_from_parts.
+ */
+gboolean save_session_part_to_file(const char *filename);
+
+/* Writes a complete session file from parts saved by the workers in a pool.
+ * parts is NULL-terminated.
+ */
+gboolean save_session_from_parts(const char *filename, const char *id,
+        char **parts);
+
+/* filename may also be a session journal */
 gboolean load_session_from_file(const char *filename, const char *client_id);
 
 /*
@@ -0,0 +1,504 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "defns.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "session-file.h"
+#include "session-journal.h"
+
+/* How long to collect changes before writing them */
+#define SESSION_JOURNAL_DELAY_MS 1000
+
+/* The journal is compacted after this many records have been appended */
+#define SESSION_JOURNAL_COMPACT_RECORDS 1000
+
+typedef struct {
+    GString *data;              /* NULL tells the writer thread to stop */
+    gboolean snapshot;
+} SessionJournalJob;
+
+typedef struct {
+    guint order;
+    char *xml;
+    const char *id;             /* The key in the table of windows */
+} SessionJournalWin;
+
+typedef struct {
+    guint order;
+    int index;
+    char *xml;
+    char *win_id;
+} SessionJournalTab;
+
+static struct {
+    char *filename;
+    GThread *thread;
+    GAsyncQueue *jobs;
+    GHashTable *dirty_wins;
+    GHashTable *dirty_tabs;
+    GString *closed;            /* Records of closed windows and tabs */
+    guint flush_tag;
+    guint records;              /* Appended since the last snapshot */
+} session_journal;
+
+static gboolean session_journal_write_all(int fd, const char *buf, gsize len)
+{
+    while (len)
+    {
+        ssize_t n = write(fd, buf, len);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return FALSE;
+        }
+        buf += n;
+        len -= n;
+    }
+    return TRUE;
+}
+
+/* Replaces the journal with a snapshot and returns an fd for appending to
+ * it, or -1.
+ */
+static int session_journal_write_snapshot(int fd, GString *snapshot)
+{
+    GError *error = NULL;
+
+    /* g_file_set_contents writes a temporary file and renames it */
+    if (!g_file_set_contents(session_journal.filename,
+                snapshot->str, snapshot->len, &error))
+    {
+        g_warning(_("Unable to write session journal: %s"), error->message);
+        g_error_free(error);
+        return fd;
+    }
+    if (fd >= 0)
+        close(fd);
+    fd = open(session_journal.filename, O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (fd < 0)
+    {
+        g_warning(_("Unable to open session journal '%s': %s"),
+                session_journal.filename, g_strerror(errno));
+    }
+    return fd;
+}
+
+static gpointer session_journal_writer(gpointer data)
+{
+    int fd = -1;
+    (void) data;
+
+    for (;;)
+    {
+        SessionJournalJob *job = g_async_queue_pop(session_journal.jobs);
+
+        if (!job->data)
+        {
+            g_free(job);
+            break;
+        }
+        if (job->snapshot)
+        {
+            fd = session_journal_write_snapshot(fd, job->data);
+        }
+        else if (fd >= 0)
+        {
+            if (!session_journal_write_all(fd, job->data->str,
+                        job->data->len))
+            {
+                g_warning(_("Unable to write session journal: %s"),
+                        g_strerror(errno));
+            }
+            fdatasync(fd);
+        }
+        g_string_free(job->data, TRUE);
+        g_free(job);
+    }
+    if (fd >= 0)
+        close(fd);
+    return NULL;
+}
+
+static void session_journal_push(GString *data, gboolean snapshot)
+{
+    SessionJournalJob *job = g_new(SessionJournalJob, 1);
+
+    job->data = data;
+    job->snapshot = snapshot;
+    g_async_queue_push(session_journal.jobs, job);
+}
+
+/* Records are one line each; the XML's newlines are only for layout */
+static void session_journal_append_xml(GString *str, char *xml)
+{
+    char *s;
+
+    for (s = xml; *s; ++s)
+    {
+        if (*s == '\n')
+            *s = ' ';
+    }
+    g_string_append(str, g_strstrip(xml));
+    g_string_append_c(str, '\n');
+    g_free(xml);
+}
+
+static void session_journal_append_win(GString *str, MultiWin *win)
+{
+    char *xml = session_file_get_window_start_tag(win);
+
+    if (!xml)
+        return;
+    g_string_append_printf(str, "W %p ", win);
+    session_journal_append_xml(str, xml);
+    ++session_journal.records;
+}
+
+static void session_journal_append_tab(GString *str, MultiTab *tab)
+{
+    MultiWin *win = multi_tab_get_parent(tab);
+
+    if (!win || !multi_tab_get_user_data(tab))
+        return;
+    g_string_append_printf(str, "T %p %p %d ", tab, win,
+            multi_tab_get_page_num(tab));
+    session_journal_append_xml(str, session_file_get_tab_element(tab));
+    ++session_journal.records;
+}
+
+static void session_journal_snapshot(void)
+{
+    GString *str = g_string_new(SESSION_JOURNAL_MAGIC);
+    GList *wlink;
+
+    for (wlink = multi_win_all; wlink; wlink = g_list_next(wlink))
+    {
+        MultiWin *win = wlink->data;
+        GList *tlink;
+
+        session_journal_append_win(str, win);
+        for (tlink = multi_win_get_tabs(win); tlink;
+                tlink = g_list_next(tlink))
+        {
+            session_journal_append_tab(str, tlink->data);
+        }
+    }
+    session_journal.records = 0;
+    session_journal_push(str, TRUE);
+}
+
+static gboolean session_journal_flush(gpointer data)
+{
+    GHashTableIter iter;
+    gpointer key;
+    GString *str;
+    (void) data;
+
+    session_journal.flush_tag = 0;
+    if (session_journal.records >= SESSION_JOURNAL_COMPACT_RECORDS)
+    {
+        session_journal_snapshot();
+    }
+    else
+    {
+        str = session_journal.closed;
+        session_journal.closed = g_string_new(NULL);
+        /* A tab's window must be recorded before the tab */
+        g_hash_table_iter_init(&iter, session_journal.dirty_wins);
+        while (g_hash_table_iter_next(&iter, &key, NULL))
+            session_journal_append_win(str, key);
+        g_hash_table_iter_init(&iter, session_journal.dirty_tabs);
+        while (g_hash_table_iter_next(&iter, &key, NULL))
+            session_journal_append_tab(str, key);
+        if (str->len)
+            session_journal_push(str, FALSE);
+        else
+            g_string_free(str, TRUE);
+    }
+    g_string_truncate(session_journal.closed, 0);
+    g_hash_table_remove_all(session_journal.dirty_wins);
+    g_hash_table_remove_all(session_journal.dirty_tabs);
+    return G_SOURCE_REMOVE;
+}
+
+static void session_journal_schedule(void)
+{
+    if (!session_journal.flush_tag)
+    {
+        session_journal.flush_tag = g_timeout_add(SESSION_JOURNAL_DELAY_MS,
+                session_journal_flush, NULL);
+    }
+}
+
+void session_journal_start(const char *filename)
+{
+    g_return_if_fail(!session_journal.thread);
+    session_journal.filename = g_strdup(filename);
+    session_journal.jobs = g_async_queue_new();
+    session_journal.dirty_wins = g_hash_table_new(NULL, NULL);
+    session_journal.dirty_tabs = g_hash_table_new(NULL, NULL);
+    session_journal.closed = g_string_new(NULL);
+    session_journal.thread = g_thread_new("session-journal",
+            session_journal_writer, NULL);
+    session_journal_snapshot();
+}
+
+void session_journal_stop(void)
+{
+    if (!session_journal.thread)
+        return;
+    if (session_journal.flush_tag)
+    {
+        g_source_remove(session_journal.flush_tag);
+        session_journal.flush_tag = 0;
+    }
+    /* Everything's normally closed by now, so this just empties the journal */
+    session_journal_snapshot();
+    session_journal_push(NULL, FALSE);
+    g_thread_join(session_journal.thread);
+    session_journal.thread = NULL;
+    g_async_queue_unref(session_journal.jobs);
+    g_hash_table_destroy(session_journal.dirty_wins);
+    g_hash_table_destroy(session_journal.dirty_tabs);
+    g_string_free(session_journal.closed, TRUE);
+    g_free(session_journal.filename);
+    session_journal.filename = NULL;
+}
+
+void session_journal_win_changed(MultiWin *win)
+{
+    GList *link;
+
+    if (!session_journal.thread)
+        return;
+    g_hash_table_add(session_journal.dirty_wins, win);
+    /* The positions of its tabs have probably changed too */
+    for (link = multi_win_get_tabs(win); link; link = g_list_next(link))
+        g_hash_table_add(session_journal.dirty_tabs, link->data);
+    session_journal_schedule();
+}
+
+void session_journal_win_closed(MultiWin *win)
+{
+    if (!session_journal.thread)
+        return;
+    g_hash_table_remove(session_journal.dirty_wins, win);
+    g_string_append_printf(session_journal.closed, "w %p\n", win);
+    ++session_journal.records;
+    session_journal_schedule();
+}
+
+void session_journal_tab_changed(MultiTab *tab)
+{
+    if (!session_journal.thread)
+        return;
+    g_hash_table_add(session_journal.dirty_tabs, tab);
+    session_journal_schedule();
+}
+
+void session_journal_tab_closed(MultiTab *tab)
+{
+    if (!session_journal.thread)
+        return;
+    g_hash_table_remove(session_journal.dirty_tabs, tab);
+    g_string_append_printf(session_journal.closed, "t %p\n", tab);
+    ++session_journal.records;
+    session_journal_schedule();
+}
+
+static void session_journal_win_free(gpointer data)
+{
+    SessionJournalWin *jwin = data;
+
+    g_free(jwin->xml);
+    g_free(jwin);
+}
+
+static void session_journal_tab_free(gpointer data)
+{
+    SessionJournalTab *jtab = data;
+
+    g_free(jtab->xml);
+    g_free(jtab->win_id);
+    g_free(jtab);
+}
+
+static gint session_journal_compare_wins(gconstpointer a, gconstpointer b)
+{
+    const SessionJournalWin *wa = *(SessionJournalWin * const *) a;
+    const SessionJournalWin *wb = *(SessionJournalWin * const *) b;
+
+    return (wa->order > wb->order) - (wa->order < wb->order);
+}
+
+static gint session_journal_compare_tabs(gconstpointer a, gconstpointer b)
+{
+    const SessionJournalTab *ta = *(SessionJournalTab * const *) a;
+    const SessionJournalTab *tb = *(SessionJournalTab * const *) b;
+
+    if (ta->index != tb->index)
+        return ta->index < tb->index ? -1 : 1;
+    return (ta->order > tb->order) - (ta->order < tb->order);
+}
+
+/* Handles one complete line of a journal, without its newline */
+static void session_journal_parse_record(char *line,
+        GHashTable *wins, GHashTable *tabs, guint order)
+{
+    char **fields;
+
+    switch (line[0])
+    {
+        case 'W':
+            fields = g_strsplit(line, " ", 3);
+            if (g_strv_length(fields) == 3)
+            {
+                SessionJournalWin *jwin =
+                        g_hash_table_lookup(wins, fields[1]);
+
+                if (!jwin)
+                {
+                    jwin = g_new0(SessionJournalWin, 1);
+                    jwin->order = order;
+                    jwin->id = g_strdup(fields[1]);
+                    g_hash_table_insert(wins, (char *) jwin->id, jwin);
+                }
+                g_free(jwin->xml);
+                jwin->xml = g_strdup(fields[2]);
+            }
+            break;
+        case 'T':
+            fields = g_strsplit(line, " ", 5);
+            if (g_strv_length(fields) == 5)
+            {
+                SessionJournalTab *jtab = g_new0(SessionJournalTab, 1);
+
+                jtab->order = order;
+                jtab->win_id = g_strdup(fields[2]);
+                jtab->index = atoi(fields[3]);
+                jtab->xml = g_strdup(fields[4]);
+                g_hash_table_replace(tabs, g_strdup(fields[1]), jtab);
+            }
+            break;
+        case 'w':
+            g_hash_table_remove(wins, line + 2);
+            return;
+        case 't':
+            g_hash_table_remove(tabs, line + 2);
+            return;
+        default:
+            return;
+    }
+    g_strfreev(fields);
+}
+
+char *session_journal_to_session(const char *buf, gsize len, const char *id)
+{
+    GHashTable *wins = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, session_journal_win_free);
+    GHashTable *tabs = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, session_journal_tab_free);
+    GHashTable *tabs_by_win = g_hash_table_new_full(g_str_hash, g_str_equal,
+            NULL, (GDestroyNotify) g_ptr_array_unref);
+    GPtrArray *sorted_wins;
+    GHashTableIter iter;
+    gpointer key, value;
+    GString *session = NULL;
+    const char *end = buf + len;
+    guint order = 0;
+    guint n;
+
+    while (buf < end)
+    {
+        const char *eol = memchr(buf, '\n', end - buf);
+        char *line;
+
+        /* The last record may have been cut short */
+        if (!eol)
+            break;
+        line = g_strndup(buf, eol - buf);
+        if (line[0] && line[1] == ' ')
+            session_journal_parse_record(line, wins, tabs, order++);
+        g_free(line);
+        buf = eol + 1;
+    }
+
+    sorted_wins = g_ptr_array_new();
+    g_hash_table_iter_init(&iter, wins);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        g_ptr_array_add(sorted_wins, value);
+        g_hash_table_insert(tabs_by_win, key, g_ptr_array_new());
+    }
+    g_hash_table_iter_init(&iter, tabs);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        SessionJournalTab *jtab = value;
+        GPtrArray *win_tabs = g_hash_table_lookup(tabs_by_win, jtab->win_id);
+
+        if (win_tabs)
+            g_ptr_array_add(win_tabs, jtab);
+    }
+    g_ptr_array_sort(sorted_wins, session_journal_compare_wins);
+
+    for (n = 0; n < sorted_wins->len; ++n)
+    {
+        SessionJournalWin *jwin = g_ptr_array_index(sorted_wins, n);
+        GPtrArray *win_tabs = g_hash_table_lookup(tabs_by_win, jwin->id);
+        guint t;
+
+        if (!win_tabs->len)
+            continue;
+        g_ptr_array_sort(win_tabs, session_journal_compare_tabs);
+        if (!session)
+        {
+            char *s = g_markup_printf_escaped("<roxterm_session id='%s'>\n",
+                    id);
+
+            session = g_string_new(s);
+            g_free(s);
+        }
+        g_string_append_printf(session, "  %s\n", jwin->xml);
+        for (t = 0; t < win_tabs->len; ++t)
+        {
+            SessionJournalTab *jtab = g_ptr_array_index(win_tabs, t);
+
+            g_string_append_printf(session, "    %s\n", jtab->xml);
+        }
+        g_string_append(session, "  </window>\n");
+    }
+    if (session)
+        g_string_append(session, "</roxterm_session>\n");
+    g_ptr_array_unref(sorted_wins);
+    g_hash_table_destroy(tabs_by_win);
+    g_hash_table_destroy(tabs);
+    g_hash_table_destroy(wins);
+    return session ? g_string_free(session, FALSE) : NULL;
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
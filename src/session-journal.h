@@ -0,0 +1,67 @@
+#ifndef SESSION_JOURNAL_H
+#define SESSION_JOURNAL_H
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+/* An append-only record of the windows and tabs which are open, so they can
+ * be restored after a crash instead of only from a session saved explicitly.
+ * Changes are noted as they happen, collected for a short while, then
+ * written by a background thread. Each record holds the same XML as a
+ * session file for one window or tab, and later records replace earlier ones
+ * with the same id. Every so often the journal is compacted by replacing it
+ * with a snapshot of the current state, renamed into place atomically. A
+ * record cut short by a crash is ignored when the journal is loaded.
+ */
+
+#ifndef DEFNS_H
+#include "defns.h"
+#endif
+
+#include "multitab.h"
+
+/* The first line of a journal, so load_session_from_file can recognise one */
+#define SESSION_JOURNAL_MAGIC "roxterm-session-journal 1\n"
+
+/* Starts recording this process' windows in filename, replacing its
+ * previous contents.
+ */
+void session_journal_start(const char *filename);
+
+/* Writes any outstanding changes and waits for the writer thread to finish */
+void session_journal_stop(void);
+
+/* These do nothing if the journal hasn't been started */
+void session_journal_win_changed(MultiWin *win);
+
+void session_journal_win_closed(MultiWin *win);
+
+void session_journal_tab_changed(MultiTab *tab);
+
+void session_journal_tab_closed(MultiTab *tab);
+
+/* Converts the contents of a journal to a session file in a single pass.
+ * Returns NULL if there are no windows to restore. The result should be
+ * freed with g_free.
+ */
+char *session_journal_to_session(const char *buf, gsize len, const char *id);
+
+#endif /* SESSION_JOURNAL_H */
+
+/* vi:set sw=4 ts=4 et cindent cino= */
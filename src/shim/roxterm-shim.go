@@ -1,6 +1,7 @@
 package main
 
 import (
+	"bytes"
 	"fmt"
 	"io"
 	"log"
@@ -9,6 +10,7 @@ import (
 	"strconv"
 	"strings"
 	"sync"
+	"sync/atomic"
 	"time"
 )
 
@@ -42,27 +44,54 @@ const (
 	// Sequence was of interest, but it's too long, so the rest of it will be
 	// discarded until we get a terminator.
 	Discarding
-
-	// Copying until we get to an Esc terminator.
-	CopyingIgnoredEsc
 )
 
+// debugLogging enables logging of every chunk and state change. It's off
+// unless ROXTERM_SHIM_DEBUG is set, because formatting all the data passing
+// through is much more expensive than copying it.
+var debugLogging = os.Getenv("ROXTERM_SHIM_DEBUG") != ""
+
 // ShimBuffer holds data as it's read from the input until it's ready to be
-// sent downstream.
+// sent downstream. Buffers are pooled and reference counted, because chunks
+// of a buffer are still queued for writing after the reader has moved on to
+// another buffer.
 type ShimBuffer struct {
 	buf     []byte
 	nFilled int // Number of bytes stored in the buffer
+	refs    int32
+}
+
+var shimBufferPool = sync.Pool{
+	New: func() any {
+		return &ShimBuffer{buf: make([]byte, BufferSize)}
+	},
 }
 
-// NewShimBuffer allocates an empty ShimBuffer
+// NewShimBuffer gets an empty ShimBuffer from the pool, holding one reference
 func NewShimBuffer() *ShimBuffer {
-	return &ShimBuffer{
-		buf: make([]byte, BufferSize),
+	buf := shimBufferPool.Get().(*ShimBuffer)
+	buf.nFilled = 0
+	buf.refs = 1
+	return buf
+}
+
+// Ref adds a reference to the buffer. It's safe to call with nil.
+func (buf *ShimBuffer) Ref() {
+	if buf != nil {
+		atomic.AddInt32(&buf.refs, 1)
+	}
+}
+
+// Unref releases a reference, returning the buffer to the pool when none
+// are left. It's safe to call with nil.
+func (buf *ShimBuffer) Unref() {
+	if buf != nil && atomic.AddInt32(&buf.refs, -1) == 0 {
+		shimBufferPool.Put(buf)
 	}
 }
 
 // NextFillableSlice gets a slice from the ShimBuffer that can be written to.
-// If the buffer is near capacity it returns nil and you should allocate a new
+// If the buffer is near capacity it returns nil and you should get a new
 // ShimBuffer.
 func (buf *ShimBuffer) NextFillableSlice() []byte {
 	if buf.nFilled > MaxBufferSizeForTopUp {
@@ -83,6 +112,51 @@ func (buf *ShimBuffer) IsEmpty() bool {
 	return buf.nFilled == 0
 }
 
+// Chunk is a span of data read from the input, holding a reference to the
+// buffer it's in.
+type Chunk struct {
+	data []byte
+	buf  *ShimBuffer
+}
+
+// ChunkBatch is everything that has to be written for one input chunk, so
+// that it costs one channel hand-off however many pieces an escape sequence
+// splits it into. The pieces are usually slices of the chunk, so the batch
+// holds the chunk's buffer reference until they've been written.
+type ChunkBatch struct {
+	pieces [][]byte
+	buf    *ShimBuffer
+}
+
+var chunkBatchPool = sync.Pool{
+	New: func() any {
+		return &ChunkBatch{pieces: make([][]byte, 0, 4)}
+	},
+}
+
+func newChunkBatch(buf *ShimBuffer) *ChunkBatch {
+	batch := chunkBatchPool.Get().(*ChunkBatch)
+	batch.buf = buf
+	return batch
+}
+
+func (batch *ChunkBatch) add(piece []byte) {
+	if len(piece) != 0 {
+		batch.pieces = append(batch.pieces, piece)
+	}
+}
+
+// release drops the batch's buffer reference and returns it to the pool
+func (batch *ChunkBatch) release() {
+	batch.buf.Unref()
+	batch.buf = nil
+	for i := range batch.pieces {
+		batch.pieces[i] = nil
+	}
+	batch.pieces = batch.pieces[:0]
+	chunkBatchPool.Put(batch)
+}
+
 func composeOsc52Log(chunks [][]byte) string {
 	var s []byte
 	for _, chunk := range chunks {
@@ -92,18 +166,30 @@ func composeOsc52Log(chunks [][]byte) string {
 }
 
 type StreamProcessor struct {
-	input                io.Reader
-	output               io.Writer
-	state                int
-	unprocessedChunks    chan []byte
-	processedChunks      chan []byte
-	osc52Chan            chan [][]byte
-	wg                   *sync.WaitGroup
-	name                 string
-	escStart             []byte
-	escEnd               bool
-	collectedOsc52Chunks [][]byte
-	collectedOsc52Size   int
+	input             io.Reader
+	output            io.Writer
+	state             int
+	unprocessedChunks chan Chunk
+	processedChunks   chan *ChunkBatch
+	chanMutex         sync.Mutex
+	osc52Chan         chan [][]byte
+	wg                *sync.WaitGroup
+	name              string
+
+	// While state is PotentialMatch, the number of bytes of the OSC 52
+	// introducer matched so far, and whether it started with ESC-] rather
+	// than 0x9d.
+	prefixLen int
+	prefixEsc bool
+	// The selection parameter ('c' or 'p') in the introducer.
+	selection byte
+	// How many bytes of the introducer came from earlier chunks.
+	carriedLen int
+	// Whether the last byte of the previous chunk was an ESC which may be
+	// the start of an ESC-\ terminator.
+	escEnd bool
+
+	collectedOsc52 []byte
 }
 
 func NewStreamProcessor(input io.Reader, output io.Writer, wg *sync.WaitGroup,
@@ -113,8 +199,8 @@ func NewStreamProcessor(input io.Reader, output io.Writer, wg *sync.WaitGroup,
 		input:             input,
 		output:            output,
 		state:             Filtering,
-		unprocessedChunks: make(chan []byte, MaxChunkQueueLength),
-		processedChunks:   make(chan []byte, MaxChunkQueueLength),
+		unprocessedChunks: make(chan Chunk, MaxChunkQueueLength),
+		processedChunks:   make(chan *ChunkBatch, MaxChunkQueueLength),
 		osc52Chan:         osc52Chan,
 		wg:                wg,
 		name:              name,
@@ -122,17 +208,30 @@ func NewStreamProcessor(input io.Reader, output io.Writer, wg *sync.WaitGroup,
 	return sp
 }
 
+// getUnprocessedChunksChan returns nil once the queue has been closed. The
+// queue can be closed by the thread waiting for the child as well as by the
+// reader.
+func (sp *StreamProcessor) getUnprocessedChunksChan() chan Chunk {
+	sp.chanMutex.Lock()
+	defer sp.chanMutex.Unlock()
+	return sp.unprocessedChunks
+}
+
 func (sp *StreamProcessor) closeUnprocessedChunksChan() {
+	sp.chanMutex.Lock()
 	ch := sp.unprocessedChunks
 	sp.unprocessedChunks = nil
+	sp.chanMutex.Unlock()
 	if ch != nil {
 		close(ch)
 	}
 }
 
 func (sp *StreamProcessor) closeProcessedChunksChan() {
+	sp.chanMutex.Lock()
 	ch := sp.processedChunks
 	sp.processedChunks = nil
+	sp.chanMutex.Unlock()
 	if ch != nil {
 		close(ch)
 	}
@@ -144,11 +243,6 @@ func (sp *StreamProcessor) inputReaderThread() {
 	running := true
 	for running {
 		buf := NewShimBuffer()
-		if buf == nil {
-			log.Printf("%s CPT: NewShimBuffer returned nil", sp.name)
-			running = false
-			break
-		}
 		for {
 			chunk := buf.NextFillableSlice()
 			if chunk == nil {
@@ -161,7 +255,9 @@ func (sp *StreamProcessor) inputReaderThread() {
 			}
 			nFilled, err := reader.Read(chunk)
 			if err != nil {
-				log.Printf("%s IRT: Error reading stream: %v", sp.name, err)
+				if err != io.EOF {
+					log.Printf("%s IRT: Error reading stream: %v", sp.name, err)
+				}
 				sp.closeUnprocessedChunksChan()
 				running = false
 				break
@@ -173,269 +269,311 @@ func (sp *StreamProcessor) inputReaderThread() {
 			}
 			buf.Filled(nFilled)
 			chunk = chunk[:nFilled]
-			log.Printf("%s IRT: Read chunk from input: '%s'", sp.name, chunk)
-			ch := sp.unprocessedChunks
+			if debugLogging {
+				log.Printf("%s IRT: Read chunk from input: '%s'", sp.name, chunk)
+			}
+			ch := sp.getUnprocessedChunksChan()
 			if ch != nil {
-				ch <- chunk
+				buf.Ref()
+				ch <- Chunk{data: chunk, buf: buf}
 			} else {
 				running = false
 				break
 			}
 		}
+		buf.Unref()
 	}
 	log.Printf("%s IRT: Leaving thread", sp.name)
 	sp.wg.Done()
 }
 
 // chunkProcessorThread reads from the unprocessed chunks queue, and passes
-// the chunks on to the processed chunk queue.
-func (sp *StreamProcessor) chunkProcessorThread() {
-	chin := sp.unprocessedChunks
-	var chout chan []byte
+// the chunks on to the processed chunk queue, minus any OSC 52 sequences.
+// The queues are passed in because the reader may close and clear
+// sp.unprocessedChunks before this thread starts.
+func (sp *StreamProcessor) chunkProcessorThread(chin chan Chunk,
+	chout chan *ChunkBatch,
+) {
 	if chin == nil {
 		log.Printf("%s CPT: Input nil, closing output", sp.name)
 		sp.closeProcessedChunksChan()
-	} else if chout = sp.processedChunks; chout == nil {
+	} else if chout == nil {
 		log.Printf("%s CPT: Output nil, closing input", sp.name)
 		sp.closeUnprocessedChunksChan()
 	} else {
-		ok := true
-		for ok {
-			chunk := <-chin
-			if chunk == nil {
-				log.Printf(
-					"%s CPT: channel closed (nil chunk), closing output",
-					sp.name)
-				ok = false
-				break
-			}
-			switch sp.state {
-			case Filtering:
-				ok = sp.processChunkInFilteringState(chunk)
-			case PotentialMatch:
-				ok = sp.processChunkInPotentialMatchState(chunk)
-			case Discarding:
-				ok = sp.processChunkUntilST(chunk)
-			case CopyingIgnoredEsc:
-				ok = sp.processChunkUntilST(chunk)
-			case CollectingOsc52:
-				ok = sp.processChunkUntilST(chunk)
-			default:
-				log.Printf("%s CPT: Invalid state %d", sp.name, sp.state)
-				ok = false
+		for chunk := range chin {
+			batch := newChunkBatch(chunk.buf)
+			sp.processChunk(chunk.data, batch)
+			if len(batch.pieces) == 0 {
+				batch.release()
+			} else {
+				chout <- batch
 			}
 		}
+		log.Printf("%s CPT: channel closed, closing output", sp.name)
 		sp.closeProcessedChunksChan()
 	}
 	log.Printf("%s CPT: Leaving thread", sp.name)
 	sp.wg.Done()
 }
 
-func (sp *StreamProcessor) processChunkInFilteringState(chunk []byte,
-) bool {
+// indexSequenceStart returns the index of the first byte in chunk which could
+// start an OSC sequence, or -1. Scanning for each byte separately with
+// bytes.IndexByte is much faster than a loop for data which doesn't contain
+// them.
+func indexSequenceStart(chunk []byte) int {
+	i := bytes.IndexByte(chunk, EscCode)
+	limit := chunk
+	if i >= 0 {
+		limit = chunk[:i]
+	}
+	if j := bytes.IndexByte(limit, OscCode); j >= 0 {
+		return j
+	}
+	return i
+}
+
+// indexTerminator returns the index of the first byte in chunk which could
+// terminate an OSC sequence, or -1.
+func indexTerminator(chunk []byte) int {
 	for i, c := range chunk {
-		if c == EscCode || c == OscCode {
-			log.Printf("%s processor got potential OSC 52 start %d", sp.name, c)
-			sp.escStart = []byte{c}
-			if i != 0 {
-				sp.processedChunks <- chunk[i:]
-			}
-			remainder := chunk[i+1:]
-			sp.state = PotentialMatch
-			if len(remainder) != 0 {
-				return sp.processChunkInPotentialMatchState(remainder)
-			} else {
-				return true
-			}
+		if c == BelCode || c == StCode || c == EscCode {
+			return i
 		}
 	}
-	sp.processedChunks <- chunk
-	return true
+	return -1
 }
 
-func (sp *StreamProcessor) processChunkInPotentialMatchState(chunk []byte,
-) bool {
-	for i, c := range chunk {
-		ess := len(sp.escStart)
-		var expect byte
-		switch ess {
-		case 1:
-			if sp.escStart[0] == OscCode {
-				log.Printf("%s just had 0x9d, expecting 5", sp.name)
-				expect = '5'
-			} else if sp.escStart[0] == EscCode && c == OscEsc {
-				log.Printf("%s got ESC-] ...", sp.name)
-				sp.escStart = append(sp.escStart, c)
-				continue
-			} else {
-				log.Printf("%s: Unexpected character %d after ESC",
-					sp.name, c)
-				return sp.processRestOfChunkInCopyingEscState(chunk, i)
-			}
-		case 2:
-			if sp.escStart[1] == OscEsc {
-				log.Printf("%s just had ESC-], expecting 5", sp.name)
-				expect = '5'
-			} else {
-				sp.escStart = append(sp.escStart, c)
-				log.Printf("%s ESC sequence started with %d %d, then %d",
-					sp.name, sp.escStart[0], sp.escStart[1], c)
-			}
-		default:
-			switch sp.escStart[ess-1] {
-			case '5':
-				log.Printf("%s: had 5, expecting 2", sp.name)
-				expect = '2'
-			case '2':
-				log.Printf("%s: had 2, expecting ;", sp.name)
-				expect = ';'
-			case ';':
-				if ess < 6 {
-					log.Printf("%s: had ;, expecting c or p", sp.name)
-					expect = 'c'
-				} else {
-					log.Printf("%s: had ;, expecting (not) ?", sp.name)
-					expect = '?'
-				}
-			case 'c', 'p':
-				log.Printf("%s: had c/p, expecting ;", sp.name)
-				expect = ';'
+const (
+	prefixContinue = iota
+	prefixComplete
+	prefixMismatch
+)
+
+// matchPrefix checks whether c is the next byte of an OSC 52 write
+// introducer, ESC-] or 0x9d followed by "52;", 'c' or 'p', ';', and then
+// anything but the '?' of a read request, which isn't allowed.
+func (sp *StreamProcessor) matchPrefix(c byte) int {
+	pos := sp.prefixLen
+	if sp.prefixEsc {
+		if pos == 1 {
+			if c != OscEsc {
+				return prefixMismatch
 			}
+			sp.prefixLen++
+			return prefixContinue
 		}
-		if expect != 0 {
-			if expect == '?' && c != expect {
-				// If expect is '?', it means we want anything except '?',
-				// because '?' means the child wants to read the clipboard
-				// which we don't allow.
-				log.Printf("%s: found start of OSC 52 write", sp.name)
-				sp.state = CollectingOsc52
-				sp.escEnd = false
-				// Include the c/p and the semicolon after
-				sp.escStart = sp.escStart[len(sp.escStart)-2:]
-				sp.collectedOsc52Chunks = [][]byte{sp.escStart}
-				sp.collectedOsc52Size = 0
-				remainder := chunk[i:]
-				return sp.processChunkUntilST(remainder)
-			} else if c == expect || (expect == 'c' && c == 'p') {
-				log.Printf("%s got expected char %c", sp.name, c)
-				sp.escStart = append(sp.escStart, c)
-				continue
-			}
-			// Again, some OSC other than 52
-			return sp.processRestOfChunkInCopyingEscState(chunk, i)
+		pos--
+	}
+	var ok bool
+	switch pos {
+	case 1:
+		ok = c == '5'
+	case 2:
+		ok = c == '2'
+	case 3, 5:
+		ok = c == ';'
+	case 4:
+		ok = c == 'c' || c == 'p'
+		sp.selection = c
+	case 6:
+		if c == '?' {
+			return prefixMismatch
 		}
+		return prefixComplete
 	}
-	sp.processedChunks <- chunk
-	return true
+	if !ok {
+		return prefixMismatch
+	}
+	sp.prefixLen++
+	return prefixContinue
 }
 
-func (sp *StreamProcessor) resetEscState() {
-	sp.escStart = nil
-	sp.escEnd = false
+// carriedPrefix reconstructs the bytes of an introducer which came from
+// earlier chunks and turned out not to be OSC 52, so they can be passed on.
+func (sp *StreamProcessor) carriedPrefix() []byte {
+	var prefix []byte
+	if sp.prefixEsc {
+		prefix = []byte{EscCode, OscEsc, '5', '2', ';', sp.selection, ';'}
+	} else {
+		prefix = []byte{OscCode, '5', '2', ';', sp.selection, ';'}
+	}
+	return prefix[:sp.carriedLen]
 }
 
-func (sp *StreamProcessor) processChunkUntilST(chunk []byte,
-) bool {
-	for i, c := range chunk {
-		gotTerm := false
-		badEsc := false
-		if sp.escEnd {
-			if c == StEsc {
-				gotTerm = true
-			} else {
-				badEsc = true
+func (sp *StreamProcessor) startPrefix(c byte) {
+	sp.state = PotentialMatch
+	sp.prefixLen = 1
+	sp.carriedLen = 0
+	sp.prefixEsc = c == EscCode
+}
+
+// processChunk adds the parts of chunk which should be passed through to
+// batch, without copying them, and collects OSC 52 sequences. Only the
+// introducer of a sequence split across chunks needs to be remembered
+// between them.
+func (sp *StreamProcessor) processChunk(chunk []byte, batch *ChunkBatch) {
+	// Start of the span being passed through, and of a potential sequence
+	// within this chunk, or -1 if it started in an earlier one.
+	start := 0
+	seqStart := -1
+	i := 0
+	sp.carriedLen = sp.prefixLen
+	for i < len(chunk) {
+		switch sp.state {
+		case Filtering:
+			n := indexSequenceStart(chunk[i:])
+			if n < 0 {
+				i = len(chunk)
+				break
 			}
-		}
-		if c == EscCode {
-			sp.escEnd = true
-			continue
-		} else if c == StCode || c == BelCode {
-			gotTerm = true
-		}
-		if gotTerm {
-			switch sp.state {
-			case CollectingOsc52:
-				boundary := i
-				if sp.escEnd {
-					boundary -= 1
+			i += n
+			seqStart = i
+			sp.startPrefix(chunk[i])
+			i++
+		case PotentialMatch:
+			switch sp.matchPrefix(chunk[i]) {
+			case prefixContinue:
+				i++
+			case prefixComplete:
+				if seqStart >= 0 {
+					batch.add(chunk[start:seqStart])
 				}
-				sp.collectedOsc52Chunks = append(sp.collectedOsc52Chunks,
-					chunk[:boundary])
-				sp.collectedOsc52Size += i
-				log.Printf("%s: Sending '%s' to osc52Chan", sp.name,
-					composeOsc52Log(sp.collectedOsc52Chunks))
-				sp.osc52Chan <- sp.collectedOsc52Chunks
-				sp.collectedOsc52Chunks = nil
-				sp.collectedOsc52Size = 0
-			case CopyingIgnoredEsc:
-				sp.processedChunks <- chunk[:i+1]
-			}
-			sp.resetEscState()
-			sp.state = Filtering
-			return sp.processChunkInFilteringState(chunk[i+1:])
-		}
-		if badEsc {
-			log.Printf("%s: Bad ESC terminator %d in state %d",
-				sp.name, c, sp.state)
-			switch sp.state {
-			case CollectingOsc52:
-				sp.collectedOsc52Chunks = nil
-				sp.collectedOsc52Size = 0
-			case CopyingIgnoredEsc:
-				sp.processedChunks <- chunk[:i+1]
+				if debugLogging {
+					log.Printf("%s: found start of OSC 52 write", sp.name)
+				}
+				sp.state = CollectingOsc52
+				sp.escEnd = false
+				sp.collectedOsc52 = append(make([]byte, 0, 256),
+					sp.selection, ';')
+				start = i
+			case prefixMismatch:
+				// Some other sequence, which is passed through. The byte
+				// that didn't match could start another one.
+				if seqStart < 0 {
+					batch.add(sp.carriedPrefix())
+				}
+				sp.state = Filtering
 			}
-			sp.resetEscState()
-			sp.state = Filtering
-			return sp.processChunkInFilteringState(chunk[:i+1])
+		case CollectingOsc52, Discarding:
+			i = sp.processSequenceData(chunk, i, &start, &seqStart)
 		}
 	}
-	// End of chunk with no terminator
 	switch sp.state {
+	case Filtering:
+		batch.add(chunk[start:])
+	case PotentialMatch:
+		// Hold the introducer back until we know what it is
+		if seqStart >= 0 {
+			batch.add(chunk[start:seqStart])
+		}
 	case CollectingOsc52:
-		sp.collectedOsc52Size += len(chunk)
-		if sp.collectedOsc52Size < Osc52SizeLimit {
-			sp.collectedOsc52Chunks = append(sp.collectedOsc52Chunks, chunk)
-		} else {
-			sp.collectedOsc52Chunks = nil
-			sp.collectedOsc52Size = 0
-			log.Printf("%s: OSC 52 sequence too long", sp.name)
-			sp.state = Discarding
-			sp.resetEscState()
+		sp.collectOsc52(chunk[start:])
+	}
+}
+
+func (sp *StreamProcessor) collectOsc52(data []byte) {
+	if sp.state != CollectingOsc52 {
+		return
+	}
+	if len(sp.collectedOsc52)+len(data) > Osc52SizeLimit {
+		log.Printf("%s: OSC 52 sequence too long", sp.name)
+		sp.collectedOsc52 = nil
+		sp.state = Discarding
+	} else {
+		sp.collectedOsc52 = append(sp.collectedOsc52, data...)
+	}
+}
+
+// processSequenceData looks for the end of an OSC 52 sequence's data from
+// chunk[i:], where *start is the start of its data in chunk, and returns the
+// index at which to carry on processing.
+func (sp *StreamProcessor) processSequenceData(chunk []byte, i int,
+	start *int, seqStart *int,
+) int {
+	if sp.escEnd {
+		sp.escEnd = false
+		if chunk[i] == StEsc {
+			sp.finishOsc52()
+			*start = i + 1
+			return i + 1
 		}
-	case CopyingIgnoredEsc:
-		sp.processedChunks <- chunk
+		// An ESC aborts the sequence and starts another one
+		sp.abortOsc52()
+		sp.startPrefix(EscCode)
+		sp.carriedLen = 1
+		*start = i
+		*seqStart = -1
+		return i
+	}
+	n := indexTerminator(chunk[i:])
+	if n < 0 {
+		return len(chunk)
+	}
+	t := i + n
+	sp.collectOsc52(chunk[*start:t])
+	if chunk[t] != EscCode {
+		sp.finishOsc52()
+		*start = t + 1
+		return t + 1
+	}
+	if t+1 == len(chunk) {
+		sp.escEnd = true
+		*start = t + 1
+		return t + 1
 	}
-	return true
+	if chunk[t+1] == StEsc {
+		sp.finishOsc52()
+		*start = t + 2
+		return t + 2
+	}
+	sp.abortOsc52()
+	*start = t
+	return t
+}
+
+func (sp *StreamProcessor) finishOsc52() {
+	if sp.state == CollectingOsc52 {
+		if debugLogging {
+			log.Printf("%s: Sending '%s' to osc52Chan", sp.name,
+				sp.collectedOsc52)
+		}
+		sp.osc52Chan <- [][]byte{sp.collectedOsc52}
+	}
+	sp.collectedOsc52 = nil
+	sp.state = Filtering
 }
 
-func (sp *StreamProcessor) processRestOfChunkInCopyingEscState(chunk []byte,
-	offset int,
-) bool {
-	log.Printf("%s: passing through remainder of Esc sequence", sp.name)
-	sp.processedChunks <- sp.escStart
-	remainder := chunk[:offset]
-	sp.resetEscState()
-	sp.state = CopyingIgnoredEsc
-	return sp.processChunkUntilST(remainder)
+func (sp *StreamProcessor) abortOsc52() {
+	if debugLogging {
+		log.Printf("%s: Bad ESC terminator in state %d", sp.name, sp.state)
+	}
+	sp.collectedOsc52 = nil
+	sp.state = Filtering
 }
 
 // chunkWriterThread reads from the processed chunks queue, and writes them to
 // the output stream.
-func (sp *StreamProcessor) chunkWriterThread() {
-	ch := sp.processedChunks
-	for ch != nil {
-		chunk := <-ch
-		if chunk == nil {
-			log.Printf("%s CWT: channel closed (nil chunk)", sp.name)
-			break
-		}
-		log.Printf("%s CWT: Read chunk '%s'", sp.name, chunk)
-		// Write is guaranteed to write the entire slice or return an error
-		_, err := sp.output.Write(chunk)
-		if err != nil {
-			log.Printf("%s CWT: Error writing stream: %v", sp.name, err)
-			break
+func (sp *StreamProcessor) chunkWriterThread(ch chan *ChunkBatch) {
+	failed := false
+	for batch := range ch {
+		for _, piece := range batch.pieces {
+			if failed {
+				break
+			}
+			if debugLogging {
+				log.Printf("%s CWT: Read chunk '%s'", sp.name, piece)
+			}
+			// Write is guaranteed to write the entire slice or return an
+			// error
+			_, err := sp.output.Write(piece)
+			if err != nil {
+				log.Printf("%s CWT: Error writing stream: %v", sp.name, err)
+				// Keep draining the queue so the other threads don't block
+				failed = true
+			}
 		}
+		batch.release()
 	}
 	sp.wg.Done()
 	log.Printf("%s CWT: Leaving thread", sp.name)
@@ -463,7 +601,9 @@ func osc52Thread(osc52Chan chan [][]byte, osc52Pipe io.Writer,
 		dataLen[2] = byte((l >> 16) & 0xff)
 		dataLen[3] = byte((l >> 24) & 0xff)
 		log.Printf("OFT: Sending %d bytes in total", l)
-		log.Printf("OFT: Sending '%s'", composeOsc52Log(chunks))
+		if debugLogging {
+			log.Printf("OFT: Sending '%s'", composeOsc52Log(chunks))
+		}
 		_, err = osc52Pipe.Write(dataLen)
 		if err != nil {
 			break
@@ -482,10 +622,12 @@ func osc52Thread(osc52Chan chan [][]byte, osc52Pipe io.Writer,
 // Start starts all of a StreamProcessor's goroutines.
 func (sp *StreamProcessor) Start() {
 	log.Printf("Starting %s processor", sp.name)
+	chin := sp.unprocessedChunks
+	chout := sp.processedChunks
 	sp.wg.Add(3)
 	go sp.inputReaderThread()
-	go sp.chunkProcessorThread()
-	go sp.chunkWriterThread()
+	go sp.chunkProcessorThread(chin, chout)
+	go sp.chunkWriterThread(chout)
 }
 
 func reportErrorOnStderr(message string) {
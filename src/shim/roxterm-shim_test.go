@@ -0,0 +1,281 @@
+package main
+
+import (
+	"bytes"
+	"fmt"
+	"io"
+	"log"
+	"runtime"
+	"sync"
+	"testing"
+)
+
+// Run with:
+//   go test -bench . roxterm-shim.go roxterm-shim_test.go
+
+const (
+	benchStreamSize = 1024 * 1024
+	benchReadSize   = 4096
+)
+
+// benchReader returns a sample repeatedly until size bytes have been read,
+// in reads no bigger than a pty's.
+type benchReader struct {
+	sample []byte
+	offset int
+	left   int
+}
+
+func (r *benchReader) Read(p []byte) (int, error) {
+	if r.left == 0 {
+		return 0, io.EOF
+	}
+	n := len(p)
+	if n > benchReadSize {
+		n = benchReadSize
+	}
+	if n > r.left {
+		n = r.left
+	}
+	for i := 0; i < n; {
+		c := copy(p[i:n], r.sample[r.offset:])
+		i += c
+		r.offset = (r.offset + c) % len(r.sample)
+	}
+	r.left -= n
+	return n, nil
+}
+
+type countingWriter struct {
+	n int
+}
+
+func (w *countingWriter) Write(p []byte) (int, error) {
+	w.n += len(p)
+	return len(p), nil
+}
+
+func benchmarkStream(b *testing.B, sample []byte, osc52Size int) {
+	log.SetOutput(io.Discard)
+	// Whole samples only, so the expected output size is easy to work out
+	size := benchStreamSize / len(sample) * len(sample)
+	expected := size / len(sample) * (len(sample) - osc52Size)
+	var before, after runtime.MemStats
+	b.SetBytes(int64(size))
+	b.ResetTimer()
+	runtime.ReadMemStats(&before)
+	for i := 0; i < b.N; i++ {
+		out := &countingWriter{}
+		osc52Chan := make(chan [][]byte, 2)
+		done := make(chan bool)
+		go func() {
+			for range osc52Chan {
+			}
+			close(done)
+		}()
+		wg := &sync.WaitGroup{}
+		sp := NewStreamProcessor(&benchReader{sample: sample, left: size},
+			out, wg, osc52Chan, "bench")
+		sp.Start()
+		wg.Wait()
+		close(osc52Chan)
+		<-done
+		if out.n != expected {
+			b.Fatalf("wrote %d bytes, expected %d", out.n, expected)
+		}
+	}
+	runtime.ReadMemStats(&after)
+	b.StopTimer()
+	mb := float64(size) * float64(b.N) / (1024 * 1024)
+	b.ReportMetric(float64(after.Mallocs-before.Mallocs)/mb, "allocs/MB")
+	b.ReportMetric(float64(after.TotalAlloc-before.TotalAlloc)/mb, "B/MB")
+}
+
+func BenchmarkStreamProcessor(b *testing.B) {
+	plain := bytes.Repeat([]byte("The quick brown fox jumps over the lazy dog\n"),
+		20)
+	sgr := bytes.Repeat(
+		[]byte("\x1b[1;32mok\x1b[0m  \x1b]8;;file:///tmp\x1b\\tmp\x1b]8;;\x1b\\\n"),
+		20)
+	osc52 := []byte("\x1b]52;c;SGVsbG8sIHdvcmxkIQ==\x07")
+	withOsc52 := append(append([]byte{}, plain...), osc52...)
+
+	b.Run("plain", func(b *testing.B) {
+		benchmarkStream(b, plain, 0)
+	})
+	b.Run("escapes", func(b *testing.B) {
+		benchmarkStream(b, sgr, 0)
+	})
+	b.Run("osc52", func(b *testing.B) {
+		benchmarkStream(b, withOsc52, len(osc52))
+	})
+}
+
+// splitReader returns its reads one at a time, so a test controls where the
+// stream is split. A read which doesn't fit in p is continued in the next
+// call. onRead, if set, is called before each read with the number of reads
+// started so far.
+type splitReader struct {
+	reads  [][]byte
+	count  int
+	onRead func(count int)
+}
+
+func (r *splitReader) Read(p []byte) (int, error) {
+	if len(r.reads) == 0 {
+		return 0, io.EOF
+	}
+	if r.onRead != nil {
+		r.onRead(r.count)
+	}
+	r.count++
+	n := copy(p, r.reads[0])
+	if n == len(r.reads[0]) {
+		r.reads = r.reads[1:]
+	} else {
+		r.reads[0] = r.reads[0][n:]
+	}
+	return n, nil
+}
+
+// runShim passes reads through a StreamProcessor and returns what it wrote
+// to its output and the OSC 52 data it extracted.
+func runShim(t *testing.T, reads [][]byte, output io.Writer,
+	onRead func(count int)) []string {
+	t.Helper()
+	log.SetOutput(io.Discard)
+	var osc52 []string
+	osc52Chan := make(chan [][]byte, 2)
+	done := make(chan bool)
+	go func() {
+		for chunks := range osc52Chan {
+			osc52 = append(osc52, composeOsc52Log(chunks))
+		}
+		close(done)
+	}()
+	wg := &sync.WaitGroup{}
+	sp := NewStreamProcessor(&splitReader{reads: reads, onRead: onRead},
+		output, wg, osc52Chan, "test")
+	sp.Start()
+	wg.Wait()
+	close(osc52Chan)
+	<-done
+	return osc52
+}
+
+var shimTests = []struct {
+	name   string
+	input  string
+	output string
+	osc52  []string
+}{
+	{"plain", "hello, world\n", "hello, world\n", nil},
+	{"empty", "", "", nil},
+	{"bel", "a\x1b]52;c;SGk=\x07b", "ab", []string{"c;SGk="}},
+	{"st", "a\x1b]52;p;SGk=\x1b\\b", "ab", []string{"p;SGk="}},
+	{"c1 introducer", "a\x9d52;c;SGk=\x07b", "ab", []string{"c;SGk="}},
+	{"c1 st", "a\x1b]52;c;SGk=\x9cb", "ab", []string{"c;SGk="}},
+	{"empty data", "\x1b]52;c;\x07", "", []string{"c;"}},
+	{"several", "\x1b]52;c;QQ==\x07-\x1b]52;c;Qg==\x1b\\",
+		"-", []string{"c;QQ==", "c;Qg=="}},
+	{"read request", "\x1b]52;c;?\x07", "\x1b]52;c;?\x07", nil},
+	{"other osc", "\x1b]0;title\x07x", "\x1b]0;title\x07x", nil},
+	{"osc 5", "\x1b]5;c;x\x07", "\x1b]5;c;x\x07", nil},
+	{"bad selection", "\x1b]52;s;x\x07", "\x1b]52;s;x\x07", nil},
+	{"csi", "\x1b[1;32mok\x1b[0m", "\x1b[1;32mok\x1b[0m", nil},
+	{"esc esc", "\x1b\x1b]52;c;SGk=\x07", "\x1b", []string{"c;SGk="}},
+	{"aborted by esc", "\x1b]52;c;SGk=\x1b[0m", "\x1b[0m", nil},
+	{"unterminated prefix", "x\x1b]52;", "x", nil},
+}
+
+func checkShim(t *testing.T, name string, reads [][]byte, output string,
+	osc52 []string) {
+	t.Helper()
+	var out bytes.Buffer
+	got := runShim(t, reads, &out, nil)
+	if out.String() != output {
+		t.Errorf("%s: output %q, expected %q", name, out.String(), output)
+	}
+	if fmt.Sprint(got) != fmt.Sprint(osc52) {
+		t.Errorf("%s: OSC 52 %q, expected %q", name, got, osc52)
+	}
+}
+
+func TestStreamProcessor(t *testing.T) {
+	for _, test := range shimTests {
+		checkShim(t, test.name, [][]byte{[]byte(test.input)}, test.output,
+			test.osc52)
+	}
+}
+
+// TestStreamProcessorSplit splits each test's input at every position, and
+// also into single bytes, to check sequences split across reads.
+func TestStreamProcessorSplit(t *testing.T) {
+	for _, test := range shimTests {
+		input := []byte(test.input)
+		for i := 1; i < len(input); i++ {
+			checkShim(t, fmt.Sprintf("%s split at %d", test.name, i),
+				[][]byte{input[:i], input[i:]}, test.output, test.osc52)
+		}
+		var bytewise [][]byte
+		for i := range input {
+			bytewise = append(bytewise, input[i:i+1])
+		}
+		checkShim(t, test.name+" bytewise", bytewise, test.output,
+			test.osc52)
+	}
+}
+
+// gatedWriter blocks the first write until gate is closed, so reads pile up
+// behind it.
+type gatedWriter struct {
+	gate chan bool
+	out  bytes.Buffer
+}
+
+func (w *gatedWriter) Write(p []byte) (int, error) {
+	<-w.gate
+	return w.out.Write(p)
+}
+
+// TestStreamProcessorBufferReuse holds up the writer while the reader gets
+// through several buffers, with OSC 52 sequences split between reads. If a
+// buffer went back to the pool while a queued chunk still referred to it,
+// it would be refilled and the output would be corrupted.
+func TestStreamProcessorBufferReuse(t *testing.T) {
+	const nReads = 64
+	const readSize = 4096
+	var reads [][]byte
+	var expected bytes.Buffer
+	var expectedOsc52 []string
+	for n := 0; n < nReads; n++ {
+		read := bytes.Repeat([]byte{byte('A' + n%26)}, readSize)
+		expected.Write(read)
+		if n%4 == 3 {
+			// Split an OSC 52 sequence between this read and the next
+			data := fmt.Sprintf("c;%d", n)
+			seq := "\x1b]52;" + data + "\x07"
+			read = append(read, seq[:5]...)
+			reads = append(reads, read)
+			read = []byte(seq[5:])
+			expectedOsc52 = append(expectedOsc52, data)
+		}
+		reads = append(reads, read)
+	}
+	w := &gatedWriter{gate: make(chan bool)}
+	var once sync.Once
+	got := runShim(t, reads, w, func(count int) {
+		// Well short of filling both queues, which would block the reader
+		if count == 2*MaxChunkQueueLength-8 {
+			once.Do(func() { close(w.gate) })
+		}
+	})
+	once.Do(func() { close(w.gate) })
+	if !bytes.Equal(w.out.Bytes(), expected.Bytes()) {
+		t.Errorf("output corrupted: %d bytes, expected %d",
+			w.out.Len(), expected.Len())
+	}
+	if fmt.Sprint(got) != fmt.Sprint(expectedOsc52) {
+		t.Errorf("OSC 52 %q, expected %q", got, expectedOsc52)
+	}
+}
@@ -24,6 +24,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "configcache.h"
 #include "dlg.h"
 #include "dynopts.h"
 #include "optsdbus.h"
@@ -219,7 +220,7 @@ Options *shortcuts_open(const char *scheme, gboolean reload)
                 /* Not an error, user may have deleted shortcut */
                 continue;
             }
-            gtk_accelerator_parse(accel, &item.key, &item.modifiers);
+            config_cache_parse_accel(accel, &item.key, &item.modifiers);
             if (item.key)
             {
                 full_path = make_full_path(data->index_str, path);
@@ -0,0 +1,618 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+
+#include "defns.h"
+
+#include <string.h>
+
+#include "dlg.h"
+#include "multitab.h"
+#include "tabswitch.h"
+
+/* Separates the fields in each tab's lower-cased text; it can't be typed
+ * into the entry.
+ */
+#define TAB_SWITCH_SEP '\n'
+
+/* Bonuses for each matching character of the query, on top of 1 */
+#define TAB_SWITCH_BONUS_CONSECUTIVE 5
+#define TAB_SWITCH_BONUS_WORD_START 8
+#define TAB_SWITCH_BONUS_TITLE 2
+
+typedef struct {
+    gpointer data;
+    /* title, cwd and profile, lower-cased and separated by TAB_SWITCH_SEP */
+    char *haystack;
+    /* Which characters are in haystack, so most tabs can be rejected without
+     * looking at it.
+     */
+    guint64 mask;
+    gint64 last_output;
+} TabSwitchEntry;
+
+typedef struct {
+    guint index;
+    int score;
+} TabSwitchMatch;
+
+struct TabSwitchIndex {
+    GArray *entries;
+    /* Indices of the entries matching query */
+    GArray *matches;
+    /* TabSwitchMatch, best first */
+    GArray *best;
+    char *query;
+};
+
+static void tab_switch_entry_clear(gpointer data)
+{
+    g_free(((TabSwitchEntry *) data)->haystack);
+}
+
+TabSwitchIndex *tab_switch_index_new(void)
+{
+    TabSwitchIndex *tsi = g_new0(TabSwitchIndex, 1);
+
+    tsi->entries = g_array_new(FALSE, FALSE, sizeof(TabSwitchEntry));
+    g_array_set_clear_func(tsi->entries, tab_switch_entry_clear);
+    tsi->matches = g_array_new(FALSE, FALSE, sizeof(guint));
+    tsi->best = g_array_sized_new(FALSE, FALSE, sizeof(TabSwitchMatch),
+            TAB_SWITCH_MAX_ROWS + 1);
+    return tsi;
+}
+
+void tab_switch_index_free(TabSwitchIndex *tsi)
+{
+    g_array_unref(tsi->entries);
+    g_array_unref(tsi->matches);
+    g_array_unref(tsi->best);
+    g_free(tsi->query);
+    g_free(tsi);
+}
+
+/* Letters and digits get a bit each. Everything else shares the remaining
+ * bits, which only makes the test less selective.
+ */
+static guint64 tab_switch_char_bit(guchar c)
+{
+    if (c >= 'a' && c <= 'z')
+        return G_GUINT64_CONSTANT(1) << (c - 'a');
+    if (c >= '0' && c <= '9')
+        return G_GUINT64_CONSTANT(1) << (26 + c - '0');
+    return G_GUINT64_CONSTANT(1) << (36 + c % 28);
+}
+
+static guint64 tab_switch_mask(const char *s)
+{
+    guint64 mask = 0;
+
+    for (; *s; ++s)
+    {
+        if (*s != TAB_SWITCH_SEP)
+            mask |= tab_switch_char_bit((guchar) *s);
+    }
+    return mask;
+}
+
+void tab_switch_index_add(TabSwitchIndex *tsi, gpointer data,
+        const char *title, const char *cwd, const char *profile,
+        gint64 last_output)
+{
+    TabSwitchEntry entry;
+    char *joined = g_strdup_printf("%s%c%s%c%s", title ? title : "",
+            TAB_SWITCH_SEP, cwd ? cwd : "", TAB_SWITCH_SEP,
+            profile ? profile : "");
+
+    entry.data = data;
+    entry.haystack = g_utf8_strdown(joined, -1);
+    entry.mask = tab_switch_mask(entry.haystack);
+    entry.last_output = last_output;
+    g_array_append_val(tsi->entries, entry);
+    g_free(joined);
+    /* The matches are out of date, so the next query can't narrow them */
+    g_free(tsi->query);
+    tsi->query = NULL;
+}
+
+/* Matches each character of query at the earliest place it can in haystack,
+ * returning 0 if they aren't all there in order. Runs of characters, the
+ * starts of words and the title score more.
+ */
+static int tab_switch_score(const char *query, const char *haystack)
+{
+    const char *h = haystack;
+    const char *after_last = NULL;
+    int field = 0;
+    int score = 0;
+    const char *q;
+
+    for (q = query; *q; q = g_utf8_next_char(q))
+    {
+        gsize len = g_utf8_next_char(q) - q;
+
+        while (strncmp(h, q, len))
+        {
+            if (!*h)
+                return 0;
+            if (*h == TAB_SWITCH_SEP)
+                ++field;
+            h = g_utf8_next_char(h);
+        }
+        ++score;
+        if (h == after_last)
+            score += TAB_SWITCH_BONUS_CONSECUTIVE;
+        if (h == haystack || strchr(" /-_.:@\n", h[-1]))
+            score += TAB_SWITCH_BONUS_WORD_START;
+        if (!field)
+            score += TAB_SWITCH_BONUS_TITLE;
+        h += len;
+        after_last = h;
+    }
+    return score;
+}
+
+static gboolean tab_switch_is_better(TabSwitchIndex *tsi,
+        const TabSwitchMatch *a, const TabSwitchMatch *b)
+{
+    if (a->score != b->score)
+        return a->score > b->score;
+    return g_array_index(tsi->entries, TabSwitchEntry, a->index).last_output >
+        g_array_index(tsi->entries, TabSwitchEntry, b->index).last_output;
+}
+
+/* An insertion sort is fine because there are so few rows, and a match which
+ * isn't good enough is rejected after one comparison.
+ */
+static void tab_switch_add_best(TabSwitchIndex *tsi, guint index, int score)
+{
+    TabSwitchMatch match = { index, score };
+    guint pos = tsi->best->len;
+
+    while (pos > 0 && tab_switch_is_better(tsi, &match,
+                &g_array_index(tsi->best, TabSwitchMatch, pos - 1)))
+    {
+        --pos;
+    }
+    if (pos >= TAB_SWITCH_MAX_ROWS)
+        return;
+    g_array_insert_val(tsi->best, pos, match);
+    if (tsi->best->len > TAB_SWITCH_MAX_ROWS)
+        g_array_set_size(tsi->best, TAB_SWITCH_MAX_ROWS);
+}
+
+guint tab_switch_index_filter(TabSwitchIndex *tsi, const char *query)
+{
+    char *lower = g_utf8_strdown(query ? query : "", -1);
+    guint64 mask = tab_switch_mask(lower);
+    /* Anything matching the new query matched the old one if it's an
+     * extension of it, so only those need to be looked at.
+     */
+    gboolean narrow = tsi->query && g_str_has_prefix(lower, tsi->query);
+    GArray *old_matches = tsi->matches;
+    guint count = narrow ? old_matches->len : tsi->entries->len;
+    guint n;
+
+    tsi->matches = g_array_new(FALSE, FALSE, sizeof(guint));
+    g_array_set_size(tsi->best, 0);
+    for (n = 0; n < count; ++n)
+    {
+        guint index = narrow ? g_array_index(old_matches, guint, n) : n;
+        const TabSwitchEntry *entry = &g_array_index(tsi->entries,
+                TabSwitchEntry, index);
+        int score;
+
+        if ((entry->mask & mask) != mask)
+            continue;
+        score = lower[0] ? tab_switch_score(lower, entry->haystack) : 1;
+        if (!score)
+            continue;
+        g_array_append_val(tsi->matches, index);
+        tab_switch_add_best(tsi, index, score);
+    }
+    g_array_unref(old_matches);
+    g_free(tsi->query);
+    tsi->query = lower;
+    return tsi->matches->len;
+}
+
+guint tab_switch_index_get_n_best(TabSwitchIndex *tsi)
+{
+    return tsi->best->len;
+}
+
+gpointer tab_switch_index_get_best(TabSwitchIndex *tsi, guint n)
+{
+    guint index;
+
+    g_return_val_if_fail(n < tsi->best->len, NULL);
+    index = g_array_index(tsi->best, TabSwitchMatch, n).index;
+    return g_array_index(tsi->entries, TabSwitchEntry, index).data;
+}
+
+/* The dialog */
+
+typedef struct {
+    ROXTermData *roxterm;
+    MultiTab *tab;
+    char *title;
+    char *cwd;
+    char *profile;
+    gint64 last_output;
+} TabSwitchTab;
+
+enum {
+    TAB_SWITCH_COL_TITLE,
+    TAB_SWITCH_COL_DIR,
+    TAB_SWITCH_COL_PROFILE,
+    TAB_SWITCH_COL_ACTIVE,
+    TAB_SWITCH_COL_TAB,
+    TAB_SWITCH_N_COLS
+};
+
+static struct {
+    GtkWidget *dialog;
+    GtkEntry *entry;
+    GtkTreeView *tvw;
+    GtkListStore *store;
+    GtkLabel *status;
+    TabSwitchIndex *index;
+    GPtrArray *tabs;
+} tab_switch_dialog;
+
+static void tab_switch_tab_free(gpointer data)
+{
+    TabSwitchTab *t = data;
+
+    g_free(t->title);
+    g_free(t->cwd);
+    g_free(t->profile);
+    g_free(t);
+}
+
+static void tab_switch_dialog_clear_index(void)
+{
+    if (tab_switch_dialog.index)
+    {
+        tab_switch_index_free(tab_switch_dialog.index);
+        tab_switch_dialog.index = NULL;
+    }
+    if (tab_switch_dialog.tabs)
+    {
+        g_ptr_array_unref(tab_switch_dialog.tabs);
+        tab_switch_dialog.tabs = NULL;
+    }
+}
+
+static void tab_switch_dialog_build_index(void)
+{
+    GList *wlink;
+
+    tab_switch_dialog_clear_index();
+    tab_switch_dialog.index = tab_switch_index_new();
+    tab_switch_dialog.tabs = g_ptr_array_new_with_free_func(
+            tab_switch_tab_free);
+    for (wlink = multi_win_all; wlink; wlink = g_list_next(wlink))
+    {
+        GList *tlink;
+
+        for (tlink = multi_win_get_tabs(wlink->data); tlink;
+                tlink = g_list_next(tlink))
+        {
+            TabSwitchTab *t = g_new(TabSwitchTab, 1);
+
+            t->tab = tlink->data;
+            t->roxterm = multi_tab_get_user_data(t->tab);
+            t->title = g_strdup(multi_tab_get_window_title(t->tab));
+            t->cwd = roxterm_get_cwd(t->roxterm);
+            t->profile = g_strdup(roxterm_get_profile_name(t->roxterm));
+            t->last_output = roxterm_get_last_output(t->roxterm);
+            g_ptr_array_add(tab_switch_dialog.tabs, t);
+            tab_switch_index_add(tab_switch_dialog.index, t,
+                    t->title, t->cwd, t->profile, t->last_output);
+        }
+    }
+}
+
+static char *tab_switch_format_age(gint64 last_output, gint64 now)
+{
+    gint64 secs;
+
+    if (!last_output)
+        return g_strdup("");
+    secs = (now - last_output) / G_USEC_PER_SEC;
+    if (secs < 60)
+        return g_strdup_printf(_("%ds ago"), (int) secs);
+    if (secs < 60 * 60)
+        return g_strdup_printf(_("%dm ago"), (int) (secs / 60));
+    if (secs < 24 * 60 * 60)
+        return g_strdup_printf(_("%dh ago"), (int) (secs / (60 * 60)));
+    return g_strdup_printf(_("%dd ago"), (int) (secs / (24 * 60 * 60)));
+}
+
+static void tab_switch_dialog_select_row(int row)
+{
+    GtkTreePath *path = gtk_tree_path_new_from_indices(row, -1);
+
+    gtk_tree_selection_select_path(
+            gtk_tree_view_get_selection(tab_switch_dialog.tvw), path);
+    gtk_tree_view_scroll_to_cell(tab_switch_dialog.tvw, path, NULL,
+            FALSE, 0, 0);
+    gtk_tree_path_free(path);
+}
+
+static void tab_switch_dialog_update(void)
+{
+    TabSwitchIndex *tsi = tab_switch_dialog.index;
+    guint total = tab_switch_index_filter(tsi,
+            gtk_entry_get_text(tab_switch_dialog.entry));
+    guint n_best = tab_switch_index_get_n_best(tsi);
+    gint64 now = g_get_monotonic_time();
+    char *status;
+    guint n;
+
+    gtk_list_store_clear(tab_switch_dialog.store);
+    for (n = 0; n < n_best; ++n)
+    {
+        TabSwitchTab *t = tab_switch_index_get_best(tsi, n);
+        char *age = tab_switch_format_age(t->last_output, now);
+        GtkTreeIter iter;
+
+        gtk_list_store_insert_with_values(tab_switch_dialog.store, &iter, -1,
+                TAB_SWITCH_COL_TITLE, t->title,
+                TAB_SWITCH_COL_DIR, t->cwd,
+                TAB_SWITCH_COL_PROFILE, t->profile,
+                TAB_SWITCH_COL_ACTIVE, age,
+                TAB_SWITCH_COL_TAB, t,
+                -1);
+        g_free(age);
+    }
+    if (n_best)
+        tab_switch_dialog_select_row(0);
+    if (n_best < total)
+    {
+        status = g_strdup_printf(_("Showing the best %u of %u matching tabs"),
+                n_best, total);
+    }
+    else
+    {
+        status = g_strdup_printf(_("%u of %u tabs"), total,
+                tab_switch_dialog.tabs->len);
+    }
+    gtk_label_set_text(tab_switch_dialog.status, status);
+    g_free(status);
+}
+
+static void tab_switch_dialog_switch(void)
+{
+    GtkTreeModel *model;
+    GtkTreeIter iter;
+    TabSwitchTab *t;
+    MultiWin *win;
+
+    if (!gtk_tree_selection_get_selected(
+                gtk_tree_view_get_selection(tab_switch_dialog.tvw),
+                &model, &iter))
+    {
+        return;
+    }
+    gtk_tree_model_get(model, &iter, TAB_SWITCH_COL_TAB, &t, -1);
+    if (!roxterm_is_valid(t->roxterm))
+    {
+        gtk_label_set_text(tab_switch_dialog.status,
+                _("That tab has been closed"));
+        return;
+    }
+    win = multi_tab_get_parent(t->tab);
+    gtk_widget_hide(tab_switch_dialog.dialog);
+    multi_win_select_tab(win, t->tab);
+    gtk_window_present(GTK_WINDOW(multi_win_get_widget(win)));
+    tab_switch_dialog_clear_index();
+}
+
+/* Lets the selection be moved without taking the focus from the entry */
+static gboolean tab_switch_entry_key_press(GtkWidget *widget,
+        GdkEventKey *event, gpointer data)
+{
+    GtkTreeModel *model;
+    GtkTreeIter iter;
+    int n_rows;
+    int row = 0;
+    int delta;
+    (void) widget;
+    (void) data;
+
+    switch (event->keyval)
+    {
+        case GDK_KEY_Up:
+        case GDK_KEY_KP_Up:
+            delta = -1;
+            break;
+        case GDK_KEY_Down:
+        case GDK_KEY_KP_Down:
+            delta = 1;
+            break;
+        case GDK_KEY_Page_Up:
+        case GDK_KEY_KP_Page_Up:
+            delta = -10;
+            break;
+        case GDK_KEY_Page_Down:
+        case GDK_KEY_KP_Page_Down:
+            delta = 10;
+            break;
+        default:
+            return FALSE;
+    }
+    model = GTK_TREE_MODEL(tab_switch_dialog.store);
+    n_rows = gtk_tree_model_iter_n_children(model, NULL);
+    if (!n_rows)
+        return TRUE;
+    if (gtk_tree_selection_get_selected(
+                gtk_tree_view_get_selection(tab_switch_dialog.tvw),
+                NULL, &iter))
+    {
+        GtkTreePath *path = gtk_tree_model_get_path(model, &iter);
+
+        row = gtk_tree_path_get_indices(path)[0];
+        gtk_tree_path_free(path);
+    }
+    tab_switch_dialog_select_row(CLAMP(row + delta, 0, n_rows - 1));
+    return TRUE;
+}
+
+static void tab_switch_entry_changed(GtkEditable *editable, gpointer data)
+{
+    (void) editable;
+    (void) data;
+    if (tab_switch_dialog.index)
+        tab_switch_dialog_update();
+}
+
+static void tab_switch_row_activated(GtkTreeView *tvw, GtkTreePath *path,
+        GtkTreeViewColumn *column, gpointer data)
+{
+    (void) tvw;
+    (void) path;
+    (void) column;
+    (void) data;
+    tab_switch_dialog_switch();
+}
+
+static void tab_switch_response_cb(GtkWidget *widget, int response,
+        gpointer data)
+{
+    (void) widget;
+    (void) data;
+    if (response == GTK_RESPONSE_ACCEPT)
+    {
+        tab_switch_dialog_switch();
+        return;
+    }
+    gtk_widget_hide(tab_switch_dialog.dialog);
+    tab_switch_dialog_clear_index();
+}
+
+static void tab_switch_destroy_cb(GtkWidget *widget, gpointer data)
+{
+    (void) widget;
+    (void) data;
+    tab_switch_dialog_clear_index();
+    g_object_unref(tab_switch_dialog.store);
+    tab_switch_dialog.store = NULL;
+    tab_switch_dialog.dialog = NULL;
+}
+
+static void tab_switch_add_column(GtkTreeView *tvw, const char *title,
+        int col, gboolean expand)
+{
+    GtkCellRenderer *cell = gtk_cell_renderer_text_new();
+    GtkTreeViewColumn *column = gtk_tree_view_column_new_with_attributes(
+            title, cell, "text", col, NULL);
+
+    g_object_set(cell, "ellipsize", PANGO_ELLIPSIZE_END, NULL);
+    gtk_tree_view_column_set_resizable(column, TRUE);
+    gtk_tree_view_column_set_expand(column, expand);
+    gtk_tree_view_append_column(tvw, column);
+}
+
+void tab_switch_open_dialog(ROXTermData *roxterm)
+{
+    GtkWindow *parent = GTK_WINDOW(multi_win_get_widget(
+            roxterm_get_multi_win(roxterm)));
+
+    if (!tab_switch_dialog.dialog)
+    {
+        GtkWidget *vbox;
+        GtkWidget *entry = gtk_entry_new();
+        GtkWidget *scroll;
+        GtkWidget *tvw;
+        GtkWidget *w;
+
+        tab_switch_dialog.dialog = gtk_dialog_new_with_buttons(
+                _("Switch to Tab"), parent,
+                GTK_DIALOG_DESTROY_WITH_PARENT,
+                _("_Close"), GTK_RESPONSE_CLOSE,
+                _("_Switch"), GTK_RESPONSE_ACCEPT,
+                NULL);
+        gtk_dialog_set_default_response(GTK_DIALOG(tab_switch_dialog.dialog),
+                GTK_RESPONSE_ACCEPT);
+        gtk_window_set_default_size(GTK_WINDOW(tab_switch_dialog.dialog),
+                720, 420);
+        vbox = gtk_dialog_get_content_area(
+                GTK_DIALOG(tab_switch_dialog.dialog));
+
+        tab_switch_dialog.entry = GTK_ENTRY(entry);
+        gtk_entry_set_activates_default(tab_switch_dialog.entry, TRUE);
+        gtk_entry_set_placeholder_text(tab_switch_dialog.entry,
+                _("Type part of a tab's title, directory or profile"));
+        g_signal_connect(entry, "changed",
+                G_CALLBACK(tab_switch_entry_changed), NULL);
+        g_signal_connect(entry, "key-press-event",
+                G_CALLBACK(tab_switch_entry_key_press), NULL);
+        gtk_box_pack_start(GTK_BOX(vbox), entry, FALSE, FALSE, DLG_SPACING);
+
+        tab_switch_dialog.store = gtk_list_store_new(TAB_SWITCH_N_COLS,
+                G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,
+                G_TYPE_POINTER);
+        tvw = gtk_tree_view_new_with_model(
+                GTK_TREE_MODEL(tab_switch_dialog.store));
+        tab_switch_dialog.tvw = GTK_TREE_VIEW(tvw);
+        gtk_tree_view_set_enable_search(tab_switch_dialog.tvw, FALSE);
+        tab_switch_add_column(tab_switch_dialog.tvw, _("Tab"),
+                TAB_SWITCH_COL_TITLE, TRUE);
+        tab_switch_add_column(tab_switch_dialog.tvw, _("Directory"),
+                TAB_SWITCH_COL_DIR, TRUE);
+        tab_switch_add_column(tab_switch_dialog.tvw, _("Profile"),
+                TAB_SWITCH_COL_PROFILE, FALSE);
+        tab_switch_add_column(tab_switch_dialog.tvw, _("Last output"),
+                TAB_SWITCH_COL_ACTIVE, FALSE);
+        g_signal_connect(tvw, "row-activated",
+                G_CALLBACK(tab_switch_row_activated), NULL);
+        scroll = gtk_scrolled_window_new(NULL, NULL);
+        gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll),
+                GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+        gtk_container_add(GTK_CONTAINER(scroll), tvw);
+        gtk_box_pack_start(GTK_BOX(vbox), scroll, TRUE, TRUE, DLG_SPACING);
+
+        w = gtk_label_new(NULL);
+        gtk_label_set_xalign(GTK_LABEL(w), 0);
+        tab_switch_dialog.status = GTK_LABEL(w);
+        gtk_box_pack_start(GTK_BOX(vbox), w, FALSE, FALSE, DLG_SPACING);
+
+        g_signal_connect(tab_switch_dialog.dialog, "response",
+                G_CALLBACK(tab_switch_response_cb), NULL);
+        g_signal_connect(tab_switch_dialog.dialog, "destroy",
+                G_CALLBACK(tab_switch_destroy_cb), NULL);
+    }
+    else
+    {
+        gtk_window_set_transient_for(GTK_WINDOW(tab_switch_dialog.dialog),
+                parent);
+    }
+    /* Titles and directories change, so the index is rebuilt every time */
+    tab_switch_dialog_build_index();
+    gtk_entry_set_text(tab_switch_dialog.entry, "");
+    tab_switch_dialog_update();
+    gtk_widget_show_all(tab_switch_dialog.dialog);
+    gtk_window_present(GTK_WINDOW(tab_switch_dialog.dialog));
+    gtk_widget_grab_focus(GTK_WIDGET(tab_switch_dialog.entry));
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
@@ -0,0 +1,62 @@
+#ifndef TABSWITCH_H
+#define TABSWITCH_H
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+/* A popup for switching to any tab in any window by typing part of its title,
+ * directory or profile. Each tab's fields are lower-cased once when the popup
+ * opens, and each keystroke only rescans the tabs that matched the previous
+ * query if the new one extends it. Only the best matches are put in the list
+ * view, so the cost of updating it doesn't grow with the number of tabs.
+ */
+
+#include "roxterm.h"
+
+typedef struct TabSwitchIndex TabSwitchIndex;
+
+TabSwitchIndex *tab_switch_index_new(void);
+
+void tab_switch_index_free(TabSwitchIndex *tsi);
+
+/* Any of the strings may be NULL. last_output is a g_get_monotonic_time()
+ * value, or 0 if there hasn't been any output; it breaks ties between equal
+ * scores, and orders the tabs when the query is empty.
+ */
+void tab_switch_index_add(TabSwitchIndex *tsi, gpointer data,
+        const char *title, const char *cwd, const char *profile,
+        gint64 last_output);
+
+/* Returns the number of tabs matching query */
+guint tab_switch_index_filter(TabSwitchIndex *tsi, const char *query);
+
+/* The best matches from the last call to tab_switch_index_filter, best
+ * first; there are at most TAB_SWITCH_MAX_ROWS.
+ */
+#define TAB_SWITCH_MAX_ROWS 50
+
+guint tab_switch_index_get_n_best(TabSwitchIndex *tsi);
+
+gpointer tab_switch_index_get_best(TabSwitchIndex *tsi, guint n);
+
+void tab_switch_open_dialog(ROXTermData *roxterm);
+
+#endif /* TABSWITCH_H */
+
+/* vi:set sw=4 ts=4 et cindent cino= */
@@ -0,0 +1,652 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "defns.h"
+
+#include <string.h>
+
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+
+#include "escscan.h"
+#include "trigger.h"
+
+/* Longer lines are matched against the regexes in pieces */
+#define TRIGGER_MAX_LINE 4096
+
+#define TRIGGER_COOLDOWN_USEC G_USEC_PER_SEC
+
+#define TRIGGER_MAX_IN_PROFILE 1000
+
+#ifdef PCRE2_MATCH_INVALID_UTF
+#define TRIGGER_PCRE2_FLAGS (PCRE2_UTF | PCRE2_MATCH_INVALID_UTF)
+#else
+#define TRIGGER_PCRE2_FLAGS 0
+#endif
+
+typedef struct {
+    char *pattern;
+    gboolean regex;
+    guint actions;
+    char *command;
+    pcre2_code *code;           /* Only for regexes */
+} Trigger;
+
+struct TriggerSet {
+    gint ref;
+    GArray *triggers;           /* Of Trigger */
+    gboolean compiled;
+
+    /* The automaton for the strings. Bytes which don't appear in any of
+     * them share class 0, so the transition table is only as wide as the
+     * number of distinct bytes used.
+     */
+    guint8 byte_class[256];
+    guint n_classes;
+    guint n_states;
+    guint32 *delta;             /* n_states * n_classes */
+    guint32 *out_start;         /* n_states + 1 indices into out */
+    guint32 *out;               /* Triggers ending at each state */
+
+    /* The regexes which could be combined, and ones which can't, because
+     * they use backreferences whose group numbers would change or wouldn't
+     * stay inside a group.
+     */
+    pcre2_code *combined;
+    GArray *combined_regexes;   /* Of guint */
+    GArray *other_regexes;      /* Of guint */
+};
+
+struct TriggerMatcher {
+    TriggerSet *ts;
+    TriggerHandler handler;
+    gpointer handler_data;
+    EscScanState state;
+    guint32 ac_state;
+    pcre2_match_data *md;
+    char line[TRIGGER_MAX_LINE];
+    gsize line_len;
+    gsize scanned_len;          /* How much of the line the regexes saw */
+    guint64 line_no;
+    guint64 *fired_line;        /* line_no + 1 when each trigger last fired */
+    gint64 *fired_time;
+    guint64 hits;
+};
+
+typedef struct {
+    TriggerSet *ts;
+    guint index;
+    char *text;
+    TriggerHandler handler;
+    gpointer handler_data;
+} TriggerHit;
+
+TriggerSet *trigger_set_new(void)
+{
+    TriggerSet *ts = g_new0(TriggerSet, 1);
+
+    ts->ref = 1;
+    ts->triggers = g_array_new(FALSE, FALSE, sizeof(Trigger));
+    ts->combined_regexes = g_array_new(FALSE, FALSE, sizeof(guint));
+    ts->other_regexes = g_array_new(FALSE, FALSE, sizeof(guint));
+    return ts;
+}
+
+static guint trigger_parse_actions(const char *s)
+{
+    char **names;
+    guint actions = 0;
+    int n;
+
+    if (!s || !s[0])
+        return TRIGGER_NOTIFY;
+    names = g_strsplit(s, ",", -1);
+    for (n = 0; names[n]; ++n)
+    {
+        char *name = g_strstrip(names[n]);
+
+        if (!strcmp(name, "notify"))
+            actions |= TRIGGER_NOTIFY;
+        else if (!strcmp(name, "flash"))
+            actions |= TRIGGER_FLASH;
+        else if (!strcmp(name, "icon"))
+            actions |= TRIGGER_ICON;
+        else if (!strcmp(name, "command"))
+            actions |= TRIGGER_COMMAND;
+        else if (name[0])
+            g_warning(_("Unknown trigger action '%s'"), name);
+    }
+    g_strfreev(names);
+    return actions;
+}
+
+TriggerSet *trigger_set_new_for_profile(Options *profile)
+{
+    TriggerSet *ts = NULL;
+    int n;
+
+    for (n = 0; n < TRIGGER_MAX_IN_PROFILE; ++n)
+    {
+        char *key = g_strdup_printf("trigger%d", n);
+        char *pattern = options_lookup_string(profile, key);
+        char *key2;
+        char *actions;
+        char *command;
+        gboolean regex;
+        GError *error = NULL;
+
+        if (!pattern)
+        {
+            g_free(key);
+            break;
+        }
+        key2 = g_strdup_printf("%s_regex", key);
+        regex = options_lookup_int_with_default(profile, key2, 0) == 1;
+        g_free(key2);
+        key2 = g_strdup_printf("%s_actions", key);
+        actions = options_lookup_string(profile, key2);
+        g_free(key2);
+        key2 = g_strdup_printf("%s_command", key);
+        command = options_lookup_string(profile, key2);
+        g_free(key2);
+        if (!ts)
+            ts = trigger_set_new();
+        if (!trigger_set_add(ts, pattern, regex,
+                    trigger_parse_actions(actions), command, &error))
+        {
+            g_warning(_("Ignoring %s: %s"), key, error->message);
+            g_error_free(error);
+        }
+        g_free(command);
+        g_free(actions);
+        g_free(pattern);
+        g_free(key);
+    }
+    if (ts && !ts->triggers->len)
+    {
+        trigger_set_unref(ts);
+        ts = NULL;
+    }
+    if (ts)
+        trigger_set_compile(ts);
+    return ts;
+}
+
+TriggerSet *trigger_set_ref(TriggerSet *ts)
+{
+    g_atomic_int_inc(&ts->ref);
+    return ts;
+}
+
+void trigger_set_unref(TriggerSet *ts)
+{
+    guint n;
+
+    if (!g_atomic_int_dec_and_test(&ts->ref))
+        return;
+    for (n = 0; n < ts->triggers->len; ++n)
+    {
+        Trigger *t = &g_array_index(ts->triggers, Trigger, n);
+
+        g_free(t->pattern);
+        g_free(t->command);
+        if (t->code)
+            pcre2_code_free(t->code);
+    }
+    g_array_unref(ts->triggers);
+    g_free(ts->delta);
+    g_free(ts->out_start);
+    g_free(ts->out);
+    if (ts->combined)
+        pcre2_code_free(ts->combined);
+    g_array_unref(ts->combined_regexes);
+    g_array_unref(ts->other_regexes);
+    g_free(ts);
+}
+
+gboolean trigger_set_add(TriggerSet *ts, const char *pattern, gboolean regex,
+        guint actions, const char *command, GError **error)
+{
+    Trigger t;
+
+    g_return_val_if_fail(!ts->compiled, FALSE);
+    if (!pattern || !pattern[0])
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                _("Empty trigger"));
+        return FALSE;
+    }
+    t.code = NULL;
+    if (regex)
+    {
+        int errcode;
+        PCRE2_SIZE erroffset;
+
+        t.code = pcre2_compile((PCRE2_SPTR) pattern, PCRE2_ZERO_TERMINATED,
+                TRIGGER_PCRE2_FLAGS, &errcode, &erroffset, NULL);
+        if (!t.code)
+        {
+            PCRE2_UCHAR msg[256];
+
+            pcre2_get_error_message(errcode, msg, sizeof(msg));
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                    _("Invalid regex '%s' at %d: %s"), pattern,
+                    (int) erroffset, (const char *) msg);
+            return FALSE;
+        }
+        pcre2_jit_compile(t.code, PCRE2_JIT_COMPLETE);
+    }
+    t.pattern = g_strdup(pattern);
+    t.regex = regex;
+    t.actions = actions;
+    t.command = command && command[0] ? g_strdup(command) : NULL;
+    g_array_append_val(ts->triggers, t);
+    return TRUE;
+}
+
+static void trigger_set_build_automaton(TriggerSet *ts)
+{
+    guint max_states = 1;
+    guint32 *fail;
+    guint32 *queue;
+    GArray **outs;
+    guint head, tail;
+    guint n, c;
+    guint n_out;
+
+    /* Assign classes to the bytes the strings use */
+    memset(ts->byte_class, 0, sizeof(ts->byte_class));
+    ts->n_classes = 1;
+    for (n = 0; n < ts->triggers->len; ++n)
+    {
+        Trigger *t = &g_array_index(ts->triggers, Trigger, n);
+        const guint8 *s;
+
+        if (t->regex)
+            continue;
+        for (s = (const guint8 *) t->pattern; *s; ++s)
+        {
+            if (!ts->byte_class[*s])
+                ts->byte_class[*s] = ts->n_classes++;
+            ++max_states;
+        }
+    }
+
+    /* Build the trie; 0 in delta means there's no edge yet, which is safe
+     * because nothing can go back to the root while the trie is built.
+     */
+    ts->delta = g_new0(guint32, max_states * ts->n_classes);
+    outs = g_new0(GArray *, max_states);
+    ts->n_states = 1;
+    for (n = 0; n < ts->triggers->len; ++n)
+    {
+        Trigger *t = &g_array_index(ts->triggers, Trigger, n);
+        const guint8 *s;
+        guint32 state = 0;
+
+        if (t->regex)
+            continue;
+        for (s = (const guint8 *) t->pattern; *s; ++s)
+        {
+            guint32 *next = &ts->delta[state * ts->n_classes +
+                    ts->byte_class[*s]];
+
+            if (!*next)
+                *next = ts->n_states++;
+            state = *next;
+        }
+        if (!outs[state])
+            outs[state] = g_array_new(FALSE, FALSE, sizeof(guint32));
+        g_array_append_val(outs[state], n);
+    }
+
+    /* Fill in the failure transitions breadth first, so each state's
+     * failure state is complete before the state itself, making delta a
+     * DFA. Each state also inherits the outputs of its failure state.
+     */
+    fail = g_new0(guint32, ts->n_states);
+    queue = g_new(guint32, ts->n_states);
+    head = tail = 0;
+    for (c = 0; c < ts->n_classes; ++c)
+    {
+        guint32 child = ts->delta[c];
+
+        if (child)
+            queue[tail++] = child;
+    }
+    while (head < tail)
+    {
+        guint32 state = queue[head++];
+        guint32 f = fail[state];
+
+        if (outs[f])
+        {
+            if (!outs[state])
+                outs[state] = g_array_new(FALSE, FALSE, sizeof(guint32));
+            g_array_append_vals(outs[state], outs[f]->data, outs[f]->len);
+        }
+        for (c = 0; c < ts->n_classes; ++c)
+        {
+            guint32 *next = &ts->delta[state * ts->n_classes + c];
+            guint32 via_fail = ts->delta[f * ts->n_classes + c];
+
+            if (*next)
+            {
+                fail[*next] = via_fail;
+                queue[tail++] = *next;
+            }
+            else
+            {
+                *next = via_fail;
+            }
+        }
+    }
+
+    /* Flatten the outputs */
+    ts->out_start = g_new(guint32, ts->n_states + 1);
+    n_out = 0;
+    for (n = 0; n < ts->n_states; ++n)
+        n_out += outs[n] ? outs[n]->len : 0;
+    ts->out = g_new(guint32, n_out ? n_out : 1);
+    n_out = 0;
+    for (n = 0; n < ts->n_states; ++n)
+    {
+        ts->out_start[n] = n_out;
+        if (outs[n])
+        {
+            memcpy(ts->out + n_out, outs[n]->data,
+                    outs[n]->len * sizeof(guint32));
+            n_out += outs[n]->len;
+            g_array_unref(outs[n]);
+        }
+    }
+    ts->out_start[ts->n_states] = n_out;
+    g_free(outs);
+    g_free(queue);
+    g_free(fail);
+}
+
+/* Whether a trigger's regex can be wrapped in a group and combined with
+ * others. Something like an unterminated \Q or a comment in extended mode
+ * would swallow the end of the group and the regexes after it, so this
+ * checks that an empty capture after the group still counts.
+ */
+static gboolean trigger_can_combine(Trigger *t)
+{
+    char *wrapped = g_strdup_printf("(?:%s)()", t->pattern);
+    int errcode;
+    PCRE2_SIZE erroffset;
+    pcre2_code *code = pcre2_compile((PCRE2_SPTR) wrapped,
+            PCRE2_ZERO_TERMINATED, TRIGGER_PCRE2_FLAGS, &errcode, &erroffset,
+            NULL);
+    uint32_t captures = 0;
+    uint32_t wrapped_captures = 0;
+
+    g_free(wrapped);
+    if (!code)
+        return FALSE;
+    pcre2_pattern_info(t->code, PCRE2_INFO_CAPTURECOUNT, &captures);
+    pcre2_pattern_info(code, PCRE2_INFO_CAPTURECOUNT, &wrapped_captures);
+    pcre2_code_free(code);
+    return wrapped_captures == captures + 1;
+}
+
+static void trigger_set_combine_regexes(TriggerSet *ts)
+{
+    GString *combined = g_string_new(NULL);
+    guint n;
+    int errcode;
+    PCRE2_SIZE erroffset;
+
+    for (n = 0; n < ts->triggers->len; ++n)
+    {
+        Trigger *t = &g_array_index(ts->triggers, Trigger, n);
+        uint32_t backrefs = 0;
+
+        if (!t->regex)
+            continue;
+        pcre2_pattern_info(t->code, PCRE2_INFO_BACKREFMAX, &backrefs);
+        if (backrefs || !trigger_can_combine(t))
+        {
+            g_array_append_val(ts->other_regexes, n);
+            continue;
+        }
+        g_string_append_printf(combined, "%s(?:%s)",
+                combined->len ? "|" : "", t->pattern);
+        g_array_append_val(ts->combined_regexes, n);
+    }
+    /* One regex on its own may as well be matched directly */
+    if (ts->combined_regexes->len > 1)
+    {
+        ts->combined = pcre2_compile((PCRE2_SPTR) combined->str,
+                combined->len, TRIGGER_PCRE2_FLAGS, &errcode, &erroffset,
+                NULL);
+        if (ts->combined)
+            pcre2_jit_compile(ts->combined, PCRE2_JIT_COMPLETE);
+    }
+    if (!ts->combined)
+    {
+        g_array_append_vals(ts->other_regexes, ts->combined_regexes->data,
+                ts->combined_regexes->len);
+        g_array_set_size(ts->combined_regexes, 0);
+    }
+    g_string_free(combined, TRUE);
+}
+
+void trigger_set_compile(TriggerSet *ts)
+{
+    g_return_if_fail(!ts->compiled);
+    trigger_set_build_automaton(ts);
+    trigger_set_combine_regexes(ts);
+    ts->compiled = TRUE;
+}
+
+guint trigger_set_get_count(TriggerSet *ts)
+{
+    return ts->triggers->len;
+}
+
+const char *trigger_set_get_pattern(TriggerSet *ts, guint index)
+{
+    return g_array_index(ts->triggers, Trigger, index).pattern;
+}
+
+guint trigger_set_get_actions(TriggerSet *ts, guint index)
+{
+    return g_array_index(ts->triggers, Trigger, index).actions;
+}
+
+const char *trigger_set_get_command(TriggerSet *ts, guint index)
+{
+    return g_array_index(ts->triggers, Trigger, index).command;
+}
+
+TriggerMatcher *trigger_matcher_new(TriggerSet *ts, TriggerHandler handler,
+        gpointer data)
+{
+    TriggerMatcher *tm = g_new(TriggerMatcher, 1);
+    guint count = ts->triggers->len;
+
+    g_return_val_if_fail(ts->compiled, NULL);
+    tm->ts = trigger_set_ref(ts);
+    tm->handler = handler;
+    tm->handler_data = data;
+    tm->state = ESC_SCAN_TEXT;
+    tm->ac_state = 0;
+    tm->md = pcre2_match_data_create(1, NULL);
+    tm->line_len = 0;
+    tm->scanned_len = 0;
+    tm->line_no = 0;
+    tm->fired_line = g_new0(guint64, count);
+    tm->fired_time = g_new0(gint64, count);
+    tm->hits = 0;
+    return tm;
+}
+
+void trigger_matcher_free(TriggerMatcher *tm)
+{
+    if (!tm)
+        return;
+    pcre2_match_data_free(tm->md);
+    g_free(tm->fired_line);
+    g_free(tm->fired_time);
+    trigger_set_unref(tm->ts);
+    g_free(tm);
+}
+
+guint64 trigger_matcher_get_hits(TriggerMatcher *tm)
+{
+    return tm->hits;
+}
+
+static gboolean trigger_hit_dispatch(TriggerHit *hit)
+{
+    hit->handler(hit->ts, hit->index, hit->text, hit->handler_data);
+    trigger_set_unref(hit->ts);
+    g_free(hit->text);
+    g_free(hit);
+    return G_SOURCE_REMOVE;
+}
+
+static void trigger_matcher_fire(TriggerMatcher *tm, guint index,
+        const char *text, gsize len)
+{
+    TriggerHit *hit;
+    gint64 now;
+
+    if (tm->fired_line[index] == tm->line_no + 1)
+        return;
+    tm->fired_line[index] = tm->line_no + 1;
+    ++tm->hits;
+    if (!tm->handler)
+        return;
+    now = g_get_monotonic_time();
+    if (tm->fired_time[index] &&
+            now - tm->fired_time[index] < TRIGGER_COOLDOWN_USEC)
+    {
+        return;
+    }
+    tm->fired_time[index] = now;
+    hit = g_new(TriggerHit, 1);
+    hit->ts = trigger_set_ref(tm->ts);
+    hit->index = index;
+    hit->text = g_strndup(text, len);
+    hit->handler = tm->handler;
+    hit->handler_data = tm->handler_data;
+    g_idle_add((GSourceFunc) trigger_hit_dispatch, hit);
+}
+
+static void trigger_matcher_try_regex(TriggerMatcher *tm, guint index)
+{
+    Trigger *t = &g_array_index(tm->ts->triggers, Trigger, index);
+
+    if (tm->fired_line[index] == tm->line_no + 1)
+        return;
+    if (pcre2_match(t->code, (PCRE2_SPTR) tm->line, tm->line_len, 0, 0,
+                tm->md, NULL) >= 0)
+    {
+        PCRE2_SIZE *ovector = pcre2_get_ovector_pointer(tm->md);
+
+        trigger_matcher_fire(tm, index, tm->line + ovector[0],
+                ovector[1] - ovector[0]);
+    }
+}
+
+/* Matches the regexes against the current line, complete or not */
+static void trigger_matcher_scan_line(TriggerMatcher *tm)
+{
+    TriggerSet *ts = tm->ts;
+    guint n;
+
+    if (tm->scanned_len == tm->line_len ||
+            (!ts->combined && !ts->other_regexes->len))
+    {
+        return;
+    }
+    tm->scanned_len = tm->line_len;
+    if (ts->combined && pcre2_match(ts->combined, (PCRE2_SPTR) tm->line,
+                tm->line_len, 0, 0, tm->md, NULL) >= 0)
+    {
+        for (n = 0; n < ts->combined_regexes->len; ++n)
+        {
+            trigger_matcher_try_regex(tm,
+                    g_array_index(ts->combined_regexes, guint, n));
+        }
+    }
+    for (n = 0; n < ts->other_regexes->len; ++n)
+    {
+        trigger_matcher_try_regex(tm,
+                g_array_index(ts->other_regexes, guint, n));
+    }
+}
+
+static void trigger_matcher_end_line(TriggerMatcher *tm)
+{
+    trigger_matcher_scan_line(tm);
+    tm->line_len = 0;
+    tm->scanned_len = 0;
+    ++tm->line_no;
+}
+
+inline static void trigger_matcher_text(TriggerMatcher *tm, guint8 c)
+{
+    TriggerSet *ts = tm->ts;
+    guint32 state;
+    guint32 o;
+
+    if (c == '\n')
+    {
+        trigger_matcher_end_line(tm);
+        tm->ac_state = 0;
+        return;
+    }
+    if ((c < 0x20 && c != '\t') || c == 0x7f)
+        return;
+    if (tm->line_len == TRIGGER_MAX_LINE)
+        trigger_matcher_end_line(tm);
+    tm->line[tm->line_len++] = c;
+    state = ts->delta[tm->ac_state * ts->n_classes + ts->byte_class[c]];
+    tm->ac_state = state;
+    for (o = ts->out_start[state]; o < ts->out_start[state + 1]; ++o)
+    {
+        guint index = ts->out[o];
+
+        const char *pattern =
+                g_array_index(ts->triggers, Trigger, index).pattern;
+
+        trigger_matcher_fire(tm, index, pattern, strlen(pattern));
+    }
+}
+
+void trigger_matcher_feed(TriggerMatcher *tm, const guint8 *buf, gsize len)
+{
+    gsize n;
+
+    for (n = 0; n < len; ++n)
+    {
+        if (esc_scan_feed(&tm->state, buf[n]))
+            trigger_matcher_text(tm, buf[n]);
+    }
+    /* Catch prompts, which don't end with a newline */
+    if (tm->line_len)
+        trigger_matcher_scan_line(tm);
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
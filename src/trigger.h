@@ -0,0 +1,118 @@
+#ifndef TRIGGER_H
+#define TRIGGER_H
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+/* Triggers watch a terminal's output for strings or regexes, eg "BUILD
+ * FAILED" or "password:", and raise a notification, draw attention to the
+ * tab, show a status icon or run a command when one appears. They're set in
+ * profiles with numbered keys, starting with 0 and stopping at the first one
+ * which is missing:
+ *
+ * triggerN            The string or regex to look for
+ * triggerN_regex      1 if it's a regex
+ * triggerN_actions    Comma-separated list of notify, flash, icon and
+ *                     command; the default is notify
+ * triggerN_command    Run with sh -c, with the text which matched in
+ *                     ROXTERM_TRIGGER_MATCH
+ *
+ * Escape sequences are stripped from the output first, and regexes are
+ * matched against one line at a time, or the incomplete current line, so
+ * that prompts are found without waiting for a newline.
+ *
+ * The cost has to stay the same however many triggers a profile has, so all
+ * the strings are compiled into a single Aho-Corasick automaton, and the
+ * regexes are combined into one PCRE2 pattern. A line is only tried against
+ * the individual regexes when the combined pattern matches it, to find out
+ * which of them did.
+ */
+
+#ifndef DEFNS_H
+#include "defns.h"
+#endif
+
+#include "options.h"
+
+typedef enum {
+    TRIGGER_NOTIFY = 1,
+    TRIGGER_FLASH = 2,
+    TRIGGER_ICON = 4,
+    TRIGGER_COMMAND = 8
+} TriggerAction;
+
+typedef struct TriggerSet TriggerSet;
+
+typedef struct TriggerMatcher TriggerMatcher;
+
+/* Called in the main thread when trigger number index fires; text is what
+ * matched.
+ */
+typedef void (*TriggerHandler)(TriggerSet *ts, guint index,
+        const char *text, gpointer data);
+
+TriggerSet *trigger_set_new(void);
+
+/* Returns NULL if the profile doesn't have any triggers */
+TriggerSet *trigger_set_new_for_profile(Options *profile);
+
+TriggerSet *trigger_set_ref(TriggerSet *ts);
+
+void trigger_set_unref(TriggerSet *ts);
+
+/* Returns FALSE and sets error if pattern is empty or an invalid regex.
+ * actions is a combination of TriggerAction flags.
+ */
+gboolean trigger_set_add(TriggerSet *ts, const char *pattern, gboolean regex,
+        guint actions, const char *command, GError **error);
+
+/* Builds the automaton and combined regex. After this no more triggers can
+ * be added, and the set can be shared by matchers in any thread.
+ */
+void trigger_set_compile(TriggerSet *ts);
+
+guint trigger_set_get_count(TriggerSet *ts);
+
+const char *trigger_set_get_pattern(TriggerSet *ts, guint index);
+
+guint trigger_set_get_actions(TriggerSet *ts, guint index);
+
+/* May be NULL */
+const char *trigger_set_get_command(TriggerSet *ts, guint index);
+
+/* handler may be NULL, eg for roxterm-bench */
+TriggerMatcher *trigger_matcher_new(TriggerSet *ts, TriggerHandler handler,
+        gpointer data);
+
+void trigger_matcher_free(TriggerMatcher *tm);
+
+/* Scans a chunk of raw pty output. This may be called from any thread, but
+ * only one at a time for each matcher. A trigger fires at most once per
+ * line, and the handler is called at most once a second for each trigger.
+ */
+void trigger_matcher_feed(TriggerMatcher *tm, const guint8 *buf, gsize len);
+
+/* The number of times triggers have fired, including ones which were rate
+ * limited.
+ */
+guint64 trigger_matcher_get_hits(TriggerMatcher *tm);
+
+#endif /* TRIGGER_H */
+
+/* vi:set sw=4 ts=4 et cindent cino= */
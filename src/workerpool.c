@@ -0,0 +1,614 @@
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "defns.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "globalopts.h"
+#include "session-file.h"
+#include "workerpool.h"
+
+#define WORKER_POOL_ERROR RTDBUS_ERROR ".WorkerPoolError"
+#define WORKER_POOL_SAVE_SESSION "SaveSession"
+#define WORKER_POOL_SAVE_SESSION_PART "SaveSessionPart"
+
+/* How often workers' CPU usage is sampled for WORKER_PLACEMENT_LOAD */
+#define WORKER_POOL_LOAD_MS 1000
+
+#define WORKER_POOL_SAVE_TIMEOUT_MS 10000
+
+typedef enum {
+    WORKER_STOPPED,
+    WORKER_STARTING,        /* Spawned but doesn't own its bus name yet */
+    WORKER_READY
+} WorkerState;
+
+typedef struct {
+    char *bus_name;
+    WorkerState state;
+    gboolean was_ready;
+    GPid pid;
+    GQueue pending;         /* NewTerminal messages waiting for WORKER_READY */
+    guint64 cpu_ticks;
+    double load;
+    guint placed;           /* Number of windows sent to this worker */
+} Worker;
+
+typedef struct {
+    char *filename;
+    char *id;
+    char **parts;
+    int outstanding;
+} WorkerPoolSave;
+
+typedef struct {
+    gboolean dispatcher;
+    Worker *workers;
+    int size;
+    WorkerPlacement placement;
+    int next;
+    char *exe;
+    guint load_tag;
+} WorkerPoolGlobal;
+
+static WorkerPoolGlobal worker_pool_global;
+
+WorkerPlacement worker_pool_parse_placement(const char *name)
+{
+    if (!name || !strcmp(name, "load"))
+        return WORKER_PLACEMENT_LOAD;
+    if (!strcmp(name, "profile"))
+        return WORKER_PLACEMENT_PROFILE;
+    if (!strcmp(name, "round-robin") || !strcmp(name, "round_robin"))
+        return WORKER_PLACEMENT_ROUND_ROBIN;
+    g_warning(_("Unknown worker placement '%s'"), name);
+    return WORKER_PLACEMENT_LOAD;
+}
+
+char *worker_pool_get_worker_name(int index)
+{
+    return g_strdup_printf("%s.w%d", ROXTERM_DBUS_NAME, index);
+}
+
+gboolean worker_pool_is_worker(void)
+{
+    return global_options_worker >= 0;
+}
+
+gboolean worker_pool_is_dispatcher(void)
+{
+    return worker_pool_global.dispatcher;
+}
+
+gboolean worker_pool_start_worker(DBusObjectPathMessageFunction handler)
+{
+    char *name = worker_pool_get_worker_name(global_options_worker);
+    gboolean result;
+
+    /* Replace any worker left over from a previous dispatcher which
+     * the current one doesn't know about.
+     */
+    result = !rtdbus_start_service(name, ROXTERM_DBUS_OBJECT_PATH,
+            handler, TRUE) && rtdbus_connection;
+    g_free(name);
+    return result;
+}
+
+/* Copies a client's args (excluding argv[0]) for a worker, leaving out the
+ * options which only apply to the first process.
+ */
+static char **worker_pool_make_argv(int index, char **args)
+{
+    GPtrArray *argv = g_ptr_array_new();
+    int n;
+
+    g_ptr_array_add(argv, g_strdup(worker_pool_global.exe));
+    g_ptr_array_add(argv, g_strdup_printf("--worker=%d", index));
+    for (n = 0; args && args[n]; ++n)
+    {
+        const char *arg = args[n];
+
+        if (!strcmp(arg, "-e") || !strcmp(arg, "--execute"))
+        {
+            for (; args[n]; ++n)
+                g_ptr_array_add(argv, g_strdup(args[n]));
+            break;
+        }
+        if (!strcmp(arg, "--workers") || !strcmp(arg, "--worker-placement"))
+        {
+            if (args[n + 1])
+                ++n;
+            continue;
+        }
+        if (g_str_has_prefix(arg, "--workers=") ||
+                g_str_has_prefix(arg, "--worker-placement=") ||
+                g_str_has_prefix(arg, "--worker=") ||
+                !strcmp(arg, "--replace") || !strcmp(arg, "--fork"))
+        {
+            continue;
+        }
+        g_ptr_array_add(argv, g_strdup(arg));
+    }
+    g_ptr_array_add(argv, NULL);
+    return (char **) g_ptr_array_free(argv, FALSE);
+}
+
+static gboolean worker_pool_any_running(void)
+{
+    int n;
+
+    for (n = 0; n < worker_pool_global.size; ++n)
+    {
+        if (worker_pool_global.workers[n].state != WORKER_STOPPED)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static void worker_pool_dispatch(DBusMessage *message);
+
+static void worker_pool_child_exited(GPid pid, int status, gpointer data)
+{
+    Worker *w = data;
+    DBusMessage *message;
+    (void) status;
+
+    g_spawn_close_pid(pid);
+    w->pid = 0;
+    w->state = WORKER_STOPPED;
+    w->load = 0;
+    w->placed = 0;
+    /* If it died before it was ready it's probably going to fail again */
+    while ((message = g_queue_pop_head(&w->pending)) != NULL)
+    {
+        if (w->was_ready)
+            worker_pool_dispatch(message);
+        else
+            g_warning(_("Worker %s exited before opening a window"),
+                    w->bus_name);
+        dbus_message_unref(message);
+    }
+    if (!worker_pool_any_running())
+        gtk_main_quit();
+}
+
+static gboolean worker_pool_spawn(Worker *w, char **args, char **envp)
+{
+    char **argv = worker_pool_make_argv(w - worker_pool_global.workers, args);
+    GError *error = NULL;
+    gboolean result = g_spawn_async(NULL, argv, envp,
+            G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_SEARCH_PATH,
+            NULL, NULL, &w->pid, &error);
+
+    g_strfreev(argv);
+    if (!result)
+    {
+        g_warning(_("Unable to start worker process: %s"), error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+    w->state = WORKER_STARTING;
+    w->was_ready = FALSE;
+    w->cpu_ticks = 0;
+    w->load = 0;
+    w->placed = 1;
+    g_child_watch_add(w->pid, worker_pool_child_exited, w);
+    return TRUE;
+}
+
+static void worker_pool_forward(Worker *w, DBusMessage *message)
+{
+    DBusMessage *copy = dbus_message_copy(message);
+
+    if (!copy || !dbus_message_set_destination(copy, w->bus_name))
+    {
+        g_warning(_("Unable to forward D-BUS message to %s"), w->bus_name);
+        if (copy)
+            dbus_message_unref(copy);
+        return;
+    }
+    dbus_message_set_no_reply(copy, TRUE);
+    rtdbus_send_message(copy);
+    ++w->placed;
+}
+
+/* Returns the value of any --profile/-p option */
+static const char *worker_pool_find_profile(char **args)
+{
+    int n;
+
+    for (n = 1; args && args[n]; ++n)
+    {
+        const char *arg = args[n];
+
+        if (!strcmp(arg, "-e") || !strcmp(arg, "--execute"))
+            break;
+        if (g_str_has_prefix(arg, "--profile="))
+            return arg + 10;
+        if (!strcmp(arg, "--profile") || !strcmp(arg, "-p"))
+            return args[n + 1];
+        if (g_str_has_prefix(arg, "-p") && arg[2])
+            return arg + 2;
+    }
+    return NULL;
+}
+
+static Worker *worker_pool_choose(char **args)
+{
+    Worker *workers = worker_pool_global.workers;
+    Worker *best = NULL;
+    const char *profile;
+    int n;
+
+    switch (worker_pool_global.placement)
+    {
+        case WORKER_PLACEMENT_PROFILE:
+            profile = worker_pool_find_profile(args);
+            n = g_str_hash(profile ? profile : "Default") %
+                    worker_pool_global.size;
+            return &workers[n];
+        case WORKER_PLACEMENT_ROUND_ROBIN:
+            n = worker_pool_global.next;
+            worker_pool_global.next = (n + 1) % worker_pool_global.size;
+            return &workers[n];
+        default:
+            break;
+    }
+    for (n = 0; n < worker_pool_global.size; ++n)
+    {
+        Worker *w = &workers[n];
+
+        /* An unused slot is bound to be the least loaded */
+        if (w->state == WORKER_STOPPED)
+            return w;
+        if (!best || w->load < best->load ||
+                (w->load == best->load && w->placed < best->placed))
+        {
+            best = w;
+        }
+    }
+    return best;
+}
+
+static void worker_pool_dispatch(DBusMessage *message)
+{
+    DBusMessageIter iter;
+    char **env;
+    char **args;
+    Worker *w;
+
+    dbus_message_iter_init(message, &iter);
+    env = rtdbus_get_message_arg_string_array(&iter);
+    args = rtdbus_get_message_args_as_strings(&iter);
+    w = worker_pool_choose(args);
+    switch (w->state)
+    {
+        case WORKER_STOPPED:
+            /* The new worker opens the window itself */
+            worker_pool_spawn(w, args ? args + 1 : NULL, env);
+            break;
+        case WORKER_STARTING:
+            g_queue_push_tail(&w->pending, dbus_message_ref(message));
+            ++w->placed;
+            break;
+        case WORKER_READY:
+            worker_pool_forward(w, message);
+            break;
+    }
+    g_strfreev(args);
+    g_strfreev(env);
+}
+
+static DBusHandlerResult worker_pool_name_owner_changed(
+        DBusConnection *connection, DBusMessage *message, void *user_data)
+{
+    const char *name = NULL;
+    const char *old_owner = NULL;
+    const char *new_owner = NULL;
+    DBusError derror;
+    int n;
+    (void) connection;
+    (void) user_data;
+
+    if (!dbus_message_is_signal(message, DBUS_INTERFACE_DBUS,
+                "NameOwnerChanged"))
+    {
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    }
+    dbus_error_init(&derror);
+    if (!dbus_message_get_args(message, &derror,
+            DBUS_TYPE_STRING, &name,
+            DBUS_TYPE_STRING, &old_owner,
+            DBUS_TYPE_STRING, &new_owner,
+            DBUS_TYPE_INVALID))
+    {
+        rtdbus_warn(&derror, "Bad NameOwnerChanged signal");
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    }
+    for (n = 0; n < worker_pool_global.size; ++n)
+    {
+        Worker *w = &worker_pool_global.workers[n];
+        DBusMessage *pending;
+
+        if (strcmp(name, w->bus_name) || w->state == WORKER_STOPPED)
+            continue;
+        if (!new_owner[0])
+        {
+            /* Exiting; the child watch will tidy up */
+            w->state = WORKER_STARTING;
+            break;
+        }
+        w->state = WORKER_READY;
+        w->was_ready = TRUE;
+        while ((pending = g_queue_pop_head(&w->pending)) != NULL)
+        {
+            worker_pool_forward(w, pending);
+            --w->placed;
+            dbus_message_unref(pending);
+        }
+        break;
+    }
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+/* Total user + system time from /proc/PID/stat, or 0 if unavailable */
+static guint64 worker_pool_get_cpu_ticks(GPid pid)
+{
+    char *filename = g_strdup_printf("/proc/%d/stat", (int) pid);
+    char *stat = NULL;
+    char *p;
+    unsigned long utime = 0, stime = 0;
+
+    if (g_file_get_contents(filename, &stat, NULL, NULL) &&
+            (p = strrchr(stat, ')')) != NULL)
+    {
+        if (sscanf(p + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u "
+                "%lu %lu", &utime, &stime) != 2)
+        {
+            utime = stime = 0;
+        }
+    }
+    g_free(stat);
+    g_free(filename);
+    return (guint64) utime + stime;
+}
+
+static gboolean worker_pool_sample_load(gpointer data)
+{
+    int n;
+    (void) data;
+
+    for (n = 0; n < worker_pool_global.size; ++n)
+    {
+        Worker *w = &worker_pool_global.workers[n];
+        guint64 ticks;
+
+        if (!w->pid)
+            continue;
+        ticks = worker_pool_get_cpu_ticks(w->pid);
+        if (w->cpu_ticks && ticks >= w->cpu_ticks)
+            w->load = w->load * 0.5 + (double) (ticks - w->cpu_ticks) * 0.5;
+        w->cpu_ticks = ticks;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+gboolean worker_pool_start_dispatcher(int size, WorkerPlacement placement,
+        char **argv, char **envp)
+{
+    int n;
+
+    if (!rtdbus_add_rule_and_filter("type='signal',"
+                "sender='" DBUS_SERVICE_DBUS "',"
+                "interface='" DBUS_INTERFACE_DBUS "',"
+                "member='NameOwnerChanged',"
+                "arg0namespace='" ROXTERM_DBUS_NAME "'",
+            worker_pool_name_owner_changed, NULL))
+    {
+        return FALSE;
+    }
+    worker_pool_global.size = size;
+    worker_pool_global.placement = placement;
+    worker_pool_global.exe = g_strdup(argv[0]);
+    worker_pool_global.workers = g_new0(Worker, size);
+    for (n = 0; n < size; ++n)
+    {
+        Worker *w = &worker_pool_global.workers[n];
+
+        w->bus_name = worker_pool_get_worker_name(n);
+        g_queue_init(&w->pending);
+    }
+    if (!worker_pool_spawn(worker_pool_choose(argv), argv + 1, envp))
+        return FALSE;
+    worker_pool_global.dispatcher = TRUE;
+    if (placement == WORKER_PLACEMENT_LOAD)
+    {
+        worker_pool_global.load_tag = g_timeout_add(WORKER_POOL_LOAD_MS,
+                worker_pool_sample_load, NULL);
+    }
+    return TRUE;
+}
+
+static void worker_pool_finish_save(WorkerPoolSave *save)
+{
+    int n;
+
+    if (!save_session_from_parts(save->filename, save->id, save->parts))
+    {
+        g_warning(_("Unable to save session to '%s'"), save->filename);
+    }
+    for (n = 0; save->parts[n]; ++n)
+        unlink(save->parts[n]);
+    g_strfreev(save->parts);
+    g_free(save->filename);
+    g_free(save->id);
+    g_free(save);
+}
+
+static void worker_pool_part_saved(DBusPendingCall *pending, void *data)
+{
+    WorkerPoolSave *save = data;
+    DBusMessage *reply = dbus_pending_call_steal_reply(pending);
+
+    if (reply && dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_ERROR)
+    {
+        g_warning(_("Worker failed to save its part of session: %s"),
+                dbus_message_get_error_name(reply));
+    }
+    if (reply)
+        dbus_message_unref(reply);
+    dbus_pending_call_unref(pending);
+    if (!--save->outstanding)
+        worker_pool_finish_save(save);
+}
+
+/* Asks each running worker to save its windows to a separate file, then
+ * combines them when they've all replied.
+ */
+static void worker_pool_save(const char *filename, const char *id)
+{
+    WorkerPoolSave *save = g_new0(WorkerPoolSave, 1);
+    int n, p = 0;
+
+    save->filename = g_strdup(filename);
+    save->id = g_strdup(id);
+    save->parts = g_new0(char *, worker_pool_global.size + 1);
+    for (n = 0; n < worker_pool_global.size; ++n)
+    {
+        Worker *w = &worker_pool_global.workers[n];
+        char *part;
+        DBusMessage *message;
+        DBusPendingCall *pending = NULL;
+
+        if (w->state != WORKER_READY)
+            continue;
+        part = g_strdup_printf("%s.part%d", filename, n);
+        message = rtdbus_method_new(w->bus_name, ROXTERM_DBUS_OBJECT_PATH,
+                ROXTERM_DBUS_INTERFACE, WORKER_POOL_SAVE_SESSION_PART,
+                DBUS_TYPE_STRING, &part,
+                DBUS_TYPE_INVALID);
+        if (message && dbus_connection_send_with_reply(rtdbus_connection,
+                    message, &pending, WORKER_POOL_SAVE_TIMEOUT_MS) &&
+                pending)
+        {
+            dbus_pending_call_set_notify(pending, worker_pool_part_saved,
+                    save, NULL);
+            save->parts[p++] = part;
+            ++save->outstanding;
+        }
+        else
+        {
+            g_warning(_("Unable to ask %s to save its windows"), w->bus_name);
+            g_free(part);
+        }
+        if (message)
+            dbus_message_unref(message);
+    }
+    if (!save->outstanding)
+        worker_pool_finish_save(save);
+}
+
+static void worker_pool_save_part(DBusMessage *message)
+{
+    const char *filename = NULL;
+    DBusError derror;
+    DBusMessage *reply;
+
+    dbus_error_init(&derror);
+    if (!dbus_message_get_args(message, &derror,
+            DBUS_TYPE_STRING, &filename,
+            DBUS_TYPE_INVALID))
+    {
+        rtdbus_warn(&derror, "Bad SaveSessionPart message");
+        reply = dbus_message_new_error(message, WORKER_POOL_ERROR,
+                _("Unable to get argument"));
+    }
+    else if (save_session_part_to_file(filename))
+    {
+        reply = dbus_message_new_method_return(message);
+    }
+    else
+    {
+        reply = dbus_message_new_error(message, WORKER_POOL_ERROR,
+                _("Unable to save session"));
+    }
+    if (reply)
+        rtdbus_send_message(reply);
+}
+
+gboolean worker_pool_handle_message(DBusMessage *message)
+{
+    if (worker_pool_global.dispatcher)
+    {
+        if (dbus_message_is_method_call(message, ROXTERM_DBUS_INTERFACE,
+                    ROXTERM_DBUS_METHOD_NAME))
+        {
+            worker_pool_dispatch(message);
+            return TRUE;
+        }
+        if (dbus_message_is_method_call(message, ROXTERM_DBUS_INTERFACE,
+                    WORKER_POOL_SAVE_SESSION))
+        {
+            const char *filename = NULL;
+            const char *id = NULL;
+            DBusError derror;
+
+            dbus_error_init(&derror);
+            if (dbus_message_get_args(message, &derror,
+                    DBUS_TYPE_STRING, &filename,
+                    DBUS_TYPE_STRING, &id,
+                    DBUS_TYPE_INVALID))
+            {
+                worker_pool_save(filename, id);
+            }
+            else
+            {
+                rtdbus_warn(&derror, "Bad SaveSession message");
+            }
+            return TRUE;
+        }
+    }
+    else if (worker_pool_is_worker() &&
+            dbus_message_is_method_call(message, ROXTERM_DBUS_INTERFACE,
+                WORKER_POOL_SAVE_SESSION_PART))
+    {
+        worker_pool_save_part(message);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+gboolean worker_pool_save_session(const char *filename, const char *id)
+{
+    DBusMessage *message;
+
+    if (!rtdbus_ok || !rtdbus_connection)
+        return FALSE;
+    message = rtdbus_method_new(ROXTERM_DBUS_NAME, ROXTERM_DBUS_OBJECT_PATH,
+            ROXTERM_DBUS_INTERFACE, WORKER_POOL_SAVE_SESSION,
+            DBUS_TYPE_STRING, &filename,
+            DBUS_TYPE_STRING, &id,
+            DBUS_TYPE_INVALID);
+    return message && rtdbus_send_message(message);
+}
+
+/* vi:set sw=4 ts=4 et cindent cino= */
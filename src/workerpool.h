@@ -0,0 +1,94 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+/*
+    roxterm - VTE/GTK terminal emulator with tabs
+    Copyright (C) 2004-2024 Tony Houghton <h@realh.co.uk>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* With --workers=N the process which owns ROXTERM_DBUS_NAME doesn't open any
+ * windows itself, but acts as a dispatcher, passing each NewTerminal request
+ * to one of up to N worker processes so that a busy or blocked window can
+ * only hold up the others in the same worker. Workers are started on demand
+ * and each listens on its own bus name. Option change signals are broadcast,
+ * so they reach every worker anyway; saving a session is coordinated by the
+ * dispatcher.
+ */
+
+#ifndef DEFNS_H
+#include "defns.h"
+#endif
+
+#include "rtdbus.h"
+
+#define ROXTERM_DBUS_NAME RTDBUS_NAME ".term"
+#define ROXTERM_DBUS_OBJECT_PATH RTDBUS_OBJECT_PATH "/term"
+#define ROXTERM_DBUS_INTERFACE RTDBUS_INTERFACE
+#define ROXTERM_DBUS_METHOD_NAME "NewTerminal"
+/* Returns scrollback_describe()'s string, for inspecting the governor */
+#define ROXTERM_DBUS_SCROLLBACK_METHOD_NAME "GetScrollbackAllocations"
+/* Returns roxterm_describe_latency()'s string, for --stats */
+#define ROXTERM_DBUS_STATS_METHOD_NAME "GetLatencyStats"
+/* Returns roxterm_describe_memory()'s string */
+#define ROXTERM_DBUS_MEMORY_METHOD_NAME "GetMemoryUsage"
+/* Args: env (as), specs (aa{ss}) with keys command, directory, profile, title
+ * and window; see roxterm_launch_batch. Returns the new terminals' IDs (as).
+ */
+#define ROXTERM_DBUS_BATCH_METHOD_NAME "NewTerminals"
+/* Emitted for each terminal opened by NewTerminals when its command has been
+ * started or failed. Args: ID (s), pid, -1 on failure (i), error message (s)
+ */
+#define ROXTERM_DBUS_SPAWNED_SIGNAL_NAME "TerminalSpawned"
+
+typedef enum {
+    WORKER_PLACEMENT_LOAD,          /* Least CPU time recently */
+    WORKER_PLACEMENT_PROFILE,       /* Same profile, same worker */
+    WORKER_PLACEMENT_ROUND_ROBIN
+} WorkerPlacement;
+
+/* name may be NULL for the default */
+WorkerPlacement worker_pool_parse_placement(const char *name);
+
+/* The bus name used by the worker with the given index; free with g_free */
+char *worker_pool_get_worker_name(int index);
+
+gboolean worker_pool_is_worker(void);
+
+gboolean worker_pool_is_dispatcher(void);
+
+/* Called in a worker (global_options_worker >= 0) to take its bus name.
+ * handler receives the same methods as ROXTERM_DBUS_NAME's.
+ */
+gboolean worker_pool_start_worker(DBusObjectPathMessageFunction handler);
+
+/* Makes this process the dispatcher and starts the first worker with argv
+ * (including argv[0]) and envp.
+ */
+gboolean worker_pool_start_dispatcher(int size, WorkerPlacement placement,
+        char **argv, char **envp);
+
+/* Handles the messages specific to a dispatcher or worker, including
+ * NewTerminal in a dispatcher. Returns FALSE if message should be handled
+ * normally.
+ */
+gboolean worker_pool_handle_message(DBusMessage *message);
+
+/* Called in a worker to save the windows of the whole pool */
+gboolean worker_pool_save_session(const char *filename, const char *id);
+
+#endif /* WORKERPOOL_H */
+
+/* vi:set sw=4 ts=4 et cindent cino= */